@@ -46,6 +46,8 @@ class ZMQHandler():
         self.zmqSubSocket.setsockopt_string(zmq.SUBSCRIBE, "hashtx")
         self.zmqSubSocket.setsockopt_string(zmq.SUBSCRIBE, "rawblock")
         self.zmqSubSocket.setsockopt_string(zmq.SUBSCRIBE, "rawtx")
+        self.zmqSubSocket.setsockopt_string(zmq.SUBSCRIBE, "contractreceipt")
+        self.zmqSubSocket.setsockopt_string(zmq.SUBSCRIBE, "contractlog")
         self.zmqSubSocket.connect("tcp://127.0.0.1:%i" % port)
 
     async def handle(self) :
@@ -68,6 +70,12 @@ class ZMQHandler():
         elif topic == b"rawtx":
             print('- RAW TX ('+sequence+') -')
             print(binascii.hexlify(body))
+        elif topic == b"contractreceipt":
+            print('- CONTRACT RECEIPT ('+sequence+') -')
+            print(binascii.hexlify(body))
+        elif topic == b"contractlog":
+            print('- CONTRACT LOG ('+sequence+') -')
+            print(binascii.hexlify(body))
         # schedule ourselves to receive the next message
         asyncio.ensure_future(self.handle())
 
@@ -0,0 +1,138 @@
+#ifndef BITCOIN_ADDRESSINDEX_H
+#define BITCOIN_ADDRESSINDEX_H
+
+#include "amount.h"
+#include "crypto/sha256.h"
+#include "primitives/transaction.h"
+#include "script/script.h"
+#include "serialize.h"
+#include "uint256.h"
+
+/** Scripts are indexed by the SHA256 of the scriptPubKey */
+inline uint256 GetScriptHash(const CScript& script)
+{
+    uint256 hash;
+    CSHA256().Write(script.data(), script.size()).Finalize(hash.begin());
+    return hash;
+}
+
+/**
+ * A credit (output) or debit (spent input) of a script in the -addressindex
+ * history. Keys of a script sort by height, then position in the block.
+ */
+struct CAddressIndexKey {
+    uint256 scriptHash;
+    uint32_t nHeight;
+    uint32_t nTxIndex;
+    uint256 txid;
+    //! Output index, or input index if fSpending
+    uint32_t nIndex;
+    bool fSpending;
+
+    CAddressIndexKey() : nHeight(0), nTxIndex(0), nIndex(0), fSpending(false) {}
+    CAddressIndexKey(const uint256& scriptHashIn, uint32_t nHeightIn, uint32_t nTxIndexIn, const uint256& txidIn, uint32_t nIndexIn, bool fSpendingIn) :
+        scriptHash(scriptHashIn), nHeight(nHeightIn), nTxIndex(nTxIndexIn), txid(txidIn), nIndex(nIndexIn), fSpending(fSpendingIn) {}
+
+    template<typename Stream>
+    void Serialize(Stream& s) const {
+        s << scriptHash;
+        ser_writedata32be(s, nHeight);
+        ser_writedata32be(s, nTxIndex);
+        s << txid;
+        ser_writedata32be(s, nIndex);
+        s << fSpending;
+    }
+    template<typename Stream>
+    void Unserialize(Stream& s) {
+        s >> scriptHash;
+        nHeight = ser_readdata32be(s);
+        nTxIndex = ser_readdata32be(s);
+        s >> txid;
+        nIndex = ser_readdata32be(s);
+        s >> fSpending;
+    }
+};
+
+/** Seek position for the history of a script from a height on */
+struct CAddressIndexIteratorKey {
+    uint256 scriptHash;
+    uint32_t nHeight;
+
+    CAddressIndexIteratorKey(const uint256& scriptHashIn, uint32_t nHeightIn) : scriptHash(scriptHashIn), nHeight(nHeightIn) {}
+
+    template<typename Stream>
+    void Serialize(Stream& s) const {
+        s << scriptHash;
+        ser_writedata32be(s, nHeight);
+    }
+};
+
+/** An unspent output of a script */
+struct CAddressUnspentKey {
+    uint256 scriptHash;
+    COutPoint outpoint;
+
+    CAddressUnspentKey() {}
+    CAddressUnspentKey(const uint256& scriptHashIn, const COutPoint& outpointIn) : scriptHash(scriptHashIn), outpoint(outpointIn) {}
+
+    template<typename Stream>
+    void Serialize(Stream& s) const {
+        s << scriptHash << outpoint.hash;
+        ser_writedata32be(s, outpoint.n);
+    }
+    template<typename Stream>
+    void Unserialize(Stream& s) {
+        s >> scriptHash >> outpoint.hash;
+        outpoint.n = ser_readdata32be(s);
+    }
+};
+
+struct CAddressUnspentValue {
+    CAmount nValue;
+    CScript script;
+    uint32_t nHeight;
+    bool fCoinBase;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(nValue);
+        READWRITE(*(CScriptBase*)(&script));
+        READWRITE(nHeight);
+        READWRITE(fCoinBase);
+    }
+
+    //! A null value in an index update erases the output
+    CAddressUnspentValue() : nValue(-1), nHeight(0), fCoinBase(false) {}
+    CAddressUnspentValue(CAmount nValueIn, const CScript& scriptIn, uint32_t nHeightIn, bool fCoinBaseIn) :
+        nValue(nValueIn), script(scriptIn), nHeight(nHeightIn), fCoinBase(fCoinBaseIn) {}
+
+    bool IsNull() const { return nValue == -1; }
+};
+
+/**
+ * Running totals of a script, updated with each block connected or
+ * disconnected so that its balance is read without walking its outputs.
+ */
+struct CAddressBalance {
+    CAmount nBalance;
+    CAmount nReceived;
+    int64_t nUtxos;
+    //! Height the totals are up to date with, so that applying a block again is a no-op
+    uint32_t nHeight;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(nBalance);
+        READWRITE(nReceived);
+        READWRITE(nUtxos);
+        READWRITE(nHeight);
+    }
+
+    CAddressBalance() : nBalance(0), nReceived(0), nUtxos(0), nHeight(0) {}
+};
+
+#endif // BITCOIN_ADDRESSINDEX_H
@@ -4,7 +4,9 @@
 
 #include "bench.h"
 #include "coins.h"
+#include "dbwrapper.h"
 #include "policy/policy.h"
+#include "random.h"
 #include "wallet/crypter.h"
 
 #include <vector>
@@ -85,3 +87,57 @@ static void CCoinsCaching(benchmark::State& state)
 }
 
 BENCHMARK(CCoinsCaching);
+
+// Point lookups of a block's worth of inputs against an in-memory LevelDB
+// holding coins-like records, one Read() per key versus a single ReadMany().
+static const size_t DB_COINS_COUNT = 100000;
+static const size_t DB_COINS_LOOKUPS = 2000;
+
+static void SetupCoinsDB(CDBWrapper& db, std::vector<std::pair<char, COutPoint>>& keysRet)
+{
+    FastRandomContext rng(true);
+    CDBBatch batch(db);
+    Coin coin(CTxOut(50 * CENT, CScript() << OP_DUP << OP_HASH160 << std::vector<unsigned char>(20, 0) << OP_EQUALVERIFY << OP_CHECKSIG), 1, false);
+    std::vector<std::pair<char, COutPoint>> keys;
+    for (size_t i = 0; i < DB_COINS_COUNT; i++) {
+        keys.emplace_back('C', COutPoint(rng.rand256(), rng.randrange(4)));
+        batch.Write(keys.back(), coin);
+    }
+    db.WriteBatch(batch);
+    for (size_t i = 0; i < DB_COINS_LOOKUPS; i++) {
+        keysRet.push_back(keys[rng.randrange(keys.size())]);
+    }
+}
+
+static void CoinsDBRead(benchmark::State& state)
+{
+    CDBWrapper db(fs::path("coinsdb_bench"), 8 << 20, true, false, true);
+    std::vector<std::pair<char, COutPoint>> keys;
+    SetupCoinsDB(db, keys);
+
+    while (state.KeepRunning()) {
+        size_t found = 0;
+        for (const auto& key : keys) {
+            Coin coin;
+            found += db.Read(key, coin);
+        }
+        assert(found == keys.size());
+    }
+}
+
+static void CoinsDBReadMany(benchmark::State& state)
+{
+    CDBWrapper db(fs::path("coinsdb_bench"), 8 << 20, true, false, true);
+    std::vector<std::pair<char, COutPoint>> keys;
+    SetupCoinsDB(db, keys);
+
+    while (state.KeepRunning()) {
+        std::vector<Coin> coins;
+        std::vector<bool> found;
+        size_t n = db.ReadMany(keys, coins, found);
+        assert(n == keys.size());
+    }
+}
+
+BENCHMARK(CoinsDBRead);
+BENCHMARK(CoinsDBReadMany);
@@ -3,8 +3,11 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "bench.h"
+#include "random.h"
+#include "utilmoneystr.h"
 #include "wallet/wallet.h"
 
+#include <iostream>
 #include <set>
 
 static void addCoin(const CAmount& nValue, const CWallet& wallet, std::vector<COutput>& vCoins)
@@ -56,4 +59,100 @@ static void CoinSelection(benchmark::State& state)
     }
 }
 
+// Number of coins in the large wallet benchmarks
+static const int LARGE_WALLET_COINS = 20000;
+
+// Fill vCoins with a spread of coin sizes like a long used wallet has: many
+// small receipts and change outputs, fewer big ones. Values are log-uniform
+// between 0.0001 and 100 coins and deterministic across runs.
+static void addLargeWallet(const CWallet& wallet, std::vector<COutput>& vCoins)
+{
+    FastRandomContext rand(true);
+    for (int i = 0; i < LARGE_WALLET_COINS; i++) {
+        CAmount nValue = COIN / 10000;
+        for (uint64_t nSteps = rand.randrange(60); nSteps > 0; nSteps--)
+            nValue = nValue * 5 / 4;
+        addCoin(nValue + rand.randrange(COIN / 10000), wallet, vCoins);
+    }
+}
+
+// Print how often a selection needed no change and its average excess over the
+// target, after the timing line of the benchmark
+static void PrintSelectionQuality(const std::string& name, uint64_t nRuns, uint64_t nChangeless, CAmount nExcess)
+{
+    if (nRuns == 0)
+        return;
+    std::cout << "#" << name << ",changeless," << nChangeless << "/" << nRuns
+              << ",average_excess," << FormatMoney(nExcess / (CAmount)nRuns) << "\n";
+}
+
+// Pay amounts that some three coins of the wallet match to within the window,
+// so the branch and bound search has a changeless subset to find
+static void CoinSelectionLargeWalletChangeless(benchmark::State& state)
+{
+    const CWallet wallet;
+    std::vector<COutput> vCoins;
+    LOCK(wallet.cs_wallet);
+    addLargeWallet(wallet, vCoins);
+
+    FastRandomContext rand(true);
+    const CAmount nWindow = 1000;
+    uint64_t nRuns = 0, nChangeless = 0;
+    CAmount nExcess = 0;
+    while (state.KeepRunning()) {
+        CAmount nTarget = 0;
+        for (int i = 0; i < 3; i++)
+            nTarget += vCoins[rand.randrange(vCoins.size())].tx->tx->vout[0].nValue;
+        nTarget -= rand.randrange(nWindow);
+
+        std::set<CInputCoin> setCoinsRet;
+        CAmount nValueRet;
+        bool success = wallet.SelectCoinsMinConf(nTarget, 1, 6, 0, vCoins, setCoinsRet, nValueRet, nWindow);
+        assert(success);
+        assert(nValueRet >= nTarget);
+        nRuns++;
+        if (nValueRet <= nTarget + nWindow)
+            nChangeless++;
+        nExcess += nValueRet - nTarget;
+    }
+    // Compare with CoinSelectionLargeWalletFallback, which has no window
+    PrintSelectionQuality("CoinSelectionLargeWalletChangeless", nRuns, nChangeless, nExcess);
+
+    for (COutput output : vCoins)
+        delete output.tx;
+}
+
+// Pay arbitrary amounts with no window, which mostly falls back to the
+// stochastic approximation after the search gives up
+static void CoinSelectionLargeWalletFallback(benchmark::State& state)
+{
+    const CWallet wallet;
+    std::vector<COutput> vCoins;
+    LOCK(wallet.cs_wallet);
+    addLargeWallet(wallet, vCoins);
+
+    FastRandomContext rand(true);
+    uint64_t nRuns = 0, nChangeless = 0;
+    CAmount nExcess = 0;
+    while (state.KeepRunning()) {
+        CAmount nTarget = COIN / 100 + rand.randrange(10 * COIN);
+
+        std::set<CInputCoin> setCoinsRet;
+        CAmount nValueRet;
+        bool success = wallet.SelectCoinsMinConf(nTarget, 1, 6, 0, vCoins, setCoinsRet, nValueRet);
+        assert(success);
+        assert(nValueRet >= nTarget);
+        nRuns++;
+        if (nValueRet == nTarget)
+            nChangeless++;
+        nExcess += nValueRet - nTarget;
+    }
+    PrintSelectionQuality("CoinSelectionLargeWalletFallback", nRuns, nChangeless, nExcess);
+
+    for (COutput output : vCoins)
+        delete output.tx;
+}
+
 BENCHMARK(CoinSelection);
+BENCHMARK(CoinSelectionLargeWalletChangeless);
+BENCHMARK(CoinSelectionLargeWalletFallback);
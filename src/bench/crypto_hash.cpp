@@ -7,6 +7,7 @@
 #include "bench.h"
 #include "bloom.h"
 #include "hash.h"
+#include "hash_blake2.h"
 #include "random.h"
 #include "uint256.h"
 #include "utiltime.h"
@@ -52,6 +53,18 @@ static void SHA256_32b(benchmark::State& state)
     }
 }
 
+static void Blake2bHeader(benchmark::State& state)
+{
+    uint8_t header[CBlake2HeaderHasher::HEADER_SIZE] = {0};
+    CBlake2HeaderHasher hasher(header);
+    uint32_t nNonce = 0;
+    while (state.KeepRunning()) {
+        for (int i = 0; i < 1000000; i++) {
+            hasher.Hash(nNonce++);
+        }
+    }
+}
+
 static void SHA512(benchmark::State& state)
 {
     uint8_t hash[CSHA512::OUTPUT_SIZE];
@@ -98,6 +111,7 @@ BENCHMARK(SHA256);
 BENCHMARK(SHA512);
 
 BENCHMARK(SHA256_32b);
+BENCHMARK(Blake2bHeader);
 BENCHMARK(SipHash_32b);
 BENCHMARK(FastRandom_32bit);
 BENCHMARK(FastRandom_1bit);
@@ -105,4 +105,65 @@ static void VerifyScriptBench(benchmark::State& state)
     }
 }
 
+// Legacy P2PKH spends of a transaction with many inputs, verified with a
+// shared PrecomputedTransactionData like CheckInputs, or without one, in
+// which case every input hashes the whole transaction from scratch.
+static void VerifyLegacyManyInputs(benchmark::State& state, bool fCache)
+{
+    const int flags = SCRIPT_VERIFY_P2SH;
+    const int nInputs = 400;
+
+    CKey key;
+    static const std::array<unsigned char, 32> vchKey = {
+        {
+            0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1
+        }
+    };
+    key.Set(vchKey.begin(), vchKey.end(), false);
+    CPubKey pubkey = key.GetPubKey();
+    CScript scriptPubKey = CScript() << OP_DUP << OP_HASH160 << ToByteVector(pubkey.GetID()) << OP_EQUALVERIFY << OP_CHECKSIG;
+    CMutableTransaction txCredit = BuildCreditingTransaction(scriptPubKey);
+
+    CMutableTransaction txSpend = BuildSpendingTransaction(CScript(), txCredit);
+    txSpend.vin.resize(nInputs, txSpend.vin[0]);
+    for (int i = 0; i < nInputs; i++) {
+        txSpend.vin[i].prevout.n = i;
+    }
+    for (int i = 0; i < nInputs; i++) {
+        std::vector<unsigned char> vchSig;
+        key.Sign(SignatureHash(scriptPubKey, txSpend, i, SIGHASH_ALL, txCredit.vout[0].nValue, SIGVERSION_BASE), vchSig);
+        vchSig.push_back(static_cast<unsigned char>(SIGHASH_ALL));
+        txSpend.vin[i].scriptSig = CScript() << vchSig << ToByteVector(pubkey);
+    }
+    const CTransaction tx(txSpend);
+
+    while (state.KeepRunning()) {
+        PrecomputedTransactionData txdata(tx);
+        for (int i = 0; i < nInputs; i++) {
+            ScriptError err;
+            bool success = VerifyScript(
+                tx.vin[i].scriptSig,
+                scriptPubKey,
+                &tx.vin[i].scriptWitness,
+                flags,
+                fCache ? TransactionSignatureChecker(&tx, i, txCredit.vout[0].nValue, txdata) : TransactionSignatureChecker(&tx, i, txCredit.vout[0].nValue),
+                &err);
+            assert(err == SCRIPT_ERR_OK);
+            assert(success);
+        }
+    }
+}
+
+static void VerifyLegacyManyInputsBench(benchmark::State& state)
+{
+    VerifyLegacyManyInputs(state, true);
+}
+
+static void VerifyLegacyManyInputsUncachedBench(benchmark::State& state)
+{
+    VerifyLegacyManyInputs(state, false);
+}
+
 BENCHMARK(VerifyScriptBench);
+BENCHMARK(VerifyLegacyManyInputsBench);
+BENCHMARK(VerifyLegacyManyInputsUncachedBench);
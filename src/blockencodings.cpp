@@ -167,6 +167,42 @@ ReadStatus PartiallyDownloadedBlock::InitData(const CBlockHeaderAndShortTxIDs& c
     return READ_STATUS_OK;
 }
 
+size_t PartiallyDownloadedBlock::FillPredicted(const CBlockHeaderAndShortTxIDs& cmpctblock, const std::vector<CTransactionRef>& vtx_predicted) {
+    assert(!header.IsNull());
+    if (vtx_predicted.empty())
+        return 0;
+
+    // Map the short IDs of the slots still missing, skipping prefilled ones
+    std::vector<bool> prefilled(txn_available.size());
+    int32_t lastprefilledindex = -1;
+    for (const PrefilledTransaction& prefilledtx : cmpctblock.prefilledtxn) {
+        lastprefilledindex += prefilledtx.index + 1;
+        prefilled[lastprefilledindex] = true;
+    }
+    std::unordered_map<uint64_t, uint16_t> shorttxids;
+    for (size_t i = 0, j = 0; i < txn_available.size(); i++) {
+        if (prefilled[i])
+            continue;
+        if (!txn_available[i])
+            shorttxids[cmpctblock.shorttxids[j]] = i;
+        j++;
+    }
+
+    size_t count = 0;
+    for (const CTransactionRef& tx : vtx_predicted) {
+        std::unordered_map<uint64_t, uint16_t>::iterator idit = shorttxids.find(cmpctblock.GetShortID(tx->GetWitnessHash()));
+        if (idit == shorttxids.end() || txn_available[idit->second])
+            continue;
+        // If predictions share a short ID the first one wins; a wrong guess
+        // fails FillBlock's merkle check like any short ID collision
+        txn_available[idit->second] = tx;
+        count++;
+    }
+    mempool_count += count;
+    predicted_count += count;
+    return count;
+}
+
 bool PartiallyDownloadedBlock::IsTxAvailable(size_t index) const {
     assert(!header.IsNull());
     assert(index < txn_available.size());
@@ -207,7 +243,7 @@ ReadStatus PartiallyDownloadedBlock::FillBlock(CBlock& block, const std::vector<
         return READ_STATUS_CHECKBLOCK_FAILED;
     }
 
-    LogPrint(BCLog::CMPCTBLOCK, "Successfully reconstructed block %s with %lu txn prefilled, %lu txn from mempool (incl at least %lu from extra pool) and %lu txn requested\n", hash.ToString(), prefilled_count, mempool_count, extra_count, vtx_missing.size());
+    LogPrint(BCLog::CMPCTBLOCK, "Successfully reconstructed block %s with %lu txn prefilled, %lu txn from mempool (incl at least %lu from extra pool and %lu predicted) and %lu txn requested\n", hash.ToString(), prefilled_count, mempool_count, extra_count, predicted_count, vtx_missing.size());
     if (vtx_missing.size() < 5) {
         for (const auto& tx : vtx_missing) {
             LogPrint(BCLog::CMPCTBLOCK, "Reconstructed block %s required tx %s\n", hash.ToString(), tx->GetHash().ToString());
@@ -194,7 +194,7 @@ public:
 class PartiallyDownloadedBlock {
 protected:
     std::vector<CTransactionRef> txn_available;
-    size_t prefilled_count = 0, mempool_count = 0, extra_count = 0;
+    size_t prefilled_count = 0, mempool_count = 0, extra_count = 0, predicted_count = 0;
     CTxMemPool* pool;
 public:
     CBlockHeader header;
@@ -203,6 +203,11 @@ public:
     // extra_txn is a list of extra transactions to look at, in <witness hash, reference> form
     ReadStatus InitData(const CBlockHeaderAndShortTxIDs& cmpctblock, const std::vector<std::pair<uint256, CTransactionRef>>& extra_txn);
     bool IsTxAvailable(size_t index) const;
+    // The block's transactions so far, null where still missing
+    const std::vector<CTransactionRef>& GetAvailableTxn() const { return txn_available; }
+    // Fill missing transactions from ones we expect the block to contain, such
+    // as those the contract executor creates. Returns the number filled.
+    size_t FillPredicted(const CBlockHeaderAndShortTxIDs& cmpctblock, const std::vector<CTransactionRef>& vtx_predicted);
     ReadStatus FillBlock(CBlock& block, const std::vector<CTransactionRef>& vtx_missing);
 };
 
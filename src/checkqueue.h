@@ -8,6 +8,9 @@
 #include "sync.h"
 
 #include <algorithm>
+#include <atomic>
+#include <deque>
+#include <memory>
 #include <vector>
 
 #include <boost/thread/condition_variable.hpp>
@@ -25,12 +28,42 @@ class CCheckQueueControl;
   * onto the queue, where they are processed by N-1 worker threads. When
   * the master is done adding work, it temporarily joins the worker pool
   * as an N'th worker, until all jobs are done.
+  *
+  * Every worker owns a deque of chunks of verifications, which the master
+  * fills in turn. A worker takes chunks from the back of its own deque and,
+  * when that is empty, steals from the front of the others, so the workers
+  * only contend on the shared mutex to sleep and wake up.
   */
 template <typename T>
 class CCheckQueue
 {
 private:
-    //! Mutex to protect the inner state
+    //! Deques the workers are spread over; workers beyond that share them
+    static const int MAX_DEQUES = 64;
+
+    struct WorkerDeque
+    {
+        boost::mutex mutex;
+        std::deque<std::vector<T>> chunks;
+        //! Size of chunks, to skip empty deques without locking them
+        std::atomic<int> nChunks;
+
+        WorkerDeque() : nChunks(0) {}
+    };
+
+    //! The master's deque at index 0, followed by the workers'
+    std::unique_ptr<WorkerDeque[]> deques;
+
+    //! Number of workers that have started, and so own a deque
+    std::atomic<int> nWorkers;
+
+    //! Deque the next chunk from the master goes to
+    unsigned int nNextDeque;
+
+    //! Number of chunks in the deques
+    std::atomic<int> nQueued;
+
+    //! Mutex to sleep and wake up on
     boost::mutex mutex;
 
     //! Worker threads block on this when out of work
@@ -39,91 +72,114 @@ private:
     //! Master thread blocks on this when out of work
     boost::condition_variable condMaster;
 
-    //! The queue of elements to be processed.
-    //! As the order of booleans doesn't matter, it is used as a LIFO (stack)
-    std::vector<T> queue;
-
-    //! The number of workers (including the master) that are idle.
-    int nIdle;
-
-    //! The total number of workers (including the master).
-    int nTotal;
+    //! The number of workers waiting on condWorker.
+    std::atomic<int> nIdle;
 
     //! The temporary evaluation result.
-    bool fAllOk;
+    std::atomic<bool> fAllOk;
 
     /**
      * Number of verifications that haven't completed yet.
      * This includes elements that are no longer queued, but still in the
      * worker's own batches.
      */
-    unsigned int nTodo;
-
-    //! Whether we're shutting down.
-    bool fQuit;
+    std::atomic<unsigned int> nTodo;
 
-    //! The maximum number of elements to be processed in one batch
+    //! The maximum number of elements in one chunk
     unsigned int nBatchSize;
 
-    /** Internal function that does bulk of the verification work. */
-    bool Loop(bool fMaster = false)
+    //! The master collects this many elements before handing them out, so
+    //! that cheap checks don't cost a wake-up each
+    unsigned int nMinChunk;
+
+    //! Checks added by the master and not handed out yet
+    std::vector<T> vPending;
+
+    /** Take a chunk from the back of deque nOwn, or steal one from the front of another */
+    bool Take(int nOwn, std::vector<T>& vChecks)
     {
-        boost::condition_variable& cond = fMaster ? condMaster : condWorker;
-        std::vector<T> vChecks;
-        vChecks.reserve(nBatchSize);
-        unsigned int nNow = 0;
-        bool fOk = true;
-        do {
+        if (nQueued == 0)
+            return false;
+        const int nDequesUsed = 1 + std::min((int)nWorkers, MAX_DEQUES - 1);
+        for (int i = 0; i < nDequesUsed; i++) {
+            WorkerDeque& deque = deques[(nOwn + i) % nDequesUsed];
+            if (deque.nChunks == 0)
+                continue;
+            boost::unique_lock<boost::mutex> lock(deque.mutex);
+            if (deque.chunks.empty())
+                continue;
+            if (i == 0) {
+                vChecks.swap(deque.chunks.back());
+                deque.chunks.pop_back();
+            } else {
+                vChecks.swap(deque.chunks.front());
+                deque.chunks.pop_front();
+            }
+            deque.nChunks--;
+            nQueued--;
+            return true;
+        }
+        return false;
+    }
+
+    /** Hand the pending checks of the master to the workers, in chunks */
+    void Flush()
+    {
+        // Aim for a chunk per worker, so all of them can start on it at once
+        const int nDequesUsed = std::min((int)nWorkers, MAX_DEQUES - 1);
+        const unsigned int nChunk = std::max(nMinChunk, std::min(nBatchSize, (unsigned int)vPending.size() / (nDequesUsed + 1)));
+        int nChunks = 0;
+        for (size_t nStart = 0; nStart < vPending.size(); nStart += nChunk) {
+            std::vector<T> vChunk;
+            if (vPending.size() <= nChunk) {
+                vChunk.swap(vPending);
+                vPending.reserve(nChunk);
+            } else {
+                vChunk.resize(std::min((size_t)nChunk, vPending.size() - nStart));
+                for (size_t i = 0; i < vChunk.size(); i++)
+                    vChunk[i].swap(vPending[nStart + i]);
+            }
+            // Without workers yet the master runs everything in Wait
+            WorkerDeque& deque = deques[nDequesUsed ? 1 + nNextDeque++ % nDequesUsed : 0];
             {
-                boost::unique_lock<boost::mutex> lock(mutex);
-                // first do the clean-up of the previous loop run (allowing us to do it in the same critsect)
-                if (nNow) {
-                    fAllOk &= fOk;
-                    nTodo -= nNow;
-                    if (nTodo == 0 && !fMaster)
-                        // We processed the last element; inform the master it can exit and return the result
-                        condMaster.notify_one();
-                } else {
-                    // first iteration
-                    nTotal++;
-                }
-                // logically, the do loop starts here
-                while (queue.empty()) {
-                    if ((fMaster || fQuit) && nTodo == 0) {
-                        nTotal--;
-                        bool fRet = fAllOk;
-                        // reset the status for new work later
-                        if (fMaster)
-                            fAllOk = true;
-                        // return the current status
-                        return fRet;
-                    }
-                    nIdle++;
-                    cond.wait(lock); // wait
-                    nIdle--;
-                }
-                // Decide how many work units to process now.
-                // * Do not try to do everything at once, but aim for increasingly smaller batches so
-                //   all workers finish approximately simultaneously.
-                // * Try to account for idle jobs which will instantly start helping.
-                // * Don't do batches smaller than 1 (duh), or larger than nBatchSize.
-                nNow = std::max(1U, std::min(nBatchSize, (unsigned int)queue.size() / (nTotal + nIdle + 1)));
-                vChecks.resize(nNow);
-                for (unsigned int i = 0; i < nNow; i++) {
-                    // We want the lock on the mutex to be as short as possible, so swap jobs from the global
-                    // queue to the local batch vector instead of copying.
-                    vChecks[i].swap(queue.back());
-                    queue.pop_back();
-                }
-                // Check whether we need to do work at all
-                fOk = fAllOk;
+                boost::unique_lock<boost::mutex> lock(deque.mutex);
+                deque.chunks.push_back(std::move(vChunk));
+                deque.nChunks++;
+            }
+            nQueued++;
+            nChunks++;
+        }
+        vPending.clear();
+
+        if (nChunks && nIdle > 0) {
+            // Wake a worker per chunk; they steal whatever the busy ones leave
+            boost::unique_lock<boost::mutex> lock(mutex);
+            if (nChunks >= nIdle) {
+                condWorker.notify_all();
+            } else {
+                for (int i = 0; i < nChunks; i++)
+                    condWorker.notify_one();
             }
-            // execute work
-            for (T& check : vChecks)
-                if (fOk)
-                    fOk = check();
-            vChecks.clear();
-        } while (true);
+        }
+    }
+
+    /** Run a chunk, unless a verification already failed, and account for it */
+    void Run(std::vector<T>& vChecks)
+    {
+        const unsigned int nNow = vChecks.size();
+        bool fOk = fAllOk;
+        for (T& check : vChecks)
+            if (fOk)
+                fOk = check();
+        // The checks are destroyed before they count as done
+        vChecks.clear();
+        if (!fOk)
+            fAllOk = false;
+        if (nTodo.fetch_sub(nNow) == nNow) {
+            // We processed the last element; inform the master it can exit and return the result
+            boost::unique_lock<boost::mutex> lock(mutex);
+            condMaster.notify_one();
+        }
     }
 
 public:
@@ -131,33 +187,62 @@ public:
     boost::mutex ControlMutex;
 
     //! Create a new check queue
-    CCheckQueue(unsigned int nBatchSizeIn) : nIdle(0), nTotal(0), fAllOk(true), nTodo(0), fQuit(false), nBatchSize(nBatchSizeIn) {}
+    CCheckQueue(unsigned int nBatchSizeIn) : deques(new WorkerDeque[MAX_DEQUES]), nWorkers(0), nNextDeque(0), nQueued(0), nIdle(0), fAllOk(true), nTodo(0), nBatchSize(nBatchSizeIn), nMinChunk(std::max(1U, nBatchSizeIn / 16)) {}
 
     //! Worker thread
     void Thread()
     {
-        Loop();
+        const int nOwn = 1 + nWorkers++ % (MAX_DEQUES - 1);
+        std::vector<T> vChecks;
+        while (true) {
+            if (Take(nOwn, vChecks)) {
+                Run(vChecks);
+                continue;
+            }
+            boost::unique_lock<boost::mutex> lock(mutex);
+            // nIdle is raised before nQueued is read, and the master raises
+            // nQueued before it reads nIdle, so one of them sees the other
+            nIdle++;
+            try {
+                while (nQueued == 0)
+                    condWorker.wait(lock);
+            } catch (...) {
+                nIdle--;
+                throw;
+            }
+            nIdle--;
+        }
     }
 
     //! Wait until execution finishes, and return whether all evaluations were successful.
     bool Wait()
     {
-        return Loop(true);
+        Flush();
+        std::vector<T> vChecks;
+        while (Take(0, vChecks))
+            Run(vChecks);
+        {
+            // Only the master adds work, so what is left is being run by workers
+            boost::unique_lock<boost::mutex> lock(mutex);
+            while (nTodo != 0)
+                condMaster.wait(lock);
+        }
+        // reset the status for new work later
+        return fAllOk.exchange(true);
     }
 
     //! Add a batch of checks to the queue
     void Add(std::vector<T>& vChecks)
     {
-        boost::unique_lock<boost::mutex> lock(mutex);
+        if (vChecks.empty())
+            return;
+        nTodo += vChecks.size();
         for (T& check : vChecks) {
-            queue.push_back(T());
-            check.swap(queue.back());
+            vPending.push_back(T());
+            check.swap(vPending.back());
         }
-        nTodo += vChecks.size();
-        if (vChecks.size() == 1)
-            condWorker.notify_one();
-        else if (vChecks.size() > 1)
-            condWorker.notify_all();
+        if (vPending.size() >= nMinChunk)
+            Flush();
     }
 
     ~CCheckQueue()
@@ -9,13 +9,29 @@
 #include "random.h"
 #include <assert.h>
 
+#include <set>
+
 
 bool CCoinsView::GetCoin(const COutPoint &outpoint, Coin &coin) const { return false; }
 uint256 CCoinsView::GetBestBlock() const { return uint256(); }
 std::vector<uint256> CCoinsView::GetHeadBlocks() const { return std::vector<uint256>(); }
-bool CCoinsView::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) { return false; }
+bool CCoinsView::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock, bool fErase) { return false; }
 CCoinsViewCursor *CCoinsView::Cursor() const { return 0; }
 
+size_t CCoinsView::GetCoins(const std::vector<COutPoint> &vOutPoints, std::vector<Coin> &vCoins) const
+{
+    size_t nFound = 0;
+    vCoins.assign(vOutPoints.size(), Coin());
+    for (size_t i = 0; i < vOutPoints.size(); i++) {
+        if (GetCoin(vOutPoints[i], vCoins[i])) {
+            nFound++;
+        } else {
+            vCoins[i].Clear();
+        }
+    }
+    return nFound;
+}
+
 bool CCoinsView::HaveCoin(const COutPoint &outpoint) const
 {
     Coin coin;
@@ -28,13 +44,14 @@ bool CCoinsViewBacked::HaveCoin(const COutPoint &outpoint) const { return base->
 uint256 CCoinsViewBacked::GetBestBlock() const { return base->GetBestBlock(); }
 std::vector<uint256> CCoinsViewBacked::GetHeadBlocks() const { return base->GetHeadBlocks(); }
 void CCoinsViewBacked::SetBackend(CCoinsView &viewIn) { base = &viewIn; }
-bool CCoinsViewBacked::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) { return base->BatchWrite(mapCoins, hashBlock); }
+bool CCoinsViewBacked::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock, bool fErase) { return base->BatchWrite(mapCoins, hashBlock, fErase); }
 CCoinsViewCursor *CCoinsViewBacked::Cursor() const { return base->Cursor(); }
 size_t CCoinsViewBacked::EstimateSize() const { return base->EstimateSize(); }
 
 SaltedOutpointHasher::SaltedOutpointHasher() : k0(GetRand(std::numeric_limits<uint64_t>::max())), k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
 
-CCoinsViewCache::CCoinsViewCache(CCoinsView *baseIn) : CCoinsViewBacked(baseIn), cachedCoinsUsage(0) {}
+CCoinsViewCache::CCoinsViewCache(CCoinsView *baseIn) : CCoinsViewBacked(baseIn),
+    cacheCoins(0, SaltedOutpointHasher(), CCoinsMap::key_equal(), &cacheCoinsMemoryResource), cachedCoinsUsage(0) {}
 
 size_t CCoinsViewCache::DynamicMemoryUsage() const {
     return memusage::DynamicUsage(cacheCoins) + cachedCoinsUsage;
@@ -66,6 +83,72 @@ bool CCoinsViewCache::GetCoin(const COutPoint &outpoint, Coin &coin) const {
     return false;
 }
 
+size_t CCoinsViewCache::GetCoins(const std::vector<COutPoint> &vOutPoints, std::vector<Coin> &vCoins) const {
+    size_t nFound = 0;
+    vCoins.assign(vOutPoints.size(), Coin());
+    std::vector<COutPoint> vMissing;
+    std::vector<size_t> vMissingPos;
+    for (size_t i = 0; i < vOutPoints.size(); i++) {
+        CCoinsMap::const_iterator it = cacheCoins.find(vOutPoints[i]);
+        if (it != cacheCoins.end()) {
+            if (!it->second.coin.IsSpent()) {
+                vCoins[i] = it->second.coin;
+                nFound++;
+            }
+        } else {
+            vMissing.push_back(vOutPoints[i]);
+            vMissingPos.push_back(i);
+        }
+    }
+    if (vMissing.empty())
+        return nFound;
+
+    std::vector<Coin> vFetched;
+    base->GetCoins(vMissing, vFetched);
+    for (size_t i = 0; i < vMissing.size(); i++) {
+        if (vFetched[i].IsSpent())
+            continue;
+        vCoins[vMissingPos[i]] = InsertFetchedCoin(vMissing[i], std::move(vFetched[i]))->second.coin;
+        nFound++;
+    }
+    return nFound;
+}
+
+void CCoinsViewCache::FetchInputs(const std::vector<CTransactionRef>& vtx) const {
+    std::set<uint256> setTxids;
+    for (const auto& tx : vtx) {
+        setTxids.insert(tx->GetHash());
+    }
+    std::vector<COutPoint> vMissing;
+    for (const auto& tx : vtx) {
+        if (tx->IsCoinBase())
+            continue;
+        for (const CTxIn& txin : tx->vin) {
+            if (!setTxids.count(txin.prevout.hash) && !cacheCoins.count(txin.prevout))
+                vMissing.push_back(txin.prevout);
+        }
+    }
+    if (vMissing.empty())
+        return;
+    std::vector<Coin> vFetched;
+    base->GetCoins(vMissing, vFetched);
+    for (size_t i = 0; i < vMissing.size(); i++) {
+        if (!vFetched[i].IsSpent())
+            InsertFetchedCoin(vMissing[i], std::move(vFetched[i]));
+    }
+}
+
+CCoinsMap::iterator CCoinsViewCache::InsertFetchedCoin(const COutPoint &outpoint, Coin&& coin) const {
+    // Like in FetchCoin the entry is clean, and never FRESH as it is unspent.
+    CCoinsMap::iterator it;
+    bool inserted;
+    std::tie(it, inserted) = cacheCoins.emplace(std::piecewise_construct, std::forward_as_tuple(outpoint), std::forward_as_tuple(std::move(coin)));
+    if (inserted) {
+        cachedCoinsUsage += it->second.coin.DynamicMemoryUsage();
+    }
+    return it;
+}
+
 void CCoinsViewCache::AddCoin(const COutPoint &outpoint, Coin&& coin, bool possible_overwrite) {
     assert(!coin.IsSpent());
     if (coin.out.scriptPubKey.IsUnspendable()) return;
@@ -145,7 +228,7 @@ void CCoinsViewCache::SetBestBlock(const uint256 &hashBlockIn) {
     hashBlock = hashBlockIn;
 }
 
-bool CCoinsViewCache::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlockIn) {
+bool CCoinsViewCache::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlockIn, bool fErase) {
     for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end();) {
         if (it->second.flags & CCoinsCacheEntry::DIRTY) { // Ignore non-dirty entries (optimization).
             CCoinsMap::iterator itUs = cacheCoins.find(it->first);
@@ -156,7 +239,10 @@ bool CCoinsViewCache::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlockIn
                     // Otherwise we will need to create it in the parent
                     // and move the data up and mark it as dirty
                     CCoinsCacheEntry& entry = cacheCoins[it->first];
-                    entry.coin = std::move(it->second.coin);
+                    if (fErase)
+                        entry.coin = std::move(it->second.coin);
+                    else
+                        entry.coin = it->second.coin;
                     cachedCoinsUsage += entry.coin.DynamicMemoryUsage();
                     entry.flags = CCoinsCacheEntry::DIRTY;
                     // We can mark it FRESH in the parent if it was FRESH in the child
@@ -183,7 +269,10 @@ bool CCoinsViewCache::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlockIn
                 } else {
                     // A normal modification.
                     cachedCoinsUsage -= itUs->second.coin.DynamicMemoryUsage();
-                    itUs->second.coin = std::move(it->second.coin);
+                    if (fErase)
+                        itUs->second.coin = std::move(it->second.coin);
+                    else
+                        itUs->second.coin = it->second.coin;
                     cachedCoinsUsage += itUs->second.coin.DynamicMemoryUsage();
                     itUs->second.flags |= CCoinsCacheEntry::DIRTY;
                     // NOTE: It is possible the child has a FRESH flag here in
@@ -194,20 +283,68 @@ bool CCoinsViewCache::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlockIn
                 }
             }
         }
-        CCoinsMap::iterator itOld = it++;
-        mapCoins.erase(itOld);
+        if (fErase) {
+            CCoinsMap::iterator itOld = it++;
+            mapCoins.erase(itOld);
+        } else {
+            ++it;
+        }
     }
     hashBlock = hashBlockIn;
     return true;
 }
 
 bool CCoinsViewCache::Flush() {
-    bool fOk = base->BatchWrite(cacheCoins, hashBlock);
-    cacheCoins.clear();
-    cachedCoinsUsage = 0;
+    bool fOk = base->BatchWrite(cacheCoins, hashBlock, true);
+    ReallocateCache();
     return fOk;
 }
 
+bool CCoinsViewCache::Sync() {
+    bool fOk = base->BatchWrite(cacheCoins, hashBlock, false);
+    if (!fOk)
+        return false;
+    // The base is now up to date: spent entries can go, the rest is clean.
+    for (CCoinsMap::iterator it = cacheCoins.begin(); it != cacheCoins.end();) {
+        if (it->second.coin.IsSpent()) {
+            cachedCoinsUsage -= it->second.coin.DynamicMemoryUsage();
+            it = cacheCoins.erase(it);
+        } else {
+            it->second.flags = 0;
+            ++it;
+        }
+    }
+    return true;
+}
+
+size_t CCoinsViewCache::Trim(size_t nTargetUsage) {
+    size_t nEvicted = 0;
+    for (CCoinsMap::iterator it = cacheCoins.begin(); it != cacheCoins.end() && DynamicMemoryUsage() > nTargetUsage;) {
+        if (it->second.flags == 0) {
+            cachedCoinsUsage -= it->second.coin.DynamicMemoryUsage();
+            it = cacheCoins.erase(it);
+            nEvicted++;
+        } else {
+            ++it;
+        }
+    }
+    return nEvicted;
+}
+
+void ReallocateCoinsMap(CCoinsMap& map, CCoinsMapMemoryResource& resource)
+{
+    map.~CCoinsMap();
+    resource.~CCoinsMapMemoryResource();
+    new (&resource) CCoinsMapMemoryResource();
+    new (&map) CCoinsMap(0, SaltedOutpointHasher(), CCoinsMap::key_equal(), &resource);
+}
+
+void CCoinsViewCache::ReallocateCache()
+{
+    ReallocateCoinsMap(cacheCoins, cacheCoinsMemoryResource);
+    cachedCoinsUsage = 0;
+}
+
 void CCoinsViewCache::Uncache(const COutPoint& hash)
 {
     CCoinsMap::iterator it = cacheCoins.find(hash);
@@ -12,11 +12,13 @@
 #include "hash.h"
 #include "memusage.h"
 #include "serialize.h"
+#include "support/allocators/pool.h"
 #include "uint256.h"
 
 #include <assert.h>
 #include <stdint.h>
 
+#include <functional>
 #include <unordered_map>
 
 /**
@@ -118,7 +120,24 @@ struct CCoinsCacheEntry
     explicit CCoinsCacheEntry(Coin&& coin_) : coin(std::move(coin_)), flags(0) {}
 };
 
-typedef std::unordered_map<COutPoint, CCoinsCacheEntry, SaltedOutpointHasher> CCoinsMap;
+/**
+ * The nodes of CCoinsMap are allocated from a pool instead of one malloc each,
+ * which saves the per-allocation overhead and keeps neighbouring entries
+ * close together. The block size leaves room for the node's next pointer and
+ * cached hash on top of the value itself.
+ */
+typedef PoolAllocator<std::pair<const COutPoint, CCoinsCacheEntry>,
+                      sizeof(std::pair<const COutPoint, CCoinsCacheEntry>) + sizeof(void*) * 4,
+                      alignof(void*)> CCoinsMapAllocator;
+typedef std::unordered_map<COutPoint, CCoinsCacheEntry, SaltedOutpointHasher, std::equal_to<COutPoint>, CCoinsMapAllocator> CCoinsMap;
+typedef CCoinsMapAllocator::ResourceType CCoinsMapMemoryResource;
+
+/**
+ * Empty a CCoinsMap allocated from resource and give the pool's memory back.
+ * Clearing the map would only put its nodes on the pool's free lists, so both
+ * are destroyed and constructed again in place.
+ */
+void ReallocateCoinsMap(CCoinsMap& map, CCoinsMapMemoryResource& resource);
 
 /** Cursor for iterating over CoinsView state */
 class CCoinsViewCursor
@@ -150,6 +169,14 @@ public:
      */
     virtual bool GetCoin(const COutPoint &outpoint, Coin &coin) const;
 
+    /** Retrieve several coins at once, which backends may serve in a single
+     *  pass. vCoins is resized to match vOutPoints; entries for outpoints
+     *  without an unspent coin are left spent. Returns the number of unspent
+     *  coins found. The default implementation calls GetCoin for every
+     *  outpoint, so views that only override GetCoin stay consistent.
+     */
+    virtual size_t GetCoins(const std::vector<COutPoint> &vOutPoints, std::vector<Coin> &vCoins) const;
+
     //! Just check whether a given outpoint is unspent.
     virtual bool HaveCoin(const COutPoint &outpoint) const;
 
@@ -163,8 +190,10 @@ public:
     virtual std::vector<uint256> GetHeadBlocks() const;
 
     //! Do a bulk modification (multiple Coin changes + BestBlock change).
-    //! The passed mapCoins can be modified.
-    virtual bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock);
+    //! The passed mapCoins can be modified. If fErase is set, the entries
+    //! are consumed and removed from mapCoins; otherwise they are copied and
+    //! mapCoins is left as it was.
+    virtual bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock, bool fErase);
 
     //! Get a cursor to iterate over the whole state
     virtual CCoinsViewCursor *Cursor() const;
@@ -190,7 +219,7 @@ public:
     uint256 GetBestBlock() const override;
     std::vector<uint256> GetHeadBlocks() const override;
     void SetBackend(CCoinsView &viewIn);
-    bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) override;
+    bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock, bool fErase) override;
     CCoinsViewCursor *Cursor() const override;
     size_t EstimateSize() const override;
 };
@@ -205,6 +234,8 @@ protected:
      * declared as "const".  
      */
     mutable uint256 hashBlock;
+    /* Backing memory for cacheCoins; must be declared before it. */
+    mutable CCoinsMapMemoryResource cacheCoinsMemoryResource;
     mutable CCoinsMap cacheCoins;
 
     /* Cached dynamic memory usage for the inner Coin objects. */
@@ -215,10 +246,11 @@ public:
 
     // Standard CCoinsView methods
     bool GetCoin(const COutPoint &outpoint, Coin &coin) const override;
+    size_t GetCoins(const std::vector<COutPoint> &vOutPoints, std::vector<Coin> &vCoins) const override;
     bool HaveCoin(const COutPoint &outpoint) const override;
     uint256 GetBestBlock() const override;
     void SetBestBlock(const uint256 &hashBlock);
-    bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) override;
+    bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock, bool fErase) override;
     CCoinsViewCursor* Cursor() const override {
         throw std::logic_error("CCoinsViewCache cursor iteration not supported.");
     }
@@ -262,6 +294,20 @@ public:
      */
     bool Flush();
 
+    /**
+     * Push the modifications applied to this cache to its base like Flush(),
+     * but keep the unspent entries around (no longer marked dirty), so that
+     * the cache stays warm.
+     */
+    bool Sync();
+
+    /**
+     * Evict entries that are not modified until the memory usage of the
+     * cache drops to nTargetUsage bytes or no unmodified entries are left.
+     * Returns the number of evicted entries.
+     */
+    size_t Trim(size_t nTargetUsage);
+
     /**
      * Removes the UTXO with the given outpoint from the cache, if it is
      * not modified.
@@ -287,8 +333,19 @@ public:
     //! Check whether all prevouts of the transaction are present in the UTXO set represented by this view
     bool HaveInputs(const CTransaction& tx) const;
 
+    /**
+     * Bring the inputs of the given transactions into the cache, reading the
+     * missing ones from the backing view with a single GetCoins call. Inputs
+     * spending outputs of the transactions themselves are skipped.
+     */
+    void FetchInputs(const std::vector<CTransactionRef>& vtx) const;
+
 private:
     CCoinsMap::iterator FetchCoin(const COutPoint &outpoint) const;
+    CCoinsMap::iterator InsertFetchedCoin(const COutPoint &outpoint, Coin&& coin) const;
+
+    //! Drop all entries and give the memory they used back to the system
+    void ReallocateCache();
 
     /**
      * By making the copy constructor private, we prevent accidentally using it when one intends to create a cache on top of a base cache.
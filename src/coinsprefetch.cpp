@@ -0,0 +1,207 @@
+#include "coinsprefetch.h"
+
+#include "memusage.h"
+
+#include <algorithm>
+#include <set>
+
+#include <boost/thread.hpp>
+
+CCoinsViewPrefetch::CCoinsViewPrefetch(CCoinsView* viewIn, size_t nMaxUsageIn) :
+    CCoinsViewBacked(viewIn),
+    cacheCoins(0, SaltedOutpointHasher(), CCoinsMap::key_equal(), &cacheCoinsMemoryResource), cachedCoinsUsage(0), nMaxUsage(nMaxUsageIn), nEpoch(0), nHits(0), nFetched(0) {}
+
+bool CCoinsViewPrefetch::GetCoin(const COutPoint &outpoint, Coin &coin) const
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        CCoinsMap::iterator it = cacheCoins.find(outpoint);
+        if (it != cacheCoins.end()) {
+            // The caller caches the coin itself, no need to keep a second copy.
+            cachedCoinsUsage -= it->second.coin.DynamicMemoryUsage();
+            coin = std::move(it->second.coin);
+            cacheCoins.erase(it);
+            nHits++;
+            return !coin.IsSpent();
+        }
+    }
+    return base->GetCoin(outpoint, coin);
+}
+
+size_t CCoinsViewPrefetch::GetCoins(const std::vector<COutPoint> &vOutPoints, std::vector<Coin> &vCoins) const
+{
+    size_t nFound = 0;
+    vCoins.assign(vOutPoints.size(), Coin());
+    std::vector<COutPoint> vMissing;
+    std::vector<size_t> vMissingPos;
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        for (size_t i = 0; i < vOutPoints.size(); i++) {
+            CCoinsMap::iterator it = cacheCoins.find(vOutPoints[i]);
+            if (it == cacheCoins.end()) {
+                vMissing.push_back(vOutPoints[i]);
+                vMissingPos.push_back(i);
+                continue;
+            }
+            cachedCoinsUsage -= it->second.coin.DynamicMemoryUsage();
+            vCoins[i] = std::move(it->second.coin);
+            cacheCoins.erase(it);
+            nHits++;
+            if (!vCoins[i].IsSpent())
+                nFound++;
+        }
+    }
+    if (vMissing.empty())
+        return nFound;
+
+    std::vector<Coin> vFetched;
+    nFound += base->GetCoins(vMissing, vFetched);
+    for (size_t i = 0; i < vMissing.size(); i++) {
+        vCoins[vMissingPos[i]] = std::move(vFetched[i]);
+    }
+    return nFound;
+}
+
+bool CCoinsViewPrefetch::HaveCoin(const COutPoint &outpoint) const
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        CCoinsMap::const_iterator it = cacheCoins.find(outpoint);
+        if (it != cacheCoins.end()) {
+            return !it->second.coin.IsSpent();
+        }
+    }
+    return base->HaveCoin(outpoint);
+}
+
+bool CCoinsViewPrefetch::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock, bool fErase)
+{
+    // Bump the epoch both before and after the write: a worker that read
+    // from the backing view while it was being modified will notice that
+    // the epoch changed and drop its results.
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        nEpoch++;
+        ClearCache();
+    }
+    bool fOk = base->BatchWrite(mapCoins, hashBlock, fErase);
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        nEpoch++;
+        ClearCache();
+    }
+    return fOk;
+}
+
+void CCoinsViewPrefetch::ClearCache()
+{
+    ReallocateCoinsMap(cacheCoins, cacheCoinsMemoryResource);
+    cachedCoinsUsage = 0;
+}
+
+void CCoinsViewPrefetch::Prefetch(const std::shared_ptr<const CBlock>& pblock)
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    if (queue.size() >= MAX_COINS_PREFETCH_QUEUE) {
+        // Workers are behind; this block will be read on demand instead.
+        return;
+    }
+    queue.push_back(pblock);
+    condWorker.notify_one();
+}
+
+void CCoinsViewPrefetch::PrefetchBlock(const CBlock& block)
+{
+    // Outputs created inside the block itself are not in the backing view yet.
+    std::set<uint256> setTxids;
+    for (const auto& tx : block.vtx) {
+        setTxids.insert(tx->GetHash());
+    }
+
+    std::vector<COutPoint> vOutPoints;
+    uint64_t nEpochStart;
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        nEpochStart = nEpoch;
+        for (const auto& tx : block.vtx) {
+            if (tx->IsCoinBase())
+                continue;
+            for (const CTxIn& txin : tx->vin) {
+                if (setTxids.count(txin.prevout.hash) || cacheCoins.count(txin.prevout))
+                    continue;
+                vOutPoints.push_back(txin.prevout);
+            }
+        }
+    }
+    if (vOutPoints.empty())
+        return;
+
+    std::sort(vOutPoints.begin(), vOutPoints.end());
+    vOutPoints.erase(std::unique(vOutPoints.begin(), vOutPoints.end()), vOutPoints.end());
+
+    boost::this_thread::interruption_point();
+    std::vector<Coin> vFetched;
+    base->GetCoins(vOutPoints, vFetched);
+
+    boost::unique_lock<boost::mutex> lock(mutex);
+    if (nEpoch != nEpochStart) {
+        // The backing view was written to while we were reading from it.
+        return;
+    }
+    if (memusage::DynamicUsage(cacheCoins) + cachedCoinsUsage > nMaxUsage) {
+        // Entries that were never asked for (e.g. because the cache above
+        // already had them) are only dropped here; start over.
+        ClearCache();
+    }
+    for (size_t i = 0; i < vOutPoints.size(); i++) {
+        if (vFetched[i].IsSpent())
+            continue;
+        CCoinsMap::iterator it;
+        bool inserted;
+        std::tie(it, inserted) = cacheCoins.emplace(std::piecewise_construct, std::forward_as_tuple(vOutPoints[i]), std::forward_as_tuple(std::move(vFetched[i])));
+        if (inserted) {
+            cachedCoinsUsage += it->second.coin.DynamicMemoryUsage();
+            nFetched++;
+        }
+    }
+}
+
+void CCoinsViewPrefetch::Thread()
+{
+    while (true) {
+        std::shared_ptr<const CBlock> pblock;
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            while (queue.empty()) {
+                condWorker.wait(lock);
+            }
+            pblock = queue.front();
+            queue.pop_front();
+        }
+        PrefetchBlock(*pblock);
+    }
+}
+
+size_t CCoinsViewPrefetch::GetCacheSize() const
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    return cacheCoins.size();
+}
+
+size_t CCoinsViewPrefetch::DynamicMemoryUsage() const
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    return memusage::DynamicUsage(cacheCoins) + cachedCoinsUsage;
+}
+
+uint64_t CCoinsViewPrefetch::GetHits() const
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    return nHits;
+}
+
+uint64_t CCoinsViewPrefetch::GetFetched() const
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    return nFetched;
+}
@@ -0,0 +1,91 @@
+#ifndef BITCOIN_COINSPREFETCH_H
+#define BITCOIN_COINSPREFETCH_H
+
+#include "coins.h"
+#include "primitives/block.h"
+
+#include <deque>
+#include <memory>
+
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+
+/** Maximum number of coin prefetch threads allowed */
+static const int MAX_COINS_PREFETCH_THREADS = 16;
+/** -prefetchthreads default (number of coin prefetch threads, 0 = disabled) */
+static const int DEFAULT_COINS_PREFETCH_THREADS = 2;
+/** Maximum number of blocks waiting to be prefetched */
+static const size_t MAX_COINS_PREFETCH_QUEUE = 32;
+
+/**
+ * Read-only cache layer that sits between pcoinsTip and the coins database,
+ * and is filled by background threads with the inputs of blocks that have
+ * been downloaded but not connected yet.
+ *
+ * The layer is only consulted when pcoinsTip misses, in which case the
+ * database holds the authoritative value for the outpoint. A coin found here
+ * is handed to the caller and forgotten, as it now lives in the cache above.
+ * Results are discarded whenever a BatchWrite happened while they were read,
+ * so that a prefetched coin is never older than the database.
+ */
+class CCoinsViewPrefetch : public CCoinsViewBacked
+{
+private:
+    //! Mutex to protect the inner state
+    mutable boost::mutex mutex;
+
+    //! Worker threads block on this when out of work
+    boost::condition_variable condWorker;
+
+    //! Blocks whose inputs still have to be fetched
+    std::deque<std::shared_ptr<const CBlock>> queue;
+
+    //! Prefetched coins, keyed by outpoint, and the pool they are allocated from
+    mutable CCoinsMapMemoryResource cacheCoinsMemoryResource;
+    mutable CCoinsMap cacheCoins;
+
+    //! Dynamic memory usage of the Coin objects in cacheCoins
+    mutable size_t cachedCoinsUsage;
+
+    //! Memory budget for cacheCoins, in bytes
+    const size_t nMaxUsage;
+
+    //! Incremented around every write to the backing view
+    uint64_t nEpoch;
+
+    //! Statistics
+    mutable uint64_t nHits;
+    uint64_t nFetched;
+
+    //! Drop all prefetched coins and their memory (requires mutex)
+    void ClearCache();
+
+public:
+    CCoinsViewPrefetch(CCoinsView* viewIn, size_t nMaxUsageIn);
+
+    bool GetCoin(const COutPoint &outpoint, Coin &coin) const override;
+    size_t GetCoins(const std::vector<COutPoint> &vOutPoints, std::vector<Coin> &vCoins) const override;
+    bool HaveCoin(const COutPoint &outpoint) const override;
+    bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock, bool fErase) override;
+
+    //! Queue the inputs of a context-free checked block for prefetching
+    void Prefetch(const std::shared_ptr<const CBlock>& pblock);
+
+    //! Fetch the inputs of a block from the backing view (runs on worker threads)
+    void PrefetchBlock(const CBlock& block);
+
+    //! Worker thread, returns when interrupted
+    void Thread();
+
+    //! Number of coins currently held
+    size_t GetCacheSize() const;
+
+    //! Calculate the size of the cache (in bytes)
+    size_t DynamicMemoryUsage() const;
+
+    //! Number of prefetched coins that were used / read in total
+    uint64_t GetHits() const;
+    uint64_t GetFetched() const;
+};
+
+#endif // BITCOIN_COINSPREFETCH_H
@@ -0,0 +1,197 @@
+#include "contractregistry.h"
+
+//! memory allocated to contract registry DB specific cache (2 MiB)
+static const int64_t DB_CACHE_SIZE = 2 << 20;
+
+static const char DB_CONTRACT = 'c';
+static const char DB_ADDRESS = 'a';
+static const char DB_DESTROYED = 'd';
+static const char DB_COUNT = 'n';
+static const char DB_COMPLETE = 'C';
+
+//! Bumped when what is recorded changes, so that older registries count as incomplete
+static const char REGISTRY_VERSION = '2';
+
+namespace {
+
+/** Contract number, big endian so that the database keeps creation order */
+struct ContractIndexKey {
+    char prefix;
+    uint32_t n;
+
+    explicit ContractIndexKey(uint32_t nIn = 0, char prefixIn = DB_CONTRACT) : prefix(prefixIn), n(nIn) {}
+
+    template <typename Stream>
+    void Serialize(Stream& s) const
+    {
+        s << prefix;
+        ser_writedata32be(s, n);
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s)
+    {
+        s >> prefix;
+        n = ser_readdata32be(s);
+    }
+};
+
+} // namespace
+
+ContractRegistry* ContractRegistry::sInstance = nullptr;
+
+ContractRegistry* ContractRegistry::Init(const fs::path& path, bool fWipe)
+{
+    if (sInstance == nullptr) {
+        sInstance = new ContractRegistry(path, fWipe);
+    }
+    return sInstance;
+}
+
+ContractRegistry* ContractRegistry::Instance()
+{
+    assert(sInstance != nullptr);
+    return sInstance;
+}
+
+void ContractRegistry::Release()
+{
+    if (sInstance != nullptr) {
+        delete sInstance;
+        sInstance = nullptr;
+    }
+}
+
+ContractRegistry::ContractRegistry(const fs::path& path, bool fWipe)
+    : mDB(path / "registry", DB_CACHE_SIZE, false, fWipe, true), mCount(0), mComplete(false)
+{
+    mDB.Read(DB_COUNT, mCount);
+    char nVersion;
+    mComplete = mDB.Read(DB_COMPLETE, nVersion) && nVersion == REGISTRY_VERSION;
+
+    std::unique_ptr<CDBIterator> pcursor(mDB.NewIterator());
+    for (pcursor->Seek(ContractIndexKey(0, DB_DESTROYED)); pcursor->Valid(); pcursor->Next()) {
+        ContractIndexKey key;
+        uint32_t nHeight;
+        if (!pcursor->GetKey(key) || key.prefix != DB_DESTROYED || !pcursor->GetValue(nHeight))
+            break;
+        mDestroyed[key.n] = nHeight;
+    }
+}
+
+ContractRegistry::~ContractRegistry()
+{
+}
+
+bool ContractRegistry::RemoveTail(CDBBatch& batch, uint32_t nHeight, uint32_t& nCount, std::map<uint32_t, uint32_t>& destroyed) const
+{
+    for (auto it = destroyed.begin(); it != destroyed.end();) {
+        if (it->second < nHeight) {
+            ++it;
+            continue;
+        }
+        batch.Erase(ContractIndexKey(it->first, DB_DESTROYED));
+        it = destroyed.erase(it);
+    }
+    while (nCount > 0) {
+        ContractInfo info;
+        if (!mDB.Read(ContractIndexKey(nCount - 1), info))
+            return false;
+        if (info.nHeight < nHeight)
+            break;
+        batch.Erase(ContractIndexKey(nCount - 1));
+        batch.Erase(std::make_pair(DB_ADDRESS, info.address));
+        nCount--;
+    }
+    return true;
+}
+
+bool ContractRegistry::Add(uint32_t nHeight, const std::vector<ContractInfo>& contracts, const std::vector<uint160>& destroyed)
+{
+    CDBBatch batch(mDB);
+    uint32_t nCount = mCount;
+    std::map<uint32_t, uint32_t> mapDestroyed = mDestroyed;
+    if (!RemoveTail(batch, nHeight, nCount, mapDestroyed))
+        return false;
+    if (nCount == mCount && mapDestroyed.size() == mDestroyed.size() && contracts.empty() && destroyed.empty())
+        return true;
+    std::map<uint160, uint32_t> mapAdded;
+    for (const ContractInfo& info : contracts) {
+        batch.Write(ContractIndexKey(nCount), info);
+        batch.Write(std::make_pair(DB_ADDRESS, info.address), nCount);
+        mapAdded[info.address] = nCount;
+        nCount++;
+    }
+    for (const uint160& address : destroyed) {
+        uint32_t n;
+        const auto it = mapAdded.find(address);
+        if (it != mapAdded.end()) {
+            n = it->second;
+        } else if (!mDB.Read(std::make_pair(DB_ADDRESS, address), n) || n >= nCount) {
+            // Not a contract the registry knows about
+            continue;
+        }
+        if (mapDestroyed.emplace(n, nHeight).second)
+            batch.Write(ContractIndexKey(n, DB_DESTROYED), nHeight);
+    }
+    batch.Write(DB_COUNT, nCount);
+    if (!mDB.WriteBatch(batch))
+        return false;
+    mCount = nCount;
+    mDestroyed.swap(mapDestroyed);
+    return true;
+}
+
+bool ContractRegistry::Remove(uint32_t nHeight)
+{
+    CDBBatch batch(mDB);
+    uint32_t nCount = mCount;
+    std::map<uint32_t, uint32_t> mapDestroyed = mDestroyed;
+    if (!RemoveTail(batch, nHeight, nCount, mapDestroyed))
+        return false;
+    if (nCount == mCount && mapDestroyed.size() == mDestroyed.size())
+        return true;
+    batch.Write(DB_COUNT, nCount);
+    if (!mDB.WriteBatch(batch))
+        return false;
+    mCount = nCount;
+    mDestroyed.swap(mapDestroyed);
+    return true;
+}
+
+bool ContractRegistry::List(uint32_t nStart, size_t nMax, std::vector<ContractInfo>& contracts) const
+{
+    // Skip over the destroyed contracts numbered before the one to start from
+    for (const auto& entry : mDestroyed) {
+        if (entry.first > nStart)
+            break;
+        nStart++;
+    }
+
+    std::unique_ptr<CDBIterator> pcursor(const_cast<CDBWrapper&>(mDB).NewIterator());
+    pcursor->Seek(ContractIndexKey(nStart));
+    for (uint32_t n = nStart; n < mCount && contracts.size() < nMax; n++) {
+        ContractIndexKey key;
+        ContractInfo info;
+        if (!pcursor->Valid() || !pcursor->GetKey(key) || key.n != n || !pcursor->GetValue(info))
+            return false;
+        if (!mDestroyed.count(n))
+            contracts.push_back(info);
+        pcursor->Next();
+    }
+    return true;
+}
+
+bool ContractRegistry::Get(const uint160& address, ContractInfo& info) const
+{
+    uint32_t n;
+    return mDB.Read(std::make_pair(DB_ADDRESS, address), n) && !mDestroyed.count(n) && mDB.Read(ContractIndexKey(n), info);
+}
+
+bool ContractRegistry::SetComplete()
+{
+    if (!mDB.Write(DB_COMPLETE, REGISTRY_VERSION, true))
+        return false;
+    mComplete = true;
+    return true;
+}
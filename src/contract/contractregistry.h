@@ -0,0 +1,88 @@
+#ifndef BITCOINX_CONTRACT_CONTRACTREGISTRY_H
+#define BITCOINX_CONTRACT_CONTRACTREGISTRY_H
+
+#include "dbwrapper.h"
+#include "fs.h"
+#include "serialize.h"
+#include "uint256.h"
+
+#include <map>
+#include <vector>
+
+/** A contract created on chain, as recorded in the ContractRegistry */
+struct ContractInfo {
+    uint160 address;
+    uint160 creator;
+    uint256 codeHash;
+    uint256 txid;
+    uint32_t nHeight;
+
+    ContractInfo() : nHeight(0) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        READWRITE(address);
+        READWRITE(creator);
+        READWRITE(codeHash);
+        READWRITE(txid);
+        READWRITE(nHeight);
+    }
+};
+
+/**
+ * Persistent list of the contracts created on the active chain, numbered in
+ * creation order from 0, so that a page of it is read with a single seek
+ * instead of a walk over the whole state trie.
+ *
+ * Entries are appended by ConnectBlock and dropped from the end by
+ * DisconnectBlock. Both operations are keyed on the block height and can be
+ * repeated, so replaying blocks after an unclean shutdown leaves no
+ * duplicates behind. Contracts that self-destruct keep their number but are
+ * marked destroyed at the height they went away, and are skipped when
+ * listing until that height is disconnected.
+ */
+class ContractRegistry
+{
+public:
+    static ContractRegistry* Init(const fs::path& path, bool fWipe = false);
+    static ContractRegistry* Instance();
+    static void Release();
+
+    //! Record the contracts created and destroyed by the block at nHeight, replacing any left over entries from that height on
+    bool Add(uint32_t nHeight, const std::vector<ContractInfo>& contracts, const std::vector<uint160>& destroyed = std::vector<uint160>());
+    //! Forget the contracts created or destroyed at nHeight or above
+    bool Remove(uint32_t nHeight);
+
+    //! Number of contracts that still exist
+    uint32_t Count() const { return mCount - mDestroyed.size(); }
+    //! Read up to nMax existing contracts, starting with the nStart-th one
+    bool List(uint32_t nStart, size_t nMax, std::vector<ContractInfo>& contracts) const;
+    //! Look up an existing contract by address
+    bool Get(const uint160& address, ContractInfo& info) const;
+
+    //! Whether the registry was built along with the whole active chain
+    bool IsComplete() const { return mComplete; }
+    bool SetComplete();
+
+private:
+    ContractRegistry(const fs::path& path, bool fWipe = false);
+    ContractRegistry(const ContractRegistry&) = delete;
+    ContractRegistry& operator=(const ContractRegistry&) = delete;
+    ~ContractRegistry();
+
+    bool RemoveTail(CDBBatch& batch, uint32_t nHeight, uint32_t& nCount, std::map<uint32_t, uint32_t>& destroyed) const;
+
+private:
+    CDBWrapper mDB;
+    uint32_t mCount;
+    //! Numbers of the destroyed contracts, with the height they were destroyed at
+    std::map<uint32_t, uint32_t> mDestroyed;
+    bool mComplete;
+
+    static ContractRegistry* sInstance;
+};
+
+#endif // BITCOINX_CONTRACT_CONTRACTREGISTRY_H
@@ -1,6 +1,7 @@
 #include "ethstate.h"
 #include "config.h"
 #include "contractutil.h"
+#include <algorithm>
 #include <libethashseal/GenesisInfo.h>
 #include <sstream>
 #include <util.h>
@@ -299,6 +300,8 @@ EthExecutionResult EthState::execute(EnvInfo const& _envInfo, EthTransaction con
 
     CTransactionRef transferTx;
     u256 startGasUsed;
+    std::vector<dev::Address> createdContracts;
+    std::vector<dev::Address> destroyedContracts;
     try {
         if (_t.isCreation() && _t.value()) {
             BOOST_THROW_EXCEPTION(CreateWithValue());
@@ -316,6 +319,10 @@ EthExecutionResult EthState::execute(EnvInfo const& _envInfo, EthTransaction con
 
         e.finalize();
 
+        // Only the self-destructs of the transaction, not the accounts deleted below
+        std::vector<dev::Address> killed;
+        killed.swap(mDestroyedContracts);
+
         if (_p == Permanence::Reverted) {
             m_cache.clear();
             mUTXOCache.clear();
@@ -331,6 +338,8 @@ EthExecutionResult EthState::execute(EnvInfo const& _envInfo, EthTransaction con
                 }
                 const std::unordered_map<dev::Address, Vin>& vins = builder.GetNewVins(transferTx->GetHash());
                 updateUTXO(vins);
+                createdContracts = newContracts(exeResult.newAddress);
+                destroyedContracts.swap(killed);
             } else {
                 printException(_t, exeResult.excepted);
             }
@@ -359,12 +368,15 @@ EthExecutionResult EthState::execute(EnvInfo const& _envInfo, EthTransaction con
 
     mNewAddress = dev::Address();
     mTransfers.clear();
+    mDestroyedContracts.clear();
 
     if (!reachedVoutLimit) {
         return EthExecutionResult{
             exeResult,
             dev::eth::TransactionReceipt(rootHash(), startGasUsed + e.gasUsed(), e.logs()),
             transferTx == nullptr ? CTransaction() : *transferTx,
+            createdContracts,
+            destroyedContracts,
         };
     }
 
@@ -432,12 +444,28 @@ void EthState::addBalance(dev::Address const& _id, dev::u256 const& _amount)
 
 void EthState::kill(dev::Address _addr)
 {
+    if (addressHasCode(_addr)) {
+        mDestroyedContracts.push_back(_addr);
+    }
     dev::eth::State::kill(_addr);
     if (Vin* v = const_cast<Vin*>(vin(_addr))) {
         v->alive = 0;
     }
 }
 
+std::vector<dev::Address> EthState::newContracts(dev::Address const& _exclude) const
+{
+    // Accounts created since the last commit that survived the execution with code
+    std::vector<dev::Address> ret;
+    for (const dev::eth::detail::Change& change : m_changeLog) {
+        if (change.kind == dev::eth::detail::Change::Create && change.address != _exclude &&
+            addressHasCode(change.address) && std::find(ret.begin(), ret.end(), change.address) == ret.end()) {
+            ret.push_back(change.address);
+        }
+    }
+    return ret;
+}
+
 const Vin* EthState::vin(const dev::Address& _addr)
 {
     const auto it = mUTXOCache.find(_addr);
@@ -483,6 +511,61 @@ std::unordered_map<dev::Address, Vin> EthState::vins() const
     return ret;
 }
 
+bool EthState::storageRange(Address const& _addr, h256 const& _start, size_t _max, std::map<h256, std::pair<u256, u256>>& _slots, h256& _next) const
+{
+    _slots.clear();
+    Account const* a = account(_addr);
+    if (a == nullptr || _max == 0) {
+        return false;
+    }
+
+    // Writes not committed to the trie yet, from _start on
+    std::map<h256, std::pair<u256, u256>> overlay;
+    for (auto const& i : a->storageOverlay()) {
+        h256 const hashedKey = sha3(h256(i.first));
+        if (!(hashedKey < _start)) {
+            overlay[hashedKey] = std::make_pair(i.first, i.second);
+        }
+    }
+
+    // Read one slot past _max so that we know where to continue from
+    bool fTruncated = false;
+    h256 lastKey;
+    if (h256 root = a->baseRoot()) {
+        SecureTrieDB<h256, OverlayDB> memdb(const_cast<OverlayDB*>(&m_db), root); // promise we won't alter the overlay
+        for (auto it = memdb.hashedLowerBound(_start); it != memdb.hashedEnd(); ++it) {
+            if (_slots.size() > _max) {
+                fTruncated = true;
+                break;
+            }
+            h256 const hashedKey((*it).first);
+            lastKey = hashedKey;
+            if (overlay.count(hashedKey)) {
+                continue;
+            }
+            _slots[hashedKey] = std::make_pair(u256(h256(it.key())), RLP((*it).second).toInt<u256>());
+        }
+    }
+
+    // Merge the overlay, leaving out what lies beyond the part of the trie we read
+    for (auto const& i : overlay) {
+        if (fTruncated && lastKey < i.first) {
+            break;
+        }
+        if (i.second.second) {
+            _slots[i.first] = i.second;
+        }
+    }
+
+    if (_slots.size() <= _max) {
+        return false;
+    }
+    auto end = std::next(_slots.begin(), _max);
+    _next = end->first;
+    _slots.erase(end, _slots.end());
+    return true;
+}
+
 void EthState::deleteAccounts(const std::set<dev::Address>& addrs)
 {
     for (const dev::Address& addr : addrs) {
@@ -33,6 +33,10 @@ struct EthExecutionResult {
     dev::eth::ExecutionResult execRes;
     dev::eth::TransactionReceipt txRec;
     CTransaction tx;
+    //! Contracts created by other contracts during the execution, besides execRes.newAddress
+    std::vector<dev::Address> createdContracts;
+    //! Contracts that self-destructed during the execution
+    std::vector<dev::Address> destroyedContracts;
 };
 
 class EthState : public dev::eth::State
@@ -61,6 +65,13 @@ public:
 
     std::unordered_map<dev::Address, Vin> vins() const;
 
+    /**
+     * Read up to _max storage slots of _addr, in trie order starting from the
+     * hashed key _start, without loading the rest of the storage. Returns true
+     * and sets _next to the hashed key to continue from if slots remain.
+     */
+    bool storageRange(dev::Address const& _addr, dev::h256 const& _start, size_t _max, std::map<dev::h256, std::pair<dev::u256, dev::u256>>& _slots, dev::h256& _next) const;
+
     dev::OverlayDB const& dbUtxo() const { return mUTXODB; }
     dev::OverlayDB& dbUtxo() { return mUTXODB; }
 
@@ -95,6 +106,8 @@ private:
 
     void deleteAccounts(const std::set<dev::Address>& addrs);
 
+    std::vector<dev::Address> newContracts(dev::Address const& _exclude) const;
+
     void updateUTXO(const std::unordered_map<dev::Address, Vin>& vins);
 
 private:
@@ -104,6 +117,8 @@ private:
 
     std::vector<TransferInfo> mTransfers;
 
+    std::vector<dev::Address> mDestroyedContracts;
+
     dev::OverlayDB mUTXODB;
     dev::eth::SecureTrieDB<dev::Address, dev::OverlayDB> mUTXOState;
     std::unordered_map<dev::Address, Vin> mUTXOCache;
@@ -2,6 +2,7 @@
 #include "config.h"
 #include "consensus/validation.h"
 #include "contractexecutor.h"
+#include "contractregistry.h"
 #include "contractutil.h"
 #include "core_io.h"
 #include "primitives/transaction.h"
@@ -509,12 +510,27 @@ UniValue sendtocontract(const JSONRPCRequest& request)
 
 UniValue listcontracts(const JSONRPCRequest& request)
 {
-    if (request.fHelp || request.params.size() > 2)
+    if (request.fHelp || request.params.size() > 3)
         throw std::runtime_error(
-                "listcontracts (start maxDisplay)\n"
+                "listcontracts (start maxDisplay verbose)\n"
                 "\nArgument:\n"
                 "1. start     (numeric or string, optional) The starting account index, default 1\n"
                 "2. maxDisplay       (numeric or string, optional) Max accounts to list, default 20\n"
+                "3. verbose   (boolean, optional, default=false) Return an array of objects with creation details instead of an address to balance object\n"
+                "\nResult (for verbose = true):\n"
+                "[\n"
+                "  {\n"
+                "    \"address\": \"hex\",      (string) The contract address\n"
+                "    \"balance\": n,          (numeric) The balance in " + CURRENCY_UNIT + "\n"
+                "    \"creator\": \"hex\",      (string) The address that created the contract, or the contract called to create it\n"
+                "    \"height\": n,           (numeric) The height of the block it was created in\n"
+                "    \"txid\": \"hex\",         (string) The transaction that created it\n"
+                "    \"codehash\": \"hex\"      (string) The hash of its code at creation\n"
+                "  }, ...\n"
+                "]\n"
+                "\nContracts are listed in order of creation, leaving out the ones that self-destructed.\n"
+                "The details are only available if the contract registry was built along with the\n"
+                "chain (use -reindex-chainstate).\n"
         );
 
     LOCK(cs_main);
@@ -533,6 +549,43 @@ UniValue listcontracts(const JSONRPCRequest& request)
             throw JSONRPCError(RPC_TYPE_ERROR, "Invalid maxDisplay");
     }
 
+    bool fVerbose = false;
+    if (request.params.size() > 2)
+        fVerbose = request.params[2].get_bool();
+
+    ContractRegistry* registry = ContractRegistry::Instance();
+    if (registry->IsComplete()) {
+        const int contractsCount = (int)registry->Count();
+        if (contractsCount > 0 && start > contractsCount)
+            throw JSONRPCError(RPC_TYPE_ERROR, "start greater than max index "+ itostr(contractsCount));
+
+        std::vector<ContractInfo> contracts;
+        if (!registry->List(start - 1, maxDisplay, contracts))
+            throw JSONRPCError(RPC_DATABASE_ERROR, "Failed to read contract registry");
+
+        UniValue result(fVerbose ? UniValue::VARR : UniValue::VOBJ);
+        for (const ContractInfo& info : contracts) {
+            const dev::Address address(valtype(info.address.begin(), info.address.end()));
+            const UniValue balance = ValueFromAmount(CAmount(EthState::Instance()->balance(address) / SATOSHI_2_WEI_RATE));
+            if (!fVerbose) {
+                result.push_back(Pair(address.hex(), balance));
+                continue;
+            }
+            UniValue entry(UniValue::VOBJ);
+            entry.push_back(Pair("address", address.hex()));
+            entry.push_back(Pair("balance", balance));
+            entry.push_back(Pair("creator", HexStr(info.creator.begin(), info.creator.end())));
+            entry.push_back(Pair("height", (int)info.nHeight));
+            entry.push_back(Pair("txid", info.txid.GetHex()));
+            entry.push_back(Pair("codehash", uintToh256(info.codeHash).hex()));
+            result.push_back(entry);
+        }
+        return result;
+    }
+
+    if (fVerbose)
+        throw JSONRPCError(RPC_MISC_ERROR, "Contract registry is incomplete, restart with -reindex-chainstate to build it");
+
     UniValue result(UniValue::VOBJ);
 
     const auto &map = EthState::Instance()->addresses();
@@ -687,6 +740,67 @@ struct TemporaryState {
     TemporaryState& operator=(TemporaryState&&) = delete;
 };
 
+static size_t parseUInt(const UniValue& val, size_t defaultVal)
+{
+    if (val.isNull()) {
+        return defaultVal;
+    } else {
+        int n = val.get_int();
+        if (n < 0) {
+            throw JSONRPCError(RPC_INVALID_PARAMS, "Expects unsigned integer");
+        }
+
+        return n;
+    }
+}
+
+//! Number of storage slots read from the trie at a time
+static const size_t STORAGE_PAGE_SIZE = 1000;
+//! Most storage slots returned by a single getcontractstoragerange call
+static const size_t MAX_STORAGE_RANGE = 10000;
+
+static dev::Address parseStorageAddress(const UniValue& val)
+{
+    std::string addr = val.get_str();
+    if(addr.size() != 40 || !CheckHex(addr)) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Incorrect address");
+    }
+    return dev::Address(addr);
+}
+
+static void setStorageBlock(TemporaryState& ts, const UniValue& val)
+{
+    if (val.isNull()) {
+        return;
+    }
+    if (!val.isNum()) {
+        throw JSONRPCError(RPC_INVALID_PARAMS, "Incorrect block number");
+    }
+    auto blockNum = val.get_int();
+    if((blockNum < 0 && blockNum != -1) || blockNum > chainActive.Height()) {
+        throw JSONRPCError(RPC_INVALID_PARAMS, "Incorrect block number");
+    }
+
+    if(blockNum != -1) {
+        dev::h256 stateRootHash;
+        dev::h256 utxoRootHash;
+        if (!StateRootView::Instance()->GetRoot(chainActive[blockNum]->GetBlockHash(), stateRootHash, utxoRootHash)) {
+            throw JSONRPCError(RPC_INVALID_PARAMS, "Incorrect block number, contract non-active");
+        }
+        ts.SetRoot(stateRootHash, utxoRootHash);
+    }
+}
+
+static void storageToJSON(const std::map<dev::h256, std::pair<dev::u256, dev::u256>>& storage, UniValue& ret)
+{
+    for (const auto& j: storage)
+    {
+        UniValue e(UniValue::VOBJ);
+        e.push_back(Pair(dev::toHex(j.second.first), dev::toHex(j.second.second)));
+        ret.push_back(Pair(j.first.hex(), e));
+    }
+}
+
 UniValue getcontractstorage(const JSONRPCRequest& req)
 {
     if (req.fHelp || req.params.size() < 1)
@@ -696,37 +810,18 @@ UniValue getcontractstorage(const JSONRPCRequest& req)
                 "1. \"address\"          (string, required) The address to get the storage from\n"
                 "2. \"blockNum\"         (string, optional) Number of block to get state from, \"latest\" keyword supported. Latest if not passed.\n"
                 "3. \"index\"            (number, optional) Zero-based index position of the storage\n"
+                "\nUse getcontractstoragerange to page through large storage.\n"
                 );
 
     LOCK(cs_main);
 
-    std::string addr = req.params[0].get_str();
-    if(addr.size() != 40 || !CheckHex(addr)) {
-        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Incorrect address");
-    }
+    dev::Address addrAccount = parseStorageAddress(req.params[0]);
 
     TemporaryState ts(EthState::Instance());
     if (req.params.size() > 1) {
-        if (req.params[1].isNum()) {
-            auto blockNum = req.params[1].get_int();
-            if((blockNum < 0 && blockNum != -1) || blockNum > chainActive.Height()) {
-                throw JSONRPCError(RPC_INVALID_PARAMS, "Incorrect block number");
-            }
-
-            if(blockNum != -1) {
-                dev::h256 stateRootHash;
-                dev::h256 utxoRootHash;
-                if (!StateRootView::Instance()->GetRoot(chainActive[blockNum]->GetBlockHash(), stateRootHash, utxoRootHash)) {
-                    throw JSONRPCError(RPC_INVALID_PARAMS, "Incorrect block number, contract non-active");
-                }
-                ts.SetRoot(stateRootHash, utxoRootHash);
-            }
-        } else {
-            throw JSONRPCError(RPC_INVALID_PARAMS, "Incorrect block number");
-        }
+        setStorageBlock(ts, req.params[1]);
     }
 
-    dev::Address addrAccount(addr);
     if(!EthState::Instance()->addressInUse(addrAccount)) {
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Address does not exist");
     }
@@ -738,40 +833,135 @@ UniValue getcontractstorage(const JSONRPCRequest& req)
     if (onlyIndex)
         index = req.params[2].get_int();
 
-    auto storage(EthState::Instance()->storage(addrAccount));
+    // Walk the trie a page at a time, so that only one page is held in memory
+    // besides the result
+    std::map<dev::h256, std::pair<dev::u256, dev::u256>> page;
+    dev::h256 next;
+    size_t nSeen = 0;
+    bool fMore = true;
+    while (fMore) {
+        fMore = EthState::Instance()->storageRange(addrAccount, next, STORAGE_PAGE_SIZE, page, next);
+        if (onlyIndex) {
+            if (index < nSeen + page.size()) {
+                storageToJSON({*std::next(page.begin(), index - nSeen)}, ret);
+                return ret;
+            }
+        } else {
+            storageToJSON(page, ret);
+        }
+        nSeen += page.size();
+    }
 
     if (onlyIndex) {
-        if (index >= storage.size()) {
-            std::ostringstream stringStream;
-            stringStream << "Storage size: " << storage.size() << " got index: " << index;
-            throw JSONRPCError(RPC_INVALID_PARAMS, stringStream.str());
+        std::ostringstream stringStream;
+        stringStream << "Storage size: " << nSeen << " got index: " << index;
+        throw JSONRPCError(RPC_INVALID_PARAMS, stringStream.str());
+    }
+    return ret;
+}
+
+UniValue getcontractstoragerange(const JSONRPCRequest& req)
+{
+    if (req.fHelp || req.params.size() < 1 || req.params.size() > 4)
+        throw std::runtime_error(
+                "getcontractstoragerange \"address\" ( \"start\" count blockNum )\n"
+                "\nReturn the storage slots of a contract in trie order, a range at a time.\n"
+                "\nArgument:\n"
+                "1. \"address\"          (string, required) The address to get the storage from\n"
+                "2. \"start\"            (string, optional) Hashed key to start from, the \"next\" value of the previous call. Beginning of the storage if not passed.\n"
+                "3. count                (number, optional, default=" + std::to_string(STORAGE_PAGE_SIZE) + ") Most slots to return, up to " + std::to_string(MAX_STORAGE_RANGE) + "\n"
+                "4. blockNum             (number, optional) Number of block to get state from, latest if not passed or -1\n"
+                "\nResult:\n"
+                "{\n"
+                "  \"storage\": {          (object) Slots keyed by hashed key, each as { \"key\": \"value\" }\n"
+                "    ...\n"
+                "  },\n"
+                "  \"next\": \"hash\"       (string, optional) Hashed key to continue from, present only if slots remain\n"
+                "}\n"
+                "\nExamples:\n"
+                + HelpExampleCli("getcontractstoragerange", "\"eb23c0b3e6042821da281a2e2364feb22dd543e3\" \"\" 100")
+                + HelpExampleRpc("getcontractstoragerange", "\"eb23c0b3e6042821da281a2e2364feb22dd543e3\", \"\", 100")
+                );
+
+    LOCK(cs_main);
+
+    dev::Address addrAccount = parseStorageAddress(req.params[0]);
+
+    dev::h256 start;
+    if (req.params.size() > 1 && !req.params[1].isNull() && !req.params[1].get_str().empty()) {
+        std::string strStart = req.params[1].get_str();
+        if (strStart.size() != 64 || !IsHex(strStart)) {
+            throw JSONRPCError(RPC_INVALID_PARAMS, "Incorrect start key");
         }
-        auto elem = std::next(storage.begin(), index);
-        UniValue e(UniValue::VOBJ);
+        start = dev::h256(strStart);
+    }
 
-        storage = {{elem->first, {elem->second.first, elem->second.second}}};
+    size_t count = req.params.size() > 2 ? parseUInt(req.params[2], STORAGE_PAGE_SIZE) : STORAGE_PAGE_SIZE;
+    if (count == 0 || count > MAX_STORAGE_RANGE) {
+        throw JSONRPCError(RPC_INVALID_PARAMS, "count must be between 1 and " + std::to_string(MAX_STORAGE_RANGE));
     }
-    for (const auto& j: storage)
-    {
-        UniValue e(UniValue::VOBJ);
-        e.push_back(Pair(dev::toHex(j.second.first), dev::toHex(j.second.second)));
-        ret.push_back(Pair(j.first.hex(), e));
+
+    TemporaryState ts(EthState::Instance());
+    if (req.params.size() > 3) {
+        setStorageBlock(ts, req.params[3]);
+    }
+
+    if(!EthState::Instance()->addressInUse(addrAccount)) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Address does not exist");
+    }
+
+    std::map<dev::h256, std::pair<dev::u256, dev::u256>> slots;
+    dev::h256 next;
+    bool fMore = EthState::Instance()->storageRange(addrAccount, start, count, slots, next);
+
+    UniValue storage(UniValue::VOBJ);
+    storageToJSON(slots, storage);
+
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("storage", storage));
+    if (fMore) {
+        ret.push_back(Pair("next", next.hex()));
     }
     return ret;
 }
 
-static size_t parseUInt(const UniValue& val, size_t defaultVal)
+UniValue getcontractstorageat(const JSONRPCRequest& req)
 {
-    if (val.isNull()) {
-        return defaultVal;
-    } else {
-        int n = val.get_int();
-        if (n < 0) {
-            throw JSONRPCError(RPC_INVALID_PARAMS, "Expects unsigned integer");
-        }
+    if (req.fHelp || req.params.size() < 2 || req.params.size() > 3)
+        throw std::runtime_error(
+                "getcontractstorageat \"address\" \"key\" ( blockNum )\n"
+                "\nReturn a single storage slot of a contract, looked up by key.\n"
+                "\nArgument:\n"
+                "1. \"address\"          (string, required) The address to get the storage from\n"
+                "2. \"key\"              (string, required) The slot key in hex, up to 32 bytes\n"
+                "3. blockNum             (number, optional) Number of block to get state from, latest if not passed or -1\n"
+                "\nResult:\n"
+                "\"value\"                (string) The slot value in hex, zero if the slot is unset\n"
+                "\nExamples:\n"
+                + HelpExampleCli("getcontractstorageat", "\"eb23c0b3e6042821da281a2e2364feb22dd543e3\" \"00\"")
+                + HelpExampleRpc("getcontractstorageat", "\"eb23c0b3e6042821da281a2e2364feb22dd543e3\", \"00\"")
+                );
 
-        return n;
+    LOCK(cs_main);
+
+    dev::Address addrAccount = parseStorageAddress(req.params[0]);
+
+    std::string strKey = req.params[1].get_str();
+    if (strKey.empty() || strKey.size() > 64 || strKey.find_first_not_of("0123456789abcdefABCDEF") != std::string::npos) {
+        throw JSONRPCError(RPC_INVALID_PARAMS, "Incorrect key");
     }
+    dev::u256 key("0x" + strKey);
+
+    TemporaryState ts(EthState::Instance());
+    if (req.params.size() > 2) {
+        setStorageBlock(ts, req.params[2]);
+    }
+
+    if(!EthState::Instance()->addressInUse(addrAccount)) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Address does not exist");
+    }
+
+    return dev::toHex(EthState::Instance()->storage(addrAccount, key));
 }
 
 static int parseBlockHeight(const UniValue& val)
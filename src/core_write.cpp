@@ -7,6 +7,7 @@
 #include "base58.h"
 #include "consensus/consensus.h"
 #include "consensus/validation.h"
+#include "jsonwriter.h"
 #include "script/script.h"
 #include "script/standard.h"
 #include "serialize.h"
@@ -217,3 +218,86 @@ void TxToUniv(const CTransaction& tx, const uint256& hashBlock, UniValue& entry,
         entry.pushKV("hex", EncodeHexTx(tx, serialize_flags)); // the hex-encoded transaction. used the name "hex" to be consistent with the verbose output of "getrawtransaction".
     }
 }
+
+void ScriptPubKeyToJSON(const CScript& scriptPubKey, CJSONWriter& writer, bool fIncludeHex)
+{
+    txnouttype type;
+    std::vector<CTxDestination> addresses;
+    int nRequired;
+
+    writer.BeginObject();
+    writer.Key("asm").String(ScriptToAsmStr(scriptPubKey));
+    if (fIncludeHex)
+        writer.Key("hex").Hex(scriptPubKey.data(), scriptPubKey.data() + scriptPubKey.size());
+
+    if (!ExtractDestinations(scriptPubKey, type, addresses, nRequired)) {
+        writer.Key("type").String(GetTxnOutputType(type));
+        writer.EndObject();
+        return;
+    }
+
+    writer.Key("reqSigs").Int(nRequired);
+    writer.Key("type").String(GetTxnOutputType(type));
+    writer.Key("addresses").BeginArray();
+    for (const CTxDestination& addr : addresses)
+        writer.String(CBitcoinAddress(addr).ToString());
+    writer.EndArray();
+    writer.EndObject();
+}
+
+void TxToJSON(const CTransaction& tx, const uint256& hashBlock, CJSONWriter& writer, bool include_hex, int serialize_flags)
+{
+    writer.BeginObject();
+    writer.Key("txid").String(tx.GetHash().GetHex());
+    writer.Key("hash").String(tx.GetWitnessHash().GetHex());
+    writer.Key("version").Int(tx.nVersion);
+    writer.Key("size").Int(::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION));
+    writer.Key("vsize").Int((GetTransactionWeight(tx) + WITNESS_SCALE_FACTOR - 1) / WITNESS_SCALE_FACTOR);
+    writer.Key("locktime").Int(tx.nLockTime);
+
+    writer.Key("vin").BeginArray();
+    for (const CTxIn& txin : tx.vin) {
+        writer.BeginObject();
+        if (tx.IsCoinBase()) {
+            writer.Key("coinbase").Hex(txin.scriptSig.data(), txin.scriptSig.data() + txin.scriptSig.size());
+        } else {
+            writer.Key("txid").String(txin.prevout.hash.GetHex());
+            writer.Key("vout").Int(txin.prevout.n);
+            writer.Key("scriptSig").BeginObject();
+            writer.Key("asm").String(ScriptToAsmStr(txin.scriptSig, true));
+            writer.Key("hex").Hex(txin.scriptSig.data(), txin.scriptSig.data() + txin.scriptSig.size());
+            writer.EndObject();
+            if (!txin.scriptWitness.IsNull()) {
+                writer.Key("txinwitness").BeginArray();
+                for (const auto& item : txin.scriptWitness.stack)
+                    writer.Hex(item.data(), item.data() + item.size());
+                writer.EndArray();
+            }
+        }
+        writer.Key("sequence").Int(txin.nSequence);
+        writer.EndObject();
+    }
+    writer.EndArray();
+
+    writer.Key("vout").BeginArray();
+    for (unsigned int i = 0; i < tx.vout.size(); i++) {
+        const CTxOut& txout = tx.vout[i];
+        writer.BeginObject();
+        writer.Key("value").Raw(ValueFromAmount(txout.nValue).getValStr());
+        writer.Key("n").Int(i);
+        writer.Key("scriptPubKey");
+        ScriptPubKeyToJSON(txout.scriptPubKey, writer, true);
+        writer.EndObject();
+    }
+    writer.EndArray();
+
+    if (!hashBlock.IsNull())
+        writer.Key("blockhash").String(hashBlock.GetHex());
+
+    if (include_hex) {
+        CDataStream ssTx(SER_NETWORK, PROTOCOL_VERSION | serialize_flags);
+        ssTx << tx;
+        writer.Key("hex").Hex((const unsigned char*)ssTx.data(), (const unsigned char*)ssTx.data() + ssTx.size());
+    }
+    writer.EndObject();
+}
@@ -13,11 +13,16 @@
 #include "utilstrencodings.h"
 #include "version.h"
 
+#include <algorithm>
+#include <memory>
+
 #include <leveldb/db.h>
 #include <leveldb/write_batch.h>
 
 static const size_t DBWRAPPER_PREALLOC_KEY_SIZE = 64;
 static const size_t DBWRAPPER_PREALLOC_VALUE_SIZE = 1024;
+//! Number of Next() calls CDBWrapper::ReadMany tries before falling back to a Seek()
+static const int DBWRAPPER_READMANY_MAX_STEPS = 4;
 
 class dbwrapper_error : public std::runtime_error
 {
@@ -247,6 +252,78 @@ public:
         return true;
     }
 
+    /**
+     * Read several keys at once. The serialized keys are sorted and served
+     * from a single iterator pass over one snapshot, stepping forward instead
+     * of seeking when the next key is close by.
+     *
+     * @param[in]  keys    Keys to look up, in any order.
+     * @param[out] values  Resized to keys.size(); values[i] receives the value for keys[i].
+     * @param[out] found   Resized to keys.size(); found[i] tells whether keys[i] was read.
+     * @return the number of keys that were found
+     */
+    template <typename K, typename V>
+    size_t ReadMany(const std::vector<K>& keys, std::vector<V>& values, std::vector<bool>& found) const
+    {
+        values.assign(keys.size(), V());
+        found.assign(keys.size(), false);
+        if (keys.empty())
+            return 0;
+
+        std::vector<std::pair<std::string, size_t>> vKeys;
+        vKeys.reserve(keys.size());
+        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+        for (size_t i = 0; i < keys.size(); i++) {
+            ssKey.reserve(DBWRAPPER_PREALLOC_KEY_SIZE);
+            ssKey << keys[i];
+            vKeys.emplace_back(std::string(ssKey.data(), ssKey.size()), i);
+            ssKey.clear();
+        }
+        std::sort(vKeys.begin(), vKeys.end());
+
+        size_t nFound = 0;
+        std::unique_ptr<leveldb::Iterator> piter(pdb->NewIterator(readoptions));
+        for (size_t i = 0; i < vKeys.size(); i++) {
+            leveldb::Slice slKey(vKeys[i].first);
+            int nSteps = 0;
+            while (piter->Valid() && piter->key().compare(slKey) < 0 && nSteps++ < DBWRAPPER_READMANY_MAX_STEPS) {
+                piter->Next();
+            }
+            if (!piter->Valid() || piter->key().compare(slKey) < 0) {
+                piter->Seek(slKey);
+            }
+            if (!piter->Valid()) {
+                leveldb::Status status = piter->status();
+                if (!status.ok()) {
+                    LogPrintf("LevelDB read failure: %s\n", status.ToString());
+                    dbwrapper_private::HandleError(status);
+                }
+                // Nothing at or beyond this key; the remaining keys are larger.
+                break;
+            }
+            if (piter->key().compare(slKey) != 0)
+                continue;
+            if (i > 0 && vKeys[i].first == vKeys[i - 1].first && found[vKeys[i - 1].second]) {
+                values[vKeys[i].second] = values[vKeys[i - 1].second];
+                found[vKeys[i].second] = true;
+                nFound++;
+                continue;
+            }
+            leveldb::Slice slValue = piter->value();
+            try {
+                CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
+                ssValue.Xor(obfuscate_key);
+                ssValue >> values[vKeys[i].second];
+            } catch (const std::exception&) {
+                values[vKeys[i].second] = V();
+                continue;
+            }
+            found[vKeys[i].second] = true;
+            nFound++;
+        }
+        return nFound;
+    }
+
     template <typename K, typename V>
     bool Write(const K& key, const V& value, bool fSync = false)
     {
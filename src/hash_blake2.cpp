@@ -1,5 +1,9 @@
 #include "hash_blake2.h"
 
+#include "crypto/common.h"
+
+#include <string.h>
+
 extern "C" {
 #include "crypto/cblake2/blake2b-ref.c"
 }
@@ -7,4 +11,32 @@ extern "C" {
 int Blake2::hash2b(void *out, size_t outlen, const void *in, size_t inlen)
 {
     return blake2(out, outlen, in, inlen, nullptr, 0);
-}
\ No newline at end of file
+}
+
+CBlake2HeaderHasher::CBlake2HeaderHasher(const unsigned char* header)
+{
+    blake2b_state S;
+    blake2b_init(&S, BLAKE2B_OUTBYTES / 2);
+    memcpy(h, S.h, sizeof(h));
+    memset(block, 0, sizeof(block));
+    memcpy(block, header, HEADER_SIZE);
+}
+
+uint256 CBlake2HeaderHasher::Hash(uint32_t nNonce)
+{
+    WriteLE32(block + HEADER_SIZE - 4, nNonce);
+
+    // The whole header is the last block: counter at its length, final flag set
+    blake2b_state S;
+    memcpy(S.h, h, sizeof(S.h));
+    S.t[0] = HEADER_SIZE;
+    S.t[1] = 0;
+    S.f[0] = (uint64_t)-1;
+    S.f[1] = 0;
+    blake2b_compress(&S, block);
+
+    uint256 hash;
+    for (int i = 0; i < 4; i++)
+        store64(hash.begin() + 8 * i, S.h[i]);
+    return hash;
+}
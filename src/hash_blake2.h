@@ -29,4 +29,25 @@ public:
     }
 };
 
+/**
+ * Blake2b-256 of an 80-byte block header for many nonces. The header fits in
+ * one Blake2b block, so the initial state and the zero-padded block are set up
+ * once and each nonce costs a single compression, with no allocation.
+ */
+class CBlake2HeaderHasher
+{
+public:
+    static const size_t HEADER_SIZE = 80;
+
+    /** header is the serialized block header; its last four bytes are the nonce */
+    explicit CBlake2HeaderHasher(const unsigned char* header);
+
+    /** Hash of the header with nNonce in place of its nonce */
+    uint256 Hash(uint32_t nNonce);
+
+private:
+    uint64_t h[8];
+    unsigned char block[128];
+};
+
 #endif // BITCOIN_HASH_BLAKE2_H
\ No newline at end of file
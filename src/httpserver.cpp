@@ -6,6 +6,7 @@
 
 #include "chainparamsbase.h"
 #include "compat.h"
+#include "httpworkqueue.h"
 #include "util.h"
 #include "utilstrencodings.h"
 #include "netbase.h"
@@ -21,6 +22,8 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <signal.h>
+#include <atomic>
+#include <deque>
 #include <future>
 
 #include <event2/thread.h>
@@ -61,94 +64,18 @@ private:
     HTTPRequestHandler func;
 };
 
-/** Simple work queue for distributing work over multiple threads.
- * Work items are simply callable objects.
- */
-template <typename WorkItem>
-class WorkQueue
+/** Work item running a function, for QueueHTTPWork */
+class HTTPFunctionItem : public HTTPClosure
 {
-private:
-    /** Mutex protects entire object */
-    std::mutex cs;
-    std::condition_variable cond;
-    std::deque<std::unique_ptr<WorkItem>> queue;
-    bool running;
-    size_t maxDepth;
-    int numThreads;
-
-    /** RAII object to keep track of number of running worker threads */
-    class ThreadCounter
-    {
-    public:
-        WorkQueue &wq;
-        ThreadCounter(WorkQueue &w): wq(w)
-        {
-            std::lock_guard<std::mutex> lock(wq.cs);
-            wq.numThreads += 1;
-        }
-        ~ThreadCounter()
-        {
-            std::lock_guard<std::mutex> lock(wq.cs);
-            wq.numThreads -= 1;
-            wq.cond.notify_all();
-        }
-    };
-
 public:
-    WorkQueue(size_t _maxDepth) : running(true),
-                                 maxDepth(_maxDepth),
-                                 numThreads(0)
-    {
-    }
-    /** Precondition: worker threads have all stopped
-     * (call WaitExit)
-     */
-    ~WorkQueue()
-    {
-    }
-    /** Enqueue a work item */
-    bool Enqueue(WorkItem* item)
-    {
-        std::unique_lock<std::mutex> lock(cs);
-        if (queue.size() >= maxDepth) {
-            return false;
-        }
-        queue.emplace_back(std::unique_ptr<WorkItem>(item));
-        cond.notify_one();
-        return true;
-    }
-    /** Thread function */
-    void Run()
-    {
-        ThreadCounter count(*this);
-        while (true) {
-            std::unique_ptr<WorkItem> i;
-            {
-                std::unique_lock<std::mutex> lock(cs);
-                while (running && queue.empty())
-                    cond.wait(lock);
-                if (!running)
-                    break;
-                i = std::move(queue.front());
-                queue.pop_front();
-            }
-            (*i)();
-        }
-    }
-    /** Interrupt and exit loops */
-    void Interrupt()
-    {
-        std::unique_lock<std::mutex> lock(cs);
-        running = false;
-        cond.notify_all();
-    }
-    /** Wait for worker threads to exit */
-    void WaitExit()
+    explicit HTTPFunctionItem(const std::function<void()>& _func) : func(_func) {}
+    void operator()() override
     {
-        std::unique_lock<std::mutex> lock(cs);
-        while (numThreads > 0)
-            cond.wait(lock);
+        func();
     }
+
+private:
+    std::function<void()> func;
 };
 
 struct HTTPPathHandler
@@ -289,11 +216,17 @@ static void http_request_cb(struct evhttp_request* req, void* arg)
     if (i != iend) {
         std::unique_ptr<HTTPWorkItem> item(new HTTPWorkItem(std::move(hreq), path, i->handler));
         assert(workQueue);
-        if (workQueue->Enqueue(item.get()))
-            item.release(); /* if true, queue took ownership */
-        else {
+        // Beyond the queue depth requests wait their turn; as evhttp serves
+        // one request per connection at a time, that holds back the clients
+        // sending them. Requests come in before authentication, so only so
+        // many wait, and the rest are turned away.
+        if (workQueue->Enqueue(item.get())) {
+            item.release();
+            if (workQueue->Deferred() > 0)
+                LogPrint(BCLog::HTTP, "HTTP work queue full, deferred request for %s\n", strURI);
+        } else {
             LogPrintf("WARNING: request rejected because http work queue depth exceeded, it can be increased with the -rpcworkqueue= setting\n");
-            item->req->WriteReply(HTTP_INTERNAL, "Work queue depth exceeded");
+            item->req->WriteReply(HTTP_SERVUNAVAIL, "Work queue depth exceeded");
         }
     } else {
         hreq->WriteReply(HTTP_NOTFOUND);
@@ -427,7 +360,7 @@ bool InitHTTPServer()
     int workQueueDepth = std::max((long)gArgs.GetArg("-rpcworkqueue", DEFAULT_HTTP_WORKQUEUE), 1L);
     LogPrintf("HTTP: creating work queue of depth %d\n", workQueueDepth);
 
-    workQueue = new WorkQueue<HTTPClosure>(workQueueDepth);
+    workQueue = new WorkQueue<HTTPClosure>(workQueueDepth, workQueueDepth * HTTP_WORKQUEUE_DEFERRED_FACTOR);
     // tranfer ownership to eventBase/HTTP via .release()
     eventBase = base_ctr.release();
     eventHTTP = http_ctr.release();
@@ -516,6 +449,29 @@ void StopHTTPServer()
     LogPrint(BCLog::HTTP, "Stopped HTTP server\n");
 }
 
+bool GetHTTPWorkQueueInfo(HTTPWorkQueueInfo& info)
+{
+    if (!workQueue)
+        return false;
+    info.nDepth = workQueue->Depth();
+    info.nCapacity = workQueue->Capacity();
+    info.nDeferred = workQueue->Deferred();
+    info.nDeferredTotal = workQueue->DeferredTotal();
+    info.nRejectedTotal = workQueue->RejectedTotal();
+    return true;
+}
+
+bool QueueHTTPWork(const std::function<void()>& func)
+{
+    if (!workQueue)
+        return false;
+    std::unique_ptr<HTTPFunctionItem> item(new HTTPFunctionItem(func));
+    if (!workQueue->Enqueue(item.get()))
+        return false;
+    item.release();
+    return true;
+}
+
 struct event_base* EventBase()
 {
     return eventBase;
@@ -729,6 +685,23 @@ void HTTPRequest::WriteReply(int nStatus, const std::string& strReply)
     req = nullptr; // transferred back to main thread
 }
 
+void HTTPRequest::WriteReply(int nStatus, std::string&& strReply)
+{
+    assert(!replySent && req);
+    struct evbuffer* evb = evhttp_request_get_output_buffer(req);
+    assert(evb);
+    // The evbuffer references the string and frees it once the reply is sent
+    std::string* pReply = new std::string(std::move(strReply));
+    evbuffer_add_reference(evb, pReply->data(), pReply->size(),
+        [](const void*, size_t, void* extra) { delete static_cast<std::string*>(extra); }, pReply);
+
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, NULL,
+        std::bind(evhttp_send_reply, req, nStatus, (const char*)NULL, (struct evbuffer *)NULL));
+    ev->trigger(nullptr);
+    replySent = true;
+    req = nullptr; // transferred back to main thread
+}
+
 CService HTTPRequest::GetPeer()
 {
     evhttp_connection* con = evhttp_request_get_connection(req);
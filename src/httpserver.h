@@ -14,6 +14,8 @@
 
 static const int DEFAULT_HTTP_THREADS=4;
 static const int DEFAULT_HTTP_WORKQUEUE=16;
+//! requests deferred beyond the work queue, as a multiple of its depth
+static const int HTTP_WORKQUEUE_DEFERRED_FACTOR=4;
 static const int DEFAULT_HTTP_SERVER_TIMEOUT=30;
 
 struct evhttp_request;
@@ -39,6 +41,26 @@ void StopHTTPServer();
  * libevent doesn't support debug logging.*/
 bool UpdateHTTPServerLogging(bool enable);
 
+/** State of the HTTP work queue */
+struct HTTPWorkQueueInfo
+{
+    //! requests waiting in the queue
+    size_t nDepth;
+    size_t nCapacity;
+    //! requests waiting beyond the queue depth
+    size_t nDeferred;
+    //! requests deferred since startup
+    uint64_t nDeferredTotal;
+    //! requests turned away since startup, with the deferred list full
+    uint64_t nRejectedTotal;
+};
+
+/** Get the state of the work queue. Returns false if there is none. */
+bool GetHTTPWorkQueueInfo(HTTPWorkQueueInfo& info);
+
+/** Run func on an HTTP worker thread. Returns false if there are no workers or the queue is full. */
+bool QueueHTTPWork(const std::function<void()>& func);
+
 /** Handler for requests to a certain HTTP path */
 typedef std::function<bool(HTTPRequest* req, const std::string &)> HTTPRequestHandler;
 /** Register handler for prefix.
@@ -129,6 +151,11 @@ public:
      * main thread, do not call any other HTTPRequest methods after calling this.
      */
     void WriteReply(int nStatus, const std::string& strReply = "");
+    /**
+     * Write HTTP reply, handing strReply's buffer to the output buffer
+     * instead of copying it. For large replies such as blocks.
+     */
+    void WriteReply(int nStatus, std::string&& strReply);
     /**
      * Start chunk transfer. Assume to be 200.
      */
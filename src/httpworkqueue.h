@@ -0,0 +1,172 @@
+#ifndef BITCOIN_HTTPWORKQUEUE_H
+#define BITCOIN_HTTPWORKQUEUE_H
+
+#include "lockfreequeue.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+
+/** Work queue for distributing work over multiple threads.
+ * Work items are simply callable objects. Items go through a lock-free ring;
+ * when it is full they are deferred to an overflow list, and workers move
+ * them over as slots free up. Only a bounded number is deferred, beyond that
+ * items are refused. The mutex is only taken on that overflow path and to
+ * put idle workers to sleep.
+ */
+template <typename WorkItem>
+class WorkQueue
+{
+private:
+    CLockFreeQueue<WorkItem*> queue;
+    /** Mutex protects overflow, and the sleeping and exiting of workers */
+    std::mutex cs;
+    std::condition_variable cond;
+    std::deque<std::unique_ptr<WorkItem>> overflow;
+    std::atomic<size_t> nOverflow;
+    size_t nMaxOverflow;
+    std::atomic<uint64_t> nDeferredTotal;
+    std::atomic<uint64_t> nRejectedTotal;
+    std::atomic<int> nSleeping;
+    std::atomic<bool> running;
+    int numThreads;
+
+    /** RAII object to keep track of number of running worker threads */
+    class ThreadCounter
+    {
+    public:
+        WorkQueue &wq;
+        ThreadCounter(WorkQueue &w): wq(w)
+        {
+            std::lock_guard<std::mutex> lock(wq.cs);
+            wq.numThreads += 1;
+        }
+        ~ThreadCounter()
+        {
+            std::lock_guard<std::mutex> lock(wq.cs);
+            wq.numThreads -= 1;
+            wq.cond.notify_all();
+        }
+    };
+
+    /** Move deferred items into the ring while it has room. Requires cs. */
+    void RefillLocked()
+    {
+        while (!overflow.empty() && queue.TryPush(overflow.front().get())) {
+            overflow.front().release();
+            overflow.pop_front();
+        }
+        nOverflow = overflow.size();
+    }
+
+    /** Get the next item, sleeping while there is none. Returns nullptr when interrupted. */
+    WorkItem* Next()
+    {
+        WorkItem* item = nullptr;
+        while (running) {
+            if (queue.TryPop(item)) {
+                if (nOverflow > 0) {
+                    std::lock_guard<std::mutex> lock(cs);
+                    RefillLocked();
+                }
+                return item;
+            }
+            std::unique_lock<std::mutex> lock(cs);
+            if (nOverflow > 0) {
+                RefillLocked();
+                continue;
+            }
+            // Announce the sleep before the last look at the ring, so a
+            // producer either sees the sleeper or its item is seen here
+            ++nSleeping;
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (running && !queue.TryPop(item))
+                cond.wait(lock);
+            --nSleeping;
+            if (item)
+                return item;
+        }
+        return nullptr;
+    }
+
+public:
+    WorkQueue(size_t _maxDepth, size_t _maxDeferred) : queue(_maxDepth),
+                                 nOverflow(0),
+                                 nMaxOverflow(_maxDeferred),
+                                 nDeferredTotal(0),
+                                 nRejectedTotal(0),
+                                 nSleeping(0),
+                                 running(true),
+                                 numThreads(0)
+    {
+    }
+    /** Precondition: worker threads have all stopped
+     * (call WaitExit)
+     */
+    ~WorkQueue()
+    {
+        WorkItem* item;
+        while (queue.TryPop(item))
+            delete item;
+    }
+    /**
+     * Enqueue a work item, taking ownership of it. Beyond the queue depth
+     * items are deferred; returns false, leaving the item to the caller,
+     * when the deferred list is full as well.
+     */
+    bool Enqueue(WorkItem* item)
+    {
+        if (nOverflow > 0 || !queue.TryPush(item)) {
+            std::lock_guard<std::mutex> lock(cs);
+            RefillLocked();
+            if (overflow.size() >= nMaxOverflow) {
+                ++nRejectedTotal;
+                return false;
+            }
+            overflow.emplace_back(item);
+            RefillLocked();
+            ++nDeferredTotal;
+            cond.notify_one();
+            return true;
+        }
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (nSleeping > 0) {
+            std::lock_guard<std::mutex> lock(cs);
+            cond.notify_one();
+        }
+        return true;
+    }
+    /** Thread function */
+    void Run()
+    {
+        ThreadCounter count(*this);
+        while (WorkItem* item = Next()) {
+            std::unique_ptr<WorkItem> i(item);
+            (*i)();
+        }
+    }
+    /** Interrupt and exit loops */
+    void Interrupt()
+    {
+        std::unique_lock<std::mutex> lock(cs);
+        running = false;
+        cond.notify_all();
+    }
+    /** Wait for worker threads to exit */
+    void WaitExit()
+    {
+        std::unique_lock<std::mutex> lock(cs);
+        while (numThreads > 0)
+            cond.wait(lock);
+    }
+
+    size_t Depth() const { return queue.Size(); }
+    size_t Capacity() const { return queue.Capacity(); }
+    size_t Deferred() const { return nOverflow; }
+    uint64_t DeferredTotal() const { return nDeferredTotal; }
+    uint64_t RejectedTotal() const { return nRejectedTotal; }
+};
+
+#endif // BITCOIN_HTTPWORKQUEUE_H
@@ -0,0 +1,139 @@
+#include "jsonwriter.h"
+
+#include <univalue.h>
+
+#include <assert.h>
+
+CJSONWriter::CJSONWriter(size_t nReserve) : fAfterKey(false)
+{
+    out.reserve(nReserve);
+}
+
+void CJSONWriter::Separate()
+{
+    if (fAfterKey) {
+        fAfterKey = false;
+        return;
+    }
+    if (!vEmpty.empty()) {
+        if (!vEmpty.back())
+            out += ',';
+        vEmpty.back() = false;
+    }
+}
+
+CJSONWriter& CJSONWriter::BeginObject()
+{
+    Separate();
+    out += '{';
+    vEmpty.push_back(true);
+    return *this;
+}
+
+CJSONWriter& CJSONWriter::EndObject()
+{
+    assert(!vEmpty.empty() && !fAfterKey);
+    vEmpty.pop_back();
+    out += '}';
+    return *this;
+}
+
+CJSONWriter& CJSONWriter::BeginArray()
+{
+    Separate();
+    out += '[';
+    vEmpty.push_back(true);
+    return *this;
+}
+
+CJSONWriter& CJSONWriter::EndArray()
+{
+    assert(!vEmpty.empty() && !fAfterKey);
+    vEmpty.pop_back();
+    out += ']';
+    return *this;
+}
+
+CJSONWriter& CJSONWriter::Key(const char* key)
+{
+    assert(!fAfterKey);
+    Separate();
+    out += '"';
+    out += key;
+    out += "\":";
+    fAfterKey = true;
+    return *this;
+}
+
+CJSONWriter& CJSONWriter::String(const std::string& str)
+{
+    Separate();
+    for (unsigned char c : str) {
+        if (c < 0x20 || c == '"' || c == '\\' || c >= 0x7f) {
+            // Rare; leave the escaping rules to UniValue
+            out += UniValue(str).write();
+            return *this;
+        }
+    }
+    out += '"';
+    out += str;
+    out += '"';
+    return *this;
+}
+
+CJSONWriter& CJSONWriter::Hex(const unsigned char* begin, const unsigned char* end)
+{
+    static const char hexmap[16] = {'0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'a', 'b', 'c', 'd', 'e', 'f'};
+    Separate();
+    out += '"';
+    for (const unsigned char* p = begin; p != end; ++p) {
+        out += hexmap[*p >> 4];
+        out += hexmap[*p & 15];
+    }
+    out += '"';
+    return *this;
+}
+
+CJSONWriter& CJSONWriter::Int(int64_t n)
+{
+    Separate();
+    out += std::to_string(n);
+    return *this;
+}
+
+CJSONWriter& CJSONWriter::UInt(uint64_t n)
+{
+    Separate();
+    out += std::to_string(n);
+    return *this;
+}
+
+CJSONWriter& CJSONWriter::Real(double d)
+{
+    Separate();
+    out += UniValue(d).getValStr();
+    return *this;
+}
+
+CJSONWriter& CJSONWriter::Bool(bool f)
+{
+    Separate();
+    out += f ? "true" : "false";
+    return *this;
+}
+
+CJSONWriter& CJSONWriter::Raw(const std::string& json)
+{
+    Separate();
+    out += json;
+    return *this;
+}
+
+std::string CJSONWriter::Release()
+{
+    std::string ret;
+    ret.swap(out);
+    vEmpty.clear();
+    fAfterKey = false;
+    return ret;
+}
@@ -0,0 +1,50 @@
+#ifndef BITCOIN_JSONWRITER_H
+#define BITCOIN_JSONWRITER_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/**
+ * Writes compact JSON straight into a string, for replies too large to build
+ * as a UniValue tree first. The output is byte for byte what UniValue::write()
+ * gives for the same values, so the two can be used interchangeably.
+ */
+class CJSONWriter
+{
+public:
+    /** nReserve is the expected output size, to grow the buffer once */
+    explicit CJSONWriter(size_t nReserve = 0);
+
+    CJSONWriter& BeginObject();
+    CJSONWriter& EndObject();
+    CJSONWriter& BeginArray();
+    CJSONWriter& EndArray();
+
+    /** Start a member of the current object; key must need no escaping */
+    CJSONWriter& Key(const char* key);
+
+    CJSONWriter& String(const std::string& str);
+    /** A string holding the hex of [begin, end) */
+    CJSONWriter& Hex(const unsigned char* begin, const unsigned char* end);
+    CJSONWriter& Int(int64_t n);
+    CJSONWriter& UInt(uint64_t n);
+    CJSONWriter& Real(double d);
+    CJSONWriter& Bool(bool f);
+    /** A value that is already valid JSON, such as ValueFromAmount().getValStr() */
+    CJSONWriter& Raw(const std::string& json);
+
+    const std::string& str() const { return out; }
+    /** Take the output, leaving the writer empty */
+    std::string Release();
+
+private:
+    std::string out;
+    //! one entry per open object or array: whether it has no members yet
+    std::vector<bool> vEmpty;
+    bool fAfterKey;
+
+    void Separate();
+};
+
+#endif // BITCOIN_JSONWRITER_H
@@ -0,0 +1,111 @@
+#ifndef BITCOIN_LOCKFREEQUEUE_H
+#define BITCOIN_LOCKFREEQUEUE_H
+
+#include <atomic>
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Bounded queue for any number of producers and consumers, without locks.
+ * Each slot of the ring carries a sequence number telling producers and
+ * consumers whose turn it is, so a push or pop is one compare-and-swap on
+ * the shared position plus a store to the slot. The capacity is rounded up
+ * to a power of two.
+ */
+template <typename T>
+class CLockFreeQueue
+{
+private:
+    struct Cell
+    {
+        std::atomic<size_t> nSequence;
+        T value;
+    };
+
+    std::unique_ptr<Cell[]> cells;
+    size_t nMask;
+    // Keep the producer and consumer positions on separate cache lines
+    char padding0[64];
+    std::atomic<size_t> nEnqueuePos;
+    char padding1[64];
+    std::atomic<size_t> nDequeuePos;
+    char padding2[64];
+
+    static size_t RoundCapacity(size_t nCapacity)
+    {
+        size_t n = 2;
+        while (n < nCapacity)
+            n <<= 1;
+        return n;
+    }
+
+public:
+    explicit CLockFreeQueue(size_t nCapacity) : nMask(RoundCapacity(nCapacity) - 1), nEnqueuePos(0), nDequeuePos(0)
+    {
+        cells.reset(new Cell[nMask + 1]);
+        for (size_t i = 0; i <= nMask; i++)
+            cells[i].nSequence.store(i, std::memory_order_relaxed);
+    }
+
+    CLockFreeQueue(const CLockFreeQueue&) = delete;
+    CLockFreeQueue& operator=(const CLockFreeQueue&) = delete;
+
+    /** Add value at the back, or return false if the queue is full */
+    bool TryPush(T value)
+    {
+        Cell* cell;
+        size_t nPos = nEnqueuePos.load(std::memory_order_relaxed);
+        while (true) {
+            cell = &cells[nPos & nMask];
+            const size_t nSequence = cell->nSequence.load(std::memory_order_acquire);
+            const intptr_t nDiff = (intptr_t)nSequence - (intptr_t)nPos;
+            if (nDiff == 0) {
+                if (nEnqueuePos.compare_exchange_weak(nPos, nPos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (nDiff < 0) {
+                return false;
+            } else {
+                nPos = nEnqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+        cell->value = std::move(value);
+        cell->nSequence.store(nPos + 1, std::memory_order_release);
+        return true;
+    }
+
+    /** Take the value at the front, or return false if the queue is empty */
+    bool TryPop(T& value)
+    {
+        Cell* cell;
+        size_t nPos = nDequeuePos.load(std::memory_order_relaxed);
+        while (true) {
+            cell = &cells[nPos & nMask];
+            const size_t nSequence = cell->nSequence.load(std::memory_order_acquire);
+            const intptr_t nDiff = (intptr_t)nSequence - (intptr_t)(nPos + 1);
+            if (nDiff == 0) {
+                if (nDequeuePos.compare_exchange_weak(nPos, nPos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (nDiff < 0) {
+                return false;
+            } else {
+                nPos = nDequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+        value = std::move(cell->value);
+        cell->nSequence.store(nPos + nMask + 1, std::memory_order_release);
+        return true;
+    }
+
+    size_t Capacity() const { return nMask + 1; }
+
+    /** Number of queued values; only a snapshot while others push and pop */
+    size_t Size() const
+    {
+        const size_t nDequeue = nDequeuePos.load(std::memory_order_relaxed);
+        const size_t nEnqueue = nEnqueuePos.load(std::memory_order_relaxed);
+        return nEnqueue > nDequeue ? nEnqueue - nDequeue : 0;
+    }
+};
+
+#endif // BITCOIN_LOCKFREEQUEUE_H
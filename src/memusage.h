@@ -6,6 +6,7 @@
 #define BITCOIN_MEMUSAGE_H
 
 #include "indirectmap.h"
+#include "support/allocators/pool.h"
 
 #include <stdlib.h>
 
@@ -164,6 +165,17 @@ static inline size_t DynamicUsage(const std::unordered_map<X, Y, Z>& m)
     return MallocUsage(sizeof(unordered_node<std::pair<const X, Y> >)) * m.size() + MallocUsage(sizeof(void*) * m.bucket_count());
 }
 
+template<typename X, typename Y, typename Z, typename P, size_t M, size_t A>
+static inline size_t DynamicUsage(const std::unordered_map<X, Y, Z, P, PoolAllocator<std::pair<const X, Y>, M, A> >& m)
+{
+    // Nodes live in the pool's chunks, which are kept in a std::list (two
+    // links and the chunk pointer per list node). Freed nodes are not
+    // counted: the pool hands them out again before it grows.
+    const auto* resource = m.get_allocator().resource();
+    size_t usage_chunks = (MallocUsage(resource->ChunkSizeBytes()) + MallocUsage(sizeof(void*) * 3)) * resource->NumAllocatedChunks();
+    return usage_chunks - resource->NumFreeBytes() + MallocUsage(sizeof(void*) * m.bucket_count());
+}
+
 }
 
 #endif // BITCOIN_MEMUSAGE_H
@@ -13,7 +13,10 @@
 #include "consensus/tx_verify.h"
 #include "consensus/merkle.h"
 #include "consensus/validation.h"
+#include "crypto/common.h"
+#include "crypto/sha256.h"
 #include "hash.h"
+#include "hash_blake2.h"
 #include "validation.h"
 #include "net.h"
 #include "policy/feerate.h"
@@ -28,7 +31,9 @@
 #include "validationinterface.h"
 
 #include <algorithm>
+#include <atomic>
 #include <queue>
+#include <thread>
 #include <utility>
 
 #include "contract/config.h"
@@ -657,3 +662,125 @@ void IncrementExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned
     pblock->vtx[0] = MakeTransactionRef(std::move(txCoinbase));
     pblock->hashMerkleRoot = BlockMerkleRoot(*pblock);
 }
+
+//! nonces ScanNonces tries on the calling thread before starting workers
+static const uint32_t SCAN_NONCES_INLINE = 1 << 16;
+//! nonces a ScanNonces worker takes from the shared range at a time
+static const uint32_t SCAN_NONCES_CHUNK = 1 << 14;
+
+namespace {
+
+/** Proof of work hash of a serialized header for any nonce, without allocating */
+class CNonceHasher
+{
+public:
+    CNonceHasher(const unsigned char* header, bool fBlake2In) : fBlake2(fBlake2In), blake2(header)
+    {
+        // SHA256d: the first 64 bytes don't hold the nonce and are hashed once
+        midstate.Write(header, 64);
+        memcpy(tail, header + 64, sizeof(tail));
+    }
+
+    uint256 Hash(uint32_t nNonce)
+    {
+        if (fBlake2)
+            return blake2.Hash(nNonce);
+        WriteLE32(tail + sizeof(tail) - 4, nNonce);
+        unsigned char buf[CSHA256::OUTPUT_SIZE];
+        CSHA256(midstate).Write(tail, sizeof(tail)).Finalize(buf);
+        uint256 hash;
+        CSHA256().Write(buf, sizeof(buf)).Finalize(hash.begin());
+        return hash;
+    }
+
+private:
+    bool fBlake2;
+    CBlake2HeaderHasher blake2;
+    CSHA256 midstate;
+    unsigned char tail[16];
+};
+
+/** Find the first nonce in [nBegin, nEnd) whose hash meets bnTarget */
+bool ScanRange(CNonceHasher& hasher, const arith_uint256& bnTarget, uint32_t nBegin, uint32_t nEnd, uint32_t& nFound)
+{
+    for (uint32_t nNonce = nBegin; nNonce < nEnd; nNonce++) {
+        if (UintToArith256(hasher.Hash(nNonce)) <= bnTarget) {
+            nFound = nNonce;
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+bool ScanNonces(CBlockHeader& header, uint32_t nEnd, int nThreads, const Consensus::Params& params, uint64_t& nHashes)
+{
+    nHashes = 0;
+    const uint32_t nBegin = header.nNonce;
+    if (nBegin >= nEnd)
+        return false;
+
+    bool fNegative;
+    bool fOverflow;
+    arith_uint256 bnTarget;
+    bnTarget.SetCompact(header.nBits, &fNegative, &fOverflow);
+    if (fNegative || bnTarget == 0 || fOverflow || bnTarget > UintToArith256(params.powLimitBCXStart)) {
+        header.nNonce = nEnd;
+        return false;
+    }
+
+    CDataStream ss(SER_GETHASH, PROTOCOL_VERSION);
+    ss << header;
+    assert(ss.size() == CBlake2HeaderHasher::HEADER_SIZE);
+    const unsigned char* data = (const unsigned char*)ss.data();
+    const bool fBlake2 = header.CheckBCXVersion();
+
+    // Easy targets are usually met within a few nonces, so start on this
+    // thread and only bring in workers when that fails
+    const uint32_t nInlineEnd = nThreads > 1 ? std::min<uint64_t>(nEnd, (uint64_t)nBegin + SCAN_NONCES_INLINE) : nEnd;
+    uint32_t nFound;
+    CNonceHasher hasher(data, fBlake2);
+    if (ScanRange(hasher, bnTarget, nBegin, nInlineEnd, nFound)) {
+        nHashes = (uint64_t)nFound - nBegin + 1;
+        header.nNonce = nFound;
+        return true;
+    }
+    nHashes = nInlineEnd - nBegin;
+    header.nNonce = nEnd;
+    if (nInlineEnd == nEnd)
+        return false;
+
+    // Workers take chunks in nonce order and always finish the chunk they
+    // hold, so the lowest match is found even when a later chunk matches first
+    std::atomic<uint64_t> nNext(nInlineEnd);
+    std::atomic<uint32_t> nBest(nEnd);
+    std::atomic<uint64_t> nDone(0);
+    auto worker = [&]() {
+        CNonceHasher workerHasher(data, fBlake2);
+        while (true) {
+            const uint64_t nChunk = nNext.fetch_add(SCAN_NONCES_CHUNK);
+            if (nChunk >= nBest.load())
+                break;
+            const uint32_t nChunkEnd = std::min<uint64_t>(nEnd, nChunk + SCAN_NONCES_CHUNK);
+            uint32_t nChunkFound;
+            if (ScanRange(workerHasher, bnTarget, nChunk, nChunkEnd, nChunkFound)) {
+                nDone += (uint64_t)nChunkFound - nChunk + 1;
+                uint32_t nPrev = nBest.load();
+                while (nChunkFound < nPrev && !nBest.compare_exchange_weak(nPrev, nChunkFound)) {}
+                break;
+            }
+            nDone += nChunkEnd - nChunk;
+        }
+    };
+    std::vector<std::thread> threads;
+    for (int i = 1; i < nThreads; i++)
+        threads.emplace_back(worker);
+    worker();
+    for (std::thread& thread : threads)
+        thread.join();
+
+    nHashes += nDone;
+    header.nNonce = nBest;
+    return nBest < nEnd;
+}
@@ -261,5 +261,14 @@ private:
 /** Modify the extranonce in a block */
 void IncrementExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned int& nExtraNonce);
 int64_t UpdateTime(CBlockHeader* pblock, const Consensus::Params& consensusParams, const CBlockIndex* pindexPrev);
+/**
+ * Search the nonces from header.nNonce up to nEnd for one that meets the
+ * header's proof of work target, using up to nThreads threads. The header is
+ * serialized once and only the nonce is rewritten per hash. The lowest
+ * matching nonce is returned in header.nNonce, the same one a sequential
+ * scan would find; if there is none, header.nNonce is left at nEnd. nHashes
+ * is set to the number of hashes computed.
+ */
+bool ScanNonces(CBlockHeader& header, uint32_t nEnd, int nThreads, const Consensus::Params& params, uint64_t& nHashes);
 
 #endif // BITCOIN_MINER_H
@@ -60,6 +60,10 @@ void EraseOrphansFor(NodeId peer) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 static size_t vExtraTxnForCompactIt = 0;
 static std::vector<std::pair<uint256, CTransactionRef>> vExtraTxnForCompact GUARDED_BY(cs_main);
 
+/** Contract transactions predicted for the last compact block, so that every peer announcing it does not run its contracts again */
+static uint256 hashPredictedBlock GUARDED_BY(cs_main);
+static std::vector<CTransactionRef> vtxPredictedBlock GUARDED_BY(cs_main);
+
 static const uint64_t RANDOMIZER_ID_ADDRESS_RELAY = 0x3cac0035b5866b90ULL; // SHA256("main address relay")[0:8]
 
 // Internal stuff
@@ -967,6 +971,38 @@ bool static AlreadyHave(const CInv& inv) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
     return true;
 }
 
+/**
+ * Contract blocks carry transactions the contract executor created, which no
+ * mempool has. Run the block's contracts to guess them before asking the
+ * peer for what is still missing. A block is run at most once, however many
+ * peers announce it.
+ */
+static void FillPredictedTxn(PartiallyDownloadedBlock& partialBlock, const CBlockHeaderAndShortTxIDs& cmpctblock) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    const std::vector<CTransactionRef>& vtx = partialBlock.GetAvailableTxn();
+    bool fMissing = false;
+    bool fContract = false;
+    for (const CTransactionRef& ptx : vtx) {
+        if (!ptx)
+            fMissing = true;
+        else if (ptx->HasCreateOrSendOp())
+            fContract = true;
+    }
+    if (!fMissing || !fContract)
+        return;
+
+    const uint256 hash = cmpctblock.header.GetHash();
+    if (hash != hashPredictedBlock) {
+        std::vector<CTransactionRef> vtxPredicted;
+        if (!PredictContractTransactions(partialBlock.header, vtx, vtxPredicted))
+            return;
+        hashPredictedBlock = hash;
+        vtxPredictedBlock.swap(vtxPredicted);
+    }
+    size_t nFilled = partialBlock.FillPredicted(cmpctblock, vtxPredictedBlock);
+    LogPrint(BCLog::CMPCTBLOCK, "Predicted %u contract txn for block %s, %u matched\n", vtxPredictedBlock.size(), hash.ToString(), nFilled);
+}
+
 static void RelayTransaction(const CTransaction& tx, CConnman* connman)
 {
     CInv inv(MSG_TX, tx.GetHash());
@@ -2352,6 +2388,8 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
 
                 PartiallyDownloadedBlock& partialBlock = *(*queuedBlockIt)->partialBlock;
                 ReadStatus status = partialBlock.InitData(cmpctblock, vExtraTxnForCompact);
+                if (status == READ_STATUS_OK)
+                    FillPredictedTxn(partialBlock, cmpctblock);
                 if (status == READ_STATUS_INVALID) {
                     MarkBlockAsReceived(pindex->GetBlockHash()); // Reset in-flight state in case of whitelist
                     Misbehaving(pfrom->GetId(), 100);
@@ -2392,6 +2430,7 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
                     // TODO: don't ignore failures
                     return true;
                 }
+                FillPredictedTxn(tempBlock, cmpctblock);
                 std::vector<CTransactionRef> dummy;
                 status = tempBlock.FillBlock(*pblock, dummy);
                 if (status == READ_STATUS_OK) {
@@ -124,6 +124,12 @@ private Q_SLOTS:
             {
                 // Get the start location for search the event log
                 tokenInfo = mi->second;
+
+                // Tokens already synced up to the tip are kept current by
+                // the wallet itself as blocks are connected
+                if(tokenInfo.blockHash == blockHash)
+                    return;
+
                 CBlockIndex* index = chainActive[tokenInfo.blockNumber];
                 if(tokenInfo.blockNumber < toBlock)
                 {
@@ -173,17 +173,18 @@ void WalletModel::updateContractBook(const QString &address, const QString &labe
 
 void WalletModel::checkBalanceChanged()
 {
-    CAmount newBalance = getBalance();
-    CAmount newUnconfirmedBalance = getUnconfirmedBalance();
-    CAmount newImmatureBalance = getImmatureBalance();
+    CWalletBalance balances = wallet->GetBalances();
+    CAmount newBalance = balances.nTrusted;
+    CAmount newUnconfirmedBalance = balances.nUntrusted;
+    CAmount newImmatureBalance = balances.nImmature;
     CAmount newWatchOnlyBalance = 0;
     CAmount newWatchUnconfBalance = 0;
     CAmount newWatchImmatureBalance = 0;
     if (haveWatchOnly())
     {
-        newWatchOnlyBalance = getWatchBalance();
-        newWatchUnconfBalance = getWatchUnconfirmedBalance();
-        newWatchImmatureBalance = getWatchImmatureBalance();
+        newWatchOnlyBalance = balances.nWatchTrusted;
+        newWatchUnconfBalance = balances.nWatchUntrusted;
+        newWatchImmatureBalance = balances.nWatchImmature;
     }
 
     if(cachedBalance != newBalance || cachedUnconfirmedBalance != newUnconfirmedBalance || cachedImmatureBalance != newImmatureBalance ||
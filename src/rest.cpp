@@ -10,6 +10,7 @@
 #include "primitives/transaction.h"
 #include "validation.h"
 #include "httpserver.h"
+#include "jsonwriter.h"
 #include "rpc/blockchain.h"
 #include "rpc/server.h"
 #include "streams.h"
@@ -208,44 +209,73 @@ static bool rest_block(HTTPRequest* req,
     if (!ParseHashStr(hashStr, hash))
         return RESTERR(req, HTTP_BAD_REQUEST, "Invalid hash: " + hashStr);
 
-    CBlock block;
-    CBlockIndex* pblockindex = nullptr;
+    // Only the index lookups need cs_main; the block is read and written out without it
+    CDiskBlockPos pos;
+    CBlockIndexJSON index;
     {
         LOCK(cs_main);
         if (mapBlockIndex.count(hash) == 0)
             return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
 
-        pblockindex = mapBlockIndex[hash];
+        CBlockIndex* pblockindex = mapBlockIndex[hash];
         if (fHavePruned && !(pblockindex->nStatus & BLOCK_HAVE_DATA) && pblockindex->nTx > 0)
             return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not available (pruned data)");
 
-        if (!ReadBlockFromDisk(block, pblockindex, Params().GetConsensus()))
+        pos = pblockindex->GetBlockPos();
+        if (rf == RF_JSON)
+            index = CBlockIndexJSON(pblockindex);
+    }
+
+    // Blocks are stored with witness data, so unless that has to be stripped
+    // the binary and hex formats are served from the raw bytes on disk
+    if ((rf == RF_BINARY || rf == RF_HEX) && RPCSerializationFlags() == 0) {
+        std::string rawBlock;
+        if (!ReadRawBlockFromDisk(rawBlock, pos, Params().MessageStart()) || rawBlock.size() < 80)
+            return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
+        CBlockHeader header;
+        CDataStream ssHeader(rawBlock.data(), rawBlock.data() + 80, SER_NETWORK, PROTOCOL_VERSION);
+        ssHeader >> header;
+        if (header.GetHash() != hash)
             return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
+        if (rf == RF_BINARY) {
+            req->WriteHeader("Content-Type", "application/octet-stream");
+            req->WriteReply(HTTP_OK, std::move(rawBlock));
+        } else {
+            req->WriteHeader("Content-Type", "text/plain");
+            req->WriteReply(HTTP_OK, HexStr(rawBlock.begin(), rawBlock.end()) + "\n");
+        }
+        return true;
     }
 
-    CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
-    ssBlock << block;
+    CBlock block;
+    if (!ReadBlockFromDisk(block, pos, Params().GetConsensus()) || block.GetHash() != hash)
+        return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
 
     switch (rf) {
     case RF_BINARY: {
-        std::string binaryBlock = ssBlock.str();
+        CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
+        ssBlock << block;
         req->WriteHeader("Content-Type", "application/octet-stream");
-        req->WriteReply(HTTP_OK, binaryBlock);
+        req->WriteReply(HTTP_OK, ssBlock.str());
         return true;
     }
 
     case RF_HEX: {
+        CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
+        ssBlock << block;
         std::string strHex = HexStr(ssBlock.begin(), ssBlock.end()) + "\n";
         req->WriteHeader("Content-Type", "text/plain");
-        req->WriteReply(HTTP_OK, strHex);
+        req->WriteReply(HTTP_OK, std::move(strHex));
         return true;
     }
 
     case RF_JSON: {
-        UniValue objBlock = blockToJSON(block, pblockindex, showTxDetails);
-        std::string strJSON = objBlock.write() + "\n";
+        // Transaction details take several times the block size
+        CJSONWriter writer(showTxDetails ? ::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION) * 6 : block.vtx.size() * 67 + 1024);
+        blockToJSON(block, index, showTxDetails, writer);
+        std::string strJSON = writer.Release() + "\n";
         req->WriteHeader("Content-Type", "application/json");
-        req->WriteReply(HTTP_OK, strJSON);
+        req->WriteReply(HTTP_OK, std::move(strJSON));
         return true;
     }
 
@@ -586,6 +616,91 @@ static bool rest_getutxos(HTTPRequest* req, const std::string& strURIPart)
     return true; // continue to process further HTTP reqs on this cxn
 }
 
+/** Parse the address and the numbers after it in an address index request */
+static bool ParseAddressPath(HTTPRequest* req, const std::string& param, size_t nMaxNumbers, uint256& scriptHash, std::vector<int>& numbers)
+{
+    if (!fAddressIndex)
+        return RESTERR(req, HTTP_NOT_FOUND, "Address index not enabled");
+    std::vector<std::string> path;
+    boost::split(path, param, boost::is_any_of("/"));
+    if (path.empty() || path.size() > nMaxNumbers + 1)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid URI format");
+    if (!ParseScriptHash(path[0], scriptHash))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid address or script hash: " + path[0]);
+    for (size_t i = 1; i < path.size(); i++) {
+        int32_t n;
+        if (!ParseInt32(path[i], &n) || n < -1)
+            return RESTERR(req, HTTP_BAD_REQUEST, "Invalid number: " + path[i]);
+        numbers.push_back(n);
+    }
+    return true;
+}
+
+static bool rest_address_reply(HTTPRequest* req, RetFormat rf, std::function<UniValue()> toJSON)
+{
+    switch (rf) {
+    case RF_JSON: {
+        UniValue result;
+        try {
+            result = toJSON();
+        } catch (const UniValue& objError) {
+            return RESTERR(req, HTTP_INTERNAL_SERVER_ERROR, find_value(objError, "message").get_str());
+        }
+        std::string strJSON = result.write() + "\n";
+        req->WriteHeader("Content-Type", "application/json");
+        req->WriteReply(HTTP_OK, strJSON);
+        return true;
+    }
+    default: {
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: json)");
+    }
+    }
+}
+
+// /rest/address/history/<address>[/<start>[/<end>[/<skip>[/<count>]]]].json
+static bool rest_address_history(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+    uint256 scriptHash;
+    std::vector<int> numbers;
+    if (!ParseAddressPath(req, param, 4, scriptHash, numbers))
+        return false;
+    numbers.resize(4, -2);
+
+    const int nStart = numbers[0] == -2 ? 0 : numbers[0];
+    const int nEnd = numbers[1] == -2 ? -1 : numbers[1];
+    const int nSkip = numbers[2] == -2 ? 0 : numbers[2];
+    const int nCount = numbers[3] == -2 ? MAX_ADDRESSINDEX_RESULTS : numbers[3];
+    if (nStart < 0 || (nEnd >= 0 && nEnd < nStart) || nSkip < 0 || nCount < 1 || nCount > (int)MAX_ADDRESSINDEX_RESULTS)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Range out of bounds");
+
+    return rest_address_reply(req, rf, [&]() { return addressHistoryToJSON(scriptHash, nStart, nEnd, nSkip, nCount); });
+}
+
+// /rest/address/utxos/<address>[/<skip>[/<count>]].json
+static bool rest_address_utxos(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+    uint256 scriptHash;
+    std::vector<int> numbers;
+    if (!ParseAddressPath(req, param, 2, scriptHash, numbers))
+        return false;
+    numbers.resize(2, -2);
+
+    const int nSkip = numbers[0] == -2 ? 0 : numbers[0];
+    const int nCount = numbers[1] == -2 ? MAX_ADDRESSINDEX_RESULTS : numbers[1];
+    if (nSkip < 0 || nCount < 1 || nCount > (int)MAX_ADDRESSINDEX_RESULTS)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Range out of bounds");
+
+    return rest_address_reply(req, rf, [&]() { return addressUtxosToJSON(scriptHash, nSkip, nCount); });
+}
+
 static const struct {
     const char* prefix;
     bool (*handler)(HTTPRequest* req, const std::string& strReq);
@@ -598,6 +713,8 @@ static const struct {
       {"/rest/mempool/contents", rest_mempool_contents},
       {"/rest/headers/", rest_headers},
       {"/rest/getutxos", rest_getutxos},
+      {"/rest/address/history/", rest_address_history},
+      {"/rest/address/utxos/", rest_address_utxos},
 };
 
 bool StartREST()
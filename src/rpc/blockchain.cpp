@@ -5,7 +5,9 @@
 
 #include "rpc/blockchain.h"
 
+#include "addressindex.h"
 #include "amount.h"
+#include "base58.h"
 #include "chain.h"
 #include "chainparams.h"
 #include "checkpoints.h"
@@ -17,6 +19,7 @@
 #include "policy/policy.h"
 #include "primitives/transaction.h"
 #include "rpc/server.h"
+#include "script/sigcache.h"
 #include "streams.h"
 #include "sync.h"
 #include "txdb.h"
@@ -24,6 +27,7 @@
 #include "util.h"
 #include "utilstrencodings.h"
 #include "hash.h"
+#include "jsonwriter.h"
 
 #include <stdint.h>
 
@@ -127,19 +131,38 @@ UniValue blockheaderToJSON(const CBlockIndex* blockindex)
     return result;
 }
 
-UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDetails)
+CBlockIndexJSON::CBlockIndexJSON(const CBlockIndex* blockindex)
 {
-    UniValue result(UniValue::VOBJ);
-    result.push_back(Pair("hash", blockindex->GetBlockHash().GetHex()));
-    int confirmations = -1;
+    hash = blockindex->GetBlockHash();
+    confirmations = -1;
     // Only report confirmations if the block is on the main chain
     if (chainActive.Contains(blockindex))
         confirmations = chainActive.Height() - blockindex->nHeight + 1;
-    result.push_back(Pair("confirmations", confirmations));
+    height = blockindex->nHeight;
+    mediantime = blockindex->GetMedianTimePast();
+    difficulty = GetDifficulty(blockindex);
+    chainwork = ArithToUint256(blockindex->nChainWork);
+    if (blockindex->pprev)
+        hashPrev = blockindex->pprev->GetBlockHash();
+    CBlockIndex *pnext = chainActive.Next(blockindex);
+    if (pnext)
+        hashNext = pnext->GetBlockHash();
+}
+
+UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDetails)
+{
+    return blockToJSON(block, CBlockIndexJSON(blockindex), txDetails);
+}
+
+UniValue blockToJSON(const CBlock& block, const CBlockIndexJSON& index, bool txDetails)
+{
+    UniValue result(UniValue::VOBJ);
+    result.push_back(Pair("hash", index.hash.GetHex()));
+    result.push_back(Pair("confirmations", index.confirmations));
     result.push_back(Pair("strippedsize", (int)::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION | SERIALIZE_TRANSACTION_NO_WITNESS)));
     result.push_back(Pair("size", (int)::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION)));
     result.push_back(Pair("weight", (int)::GetBlockWeight(block)));
-    result.push_back(Pair("height", blockindex->nHeight));
+    result.push_back(Pair("height", index.height));
     result.push_back(Pair("version", block.nVersion));
     result.push_back(Pair("versionHex", strprintf("%08x", block.nVersion)));
     result.push_back(Pair("merkleroot", block.hashMerkleRoot.GetHex()));
@@ -157,20 +180,52 @@ UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool tx
     }
     result.push_back(Pair("tx", txs));
     result.push_back(Pair("time", block.GetBlockTime()));
-    result.push_back(Pair("mediantime", (int64_t)blockindex->GetMedianTimePast()));
+    result.push_back(Pair("mediantime", index.mediantime));
     result.push_back(Pair("nonce", (uint64_t)block.nNonce));
     result.push_back(Pair("bits", strprintf("%08x", block.nBits)));
-    result.push_back(Pair("difficulty", GetDifficulty(blockindex)));
-    result.push_back(Pair("chainwork", blockindex->nChainWork.GetHex()));
+    result.push_back(Pair("difficulty", index.difficulty));
+    result.push_back(Pair("chainwork", index.chainwork.GetHex()));
 
-    if (blockindex->pprev)
-        result.push_back(Pair("previousblockhash", blockindex->pprev->GetBlockHash().GetHex()));
-    CBlockIndex *pnext = chainActive.Next(blockindex);
-    if (pnext)
-        result.push_back(Pair("nextblockhash", pnext->GetBlockHash().GetHex()));
+    if (!index.hashPrev.IsNull())
+        result.push_back(Pair("previousblockhash", index.hashPrev.GetHex()));
+    if (!index.hashNext.IsNull())
+        result.push_back(Pair("nextblockhash", index.hashNext.GetHex()));
     return result;
 }
 
+void blockToJSON(const CBlock& block, const CBlockIndexJSON& index, bool txDetails, CJSONWriter& writer)
+{
+    writer.BeginObject();
+    writer.Key("hash").String(index.hash.GetHex());
+    writer.Key("confirmations").Int(index.confirmations);
+    writer.Key("strippedsize").Int(::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION | SERIALIZE_TRANSACTION_NO_WITNESS));
+    writer.Key("size").Int(::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION));
+    writer.Key("weight").Int(::GetBlockWeight(block));
+    writer.Key("height").Int(index.height);
+    writer.Key("version").Int(block.nVersion);
+    writer.Key("versionHex").String(strprintf("%08x", block.nVersion));
+    writer.Key("merkleroot").String(block.hashMerkleRoot.GetHex());
+    writer.Key("tx").BeginArray();
+    for (const auto& tx : block.vtx) {
+        if (txDetails)
+            TxToJSON(*tx, uint256(), writer, true, RPCSerializationFlags());
+        else
+            writer.String(tx->GetHash().GetHex());
+    }
+    writer.EndArray();
+    writer.Key("time").Int(block.GetBlockTime());
+    writer.Key("mediantime").Int(index.mediantime);
+    writer.Key("nonce").UInt(block.nNonce);
+    writer.Key("bits").String(strprintf("%08x", block.nBits));
+    writer.Key("difficulty").Real(index.difficulty);
+    writer.Key("chainwork").String(index.chainwork.GetHex());
+    if (!index.hashPrev.IsNull())
+        writer.Key("previousblockhash").String(index.hashPrev.GetHex());
+    if (!index.hashNext.IsNull())
+        writer.Key("nextblockhash").String(index.hashNext.GetHex());
+    writer.EndObject();
+}
+
 UniValue getblockcount(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() != 0)
@@ -759,8 +814,6 @@ UniValue getblock(const JSONRPCRequest& request)
             + HelpExampleRpc("getblock", "\"00000000c937983704a73af28acdec37b049d214adbda81d7e2a3dd146f6ed09\"")
         );
 
-    LOCK(cs_main);
-
     std::string strHash = request.params[0].get_str();
     uint256 hash(uint256S(strHash));
 
@@ -772,16 +825,26 @@ UniValue getblock(const JSONRPCRequest& request)
             verbosity = request.params[1].get_bool() ? 1 : 0;
     }
 
-    if (mapBlockIndex.count(hash) == 0)
-        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+    // Only the index lookups need cs_main; the block is read and described without it
+    CDiskBlockPos pos;
+    CBlockIndexJSON index;
+    {
+        LOCK(cs_main);
+        if (mapBlockIndex.count(hash) == 0)
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
 
-    CBlock block;
-    CBlockIndex* pblockindex = mapBlockIndex[hash];
+        CBlockIndex* pblockindex = mapBlockIndex[hash];
 
-    if (fHavePruned && !(pblockindex->nStatus & BLOCK_HAVE_DATA) && pblockindex->nTx > 0)
-        throw JSONRPCError(RPC_MISC_ERROR, "Block not available (pruned data)");
+        if (fHavePruned && !(pblockindex->nStatus & BLOCK_HAVE_DATA) && pblockindex->nTx > 0)
+            throw JSONRPCError(RPC_MISC_ERROR, "Block not available (pruned data)");
+
+        pos = pblockindex->GetBlockPos();
+        if (verbosity > 0)
+            index = CBlockIndexJSON(pblockindex);
+    }
 
-    if (!ReadBlockFromDisk(block, pblockindex, Params().GetConsensus()))
+    CBlock block;
+    if (!ReadBlockFromDisk(block, pos, Params().GetConsensus()) || block.GetHash() != hash)
         // Block not found on disk. This could be because we have the block
         // header in our index but don't have the block (for example if a
         // non-whitelisted node sends us an unrequested long chain of valid
@@ -797,7 +860,7 @@ UniValue getblock(const JSONRPCRequest& request)
         return strHex;
     }
 
-    return blockToJSON(block, pblockindex, verbosity >= 2);
+    return blockToJSON(block, index, verbosity >= 2);
 }
 
 struct CCoinsStats
@@ -1378,6 +1441,49 @@ UniValue getmempoolinfo(const JSONRPCRequest& request)
     return mempoolInfoToJSON();
 }
 
+static UniValue SignatureCacheStatsToJSON(const SignatureCacheStats& stats)
+{
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("elements", (uint64_t)stats.nElems));
+    ret.push_back(Pair("hits", stats.nHits));
+    ret.push_back(Pair("misses", stats.nMisses));
+    ret.push_back(Pair("inserts", stats.nInserts));
+    ret.push_back(Pair("contended", stats.nContended));
+    return ret;
+}
+
+UniValue getsigcacheinfo(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 0)
+        throw std::runtime_error(
+            "getsigcacheinfo\n"
+            "\nReturns usage statistics of the signature and script execution caches.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"shards\": n,               (numeric) Number of independently locked parts of each cache\n"
+            "  \"signatures\": {            (json object) Signature cache\n"
+            "    \"elements\": xxxxx,       (numeric) Capacity in entries\n"
+            "    \"hits\": xxxxx,           (numeric) Lookups that found their entry\n"
+            "    \"misses\": xxxxx,         (numeric) Lookups that did not\n"
+            "    \"inserts\": xxxxx,        (numeric) Entries added\n"
+            "    \"contended\": xxxxx       (numeric) Lookups and inserts that had to wait for a lock\n"
+            "  },\n"
+            "  \"scripts\": {               (json object) Script execution cache, same fields as above\n"
+            "    ...\n"
+            "  }\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getsigcacheinfo", "")
+            + HelpExampleRpc("getsigcacheinfo", "")
+        );
+
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("shards", (int)SIG_CACHE_SHARDS));
+    ret.push_back(Pair("signatures", SignatureCacheStatsToJSON(GetSignatureCacheStats())));
+    ret.push_back(Pair("scripts", SignatureCacheStatsToJSON(GetScriptExecutionCacheStats())));
+    return ret;
+}
+
 UniValue preciousblock(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() != 1)
@@ -1556,11 +1662,210 @@ UniValue getchaintxstats(const JSONRPCRequest& request)
     return ret;
 }
 
+bool ParseScriptHash(const std::string& str, uint256& scriptHash)
+{
+    CBitcoinAddress address(str);
+    if (address.IsValid()) {
+        scriptHash = GetScriptHash(GetScriptForDestination(address.Get()));
+        return true;
+    }
+    if (!IsHex(str))
+        return false;
+    if (str.size() == 40) {
+        // Contract sender addresses are the key IDs of P2PKH outputs
+        scriptHash = GetScriptHash(GetScriptForDestination(CKeyID(uint160(ParseHex(str)))));
+        return true;
+    }
+    if (str.size() == 64) {
+        scriptHash = uint256S(str);
+        return true;
+    }
+    return false;
+}
+
+UniValue addressHistoryToJSON(const uint256& scriptHash, int nStart, int nEnd, size_t nSkip, size_t nCount)
+{
+    std::vector<std::pair<CAddressIndexKey, CAmount>> vHistory;
+    if (!pblocktree->ReadAddressIndex(scriptHash, nStart, nEnd, nSkip, nCount, vHistory))
+        throw JSONRPCError(RPC_DATABASE_ERROR, "Unable to read address index");
+
+    UniValue result(UniValue::VARR);
+    for (const std::pair<CAddressIndexKey, CAmount>& entry : vHistory) {
+        UniValue obj(UniValue::VOBJ);
+        obj.push_back(Pair("txid", entry.first.txid.GetHex()));
+        obj.push_back(Pair("height", (int)entry.first.nHeight));
+        obj.push_back(Pair("blockindex", (int)entry.first.nTxIndex));
+        obj.push_back(Pair("index", (int)entry.first.nIndex));
+        obj.push_back(Pair("spending", entry.first.fSpending));
+        obj.push_back(Pair("amount", ValueFromAmount(entry.second)));
+        result.push_back(obj);
+    }
+    return result;
+}
+
+UniValue addressUtxosToJSON(const uint256& scriptHash, size_t nSkip, size_t nCount)
+{
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue>> vUnspent;
+    if (!pblocktree->ReadAddressUnspentIndex(scriptHash, nSkip, nCount, vUnspent))
+        throw JSONRPCError(RPC_DATABASE_ERROR, "Unable to read address index");
+
+    UniValue result(UniValue::VARR);
+    for (const std::pair<CAddressUnspentKey, CAddressUnspentValue>& entry : vUnspent) {
+        UniValue obj(UniValue::VOBJ);
+        obj.push_back(Pair("txid", entry.first.outpoint.hash.GetHex()));
+        obj.push_back(Pair("vout", (int)entry.first.outpoint.n));
+        obj.push_back(Pair("amount", ValueFromAmount(entry.second.nValue)));
+        obj.push_back(Pair("scriptPubKey", HexStr(entry.second.script.begin(), entry.second.script.end())));
+        obj.push_back(Pair("height", (int)entry.second.nHeight));
+        obj.push_back(Pair("coinbase", entry.second.fCoinBase));
+        result.push_back(obj);
+    }
+    return result;
+}
+
+static uint256 AddressIndexParam(const UniValue& param)
+{
+    if (!fAddressIndex)
+        throw JSONRPCError(RPC_MISC_ERROR, "Address index not enabled, restart with -addressindex and -reindex");
+    uint256 scriptHash;
+    if (!ParseScriptHash(param.get_str(), scriptHash))
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address or script hash");
+    return scriptHash;
+}
+
+static size_t AddressIndexCountParam(const JSONRPCRequest& request, size_t nParam)
+{
+    if (request.params.size() <= nParam || request.params[nParam].isNull())
+        return MAX_ADDRESSINDEX_RESULTS;
+    int nCount = request.params[nParam].get_int();
+    if (nCount < 1 || nCount > (int)MAX_ADDRESSINDEX_RESULTS)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("count must be between 1 and %u", MAX_ADDRESSINDEX_RESULTS));
+    return nCount;
+}
+
+static size_t AddressIndexSkipParam(const JSONRPCRequest& request, size_t nParam)
+{
+    if (request.params.size() <= nParam || request.params[nParam].isNull())
+        return 0;
+    int nSkip = request.params[nParam].get_int();
+    if (nSkip < 0)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Negative skip");
+    return nSkip;
+}
+
+UniValue getaddresshistory(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() < 1 || request.params.size() > 5)
+        throw std::runtime_error(
+            "getaddresshistory \"address\" ( start end skip count )\n"
+            "\nReturns the outputs paying to and the inputs spending from a script, in block order.\n"
+            "Requires -addressindex.\n"
+            "\nArguments:\n"
+            "1. \"address\"  (string, required) The address, hex sender address or hex script hash (SHA256 of the scriptPubKey)\n"
+            "2. start      (numeric, optional, default=0) The first block height\n"
+            "3. end        (numeric, optional, default=-1) The last block height, -1 for the tip\n"
+            "4. skip       (numeric, optional, default=0) The number of entries to skip\n"
+            "5. count      (numeric, optional, default=" + std::to_string(MAX_ADDRESSINDEX_RESULTS) + ") The most entries to return\n"
+            "\nResult:\n"
+            "[\n"
+            "  {\n"
+            "    \"txid\": \"hash\",       (string) The transaction id\n"
+            "    \"height\": n,          (numeric) The block height\n"
+            "    \"blockindex\": n,      (numeric) The position of the transaction in the block\n"
+            "    \"index\": n,           (numeric) The output index, or the input index if spending\n"
+            "    \"spending\": true|false, (boolean) Whether this is an input spending from the script\n"
+            "    \"amount\": x.xxx,      (numeric) The amount received, negative when spending\n"
+            "  }, ...\n"
+            "]\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getaddresshistory", "\"address\"")
+            + HelpExampleCli("getaddresshistory", "\"address\" 1000 2000 0 100")
+            + HelpExampleRpc("getaddresshistory", "\"address\", 1000, 2000, 0, 100")
+        );
+
+    uint256 scriptHash = AddressIndexParam(request.params[0]);
+    int nStart = 0;
+    if (request.params.size() > 1 && !request.params[1].isNull())
+        nStart = request.params[1].get_int();
+    int nEnd = -1;
+    if (request.params.size() > 2 && !request.params[2].isNull())
+        nEnd = request.params[2].get_int();
+    if (nStart < 0 || nEnd < -1 || (nEnd >= 0 && nEnd < nStart))
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid height range");
+
+    return addressHistoryToJSON(scriptHash, nStart, nEnd, AddressIndexSkipParam(request, 3), AddressIndexCountParam(request, 4));
+}
+
+UniValue getaddressutxos(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() < 1 || request.params.size() > 3)
+        throw std::runtime_error(
+            "getaddressutxos \"address\" ( skip count )\n"
+            "\nReturns the unspent outputs of a script in the chain, ordered by txid.\n"
+            "Requires -addressindex.\n"
+            "\nArguments:\n"
+            "1. \"address\"  (string, required) The address, hex sender address or hex script hash (SHA256 of the scriptPubKey)\n"
+            "2. skip       (numeric, optional, default=0) The number of outputs to skip\n"
+            "3. count      (numeric, optional, default=" + std::to_string(MAX_ADDRESSINDEX_RESULTS) + ") The most outputs to return\n"
+            "\nResult:\n"
+            "[\n"
+            "  {\n"
+            "    \"txid\": \"hash\",         (string) The transaction id\n"
+            "    \"vout\": n,              (numeric) The output index\n"
+            "    \"amount\": x.xxx,        (numeric) The output value\n"
+            "    \"scriptPubKey\": \"hex\",  (string) The output script\n"
+            "    \"height\": n,            (numeric) The height of the block with the output\n"
+            "    \"coinbase\": true|false  (boolean) Whether the output is from a coinbase\n"
+            "  }, ...\n"
+            "]\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getaddressutxos", "\"address\"")
+            + HelpExampleRpc("getaddressutxos", "\"address\", 100, 100")
+        );
+
+    uint256 scriptHash = AddressIndexParam(request.params[0]);
+    return addressUtxosToJSON(scriptHash, AddressIndexSkipParam(request, 1), AddressIndexCountParam(request, 2));
+}
+
+UniValue getaddressbalance(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1)
+        throw std::runtime_error(
+            "getaddressbalance \"address\"\n"
+            "\nReturns the balance of a script in the chain.\n"
+            "Requires -addressindex.\n"
+            "\nArguments:\n"
+            "1. \"address\"  (string, required) The address, hex sender address or hex script hash (SHA256 of the scriptPubKey)\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"balance\": x.xxx,    (numeric) The value of the unspent outputs\n"
+            "  \"received\": x.xxx,   (numeric) The value of all outputs ever received\n"
+            "  \"utxos\": n           (numeric) The number of unspent outputs\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getaddressbalance", "\"address\"")
+            + HelpExampleRpc("getaddressbalance", "\"address\"")
+        );
+
+    uint256 scriptHash = AddressIndexParam(request.params[0]);
+    CAddressBalance balance;
+    if (!pblocktree->ReadAddressBalance(scriptHash, balance))
+        throw JSONRPCError(RPC_DATABASE_ERROR, "Unable to read address index");
+
+    UniValue result(UniValue::VOBJ);
+    result.push_back(Pair("balance", ValueFromAmount(balance.nBalance)));
+    result.push_back(Pair("received", ValueFromAmount(balance.nReceived)));
+    result.push_back(Pair("utxos", balance.nUtxos));
+    return result;
+}
+
 // in contract/rpc.cpp
 extern UniValue callcontract(const JSONRPCRequest& request);
 extern UniValue listcontracts(const JSONRPCRequest& request);
 extern UniValue getcontractinfo(const JSONRPCRequest& request);
 extern UniValue getcontractstorage(const JSONRPCRequest& request);
+extern UniValue getcontractstoragerange(const JSONRPCRequest& request);
+extern UniValue getcontractstorageat(const JSONRPCRequest& request);
 extern UniValue waitforexecrecord(const JSONRPCRequest& request_);
 extern UniValue searchexecrecord(const JSONRPCRequest& request);
 extern UniValue getexecrecord(const JSONRPCRequest& request);
@@ -1581,6 +1886,7 @@ static const CRPCCommand commands[] =
     { "blockchain",         "getmempooldescendants",  &getmempooldescendants,  true,  {"txid","verbose"} },
     { "blockchain",         "getmempoolentry",        &getmempoolentry,        true,  {"txid"} },
     { "blockchain",         "getmempoolinfo",         &getmempoolinfo,         true,  {} },
+    { "blockchain",         "getsigcacheinfo",        &getsigcacheinfo,        true,  {} },
     { "blockchain",         "getrawmempool",          &getrawmempool,          true,  {"verbose"} },
     { "blockchain",         "gettxout",               &gettxout,               true,  {"txid","n","include_mempool"} },
     { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        true,  {} },
@@ -1589,10 +1895,16 @@ static const CRPCCommand commands[] =
 
     { "blockchain",         "preciousblock",          &preciousblock,          true,  {"blockhash"} },
 
+    { "blockchain",         "getaddresshistory",      &getaddresshistory,      true,  {"address","start","end","skip","count"} },
+    { "blockchain",         "getaddressutxos",        &getaddressutxos,        true,  {"address","skip","count"} },
+    { "blockchain",         "getaddressbalance",      &getaddressbalance,      true,  {"address"} },
+
     { "contract",           "callcontract",           &callcontract,           true,  {"address","data"} },
-    { "contract",           "listcontracts",          &listcontracts,          true,  {"start","maxDisplay"} },
+    { "contract",           "listcontracts",          &listcontracts,          true,  {"start","maxDisplay","verbose"} },
     { "contract",           "getcontractinfo",        &getcontractinfo,        true,  {"contract_address"} },
     { "contract",           "getcontractstorage",     &getcontractstorage,     true,  {"address, blockNum, index"} },
+    { "contract",           "getcontractstoragerange", &getcontractstoragerange, true, {"address","start","count","blockNum"} },
+    { "contract",           "getcontractstorageat",   &getcontractstorageat,   true,  {"address","key","blockNum"} },
     { "contract",           "searchexecrecord",       &searchexecrecord,       true,  {"fromBlock", "toBlock", "address", "topics"} },
     { "contract",           "waitforexecrecord",      &waitforexecrecord,      true,  {"fromBlock", "nblocks", "address", "topics"} },
     { "contract",           "getexecrecord",          &getexecrecord,          true,  {"hash"} },
@@ -5,8 +5,15 @@
 #ifndef BITCOIN_RPC_BLOCKCHAIN_H
 #define BITCOIN_RPC_BLOCKCHAIN_H
 
+#include "uint256.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
 class CBlock;
 class CBlockIndex;
+class CJSONWriter;
 class UniValue;
 
 /**
@@ -21,8 +28,31 @@ double GetDifficulty(const CBlockIndex* blockindex = nullptr);
 /** Callback for when block tip changed. */
 void RPCNotifyBlockChange(bool ibd, const CBlockIndex *);
 
+/**
+ * The parts of a block's JSON that come from the block index and the active
+ * chain. Taking them under cs_main lets the rest be written without the lock.
+ */
+struct CBlockIndexJSON
+{
+    uint256 hash;
+    int confirmations;
+    int height;
+    int64_t mediantime;
+    double difficulty;
+    uint256 chainwork;
+    uint256 hashPrev;
+    uint256 hashNext;
+
+    CBlockIndexJSON() : confirmations(-1), height(-1), mediantime(0), difficulty(0) {}
+    //! requires cs_main
+    explicit CBlockIndexJSON(const CBlockIndex* blockindex);
+};
+
 /** Block description to JSON */
 UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDetails = false);
+UniValue blockToJSON(const CBlock& block, const CBlockIndexJSON& index, bool txDetails = false);
+/** Stream the same description, for blocks too large to build as a tree */
+void blockToJSON(const CBlock& block, const CBlockIndexJSON& index, bool txDetails, CJSONWriter& writer);
 
 /** Mempool information to JSON */
 UniValue mempoolInfoToJSON();
@@ -33,5 +63,14 @@ UniValue mempoolToJSON(bool fVerbose = false);
 /** Block header to JSON */
 UniValue blockheaderToJSON(const CBlockIndex* blockindex);
 
+/** Address index key of an address, a hex sender address or a hex script hash */
+bool ParseScriptHash(const std::string& str, uint256& scriptHash);
+
+/** Address index history of a script to JSON */
+UniValue addressHistoryToJSON(const uint256& scriptHash, int nStart, int nEnd, size_t nSkip, size_t nCount);
+
+/** Address index unspent outputs of a script to JSON */
+UniValue addressUtxosToJSON(const uint256& scriptHash, size_t nSkip, size_t nCount);
+
 #endif
 
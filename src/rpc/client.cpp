@@ -139,10 +139,20 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "sendtocontract", 4, "gasPrice" },
     { "sendtocontract", 6, "broadcast" },
     { "sendtocontract", 7, "changeToSender" },
+    { "getaddresshistory", 1, "start" },
+    { "getaddresshistory", 2, "end" },
+    { "getaddresshistory", 3, "skip" },
+    { "getaddresshistory", 4, "count" },
+    { "getaddressutxos", 1, "skip" },
+    { "getaddressutxos", 2, "count" },
     { "listcontracts", 0, "start" },
     { "listcontracts", 1, "maxDisplay" },
+    { "listcontracts", 2, "verbose" },
     { "getcontractstorage", 1, "blockNum" },
     { "getcontractstorage", 2, "index" },
+    { "getcontractstoragerange", 2, "count" },
+    { "getcontractstoragerange", 3, "blockNum" },
+    { "getcontractstorageat", 2, "blockNum" },
     { "searchexecrecord", 0, "fromBlock"},
     { "searchexecrecord", 1, "toBlock"},
     { "searchexecrecord", 2, "address"},
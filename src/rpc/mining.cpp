@@ -26,6 +26,7 @@
 #include "validationinterface.h"
 #include "warnings.h"
 
+#include <atomic>
 #include <memory>
 #include <stdint.h>
 
@@ -105,6 +106,9 @@ UniValue getnetworkhashps(const JSONRPCRequest& request)
     return GetNetworkHashPS(!request.params[0].isNull() ? request.params[0].get_int() : 120, !request.params[1].isNull() ? request.params[1].get_int() : -1);
 }
 
+//! hash rate of the last proof of work search run by generate
+static std::atomic<int64_t> nGenerateHashesPerSec(0);
+
 UniValue generateBlocks(std::shared_ptr<CReserveScript> coinbaseScript, int nGenerate, uint64_t nMaxTries, bool keepScript)
 {
     static const int nInnerLoopCount = 0x1FFFFFFF;
@@ -118,6 +122,9 @@ UniValue generateBlocks(std::shared_ptr<CReserveScript> coinbaseScript, int nGen
         nHeightEnd = nHeight+nGenerate;
     }
     unsigned int nExtraNonce = 0;
+    const int nThreads = std::max(GetNumCores(), 1);
+    uint64_t nTotalHashes = 0;
+    int64_t nTotalTime = 0;
     UniValue blockHashes(UniValue::VARR);
     while (nHeight < nHeightEnd)
     {
@@ -129,14 +136,22 @@ UniValue generateBlocks(std::shared_ptr<CReserveScript> coinbaseScript, int nGen
             LOCK(cs_main);
             IncrementExtraNonce(pblock, chainActive.Tip(), nExtraNonce);
         }
-        while (nMaxTries > 0 && pblock->nNonce < nInnerLoopCount && !CheckProofOfWork(pblock->GetHash(), pblock->nBits, Params().GetConsensus())) {
-            ++pblock->nNonce;
-            --nMaxTries;
-        }
-        if (nMaxTries == 0) {
-            break;
+        const uint32_t nStartNonce = pblock->nNonce;
+        const uint32_t nEndNonce = std::min<uint64_t>(nInnerLoopCount, nStartNonce + nMaxTries);
+        uint64_t nHashes = 0;
+        const int64_t nStartTime = GetTimeMicros();
+        const bool fFound = ScanNonces(*pblock, nEndNonce, nThreads, Params().GetConsensus(), nHashes);
+        const int64_t nElapsed = GetTimeMicros() - nStartTime;
+        nTotalHashes += nHashes;
+        nTotalTime += nElapsed;
+        if (nElapsed > 0) {
+            nGenerateHashesPerSec = nHashes * 1000000 / nElapsed;
         }
-        if (pblock->nNonce == nInnerLoopCount) {
+        nMaxTries -= std::min<uint64_t>(nMaxTries, pblock->nNonce - nStartNonce);
+        if (!fFound) {
+            if (nMaxTries == 0) {
+                break;
+            }
             continue;
         }
         std::shared_ptr<const CBlock> shared_pblock = std::make_shared<const CBlock>(*pblock);
@@ -151,6 +166,8 @@ UniValue generateBlocks(std::shared_ptr<CReserveScript> coinbaseScript, int nGen
             coinbaseScript->KeepScript();
         }
     }
+    LogPrint(BCLog::RPC, "%s: %u hashes in %.3fs on %d threads (%.0f H/s)\n", __func__, nTotalHashes, nTotalTime * 0.000001, nThreads,
+        nTotalTime > 0 ? nTotalHashes * 1000000.0 / nTotalTime : 0.0);
     return blockHashes;
 }
 
@@ -201,6 +218,7 @@ UniValue getmininginfo(const JSONRPCRequest& request)
             "  \"difficulty\": xxx.xxxxx    (numeric) The current difficulty\n"
             "  \"errors\": \"...\"            (string) Current errors\n"
             "  \"networkhashps\": nnn,      (numeric) The network hashes per second\n"
+            "  \"hashespersec\": nnn,       (numeric) The hashes per second of the last generate call\n"
             "  \"pooledtx\": n              (numeric) The size of the mempool\n"
             "  \"chain\": \"xxxx\",           (string) current network name as defined in BIP70 (main, test, regtest)\n"
             "}\n"
@@ -219,6 +237,7 @@ UniValue getmininginfo(const JSONRPCRequest& request)
     obj.push_back(Pair("difficulty",       (double)GetDifficulty()));
     obj.push_back(Pair("errors",           GetWarnings("statusbar")));
     obj.push_back(Pair("networkhashps",    getnetworkhashps(request)));
+    obj.push_back(Pair("hashespersec",     nGenerateHashesPerSec.load()));
     obj.push_back(Pair("pooledtx",         (uint64_t)mempool.size()));
     obj.push_back(Pair("chain",            Params().NetworkIDString()));
     return obj;
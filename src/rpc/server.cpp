@@ -7,6 +7,7 @@
 
 #include "base58.h"
 #include "fs.h"
+#include "httpserver.h"
 #include "init.h"
 #include "random.h"
 #include "sync.h"
@@ -22,7 +23,10 @@
 #include <boost/algorithm/string/classification.hpp>
 #include <boost/algorithm/string/split.hpp>
 
+#include <condition_variable>
 #include <memory> // for unique_ptr
+#include <mutex>
+#include <set>
 #include <unordered_map>
 
 static std::atomic<bool> g_rpc_running{false};
@@ -269,6 +273,66 @@ UniValue uptime(const JSONRPCRequest& jsonRequest)
     return GetTime() - GetStartupTime();
 }
 
+UniValue getrpcinfo(const JSONRPCRequest& jsonRequest)
+{
+    if (jsonRequest.fHelp || jsonRequest.params.size() > 1)
+        throw std::runtime_error(
+                "getrpcinfo ( \"method\" )\n"
+                        "\nReturns the state of the RPC work queue, and call counts and latencies of the RPC methods.\n"
+                        "\nArguments:\n"
+                        "1. \"method\"    (string, optional) Only report this method. By default every method called so far is reported.\n"
+                        "\nResult:\n"
+                        "{\n"
+                        "  \"work_queue\": {            (json object) The HTTP work queue, if the HTTP server runs\n"
+                        "    \"depth\": n,              (numeric) Requests waiting in the queue\n"
+                        "    \"capacity\": n,           (numeric) The queue depth\n"
+                        "    \"deferred\": n,           (numeric) Requests waiting beyond the queue depth\n"
+                        "    \"deferred_total\": n,     (numeric) Requests deferred since startup\n"
+                        "    \"rejected_total\": n      (numeric) Requests refused since startup, with the deferred ones at the limit\n"
+                        "  },\n"
+                        "  \"methods\": {\n"
+                        "    \"method\": {\n"
+                        "      \"calls\": n,            (numeric) Number of calls\n"
+                        "      \"errors\": n,           (numeric) Number of calls that failed\n"
+                        "      \"total_us\": n,         (numeric) Total time spent in the method, in microseconds\n"
+                        "      \"avg_us\": n,           (numeric) Average time of a call\n"
+                        "      \"max_us\": n,           (numeric) Longest call\n"
+                        "      \"latency_us\": {        (json object) Calls by duration, for the ranges with any calls\n"
+                        "        \"<n\": n,             (numeric) Number of calls that took under n microseconds\n"
+                        "        ...\n"
+                        "      }\n"
+                        "    },\n"
+                        "    ...\n"
+                        "  }\n"
+                        "}\n"
+                        "\nExamples:\n"
+                + HelpExampleCli("getrpcinfo", "")
+                + HelpExampleCli("getrpcinfo", "\"getblock\"")
+                + HelpExampleRpc("getrpcinfo", "")
+        );
+
+    std::string strMethod;
+    if (!jsonRequest.params[0].isNull()) {
+        strMethod = jsonRequest.params[0].get_str();
+        if (!tableRPC[strMethod])
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Unknown method " + strMethod);
+    }
+
+    UniValue result(UniValue::VOBJ);
+    HTTPWorkQueueInfo info;
+    if (GetHTTPWorkQueueInfo(info)) {
+        UniValue queue(UniValue::VOBJ);
+        queue.pushKV("depth", (uint64_t)info.nDepth);
+        queue.pushKV("capacity", (uint64_t)info.nCapacity);
+        queue.pushKV("deferred", (uint64_t)info.nDeferred);
+        queue.pushKV("deferred_total", info.nDeferredTotal);
+        queue.pushKV("rejected_total", info.nRejectedTotal);
+        result.pushKV("work_queue", queue);
+    }
+    result.pushKV("methods", tableRPC.methodStats(strMethod));
+    return result;
+}
+
 /**
  * Call Table
  */
@@ -279,6 +343,7 @@ static const CRPCCommand vRPCCommands[] =
     { "control",            "help",                   &help,                   true,  {"command"}  },
     { "control",            "stop",                   &stop,                   true,  {}  },
     { "control",            "uptime",                 &uptime,                 true,  {}  },
+    { "control",            "getrpcinfo",             &getrpcinfo,             true,  {"method"}  },
 };
 
 CRPCTable::CRPCTable()
@@ -290,6 +355,7 @@ CRPCTable::CRPCTable()
 
         pcmd = &vRPCCommands[vcidx];
         mapCommands[pcmd->name] = pcmd;
+        mapStats[pcmd->name].reset(new CRPCMethodStats());
     }
 }
 
@@ -312,9 +378,76 @@ bool CRPCTable::appendCommand(const std::string& name, const CRPCCommand* pcmd)
         return false;
 
     mapCommands[name] = pcmd;
+    mapStats[name].reset(new CRPCMethodStats());
     return true;
 }
 
+bool CRPCTable::isParallelSafe(const std::string& name) const
+{
+    // Read-only calls that touch no wallet and take cs_main, if at all, only to read
+    static const std::set<std::string> setParallelSafe = {
+        "callcontract", "decoderawtransaction", "decodescript", "getaddressbalance",
+        "getaddresshistory", "getaddressutxos", "getbestblockhash", "getblock",
+        "getblockcount", "getblockhash", "getblockheader", "getmempoolentry",
+        "getrawtransaction", "gettxout", "getrpcinfo", "uptime",
+    };
+    return setParallelSafe.count(name) > 0 && mapCommands.count(name) > 0;
+}
+
+UniValue CRPCTable::methodStats(const std::string& name) const
+{
+    UniValue result(UniValue::VOBJ);
+    for (const auto& item : mapStats) {
+        if (name.empty() ? item.second->Calls() > 0 : item.first == name)
+            result.pushKV(item.first, item.second->ToJSON());
+    }
+    return result;
+}
+
+CRPCMethodStats::CRPCMethodStats() : nCalls(0), nErrors(0), nTotalMicros(0), nMaxMicros(0)
+{
+    for (int i = 0; i < LATENCY_BUCKETS; i++)
+        vLatency[i] = 0;
+}
+
+void CRPCMethodStats::Record(int64_t nMicros, bool fError)
+{
+    const uint64_t nTime = std::max<int64_t>(nMicros, 0);
+    int nBucket = 0;
+    while (nBucket < LATENCY_BUCKETS - 1 && nTime >= ((uint64_t)1 << nBucket))
+        nBucket++;
+    ++vLatency[nBucket];
+    ++nCalls;
+    if (fError)
+        ++nErrors;
+    nTotalMicros += nTime;
+    uint64_t nMax = nMaxMicros;
+    while (nTime > nMax && !nMaxMicros.compare_exchange_weak(nMax, nTime)) {}
+}
+
+UniValue CRPCMethodStats::ToJSON() const
+{
+    UniValue obj(UniValue::VOBJ);
+    const uint64_t nCallsNow = nCalls;
+    obj.pushKV("calls", nCallsNow);
+    obj.pushKV("errors", (uint64_t)nErrors);
+    obj.pushKV("total_us", (uint64_t)nTotalMicros);
+    obj.pushKV("avg_us", nCallsNow ? (uint64_t)nTotalMicros / nCallsNow : 0);
+    obj.pushKV("max_us", (uint64_t)nMaxMicros);
+    UniValue histogram(UniValue::VOBJ);
+    for (int i = 0; i < LATENCY_BUCKETS; i++) {
+        const uint64_t nCount = vLatency[i];
+        if (nCount == 0)
+            continue;
+        if (i < LATENCY_BUCKETS - 1)
+            histogram.pushKV(strprintf("<%d", (uint64_t)1 << i), nCount);
+        else
+            histogram.pushKV(strprintf(">=%d", (uint64_t)1 << (i - 1)), nCount);
+    }
+    obj.pushKV("latency_us", histogram);
+    return obj;
+}
+
 bool StartRPC()
 {
     LogPrint(BCLog::RPC, "Starting RPC\n");
@@ -456,11 +589,82 @@ static UniValue JSONRPCExecOne(const UniValue& req)
     return rpc_result;
 }
 
+static bool IsParallelBatchCall(const UniValue& req)
+{
+    if (!req.isObject())
+        return false;
+    const UniValue& method = find_value(req, "method");
+    return method.isStr() && tableRPC.isParallelSafe(method.get_str());
+}
+
+/** Execute vReq[nBegin, nEnd) on this thread and up to nThreads - 1 HTTP workers */
+static void JSONRPCExecParallel(const UniValue& vReq, size_t nBegin, size_t nEnd, int nThreads, std::vector<UniValue>& vResults)
+{
+    struct Job
+    {
+        std::atomic<size_t> nNext;
+        std::mutex cs;
+        std::condition_variable cond;
+        size_t nDone;
+    };
+    std::shared_ptr<Job> job = std::make_shared<Job>();
+    job->nNext = nBegin;
+    job->nDone = 0;
+
+    // Workers that start after every call is taken return without touching
+    // vReq or vResults, which are only guaranteed to live until all are done
+    const UniValue* pvReq = &vReq;
+    std::vector<UniValue>* pvResults = &vResults;
+    std::function<void()> run = [job, pvReq, pvResults, nEnd]() {
+        size_t nDone = 0;
+        for (size_t i = job->nNext++; i < nEnd; i = job->nNext++) {
+            (*pvResults)[i] = JSONRPCExecOne((*pvReq)[i]);
+            nDone++;
+        }
+        if (nDone > 0) {
+            std::lock_guard<std::mutex> lock(job->cs);
+            job->nDone += nDone;
+            job->cond.notify_all();
+        }
+    };
+
+    const size_t nHelpers = std::min<size_t>(std::max(nThreads, 1) - 1, nEnd - nBegin - 1);
+    for (size_t i = 0; i < nHelpers; i++) {
+        if (!QueueHTTPWork(run))
+            break;
+    }
+    // This thread takes calls too, so the batch finishes even when every
+    // worker is busy
+    run();
+
+    std::unique_lock<std::mutex> lock(job->cs);
+    while (job->nDone < nEnd - nBegin)
+        job->cond.wait(lock);
+}
+
 std::string JSONRPCExecBatch(const UniValue& vReq)
 {
+    const int nThreads = gArgs.GetArg("-rpcbatchthreads", DEFAULT_RPC_BATCH_THREADS);
+    std::vector<UniValue> vResults(vReq.size());
+    size_t nStart = 0;
+    while (nStart < vReq.size()) {
+        size_t nEnd = nStart;
+        if (nThreads > 1) {
+            while (nEnd < vReq.size() && IsParallelBatchCall(vReq[nEnd]))
+                nEnd++;
+        }
+        if (nEnd - nStart > 1) {
+            JSONRPCExecParallel(vReq, nStart, nEnd, nThreads, vResults);
+            nStart = nEnd;
+        } else {
+            vResults[nStart] = JSONRPCExecOne(vReq[nStart]);
+            nStart++;
+        }
+    }
+
     UniValue ret(UniValue::VARR);
-    for (unsigned int reqIdx = 0; reqIdx < vReq.size(); reqIdx++)
-        ret.push_back(JSONRPCExecOne(vReq[reqIdx]));
+    for (const UniValue& result : vResults)
+        ret.push_back(result);
 
     return ret.write() + "\n";
 }
@@ -531,14 +735,33 @@ UniValue CRPCTable::execute(const JSONRPCRequest &request) const
 
     g_rpcSignals.PreCommand(*pcmd);
 
+    // Times the call, counting it as failed unless it returns
+    struct CallTimer
+    {
+        CRPCMethodStats* pstats;
+        int64_t nStart;
+        bool fError;
+        CallTimer(CRPCMethodStats* pstatsIn) : pstats(pstatsIn), nStart(GetTimeMicros()), fError(true) {}
+        ~CallTimer()
+        {
+            if (pstats)
+                pstats->Record(GetTimeMicros() - nStart, fError);
+        }
+    };
+    std::map<std::string, std::unique_ptr<CRPCMethodStats>>::const_iterator itStats = mapStats.find(request.strMethod);
+    CallTimer timer(itStats != mapStats.end() ? itStats->second.get() : nullptr);
+
     try
     {
         // Execute, convert arguments to array if necessary
+        UniValue result;
         if (request.params.isObject()) {
-            return pcmd->actor(transformNamedArguments(request, pcmd->argNames));
+            result = pcmd->actor(transformNamedArguments(request, pcmd->argNames));
         } else {
-            return pcmd->actor(request);
+            result = pcmd->actor(request);
         }
+        timer.fError = false;
+        return result;
     }
     catch (const std::exception& e)
     {
@@ -10,8 +10,10 @@
 #include "rpc/protocol.h"
 #include "uint256.h"
 
+#include <atomic>
 #include <list>
 #include <map>
+#include <memory>
 #include <stdint.h>
 #include <string>
 
@@ -19,6 +21,8 @@
 #include <httpserver.h>
 
 static const unsigned int DEFAULT_RPC_SERIALIZE_VERSION = 1;
+//! the number of threads a JSON-RPC batch may run its calls on
+static const int DEFAULT_RPC_BATCH_THREADS = 4;
 
 
 struct CUpdatedBlock
@@ -195,6 +199,26 @@ public:
     std::vector<std::string> argNames;
 };
 
+/** Call count and latency histogram of an RPC method */
+class CRPCMethodStats
+{
+public:
+    //! bucket i counts calls that took under 2^i microseconds, the last one all slower calls
+    static const int LATENCY_BUCKETS = 28;
+
+    CRPCMethodStats();
+    void Record(int64_t nMicros, bool fError);
+    uint64_t Calls() const { return nCalls; }
+    UniValue ToJSON() const;
+
+private:
+    std::atomic<uint64_t> nCalls;
+    std::atomic<uint64_t> nErrors;
+    std::atomic<uint64_t> nTotalMicros;
+    std::atomic<uint64_t> nMaxMicros;
+    std::atomic<uint64_t> vLatency[LATENCY_BUCKETS];
+};
+
 /**
  * Bitcoin RPC command dispatcher.
  */
@@ -202,6 +226,8 @@ class CRPCTable
 {
 private:
     std::map<std::string, const CRPCCommand*> mapCommands;
+    //! filled with mapCommands, before the server starts, so calls can update it without a lock
+    std::map<std::string, std::unique_ptr<CRPCMethodStats>> mapStats;
 public:
     CRPCTable();
     const CRPCCommand* operator[](const std::string& name) const;
@@ -228,6 +254,12 @@ public:
      * Commands cannot be overwritten (returns false).
      */
     bool appendCommand(const std::string& name, const CRPCCommand* pcmd);
+
+    /** Whether calls to name may run alongside other calls of a batch */
+    bool isParallelSafe(const std::string& name) const;
+
+    /** Statistics of the method called name, or of every method called so far if name is empty */
+    UniValue methodStats(const std::string& name) const;
 };
 
 extern CRPCTable tableRPC;
@@ -249,6 +281,11 @@ extern std::string HelpExampleRpc(const std::string& methodname, const std::stri
 bool StartRPC();
 void InterruptRPC();
 void StopRPC();
+/**
+ * Execute a batch of JSON-RPC requests. Runs of consecutive read-only calls
+ * are spread over the HTTP workers, up to -rpcbatchthreads at a time; other
+ * calls run on their own, in order.
+ */
 std::string JSONRPCExecBatch(const UniValue& vReq);
 
 // Retrieves any serialization flags requested in command line argument
@@ -11,6 +11,7 @@
 #include "crypto/sha256.h"
 #include "pubkey.h"
 #include "script/script.h"
+#include "streams.h"
 #include "uint256.h"
 
 namespace {
@@ -1179,6 +1180,29 @@ public:
     }
 };
 
+/** Stream feeding what is serialized to it into a SHA256 hasher */
+class CSHA256Writer
+{
+private:
+    CSHA256& sha;
+
+public:
+    explicit CSHA256Writer(CSHA256& shaIn) : sha(shaIn) {}
+
+    int GetType() const { return SER_GETHASH; }
+    int GetVersion() const { return 0; }
+
+    void write(const char *pch, size_t size) {
+        sha.Write((const unsigned char*)pch, size);
+    }
+
+    template<typename T>
+    CSHA256Writer& operator<<(const T& obj) {
+        ::Serialize(*this, obj);
+        return (*this);
+    }
+};
+
 uint256 GetPrevoutHash(const CTransaction& txTo) {
     CHashWriter ss(SER_GETHASH, 0);
     for (const auto& txin : txTo.vin) {
@@ -1205,6 +1229,88 @@ uint256 GetOutputsHash(const CTransaction& txTo) {
 
 } // namespace
 
+uint256 LegacySighashCache::SignatureHash(const CScript& scriptCode, const CTransaction& txTo, unsigned int nIn, int nHashType)
+{
+    const std::tuple<unsigned int, int, CScript> key(nIn, nHashType, scriptCode);
+    const bool fAnyoneCanPay = nHashType & SIGHASH_ANYONECANPAY;
+    const bool fBlankSequence = (nHashType & 0x1f) == SIGHASH_SINGLE || (nHashType & 0x1f) == SIGHASH_NONE;
+    Layout& layout = layouts[fBlankSequence ? 1 : 0];
+
+    CTransactionSignatureSerializer txTmp(txTo, scriptCode, nIn, nHashType);
+    CSHA256 sha;
+    CSHA256Writer s(sha);
+    {
+        std::lock_guard<std::mutex> lock(cs);
+        std::map<std::tuple<unsigned int, int, CScript>, uint256>::const_iterator it = mapHashes.find(key);
+        if (it != mapHashes.end())
+            return it->second;
+
+        if (!fAnyoneCanPay) {
+            if (layout.vMidstates.empty()) {
+                CVectorWriter w(SER_GETHASH, 0, layout.vchInputs, layout.vchInputs.size());
+                for (const CTxIn& txin : txTo.vin) {
+                    layout.vOffsets.push_back(layout.vchInputs.size());
+                    w << txin.prevout << CScript();
+                    if (fBlankSequence)
+                        w << (int)0;
+                    else
+                        w << txin.nSequence;
+                }
+                layout.vOffsets.push_back(layout.vchInputs.size());
+                CSHA256 shaStart;
+                CSHA256Writer wStart(shaStart);
+                wStart << txTo.nVersion;
+                ::WriteCompactSize(wStart, txTo.vin.size());
+                layout.vMidstates.push_back(shaStart);
+            }
+            while (layout.vMidstates.size() <= nIn) {
+                const size_t nInput = layout.vMidstates.size() - 1;
+                CSHA256 shaNext = layout.vMidstates.back();
+                shaNext.Write(&layout.vchInputs[layout.vOffsets[nInput]], layout.vOffsets[nInput + 1] - layout.vOffsets[nInput]);
+                layout.vMidstates.push_back(shaNext);
+            }
+            sha = layout.vMidstates[nIn];
+        }
+    }
+
+    if (fAnyoneCanPay) {
+        // Only the input signed is serialized, so there is no prefix to share
+        s << txTmp << nHashType;
+    } else {
+        // The inputs are never rewritten once serialized, so the rest is
+        // hashed without the lock
+        txTmp.SerializeInput(s, nIn);
+        const size_t nRest = layout.vOffsets[nIn + 1];
+        if (nRest < layout.vchInputs.size())
+            sha.Write(&layout.vchInputs[nRest], layout.vchInputs.size() - nRest);
+        const unsigned int nOutputs = (nHashType & 0x1f) == SIGHASH_NONE ? 0 : ((nHashType & 0x1f) == SIGHASH_SINGLE ? nIn + 1 : txTo.vout.size());
+        ::WriteCompactSize(s, nOutputs);
+        for (unsigned int nOutput = 0; nOutput < nOutputs; nOutput++)
+            txTmp.SerializeOutput(s, nOutput);
+        s << txTo.nLockTime << nHashType;
+    }
+
+    // Same double SHA256 as CHashWriter
+    uint256 hash;
+    sha.Finalize(hash.begin());
+    CSHA256().Write(hash.begin(), CSHA256::OUTPUT_SIZE).Finalize(hash.begin());
+
+    std::lock_guard<std::mutex> lock(cs);
+    mapHashes.emplace(key, hash);
+    return hash;
+}
+
+void LegacySighashCache::Clear()
+{
+    std::lock_guard<std::mutex> lock(cs);
+    for (Layout& layout : layouts) {
+        std::vector<unsigned char>().swap(layout.vchInputs);
+        std::vector<size_t>().swap(layout.vOffsets);
+        std::vector<CSHA256>().swap(layout.vMidstates);
+    }
+    mapHashes.clear();
+}
+
 PrecomputedTransactionData::PrecomputedTransactionData(const CTransaction& txTo)
 {
     hashPrevouts = GetPrevoutHash(txTo);
@@ -1273,6 +1379,9 @@ uint256 SignatureHash(const CScript& scriptCode, const CTransaction& txTo, unsig
         }
     }
 
+    if (cache)
+        return cache->legacyCache.SignatureHash(scriptCode, txTo, nIn, nHashType);
+
     // Wrapper to serialize only the necessary parts of the transaction being signed
     CTransactionSignatureSerializer txTmp(txTo, scriptCode, nIn, nHashType);
 
@@ -7,8 +7,12 @@
 #define BITCOIN_SCRIPT_INTERPRETER_H
 
 #include "script_error.h"
+#include "crypto/sha256.h"
 #include "primitives/transaction.h"
 
+#include <map>
+#include <mutex>
+#include <tuple>
 #include <vector>
 #include <stdint.h>
 #include <string>
@@ -121,9 +125,44 @@ enum
 
 bool CheckSignatureEncoding(const std::vector<unsigned char> &vchSig, unsigned int flags, ScriptError* serror);
 
+/**
+ * Legacy signature hashes of one transaction. The legacy scheme serializes
+ * the whole transaction for every signature, so checking a transaction with
+ * n inputs hashes O(n^2) bytes, and OP_CHECKMULTISIG hashes it again for
+ * every key it tries. This keeps the hashes by (scriptCode, input, hash
+ * type), and serializes the blanked inputs once along with the hasher state
+ * before each of them, so an input is only hashed from its own position on.
+ * Safe to use from the threads checking the inputs of the transaction.
+ */
+class LegacySighashCache
+{
+private:
+    struct Layout
+    {
+        //! The inputs as serialized in the hash of another input
+        std::vector<unsigned char> vchInputs;
+        //! Start of each input in vchInputs, followed by the end
+        std::vector<size_t> vOffsets;
+        //! Hasher after nVersion, the input count and the inputs before each input
+        std::vector<CSHA256> vMidstates;
+    };
+
+    std::mutex cs;
+    //! With the nSequence of other inputs kept, and zeroed (SIGHASH_NONE, SIGHASH_SINGLE)
+    Layout layouts[2];
+    std::map<std::tuple<unsigned int, int, CScript>, uint256> mapHashes;
+
+public:
+    /** Hash of input nIn, which must be in range, as SignatureHash computes it for SIGVERSION_BASE */
+    uint256 SignatureHash(const CScript& scriptCode, const CTransaction& txTo, unsigned int nIn, int nHashType);
+    /** Release the memory held; must not run alongside SignatureHash */
+    void Clear();
+};
+
 struct PrecomputedTransactionData
 {
     uint256 hashPrevouts, hashSequence, hashOutputs;
+    mutable LegacySighashCache legacyCache;
 
     PrecomputedTransactionData(const CTransaction& tx);
 };
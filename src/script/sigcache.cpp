@@ -11,9 +11,62 @@
 #include "uint256.h"
 #include "util.h"
 
-#include "cuckoocache.h"
 #include <boost/thread.hpp>
 
+size_t CShardedSignatureCache::setup_bytes(size_t nBytes)
+{
+    size_t nElems = 0;
+    for (Shard& shard : shards) {
+        boost::unique_lock<boost::shared_mutex> lock(shard.mutex);
+        shard.nElems = shard.setValid.setup_bytes(nBytes / SIG_CACHE_SHARDS);
+        nElems += shard.nElems;
+    }
+    return nElems;
+}
+
+bool CShardedSignatureCache::contains(const uint256& entry, bool erase)
+{
+    Shard& shard = GetShard(entry);
+    boost::shared_lock<boost::shared_mutex> lock(shard.mutex, boost::try_to_lock);
+    if (!lock.owns_lock()) {
+        shard.nContended++;
+        lock.lock();
+    }
+    // Erasing only marks the entry as collectable, which is safe under a
+    // shared lock.
+    bool fFound = shard.setValid.contains(entry, erase);
+    if (fFound)
+        shard.nHits++;
+    else
+        shard.nMisses++;
+    return fFound;
+}
+
+void CShardedSignatureCache::insert(const uint256& entry)
+{
+    Shard& shard = GetShard(entry);
+    boost::unique_lock<boost::shared_mutex> lock(shard.mutex, boost::try_to_lock);
+    if (!lock.owns_lock()) {
+        shard.nContended++;
+        lock.lock();
+    }
+    shard.setValid.insert(entry);
+    shard.nInserts++;
+}
+
+SignatureCacheStats CShardedSignatureCache::GetStats() const
+{
+    SignatureCacheStats stats;
+    for (const Shard& shard : shards) {
+        stats.nElems += shard.nElems;
+        stats.nHits += shard.nHits;
+        stats.nMisses += shard.nMisses;
+        stats.nInserts += shard.nInserts;
+        stats.nContended += shard.nContended;
+    }
+    return stats;
+}
+
 namespace {
 /**
  * Valid signature cache, to avoid doing expensive ECDSA signature checking
@@ -25,9 +78,7 @@ class CSignatureCache
 private:
      //! Entries are SHA256(nonce || signature hash || public key || signature):
     uint256 nonce;
-    typedef CuckooCache::cache<uint256, SignatureCacheHasher> map_type;
-    map_type setValid;
-    boost::shared_mutex cs_sigcache;
+    CShardedSignatureCache setValid;
 
 public:
     CSignatureCache()
@@ -44,19 +95,21 @@ public:
     bool
     Get(const uint256& entry, const bool erase)
     {
-        boost::shared_lock<boost::shared_mutex> lock(cs_sigcache);
         return setValid.contains(entry, erase);
     }
 
     void Set(uint256& entry)
     {
-        boost::unique_lock<boost::shared_mutex> lock(cs_sigcache);
         setValid.insert(entry);
     }
-    uint32_t setup_bytes(size_t n)
+    size_t setup_bytes(size_t n)
     {
         return setValid.setup_bytes(n);
     }
+    SignatureCacheStats GetStats() const
+    {
+        return setValid.GetStats();
+    }
 };
 
 /* In previous versions of this code, signatureCache was a local static variable
@@ -80,6 +133,11 @@ void InitSignatureCache()
             (nElems*sizeof(uint256)) >>20, (nMaxCacheSize*2)>>20, nElems);
 }
 
+SignatureCacheStats GetSignatureCacheStats()
+{
+    return signatureCache.GetStats();
+}
+
 bool CachingTransactionSignatureChecker::VerifySignature(const std::vector<unsigned char>& vchSig, const CPubKey& pubkey, const uint256& sighash) const
 {
     uint256 entry;
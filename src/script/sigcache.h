@@ -6,16 +6,23 @@
 #ifndef BITCOIN_SCRIPT_SIGCACHE_H
 #define BITCOIN_SCRIPT_SIGCACHE_H
 
+#include "cuckoocache.h"
 #include "script/interpreter.h"
 
+#include <atomic>
 #include <vector>
 
+#include <boost/thread/shared_mutex.hpp>
+
 // DoS prevention: limit cache size to 32MB (over 1000000 entries on 64-bit
 // systems). Due to how we count cache size, actual memory usage is slightly
 // more (~32.25 MB)
 static const unsigned int DEFAULT_MAX_SIG_CACHE_SIZE = 32;
 // Maximum sig cache size allowed
 static const int64_t MAX_MAX_SIG_CACHE_SIZE = 16384;
+// Number of independently locked parts the signature and script execution
+// caches are split into
+static const unsigned int SIG_CACHE_SHARDS = 32;
 
 class CPubKey;
 
@@ -40,17 +47,75 @@ public:
     }
 };
 
+/** Usage counters of a CShardedSignatureCache */
+struct SignatureCacheStats
+{
+    size_t nElems;
+    uint64_t nHits;
+    uint64_t nMisses;
+    uint64_t nInserts;
+    //! Lookups or inserts that had to wait for another thread's lock
+    uint64_t nContended;
+
+    SignatureCacheStats() : nElems(0), nHits(0), nMisses(0), nInserts(0), nContended(0) {}
+};
+
+/**
+ * A set of nonced uint256 hashes, split into SIG_CACHE_SHARDS cuckoo caches
+ * with a lock each, so that script check threads looking up or adding
+ * different entries rarely wait for each other. Each shard keeps its own
+ * epochs, i.e. ages and evicts its entries independently.
+ *
+ * The shard is picked by the first byte of the entry, which barely
+ * affects where SignatureCacheHasher places it inside the shard.
+ */
+class CShardedSignatureCache
+{
+private:
+    typedef CuckooCache::cache<uint256, SignatureCacheHasher> map_type;
+
+    struct Shard
+    {
+        map_type setValid;
+        boost::shared_mutex mutex;
+        std::atomic<uint64_t> nHits;
+        std::atomic<uint64_t> nMisses;
+        std::atomic<uint64_t> nInserts;
+        std::atomic<uint64_t> nContended;
+        size_t nElems;
+
+        Shard() : nHits(0), nMisses(0), nInserts(0), nContended(0), nElems(0) {}
+    };
+
+    Shard shards[SIG_CACHE_SHARDS];
+
+    Shard& GetShard(const uint256& entry)
+    {
+        return shards[*entry.begin() % SIG_CACHE_SHARDS];
+    }
+
+public:
+    /** Split nBytes over the shards; returns the total number of elements. */
+    size_t setup_bytes(size_t nBytes);
+
+    bool contains(const uint256& entry, bool erase);
+    void insert(const uint256& entry);
+
+    SignatureCacheStats GetStats() const;
+};
+
 class CachingTransactionSignatureChecker : public TransactionSignatureChecker
 {
 private:
     bool store;
 
 public:
-    CachingTransactionSignatureChecker(const CTransaction* txToIn, unsigned int nInIn, const CAmount& amountIn, bool storeIn, PrecomputedTransactionData& txdataIn) : TransactionSignatureChecker(txToIn, nInIn, amountIn, txdataIn), store(storeIn) {}
+    CachingTransactionSignatureChecker(const CTransaction* txToIn, unsigned int nInIn, const CAmount& amountIn, bool storeIn, const PrecomputedTransactionData& txdataIn) : TransactionSignatureChecker(txToIn, nInIn, amountIn, txdataIn), store(storeIn) {}
 
     bool VerifySignature(const std::vector<unsigned char>& vchSig, const CPubKey& vchPubKey, const uint256& sighash) const override;
 };
 
 void InitSignatureCache();
+SignatureCacheStats GetSignatureCacheStats();
 
 #endif // BITCOIN_SCRIPT_SIGCACHE_H
@@ -0,0 +1,211 @@
+#ifndef BITCOIN_SUPPORT_ALLOCATORS_POOL_H
+#define BITCOIN_SUPPORT_ALLOCATORS_POOL_H
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <list>
+#include <new>
+#include <utility>
+
+/**
+ * A memory resource that hands out small blocks from large chunks, for
+ * node based containers like std::unordered_map.
+ *
+ * Blocks up to MAX_BLOCK_SIZE_BYTES are carved out of large chunks with a
+ * bump pointer, so they carry no per-allocation
+ * malloc overhead. Freed blocks are kept in one singly linked free list per
+ * size class and are reused by later allocations of the same size. Memory
+ * only goes back to the system when the resource is destroyed, which makes
+ * freeing a whole container cheap. Larger or over-aligned requests fall
+ * back to ::operator new.
+ */
+template <std::size_t MAX_BLOCK_SIZE_BYTES, std::size_t ALIGN_BYTES>
+class PoolResource
+{
+    static_assert(ALIGN_BYTES > 0, "ALIGN_BYTES must be nonzero");
+    static_assert((ALIGN_BYTES & (ALIGN_BYTES - 1)) == 0, "ALIGN_BYTES must be a power of two");
+    static_assert(ALIGN_BYTES <= alignof(std::max_align_t), "chunks are only aligned to max_align_t");
+
+    /** In-place linked list of free blocks. */
+    struct ListNode {
+        ListNode* m_next;
+        explicit ListNode(ListNode* next) : m_next(next) {}
+    };
+
+    /** Size class granularity; every block can hold a ListNode. */
+    static constexpr std::size_t ELEM_ALIGN_BYTES = ALIGN_BYTES > alignof(ListNode) ? ALIGN_BYTES : alignof(ListNode);
+    static_assert(sizeof(ListNode) <= ELEM_ALIGN_BYTES, "a free block must fit a ListNode");
+    static_assert(MAX_BLOCK_SIZE_BYTES >= ELEM_ALIGN_BYTES, "MAX_BLOCK_SIZE_BYTES too small");
+
+    const std::size_t m_chunk_size_bytes;
+
+    /** All chunks handed out by ::operator new, freed in the destructor. */
+    std::list<char*> m_allocated_chunks;
+
+    /** One free list per size class, indexed by the number of ELEM_ALIGN_BYTES units. */
+    std::array<ListNode*, MAX_BLOCK_SIZE_BYTES / ELEM_ALIGN_BYTES + 1> m_free_lists;
+
+    /** Unused tail of the current chunk. */
+    char* m_available_memory_it;
+    char* m_available_memory_end;
+
+    /** Total size of the blocks on the free lists. */
+    std::size_t m_free_bytes;
+
+    static std::size_t NumElemAlignBytes(std::size_t bytes)
+    {
+        return (bytes + ELEM_ALIGN_BYTES - 1) / ELEM_ALIGN_BYTES + (bytes == 0);
+    }
+
+    static bool IsFreeListUsable(std::size_t bytes, std::size_t alignment)
+    {
+        return alignment <= ELEM_ALIGN_BYTES && bytes <= MAX_BLOCK_SIZE_BYTES;
+    }
+
+    void PlacementAddToList(void* p, ListNode*& node)
+    {
+        node = new (p) ListNode(node);
+    }
+
+    /**
+     * Put the rest of the current chunk into the free lists and start a new
+     * one. The first chunk is only allocated on demand, so that short lived
+     * empty containers cost nothing.
+     */
+    void AllocateChunk()
+    {
+        if (m_available_memory_end != m_available_memory_it) {
+            std::size_t remaining = m_available_memory_end - m_available_memory_it;
+            PlacementAddToList(m_available_memory_it, m_free_lists[remaining / ELEM_ALIGN_BYTES]);
+            m_free_bytes += remaining;
+        }
+        char* chunk = static_cast<char*>(::operator new(m_chunk_size_bytes));
+        m_allocated_chunks.push_back(chunk);
+        m_available_memory_it = chunk;
+        m_available_memory_end = chunk + m_chunk_size_bytes;
+    }
+
+public:
+    /** Default chunk size; big enough to amortize the malloc, small enough not to waste much. */
+    static const std::size_t DEFAULT_CHUNK_SIZE_BYTES = 262144;
+
+    explicit PoolResource(std::size_t chunk_size_bytes = DEFAULT_CHUNK_SIZE_BYTES) :
+        m_chunk_size_bytes(NumElemAlignBytes(chunk_size_bytes) * ELEM_ALIGN_BYTES),
+        m_available_memory_it(nullptr), m_available_memory_end(nullptr), m_free_bytes(0)
+    {
+        assert(m_chunk_size_bytes >= MAX_BLOCK_SIZE_BYTES);
+        m_free_lists.fill(nullptr);
+    }
+
+    PoolResource(const PoolResource&) = delete;
+    PoolResource& operator=(const PoolResource&) = delete;
+
+    ~PoolResource()
+    {
+        for (char* chunk : m_allocated_chunks) {
+            ::operator delete(chunk);
+        }
+    }
+
+    void* Allocate(std::size_t bytes, std::size_t alignment)
+    {
+        if (IsFreeListUsable(bytes, alignment)) {
+            const std::size_t num_alignments = NumElemAlignBytes(bytes);
+            ListNode*& list = m_free_lists[num_alignments];
+            const std::size_t round_bytes = num_alignments * ELEM_ALIGN_BYTES;
+            if (list != nullptr) {
+                ListNode* node = list;
+                list = node->m_next;
+                m_free_bytes -= round_bytes;
+                return node;
+            }
+            if (round_bytes > static_cast<std::size_t>(m_available_memory_end - m_available_memory_it)) {
+                AllocateChunk();
+            }
+            void* p = m_available_memory_it;
+            m_available_memory_it += round_bytes;
+            return p;
+        }
+        return ::operator new(bytes);
+    }
+
+    void Deallocate(void* p, std::size_t bytes, std::size_t alignment) noexcept
+    {
+        if (IsFreeListUsable(bytes, alignment)) {
+            const std::size_t num_alignments = NumElemAlignBytes(bytes);
+            PlacementAddToList(p, m_free_lists[num_alignments]);
+            m_free_bytes += num_alignments * ELEM_ALIGN_BYTES;
+        } else {
+            ::operator delete(p);
+        }
+    }
+
+    /** Number of chunks currently held. */
+    std::size_t NumAllocatedChunks() const { return m_allocated_chunks.size(); }
+
+    /** Size of each chunk in bytes. */
+    std::size_t ChunkSizeBytes() const { return m_chunk_size_bytes; }
+
+    /** Bytes held in the chunks that were freed again and wait for reuse. */
+    std::size_t NumFreeBytes() const { return m_free_bytes; }
+};
+
+template <std::size_t MAX_BLOCK_SIZE_BYTES, std::size_t ALIGN_BYTES>
+constexpr std::size_t PoolResource<MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>::ELEM_ALIGN_BYTES;
+
+template <std::size_t MAX_BLOCK_SIZE_BYTES, std::size_t ALIGN_BYTES>
+const std::size_t PoolResource<MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>::DEFAULT_CHUNK_SIZE_BYTES;
+
+/**
+ * Standard allocator forwarding to a PoolResource. Copies, including rebound
+ * ones, share the resource, which must outlive every container using it.
+ */
+template <class T, std::size_t MAX_BLOCK_SIZE_BYTES, std::size_t ALIGN_BYTES = alignof(T)>
+class PoolAllocator
+{
+    PoolResource<MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>* m_resource;
+
+    template <class U, std::size_t M, std::size_t A>
+    friend class PoolAllocator;
+
+public:
+    typedef T value_type;
+    typedef PoolResource<MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES> ResourceType;
+
+    template <typename U>
+    struct rebind {
+        typedef PoolAllocator<U, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES> other;
+    };
+
+    PoolAllocator(ResourceType* resource) noexcept : m_resource(resource) {}
+
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& other) noexcept : m_resource(other.m_resource) {}
+
+    T* allocate(std::size_t n)
+    {
+        return static_cast<T*>(m_resource->Allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T* p, std::size_t n) noexcept
+    {
+        m_resource->Deallocate(p, n * sizeof(T), alignof(T));
+    }
+
+    ResourceType* resource() const noexcept { return m_resource; }
+};
+
+template <class T1, class T2, std::size_t M, std::size_t A>
+bool operator==(const PoolAllocator<T1, M, A>& a, const PoolAllocator<T2, M, A>& b) noexcept
+{
+    return a.resource() == b.resource();
+}
+
+template <class T1, class T2, std::size_t M, std::size_t A>
+bool operator!=(const PoolAllocator<T1, M, A>& a, const PoolAllocator<T2, M, A>& b) noexcept
+{
+    return !(a == b);
+}
+
+#endif // BITCOIN_SUPPORT_ALLOCATORS_POOL_H
@@ -0,0 +1,134 @@
+#include "addressindex.h"
+#include "chainparams.h"
+#include "consensus/validation.h"
+#include "script/standard.h"
+#include "test/test_bitcoin.h"
+#include "txdb.h"
+#include "validation.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(addressindex_tests, TestChain100Setup)
+
+static std::vector<std::pair<CAddressIndexKey, CAmount>> History(const CScript& script)
+{
+    std::vector<std::pair<CAddressIndexKey, CAmount>> vHistory;
+    BOOST_CHECK(pblocktree->ReadAddressIndex(GetScriptHash(script), 0, -1, 0, 1000, vHistory));
+    return vHistory;
+}
+
+static std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue>> Unspent(const CScript& script)
+{
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue>> vUnspent;
+    BOOST_CHECK(pblocktree->ReadAddressUnspentIndex(GetScriptHash(script), 0, 1000, vUnspent));
+    return vUnspent;
+}
+
+static CAddressBalance Balance(const CScript& script)
+{
+    CAddressBalance balance;
+    BOOST_CHECK(pblocktree->ReadAddressBalance(GetScriptHash(script), balance));
+    return balance;
+}
+
+static bool HasUnspent(const CScript& script, const COutPoint& outpoint)
+{
+    for (const std::pair<CAddressUnspentKey, CAddressUnspentValue>& entry : Unspent(script)) {
+        if (entry.first.outpoint == outpoint)
+            return true;
+    }
+    return false;
+}
+
+BOOST_AUTO_TEST_CASE(addressindex_connect_disconnect)
+{
+    fAddressIndex = true;
+    CKey key;
+    key.MakeNewKey(true);
+    const CScript scriptMined = CScript() << ToByteVector(key.GetPubKey()) << OP_CHECKSIG;
+    const CScript scriptPaid = GetScriptForDestination(key.GetPubKey().GetID());
+
+    // A block mined to a new script, with the coinbase paying it indexed
+    CBlock block1 = CreateAndProcessBlock(std::vector<CMutableTransaction>(), scriptMined);
+    BOOST_CHECK(chainActive.Tip()->GetBlockHash() == block1.GetHash());
+    std::vector<std::pair<CAddressIndexKey, CAmount>> vHistory = History(scriptMined);
+    BOOST_CHECK_EQUAL(vHistory.size(), 1U);
+    BOOST_CHECK(vHistory[0].first.txid == block1.vtx[0]->GetHash());
+    BOOST_CHECK_EQUAL(vHistory[0].first.nHeight, (uint32_t)chainActive.Height());
+    BOOST_CHECK_EQUAL(vHistory[0].second, block1.vtx[0]->vout[0].nValue);
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue>> vUnspent = Unspent(scriptMined);
+    BOOST_CHECK_EQUAL(vUnspent.size(), 1U);
+    BOOST_CHECK(vUnspent[0].second.fCoinBase);
+
+    // Spend a mature coinbase to scriptPaid, in two outputs
+    const CScript scriptCoinbase = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+    CMutableTransaction spend;
+    spend.nVersion = 1;
+    spend.vin.resize(1);
+    spend.vin[0].prevout = COutPoint(coinbaseTxns[0].GetHash(), 0);
+    spend.vout.resize(2);
+    spend.vout[0].nValue = coinbaseTxns[0].vout[0].nValue / 4;
+    spend.vout[0].scriptPubKey = scriptPaid;
+    spend.vout[1].nValue = coinbaseTxns[0].vout[0].nValue / 4;
+    spend.vout[1].scriptPubKey = scriptPaid;
+    std::vector<unsigned char> vchSig;
+    uint256 hash = SignatureHash(scriptCoinbase, spend, 0, SIGHASH_BCX_ALL, coinbaseTxns[0].vout[0].nValue, SIGVERSION_BASE);
+    BOOST_CHECK(coinbaseKey.Sign(hash, vchSig));
+    vchSig.push_back((unsigned char)SIGHASH_BCX_ALL);
+    spend.vin[0].scriptSig << vchSig;
+
+    CBlock block2 = CreateAndProcessBlock(std::vector<CMutableTransaction>(1, spend), scriptMined);
+    BOOST_CHECK(chainActive.Tip()->GetBlockHash() == block2.GetHash());
+    vHistory = History(scriptPaid);
+    BOOST_CHECK_EQUAL(vHistory.size(), 2U);
+    BOOST_CHECK_EQUAL(vHistory[1].first.nIndex, 1U);
+    BOOST_CHECK_EQUAL(Unspent(scriptPaid).size(), 2U);
+    BOOST_CHECK_EQUAL(Unspent(scriptMined).size(), 2U);
+    // The chain before was mined without the index, so only the spend is there
+    vHistory = History(scriptCoinbase);
+    BOOST_CHECK_EQUAL(vHistory.size(), 1U);
+    BOOST_CHECK(vHistory[0].first.fSpending);
+    BOOST_CHECK_EQUAL(vHistory[0].second, -coinbaseTxns[0].vout[0].nValue);
+    BOOST_CHECK(!HasUnspent(scriptCoinbase, spend.vin[0].prevout));
+
+    // Running totals, which a block written again does not count twice
+    const CAmount nPaid = 2 * spend.vout[0].nValue;
+    CAddressBalance balance = Balance(scriptPaid);
+    BOOST_CHECK_EQUAL(balance.nBalance, nPaid);
+    BOOST_CHECK_EQUAL(balance.nReceived, nPaid);
+    BOOST_CHECK_EQUAL(balance.nUtxos, 2);
+    BOOST_CHECK_EQUAL(Balance(scriptMined).nUtxos, 2);
+    vHistory = History(scriptPaid);
+    BOOST_CHECK(pblocktree->WriteAddressIndex(vHistory, std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue>>()));
+    BOOST_CHECK_EQUAL(Balance(scriptPaid).nBalance, nPaid);
+
+    // Paging
+    vHistory.clear();
+    BOOST_CHECK(pblocktree->ReadAddressIndex(GetScriptHash(scriptPaid), 0, -1, 1, 5, vHistory));
+    BOOST_CHECK_EQUAL(vHistory.size(), 1U);
+    BOOST_CHECK_EQUAL(vHistory[0].first.nIndex, 1U);
+    vHistory.clear();
+    BOOST_CHECK(pblocktree->ReadAddressIndex(GetScriptHash(scriptMined), 0, chainActive.Height() - 1, 0, 5, vHistory));
+    BOOST_CHECK_EQUAL(vHistory.size(), 1U);
+
+    // Disconnecting the block undoes its entries and restores the spent output
+    CValidationState state;
+    BOOST_CHECK(InvalidateBlock(state, Params(), chainActive.Tip()));
+    BOOST_CHECK(chainActive.Tip()->GetBlockHash() == block1.GetHash());
+    BOOST_CHECK(History(scriptPaid).empty());
+    BOOST_CHECK(Unspent(scriptPaid).empty());
+    BOOST_CHECK(History(scriptCoinbase).empty());
+    BOOST_CHECK(HasUnspent(scriptCoinbase, spend.vin[0].prevout));
+    BOOST_CHECK_EQUAL(Unspent(scriptMined).size(), 1U);
+    balance = Balance(scriptPaid);
+    BOOST_CHECK_EQUAL(balance.nBalance, 0);
+    BOOST_CHECK_EQUAL(balance.nReceived, 0);
+    BOOST_CHECK_EQUAL(balance.nUtxos, 0);
+    balance = Balance(scriptMined);
+    BOOST_CHECK_EQUAL(balance.nBalance, block1.vtx[0]->vout[0].nValue);
+    BOOST_CHECK_EQUAL(balance.nUtxos, 1);
+
+    fAddressIndex = false;
+}
+
+BOOST_AUTO_TEST_SUITE_END()
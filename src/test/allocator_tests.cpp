@@ -4,9 +4,13 @@
 
 #include "util.h"
 
+#include "support/allocators/pool.h"
 #include "support/allocators/secure.h"
 #include "test/test_bitcoin.h"
 
+#include <functional>
+#include <unordered_map>
+
 #include <boost/test/unit_test.hpp>
 
 BOOST_FIXTURE_TEST_SUITE(allocator_tests, BasicTestingSetup)
@@ -231,4 +235,57 @@ BOOST_AUTO_TEST_CASE(lockedpool_tests_live)
     BOOST_CHECK(pool.stats().used == initial.used);
 }
 
+BOOST_AUTO_TEST_CASE(poolresource_tests)
+{
+    PoolResource<64, 8> resource(1024);
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 0U);
+    BOOST_CHECK_EQUAL(resource.ChunkSizeBytes(), 1024U);
+
+    // Small blocks come from one chunk, back to back
+    char* a = static_cast<char*>(resource.Allocate(16, 8));
+    char* b = static_cast<char*>(resource.Allocate(16, 8));
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 1U);
+    BOOST_CHECK(b == a + 16);
+
+    // Freed blocks are reused for the same size class only
+    resource.Deallocate(a, 16, 8);
+    BOOST_CHECK_EQUAL(resource.NumFreeBytes(), 16U);
+    char* c = static_cast<char*>(resource.Allocate(24, 8));
+    BOOST_CHECK(c == b + 16);
+    BOOST_CHECK(resource.Allocate(13, 8) == a);
+    BOOST_CHECK_EQUAL(resource.NumFreeBytes(), 0U);
+
+    // Large or over-aligned requests bypass the pool
+    void* big = resource.Allocate(65, 8);
+    void* aligned = resource.Allocate(8, 16);
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 1U);
+    resource.Deallocate(big, 65, 8);
+    resource.Deallocate(aligned, 8, 16);
+
+    // Running out of space starts a new chunk
+    for (int i = 0; i < 20; i++) {
+        resource.Allocate(64, 8);
+    }
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 2U);
+
+    // A map using the pool works like any other
+    typedef std::unordered_map<int, int, std::hash<int>, std::equal_to<int>, PoolAllocator<std::pair<const int, int>, 64, 8>> Map;
+    PoolResource<64, 8> mapresource;
+    {
+        Map map(0, std::hash<int>(), std::equal_to<int>(), &mapresource);
+        for (int i = 0; i < 1000; i++) {
+            map[i] = i * 2;
+        }
+        for (int i = 0; i < 1000; i += 2) {
+            map.erase(i);
+        }
+        BOOST_CHECK_EQUAL(map.size(), 500U);
+        for (int i = 0; i < 1000; i++) {
+            BOOST_CHECK_EQUAL(map.count(i), (size_t)(i % 2));
+        }
+        BOOST_CHECK(map[999] == 1998);
+    }
+    BOOST_CHECK_EQUAL(mapresource.NumAllocatedChunks(), 1U);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -5,7 +5,12 @@
 #include "blockencodings.h"
 #include "consensus/merkle.h"
 #include "chainparams.h"
+#include "contract/contractutil.h"
+#include "contract/ethstate.h"
+#include "contract/ethtxversion.h"
 #include "random.h"
+#include "utilstrencodings.h"
+#include "validation.h"
 
 #include "test/test_bitcoin.h"
 
@@ -110,6 +115,95 @@ BOOST_AUTO_TEST_CASE(SimpleRoundTripTest)
     }
 }
 
+BOOST_AUTO_TEST_CASE(PredictedTxnTest)
+{
+    CTxMemPool pool;
+    CBlock block(BuildBlockTestCase());
+    CBlockHeaderAndShortTxIDs shortIDs(block, true);
+
+    PartiallyDownloadedBlock partialBlock(&pool);
+    BOOST_CHECK(partialBlock.InitData(shortIDs, extra_txn) == READ_STATUS_OK);
+    BOOST_CHECK(!partialBlock.IsTxAvailable(1));
+    BOOST_CHECK(!partialBlock.IsTxAvailable(2));
+    BOOST_CHECK(partialBlock.GetAvailableTxn()[0] == block.vtx[0]);
+
+    // Only predictions matching a missing slot are used
+    CMutableTransaction unrelated;
+    unrelated.vout.resize(1);
+    unrelated.vout[0].nValue = 7;
+    BOOST_CHECK_EQUAL(partialBlock.FillPredicted(shortIDs, {MakeTransactionRef(unrelated), block.vtx[2]}), 1U);
+    BOOST_CHECK(!partialBlock.IsTxAvailable(1));
+    BOOST_CHECK(partialBlock.IsTxAvailable(2));
+    BOOST_CHECK_EQUAL(partialBlock.FillPredicted(shortIDs, {block.vtx[0], block.vtx[2]}), 0U);
+
+    CBlock block2;
+    BOOST_CHECK(partialBlock.FillBlock(block2, {block.vtx[1]}) == READ_STATUS_OK);
+    BOOST_CHECK_EQUAL(block.GetHash().ToString(), block2.GetHash().ToString());
+}
+
+BOOST_FIXTURE_TEST_CASE(PredictContractTxnTest, TestChain100Setup)
+{
+    LOCK(cs_main);
+
+    // contract Temp { function () payable {} }
+    const valtype code(ParseHex("6060604052346000575b60398060166000396000f30060606040525b600b5b5b565b0000a165627a7a723058209cedb722bf57a30e3eb00eeefc392103ea791a2001deed29f5c3809ff10eb1dd0029"));
+    EthTransaction txCreate = TestContractHelper::CreateEthTx(code, 0, dev::u256(500000), dev::u256(1), dev::h256(ParseHex("cccccccccccccccccccccccccccccccccccccccccccccccccccccccccccccccc")), dev::Address());
+    BOOST_CHECK(TestContractHelper::Execute(std::vector<EthTransaction>(1, txCreate)).first[0].execRes.excepted == dev::eth::TransactionException::None);
+    const dev::Address contract = ContractUtil::CreateContractAddr(txCreate.GetHashWith(), txCreate.GetOutIdx());
+
+    // A block paying the contract, with the transaction the executor adds for
+    // the payment still missing
+    const CScript scriptCoinbase = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+    CMutableTransaction coinbase;
+    coinbase.vin.resize(1);
+    coinbase.vin[0].scriptSig = CScript() << chainActive.Height() + 1 << OP_0;
+    coinbase.vout.emplace_back(0, scriptCoinbase);
+
+    CMutableTransaction call;
+    call.vin.emplace_back(COutPoint(coinbaseTxns[0].GetHash(), 0));
+    call.vout.emplace_back(1300, CScript() << CScriptNum(EthTxVersion::GetDefault().ToRaw()) << CScriptNum(500000) << CScriptNum(1) << ParseHex("00") << contract.asBytes() << OP_SENDTOCONTRACT);
+    const CTransactionRef ptxCall = MakeTransactionRef(call);
+
+    CMutableTransaction condense;
+    condense.vin.emplace_back(COutPoint(ptxCall->GetHash(), 0), CScript() << OP_SPEND);
+    condense.vout.emplace_back(1300, CScript() << valtype{0} << valtype{0} << valtype{0} << valtype{0} << contract.asBytes() << OP_SENDTOCONTRACT);
+
+    CBlock block;
+    block.hashPrevBlock = chainActive.Tip()->GetBlockHash();
+    block.nTime = chainActive.Tip()->GetMedianTimePast() + 1;
+    block.nBits = 0x207fffff;
+    block.vtx = {MakeTransactionRef(coinbase), ptxCall, MakeTransactionRef(condense)};
+    block.hashMerkleRoot = BlockMerkleRoot(block);
+    CBlockHeaderAndShortTxIDs shortIDs(block, true);
+
+    CTxMemPool pool;
+    PartiallyDownloadedBlock partialBlock(&pool);
+    BOOST_CHECK(partialBlock.InitData(shortIDs, {std::make_pair(ptxCall->GetWitnessHash(), ptxCall)}) == READ_STATUS_OK);
+    BOOST_CHECK(partialBlock.IsTxAvailable(1));
+    BOOST_CHECK(!partialBlock.IsTxAvailable(2));
+
+    // Running the contracts fills the slot, and leaves their state alone
+    const dev::h256 hashStateRoot(EthState::Instance()->rootHash());
+    std::vector<CTransactionRef> vtxPredicted;
+    BOOST_CHECK(PredictContractTransactions(partialBlock.header, partialBlock.GetAvailableTxn(), vtxPredicted));
+    BOOST_CHECK_EQUAL(vtxPredicted.size(), 1U);
+    BOOST_CHECK(EthState::Instance()->rootHash() == hashStateRoot);
+    BOOST_CHECK(EthState::Instance()->balance(contract) == 0);
+    BOOST_CHECK_EQUAL(partialBlock.FillPredicted(shortIDs, vtxPredicted), 1U);
+    BOOST_CHECK(partialBlock.IsTxAvailable(2));
+
+    CBlock block2;
+    BOOST_CHECK(partialBlock.FillBlock(block2, {}) == READ_STATUS_OK);
+    BOOST_CHECK_EQUAL(block.GetHash().ToString(), block2.GetHash().ToString());
+
+    // Nothing is run for a block that does not build on the tip
+    CBlockHeader header = block.GetBlockHeader();
+    header.hashPrevBlock = chainActive.Tip()->pprev->GetBlockHash();
+    vtxPredicted.clear();
+    BOOST_CHECK(!PredictContractTransactions(header, block.vtx, vtxPredicted));
+    BOOST_CHECK(vtxPredicted.empty());
+}
+
 class TestHeaderAndShortIDs {
     // Utility to encode custom CBlockHeaderAndShortTxIDs
 public:
@@ -378,6 +378,39 @@ BOOST_AUTO_TEST_CASE(test_CheckQueue_FrozenCleanup)
 }
 
 
+// Test that checks added before any worker started, which all go to the
+// master's deque, are stolen and run exactly once
+BOOST_AUTO_TEST_CASE(test_CheckQueue_Steal_Before_Workers)
+{
+    auto queue = std::unique_ptr<Unique_Queue>(new Unique_Queue {QUEUE_BATCH_SIZE});
+    UniqueCheck::results.clear();
+    size_t COUNT = 10000;
+    boost::thread_group tg;
+    {
+        CCheckQueueControl<UniqueCheck> control(queue.get());
+        std::vector<UniqueCheck> vChecks;
+        for (size_t i = 0; i < COUNT; i++)
+            vChecks.emplace_back(i);
+        control.Add(vChecks);
+        for (auto x = 0; x < nScriptCheckThreads; ++x) {
+            tg.create_thread([&]{queue->Thread();});
+        }
+        // Checks added now are spread over the workers that have started
+        vChecks.clear();
+        for (size_t i = COUNT; i < 2 * COUNT; i++)
+            vChecks.emplace_back(i);
+        control.Add(vChecks);
+        BOOST_REQUIRE(control.Wait());
+    }
+    BOOST_REQUIRE_EQUAL(UniqueCheck::results.size(), 2 * COUNT);
+    bool r = true;
+    for (size_t i = 0; i < 2 * COUNT; ++i)
+        r = r && UniqueCheck::results.count(i) == 1;
+    BOOST_REQUIRE(r);
+    tg.interrupt_all();
+    tg.join_all();
+}
+
 /** Test that CCheckQueueControl is threadsafe */
 BOOST_AUTO_TEST_CASE(test_CheckQueueControl_Locks)
 {
@@ -3,6 +3,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "coins.h"
+#include "coinsprefetch.h"
 #include "script/standard.h"
 #include "uint256.h"
 #include "undo.h"
@@ -52,7 +53,7 @@ public:
 
     uint256 GetBestBlock() const override { return hashBestBlock_; }
 
-    bool BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlock) override
+    bool BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlock, bool fErase) override
     {
         for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end(); ) {
             if (it->second.flags & CCoinsCacheEntry::DIRTY) {
@@ -63,7 +64,10 @@ public:
                     map_.erase(it->first);
                 }
             }
-            mapCoins.erase(it++);
+            if (fErase)
+                mapCoins.erase(it++);
+            else
+                ++it;
         }
         if (!hashBlock.IsNull())
             hashBestBlock_ = hashBlock;
@@ -207,10 +211,14 @@ BOOST_AUTO_TEST_CASE(coins_cache_simulation_test)
         }
 
         if (InsecureRandRange(100) == 0) {
-            // Every 100 iterations, flush an intermediate cache
+            // Every 100 iterations, flush or sync an intermediate cache
             if (stack.size() > 1 && InsecureRandBool() == 0) {
                 unsigned int flushIndex = InsecureRandRange(stack.size() - 1);
-                stack[flushIndex]->Flush();
+                if (InsecureRandBool()) {
+                    stack[flushIndex]->Flush();
+                } else {
+                    stack[flushIndex]->Sync();
+                }
             }
         }
         if (InsecureRandRange(100) == 0) {
@@ -440,10 +448,14 @@ BOOST_AUTO_TEST_CASE(updatecoins_simulation_test)
         }
 
         if (InsecureRandRange(100) == 0) {
-            // Every 100 iterations, flush an intermediate cache
+            // Every 100 iterations, flush or sync an intermediate cache
             if (stack.size() > 1 && InsecureRandBool() == 0) {
                 unsigned int flushIndex = InsecureRandRange(stack.size() - 1);
-                stack[flushIndex]->Flush();
+                if (InsecureRandBool()) {
+                    stack[flushIndex]->Flush();
+                } else {
+                    stack[flushIndex]->Sync();
+                }
             }
         }
         if (InsecureRandRange(100) == 0) {
@@ -586,9 +598,10 @@ void GetCoinsMapEntry(const CCoinsMap& map, CAmount& value, char& flags)
 
 void WriteCoinsViewEntry(CCoinsView& view, CAmount value, char flags)
 {
-    CCoinsMap map;
+    CCoinsMapMemoryResource resource;
+    CCoinsMap map(0, SaltedOutpointHasher(), CCoinsMap::key_equal(), &resource);
     InsertCoinsMapEntry(map, value, flags);
-    view.BatchWrite(map, {});
+    view.BatchWrite(map, {}, true);
 }
 
 class SingleEntryCacheTest
@@ -855,4 +868,88 @@ BOOST_AUTO_TEST_CASE(ccoins_write)
                     CheckWriteCoins(parent_value, child_value, parent_value, parent_flags, child_flags, parent_flags);
 }
 
+BOOST_AUTO_TEST_CASE(ccoins_prefetch)
+{
+    CCoinsView dummy;
+    CCoinsViewCache backing(&dummy);
+    CCoinsViewPrefetch prefetch(&backing, 1 << 20);
+
+    COutPoint outpoint(InsecureRand256(), 0);
+    Coin coin(CTxOut(InsecureRand32(), CScript() << OP_TRUE), 1, false);
+    backing.AddCoin(outpoint, Coin(coin), false);
+
+    CBlock block;
+    CMutableTransaction coinbase;
+    coinbase.vin.resize(1);
+    coinbase.vout.resize(1);
+    block.vtx.push_back(MakeTransactionRef(coinbase));
+    CMutableTransaction spend;
+    spend.vin.resize(2);
+    spend.vin[0].prevout = outpoint;
+    spend.vin[1].prevout = COutPoint(InsecureRand256(), 0);
+    spend.vout.resize(1);
+    block.vtx.push_back(MakeTransactionRef(spend));
+    CMutableTransaction child;
+    child.vin.resize(1);
+    child.vin[0].prevout = COutPoint(block.vtx[1]->GetHash(), 0);
+    child.vout.resize(1);
+    block.vtx.push_back(MakeTransactionRef(child));
+
+    // Only the coin present in the backing view is fetched.
+    prefetch.PrefetchBlock(block);
+    BOOST_CHECK_EQUAL(prefetch.GetCacheSize(), 1U);
+    BOOST_CHECK_EQUAL(prefetch.GetFetched(), 1U);
+
+    // A miss in the cache above is served from the prefetched coins, which
+    // are then forgotten.
+    CCoinsViewCache tip(&prefetch);
+    BOOST_CHECK(tip.AccessCoin(outpoint) == coin);
+    BOOST_CHECK_EQUAL(prefetch.GetCacheSize(), 0U);
+    BOOST_CHECK_EQUAL(prefetch.GetHits(), 1U);
+
+    // Writes through the layer drop everything that was prefetched.
+    prefetch.PrefetchBlock(block);
+    BOOST_CHECK_EQUAL(prefetch.GetCacheSize(), 1U);
+    tip.SpendCoin(outpoint);
+    tip.SetBestBlock(InsecureRand256());
+    BOOST_CHECK(tip.Flush());
+    BOOST_CHECK_EQUAL(prefetch.GetCacheSize(), 0U);
+    BOOST_CHECK(!tip.HaveCoin(outpoint));
+}
+
+BOOST_AUTO_TEST_CASE(ccoins_sync_trim)
+{
+    CCoinsViewTest base;
+    CCoinsViewCacheTest cache(&base);
+
+    std::vector<COutPoint> outpoints;
+    for (int i = 0; i < 100; i++) {
+        outpoints.emplace_back(InsecureRand256(), 0);
+        cache.AddCoin(outpoints.back(), Coin(CTxOut(InsecureRand32(), CScript() << OP_TRUE), 1, false), false);
+    }
+    cache.SpendCoin(outpoints[0]);
+    cache.SetBestBlock(InsecureRand256());
+
+    // Sync writes everything but keeps the unspent coins cached.
+    BOOST_CHECK(cache.Sync());
+    cache.SelfTest();
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), 99U);
+    BOOST_CHECK(!cache.HaveCoinInCache(outpoints[0]));
+    for (int i = 1; i < 100; i++) {
+        BOOST_CHECK(cache.HaveCoinInCache(outpoints[i]));
+        BOOST_CHECK(base.HaveCoin(outpoints[i]));
+    }
+    BOOST_CHECK(base.GetBestBlock() == cache.GetBestBlock());
+
+    // Trim only evicts unmodified entries.
+    cache.SpendCoin(outpoints[1]);
+    BOOST_CHECK_EQUAL(cache.Trim(0), 98U);
+    cache.SelfTest();
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), 1U);
+    BOOST_CHECK(!cache.HaveCoin(outpoints[1]));
+    BOOST_CHECK(cache.HaveCoin(outpoints[2]));
+    BOOST_CHECK(cache.Flush());
+    BOOST_CHECK(!base.HaveCoin(outpoints[1]));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -368,4 +368,41 @@ BOOST_AUTO_TEST_CASE(contractexecutor_contract_create_contracts){
     checkBCEResult(result.second, 2344520, 7655480, 20, CAmount(GASLIMIT * 20));
 }
 
+BOOST_AUTO_TEST_CASE(contractexecutor_created_destroyed_contracts){
+    EthTransaction txEthCreate = TestContractHelper::CreateEthTx(CODE[3], 0, GASLIMIT, dev::u256(1), HASHTX, dev::Address());
+    dev::h256 hash(HASHTX);
+    ++hash;
+    EthTransaction txEthCreateSui = TestContractHelper::CreateEthTx(CODE[4], 0, GASLIMIT, dev::u256(1), hash, dev::Address());
+    std::vector<EthTransaction> txs = { txEthCreate, txEthCreateSui };
+    auto result = TestContractHelper::Execute(txs);
+    dev::Address factory(ContractUtil::CreateContractAddr(txEthCreate.GetHashWith(), txEthCreate.GetOutIdx()));
+    dev::Address sui(ContractUtil::CreateContractAddr(txEthCreateSui.GetHashWith(), txEthCreateSui.GetOutIdx()));
+    BOOST_CHECK(result.first[0].execRes.newAddress == factory);
+    BOOST_CHECK(result.first[0].createdContracts.empty());
+    BOOST_CHECK(result.first[1].createdContracts.empty());
+
+    // The factory's children are reported along with the call that made them
+    std::vector<EthTransaction> txsCall;
+    for (size_t i = 0; i < 2; i++) {
+        txsCall.push_back(TestContractHelper::CreateEthTx(valtype(ParseHex("3f811b80")), 0, GASLIMIT, dev::u256(1), HASHTX, factory, i));
+    }
+    txsCall.push_back(TestContractHelper::CreateEthTx(valtype(ParseHex("41c0e1b5")), 0, GASLIMIT, dev::u256(1), HASHTX, sui, 2));
+    result = TestContractHelper::Execute(txsCall);
+    BOOST_CHECK(result.first.size() == 3);
+    for (size_t i = 0; i < 2; i++) {
+        BOOST_CHECK(result.first[i].execRes.excepted == dev::eth::TransactionException::None);
+        BOOST_CHECK(result.first[i].createdContracts.size() == 1);
+        BOOST_CHECK(result.first[i].createdContracts[0] != factory);
+        BOOST_CHECK(EthState::Instance()->addressHasCode(result.first[i].createdContracts[0]));
+        BOOST_CHECK(result.first[i].destroyedContracts.empty());
+    }
+    BOOST_CHECK(result.first[0].createdContracts[0] != result.first[1].createdContracts[0]);
+
+    // The self-destructed one is reported, the accounts removed after every execution are not
+    BOOST_CHECK(result.first[2].createdContracts.empty());
+    BOOST_CHECK(result.first[2].destroyedContracts.size() == 1);
+    BOOST_CHECK(result.first[2].destroyedContracts[0] == sui);
+    BOOST_CHECK(!EthState::Instance()->addressHasCode(sui));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
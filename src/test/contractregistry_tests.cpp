@@ -0,0 +1,129 @@
+#include "contract/contractregistry.h"
+#include "random.h"
+#include "test/test_bitcoin.h"
+
+#include <boost/test/unit_test.hpp>
+
+static ContractInfo MakeContract(uint32_t nHeight)
+{
+    static unsigned char nCounter = 0;
+    ContractInfo info;
+    info.address = uint160(std::vector<unsigned char>(20, ++nCounter));
+    info.creator = uint160(std::vector<unsigned char>(20, 0x01));
+    info.codeHash = InsecureRand256();
+    info.txid = InsecureRand256();
+    info.nHeight = nHeight;
+    return info;
+}
+
+BOOST_FIXTURE_TEST_SUITE(contractregistry_tests, TestingSetup)
+
+BOOST_AUTO_TEST_CASE(contractregistry_add_remove)
+{
+    ContractRegistry* registry = ContractRegistry::Instance();
+    BOOST_CHECK(registry->Remove(0));
+    BOOST_CHECK_EQUAL(registry->Count(), 0U);
+
+    std::vector<ContractInfo> all;
+    for (uint32_t nHeight = 1; nHeight <= 10; nHeight++) {
+        std::vector<ContractInfo> block;
+        for (uint32_t i = 0; i < nHeight % 3; i++) {
+            block.push_back(MakeContract(nHeight));
+        }
+        BOOST_CHECK(registry->Add(nHeight, block));
+        all.insert(all.end(), block.begin(), block.end());
+    }
+    BOOST_CHECK_EQUAL(registry->Count(), all.size());
+
+    // Pages come back in creation order
+    std::vector<ContractInfo> page;
+    BOOST_CHECK(registry->List(2, 3, page));
+    BOOST_CHECK_EQUAL(page.size(), 3U);
+    for (size_t i = 0; i < page.size(); i++) {
+        BOOST_CHECK(page[i].address == all[2 + i].address);
+        BOOST_CHECK(page[i].txid == all[2 + i].txid);
+        BOOST_CHECK_EQUAL(page[i].nHeight, all[2 + i].nHeight);
+    }
+    page.clear();
+    BOOST_CHECK(registry->List(all.size() - 1, 20, page));
+    BOOST_CHECK_EQUAL(page.size(), 1U);
+
+    ContractInfo info;
+    BOOST_CHECK(registry->Get(all[4].address, info));
+    BOOST_CHECK(info.codeHash == all[4].codeHash);
+
+    // Connecting a block again replaces what was recorded from its height on
+    std::vector<ContractInfo> replacement(1, MakeContract(8));
+    BOOST_CHECK(registry->Add(8, replacement));
+    size_t nBelow8 = 0;
+    for (const ContractInfo& c : all) {
+        nBelow8 += c.nHeight < 8;
+    }
+    BOOST_CHECK_EQUAL(registry->Count(), nBelow8 + 1);
+    BOOST_CHECK(registry->Get(replacement[0].address, info));
+    BOOST_CHECK(!registry->Get(all.back().address, info));
+
+    // Disconnecting drops everything from that height on
+    BOOST_CHECK(registry->Remove(5));
+    size_t nBelow5 = 0;
+    for (const ContractInfo& c : all) {
+        nBelow5 += c.nHeight < 5;
+    }
+    BOOST_CHECK_EQUAL(registry->Count(), nBelow5);
+    BOOST_CHECK(!registry->Get(replacement[0].address, info));
+    BOOST_CHECK(registry->Remove(0));
+    BOOST_CHECK_EQUAL(registry->Count(), 0U);
+}
+
+BOOST_AUTO_TEST_CASE(contractregistry_destroyed)
+{
+    ContractRegistry* registry = ContractRegistry::Instance();
+    BOOST_CHECK(registry->Remove(0));
+
+    std::vector<ContractInfo> all;
+    for (uint32_t nHeight = 1; nHeight <= 4; nHeight++) {
+        std::vector<ContractInfo> block(2, ContractInfo());
+        block[0] = MakeContract(nHeight);
+        block[1] = MakeContract(nHeight);
+        BOOST_CHECK(registry->Add(nHeight, block));
+        all.insert(all.end(), block.begin(), block.end());
+    }
+
+    // A contract destroyed by a later block, and one created and destroyed
+    // within the same block, drop out of the list but keep the others' order
+    std::vector<ContractInfo> block(1, MakeContract(5));
+    all.push_back(block[0]);
+    std::vector<uint160> destroyed = {all[1].address, block[0].address, uint160()};
+    BOOST_CHECK(registry->Add(5, block, destroyed));
+    BOOST_CHECK_EQUAL(registry->Count(), all.size() - 2);
+
+    ContractInfo info;
+    BOOST_CHECK(!registry->Get(all[1].address, info));
+    BOOST_CHECK(!registry->Get(block[0].address, info));
+    BOOST_CHECK(registry->Get(all[2].address, info));
+
+    std::vector<ContractInfo> page;
+    BOOST_CHECK(registry->List(0, 20, page));
+    BOOST_CHECK_EQUAL(page.size(), all.size() - 2);
+    BOOST_CHECK(page[0].address == all[0].address);
+    BOOST_CHECK(page[1].address == all[2].address);
+    page.clear();
+    BOOST_CHECK(registry->List(1, 2, page));
+    BOOST_CHECK_EQUAL(page.size(), 2U);
+    BOOST_CHECK(page[0].address == all[2].address);
+    BOOST_CHECK(page[1].address == all[3].address);
+
+    // Disconnecting the destroying block brings the contract back
+    BOOST_CHECK(registry->Remove(5));
+    BOOST_CHECK_EQUAL(registry->Count(), all.size() - 1);
+    BOOST_CHECK(registry->Get(all[1].address, info));
+    page.clear();
+    BOOST_CHECK(registry->List(1, 1, page));
+    BOOST_CHECK_EQUAL(page.size(), 1U);
+    BOOST_CHECK(page[0].address == all[1].address);
+
+    BOOST_CHECK(registry->Remove(0));
+    BOOST_CHECK_EQUAL(registry->Count(), 0U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,147 @@
+#include "contract/contractutil.h"
+#include "contract/ethstate.h"
+#include "rpc/server.h"
+#include "test/test_bitcoin.h"
+#include "utilstrencodings.h"
+
+#include <boost/test/unit_test.hpp>
+
+//! Number of slots written by STORAGE_CODE
+static const size_t STORAGE_SLOTS = 20;
+
+/*
+    Constructor storing i + 1 at slot i for i < 20, deploying a single STOP:
+
+    PUSH1 0; loop: JUMPDEST DUP1 PUSH1 20 GT ISZERO PUSH1 end JUMPI
+    DUP1 PUSH1 1 ADD DUP2 SSTORE PUSH1 1 ADD PUSH1 loop JUMP
+    end: JUMPDEST POP PUSH1 1 PUSH1 0 RETURN
+*/
+static const valtype STORAGE_CODE(ParseHex("60005b8060141115601757806001018155600101600256" "5b5060016000f3"));
+
+static dev::Address CreateStorageContract()
+{
+    EthTransaction tx = TestContractHelper::CreateEthTx(STORAGE_CODE, 0, dev::u256(1000000), dev::u256(1), dev::h256(ParseHex("bbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbb")), dev::Address());
+    auto result = TestContractHelper::Execute(std::vector<EthTransaction>(1, tx));
+    BOOST_CHECK(result.first[0].execRes.excepted == dev::eth::TransactionException::None);
+    return ContractUtil::CreateContractAddr(tx.GetHashWith(), tx.GetOutIdx());
+}
+
+static UniValue CallStorageRPC(const std::string& strMethod, const UniValue& params)
+{
+    JSONRPCRequest request;
+    request.strMethod = strMethod;
+    request.params = params;
+    request.fHelp = false;
+    BOOST_CHECK(tableRPC[strMethod]);
+    try {
+        return (*tableRPC[strMethod]->actor)(request);
+    } catch (const UniValue& objError) {
+        throw std::runtime_error(find_value(objError, "message").get_str());
+    }
+}
+
+static UniValue Params(const std::vector<UniValue>& values)
+{
+    UniValue params(UniValue::VARR);
+    for (const UniValue& value : values) {
+        params.push_back(value);
+    }
+    return params;
+}
+
+BOOST_FIXTURE_TEST_SUITE(contractstorage_tests, TestingSetup)
+
+BOOST_AUTO_TEST_CASE(contractstorage_range)
+{
+    const dev::Address address = CreateStorageContract();
+
+    // Pages of 7 cover every slot once, in order, with the next key
+    // pointing right past the last slot returned
+    std::map<dev::h256, std::pair<dev::u256, dev::u256>> all;
+    std::map<dev::h256, std::pair<dev::u256, dev::u256>> slots;
+    dev::h256 start;
+    dev::h256 next;
+    size_t nPages = 0;
+    bool fMore = true;
+    while (fMore) {
+        fMore = EthState::Instance()->storageRange(address, start, 7, slots, next);
+        BOOST_CHECK(!slots.empty() && slots.size() <= 7);
+        BOOST_CHECK(!(slots.begin()->first < start));
+        if (fMore) {
+            BOOST_CHECK_EQUAL(slots.size(), 7U);
+            BOOST_CHECK(slots.rbegin()->first < next);
+            start = next;
+        }
+        for (const auto& slot : slots) {
+            BOOST_CHECK(all.insert(slot).second);
+        }
+        nPages++;
+    }
+    BOOST_CHECK_EQUAL(nPages, (STORAGE_SLOTS + 6) / 7);
+    BOOST_CHECK_EQUAL(all.size(), STORAGE_SLOTS);
+    for (const auto& slot : all) {
+        BOOST_CHECK(slot.second.second == slot.second.first + 1);
+    }
+
+    // The range as a whole matches a single read of everything
+    BOOST_CHECK(!EthState::Instance()->storageRange(address, dev::h256(), 1000, slots, next));
+    BOOST_CHECK(slots == all);
+
+    // No slots from an unknown account, or when none are asked for
+    BOOST_CHECK(!EthState::Instance()->storageRange(dev::Address("0202020202020202020202020202020202020202"), dev::h256(), 10, slots, next));
+    BOOST_CHECK(slots.empty());
+    BOOST_CHECK(!EthState::Instance()->storageRange(address, dev::h256(), 0, slots, next));
+    BOOST_CHECK(slots.empty());
+}
+
+BOOST_AUTO_TEST_CASE(contractstorage_rpc)
+{
+    const dev::Address address = CreateStorageContract();
+    const UniValue addr(address.hex());
+
+    // Page through the storage with "next"
+    std::set<std::string> seen;
+    UniValue start(UniValue::VNULL);
+    for (size_t nPages = 0; nPages < STORAGE_SLOTS; nPages++) {
+        UniValue r = CallStorageRPC("getcontractstoragerange", Params({addr, start, UniValue(6)}));
+        const UniValue& storage = find_value(r.get_obj(), "storage");
+        BOOST_CHECK(storage.size() <= 6);
+        for (const std::string& key : storage.getKeys()) {
+            BOOST_CHECK(seen.insert(key).second);
+        }
+        start = find_value(r.get_obj(), "next");
+        if (start.isNull())
+            break;
+        BOOST_CHECK_EQUAL(storage.size(), 6U);
+        BOOST_CHECK(!seen.count(start.get_str()));
+    }
+    BOOST_CHECK_EQUAL(seen.size(), STORAGE_SLOTS);
+
+    UniValue r = CallStorageRPC("getcontractstoragerange", Params({addr, UniValue(""), UniValue((int)STORAGE_SLOTS)}));
+    BOOST_CHECK_EQUAL(find_value(r.get_obj(), "storage").size(), STORAGE_SLOTS);
+    BOOST_CHECK(find_value(r.get_obj(), "next").isNull());
+
+    // Bad arguments
+    BOOST_CHECK_THROW(CallStorageRPC("getcontractstoragerange", Params({UniValue("0202020202020202020202020202020202020202")})), std::runtime_error);
+    BOOST_CHECK_THROW(CallStorageRPC("getcontractstoragerange", Params({UniValue("xyz")})), std::runtime_error);
+    BOOST_CHECK_THROW(CallStorageRPC("getcontractstoragerange", Params({addr, UniValue("00")})), std::runtime_error);
+    BOOST_CHECK_THROW(CallStorageRPC("getcontractstoragerange", Params({addr, UniValue(std::string(64, 'z'))})), std::runtime_error);
+    BOOST_CHECK_THROW(CallStorageRPC("getcontractstoragerange", Params({addr, UniValue(), UniValue(0)})), std::runtime_error);
+    BOOST_CHECK_THROW(CallStorageRPC("getcontractstoragerange", Params({addr, UniValue(), UniValue(-1)})), std::runtime_error);
+    BOOST_CHECK_THROW(CallStorageRPC("getcontractstoragerange", Params({addr, UniValue(), UniValue(10001)})), std::runtime_error);
+
+    // Single slots by key
+    for (int i = 0; i < (int)STORAGE_SLOTS; i += 5) {
+        r = CallStorageRPC("getcontractstorageat", Params({addr, UniValue(HexStr(std::vector<unsigned char>(1, i)))}));
+        BOOST_CHECK(dev::u256("0x" + r.get_str()) == dev::u256(i + 1));
+    }
+    r = CallStorageRPC("getcontractstorageat", Params({addr, UniValue("ff")}));
+    BOOST_CHECK(dev::u256("0x" + r.get_str()) == 0);
+    BOOST_CHECK_THROW(CallStorageRPC("getcontractstorageat", Params({addr})), std::runtime_error);
+    BOOST_CHECK_THROW(CallStorageRPC("getcontractstorageat", Params({addr, UniValue("")})), std::runtime_error);
+    BOOST_CHECK_THROW(CallStorageRPC("getcontractstorageat", Params({addr, UniValue("0x01")})), std::runtime_error);
+    BOOST_CHECK_THROW(CallStorageRPC("getcontractstorageat", Params({addr, UniValue(std::string(66, '1'))})), std::runtime_error);
+    BOOST_CHECK_THROW(CallStorageRPC("getcontractstorageat", Params({UniValue("0202020202020202020202020202020202020202"), UniValue("01")})), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
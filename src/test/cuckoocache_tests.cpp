@@ -377,4 +377,32 @@ BOOST_AUTO_TEST_CASE(cuckoocache_generations)
     test_cache_generations<CuckooCache::cache<uint256, SignatureCacheHasher>>();
 }
 
+BOOST_AUTO_TEST_CASE(sharded_sigcache_ok)
+{
+    local_rand_ctx = FastRandomContext(true);
+    CShardedSignatureCache cache;
+    size_t nElems = cache.setup_bytes(SIG_CACHE_SHARDS << 12);
+    BOOST_CHECK_EQUAL(nElems, SIG_CACHE_SHARDS * ((1 << 12) / sizeof(uint256)));
+
+    std::vector<uint256> hashes(nElems / 4);
+    for (uint256& h : hashes) {
+        insecure_GetRandHash(h);
+        cache.insert(h);
+    }
+    // Everything fits, so all entries are found, across all shards.
+    for (const uint256& h : hashes) {
+        BOOST_CHECK(cache.contains(h, false));
+    }
+    uint256 missing;
+    insecure_GetRandHash(missing);
+    BOOST_CHECK(!cache.contains(missing, false));
+
+    SignatureCacheStats stats = cache.GetStats();
+    BOOST_CHECK_EQUAL(stats.nElems, nElems);
+    BOOST_CHECK_EQUAL(stats.nInserts, hashes.size());
+    BOOST_CHECK_EQUAL(stats.nHits, hashes.size());
+    BOOST_CHECK_EQUAL(stats.nMisses, 1U);
+    BOOST_CHECK_EQUAL(stats.nContended, 0U);
+}
+
 BOOST_AUTO_TEST_SUITE_END();
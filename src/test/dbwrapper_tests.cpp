@@ -77,6 +77,49 @@ BOOST_AUTO_TEST_CASE(dbwrapper_batch)
     }
 }
 
+// Test reading several keys at once
+BOOST_AUTO_TEST_CASE(dbwrapper_readmany)
+{
+    // Perform tests both obfuscated and non-obfuscated.
+    for (bool obfuscate : {false, true}) {
+        fs::path ph = fs::temp_directory_path() / fs::unique_path();
+        CDBWrapper dbw(ph, (1 << 20), true, false, obfuscate);
+
+        // Write every other key, so that lookups alternate between hits and misses.
+        std::vector<uint256> written;
+        for (int x = 0; x < 200; x += 2) {
+            uint256 value = InsecureRand256();
+            BOOST_CHECK(dbw.Write(std::make_pair('r', x), value));
+            written.push_back(value);
+        }
+        BOOST_CHECK(dbw.Write('s', InsecureRand256()));
+
+        // Ask in reverse order and with a duplicate.
+        std::vector<std::pair<char, int>> keys;
+        for (int x = 199; x >= 0; x--) {
+            keys.emplace_back('r', x);
+        }
+        keys.emplace_back('r', 10);
+        keys.emplace_back('q', 0);
+
+        std::vector<uint256> values;
+        std::vector<bool> found;
+        BOOST_CHECK_EQUAL(dbw.ReadMany(keys, values, found), 101U);
+        BOOST_CHECK_EQUAL(values.size(), keys.size());
+        BOOST_CHECK_EQUAL(found.size(), keys.size());
+        for (size_t i = 0; i < 200; i++) {
+            int x = keys[i].second;
+            BOOST_CHECK_EQUAL(found[i], x % 2 == 0);
+            if (found[i]) {
+                BOOST_CHECK_EQUAL(values[i].ToString(), written[x / 2].ToString());
+            }
+        }
+        BOOST_CHECK(found[200]);
+        BOOST_CHECK_EQUAL(values[200].ToString(), written[5].ToString());
+        BOOST_CHECK(!found[201]);
+    }
+}
+
 BOOST_AUTO_TEST_CASE(dbwrapper_iterator)
 {
     // Perform tests both obfuscated and non-obfuscated.
@@ -0,0 +1,114 @@
+#include "httpworkqueue.h"
+#include "lockfreequeue.h"
+
+#include "test/test_bitcoin.h"
+
+#include <thread>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(lockfreequeue_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(lockfreequeue_fifo)
+{
+    CLockFreeQueue<int> queue(5);
+    BOOST_CHECK_EQUAL(queue.Capacity(), 8U);
+    int value;
+    BOOST_CHECK(!queue.TryPop(value));
+
+    // Go around the ring a few times
+    for (int round = 0; round < 3; round++) {
+        for (int i = 0; i < 8; i++)
+            BOOST_CHECK(queue.TryPush(round * 8 + i));
+        BOOST_CHECK(!queue.TryPush(-1));
+        BOOST_CHECK_EQUAL(queue.Size(), 8U);
+        for (int i = 0; i < 8; i++) {
+            BOOST_CHECK(queue.TryPop(value));
+            BOOST_CHECK_EQUAL(value, round * 8 + i);
+        }
+        BOOST_CHECK(!queue.TryPop(value));
+        BOOST_CHECK_EQUAL(queue.Size(), 0U);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(lockfreequeue_threads)
+{
+    static const int PRODUCERS = 4;
+    static const int CONSUMERS = 4;
+    static const int VALUES = 20000;
+    CLockFreeQueue<int> queue(64);
+    std::atomic<int> nConsumed(0);
+    std::atomic<int64_t> nSum(0);
+
+    std::vector<std::thread> threads;
+    for (int p = 0; p < PRODUCERS; p++) {
+        threads.emplace_back([&queue, p]() {
+            for (int i = 1; i <= VALUES; i++) {
+                while (!queue.TryPush(p * VALUES + i))
+                    std::this_thread::yield();
+            }
+        });
+    }
+    for (int c = 0; c < CONSUMERS; c++) {
+        threads.emplace_back([&]() {
+            int value;
+            while (nConsumed < PRODUCERS * VALUES) {
+                if (queue.TryPop(value)) {
+                    nSum += value;
+                    ++nConsumed;
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    for (std::thread& thread : threads)
+        thread.join();
+
+    // Every value came out exactly once
+    const int64_t nTotal = (int64_t)PRODUCERS * VALUES;
+    BOOST_CHECK_EQUAL(nConsumed, nTotal);
+    BOOST_CHECK_EQUAL(nSum, nTotal * (nTotal + 1) / 2);
+    int value;
+    BOOST_CHECK(!queue.TryPop(value));
+}
+
+struct CountingItem
+{
+    std::atomic<int>& nRun;
+    explicit CountingItem(std::atomic<int>& nRunIn) : nRun(nRunIn) {}
+    void operator()() { ++nRun; }
+};
+
+BOOST_AUTO_TEST_CASE(workqueue_deferred_limit)
+{
+    std::atomic<int> nRun(0);
+    WorkQueue<CountingItem> queue(2, 3);
+
+    // Two fit in the ring and three are deferred, the next is refused and
+    // stays with the caller
+    for (int i = 0; i < 5; i++)
+        BOOST_CHECK(queue.Enqueue(new CountingItem(nRun)));
+    BOOST_CHECK_EQUAL(queue.Depth(), 2U);
+    BOOST_CHECK_EQUAL(queue.Deferred(), 3U);
+    std::unique_ptr<CountingItem> item(new CountingItem(nRun));
+    BOOST_CHECK(!queue.Enqueue(item.get()));
+    BOOST_CHECK_EQUAL(queue.RejectedTotal(), 1U);
+    BOOST_CHECK_EQUAL(queue.DeferredTotal(), 3U);
+
+    // A worker drains everything accepted
+    std::thread worker([&]() { queue.Run(); });
+    while (nRun < 5)
+        std::this_thread::yield();
+    BOOST_CHECK_EQUAL(queue.Deferred(), 0U);
+    BOOST_CHECK(queue.Enqueue(item.release()));
+    while (nRun < 6)
+        std::this_thread::yield();
+    queue.Interrupt();
+    queue.WaitExit();
+    worker.join();
+    BOOST_CHECK_EQUAL(nRun, 6);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -11,12 +11,14 @@
 #include "validation.h"
 #include "miner.h"
 #include "policy/policy.h"
+#include "pow.h"
 #include "pubkey.h"
 #include "script/standard.h"
 #include "txmempool.h"
 #include "uint256.h"
 #include "util.h"
 #include "utilstrencodings.h"
+#include "versionbits.h"
 
 #include "test/test_bitcoin.h"
 
@@ -501,4 +503,36 @@ BOOST_AUTO_TEST_CASE(CreateNewBlock_validity)
     fCheckpointsEnabled = true;
 }
 
+BOOST_AUTO_TEST_CASE(ScanNonces_lowest_match)
+{
+    const auto chainParams = CreateChainParams(CBaseChainParams::REGTEST);
+    const Consensus::Params& params = chainParams->GetConsensus();
+    // SHA256d and Blake2 headers
+    for (int32_t nVersion : {VERSIONBITS_TOP_BITS, VERSIONBITS_TOP_BITS | VERSIONBITS_BCX_MASK}) {
+        CBlockHeader header;
+        header.nVersion = nVersion;
+        header.hashPrevBlock = uint256S("0x1234");
+        header.hashMerkleRoot = uint256S("0x5678");
+        header.nTime = 1500000000;
+        header.nBits = 0x1f00ffff;
+        header.nNonce = 0;
+        BOOST_CHECK_EQUAL(header.CheckBCXVersion(), nVersion != VERSIONBITS_TOP_BITS);
+
+        CBlockHeader expected = header;
+        while (!CheckProofOfWork(expected.GetHash(), expected.nBits, params))
+            ++expected.nNonce;
+
+        uint64_t nHashes = 0;
+        BOOST_CHECK(ScanNonces(header, std::numeric_limits<uint32_t>::max(), 4, params, nHashes));
+        BOOST_CHECK_EQUAL(header.nNonce, expected.nNonce);
+        BOOST_CHECK(nHashes > expected.nNonce);
+
+        // A range ending before the match
+        header.nNonce = 0;
+        BOOST_CHECK(!ScanNonces(header, expected.nNonce, 1, params, nHashes));
+        BOOST_CHECK_EQUAL(header.nNonce, expected.nNonce);
+        BOOST_CHECK_EQUAL(nHashes, expected.nNonce);
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -3,11 +3,16 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "rpc/server.h"
+#include "rpc/blockchain.h"
 #include "rpc/client.h"
 
 #include "base58.h"
+#include "chainparams.h"
 #include "core_io.h"
+#include "jsonwriter.h"
 #include "netbase.h"
+#include "script/standard.h"
+#include "validation.h"
 
 #include "test/test_bitcoin.h"
 
@@ -339,4 +344,99 @@ BOOST_AUTO_TEST_CASE(rpc_convert_values_generatetoaddress)
     BOOST_CHECK_EQUAL(result[2].get_int(), 9);
 }
 
+BOOST_AUTO_TEST_CASE(rpc_streamed_json)
+{
+    CJSONWriter writer;
+    writer.BeginObject();
+    writer.Key("a").BeginArray().Int(-1).UInt(2).Bool(true).String("q\"\n").EndArray();
+    writer.Key("b").BeginObject().EndObject();
+    writer.Key("c").Real(0.25);
+    writer.EndObject();
+    UniValue a(UniValue::VARR);
+    a.push_back(-1);
+    a.push_back(2);
+    a.push_back(true);
+    a.push_back("q\"\n");
+    UniValue expected(UniValue::VOBJ);
+    expected.pushKV("a", a);
+    expected.pushKV("b", UniValue(UniValue::VOBJ));
+    expected.pushKV("c", 0.25);
+    BOOST_CHECK_EQUAL(writer.str(), expected.write());
+
+    // A spend with a witness, to a standard output
+    CMutableTransaction mtx;
+    mtx.vin.resize(1);
+    mtx.vin[0].prevout = COutPoint(uint256S("0x1234"), 1);
+    mtx.vin[0].scriptSig = CScript() << OP_0 << std::vector<unsigned char>(33, 2);
+    mtx.vin[0].scriptWitness.stack.push_back(std::vector<unsigned char>(72, 1));
+    mtx.vout.resize(2);
+    mtx.vout[0].nValue = 12345678;
+    mtx.vout[0].scriptPubKey = GetScriptForDestination(CKeyID(uint160(std::vector<unsigned char>(20, 3))));
+    mtx.vout[1].nValue = -1;
+    mtx.vout[1].scriptPubKey = CScript() << OP_RETURN;
+    const CTransaction tx(mtx);
+    UniValue objTx(UniValue::VOBJ);
+    TxToUniv(tx, uint256S("0x9abc"), objTx);
+    CJSONWriter txWriter;
+    TxToJSON(tx, uint256S("0x9abc"), txWriter);
+    BOOST_CHECK_EQUAL(txWriter.str(), objTx.write());
+
+    LOCK(cs_main);
+    const CBlock& block = Params().GenesisBlock();
+    const CBlockIndexJSON index(chainActive.Genesis());
+    for (bool fTxDetails : {false, true}) {
+        CJSONWriter blockWriter;
+        blockToJSON(block, index, fTxDetails, blockWriter);
+        BOOST_CHECK_EQUAL(blockWriter.str(), blockToJSON(block, index, fTxDetails).write());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(rpc_method_stats)
+{
+    CRPCMethodStats stats;
+    stats.Record(0, false);
+    stats.Record(3, false);
+    stats.Record(3, true);
+    stats.Record(1000, false);
+    UniValue obj = stats.ToJSON();
+    BOOST_CHECK_EQUAL(find_value(obj, "calls").get_int(), 4);
+    BOOST_CHECK_EQUAL(find_value(obj, "errors").get_int(), 1);
+    BOOST_CHECK_EQUAL(find_value(obj, "total_us").get_int(), 1006);
+    BOOST_CHECK_EQUAL(find_value(obj, "max_us").get_int(), 1000);
+    const UniValue& histogram = find_value(obj, "latency_us");
+    BOOST_CHECK_EQUAL(histogram.size(), 3U);
+    BOOST_CHECK_EQUAL(find_value(histogram, "<1").get_int(), 1);
+    BOOST_CHECK_EQUAL(find_value(histogram, "<4").get_int(), 2);
+    BOOST_CHECK_EQUAL(find_value(histogram, "<1024").get_int(), 1);
+
+    BOOST_CHECK(CallRPC("getrpcinfo").isObject());
+    BOOST_CHECK_THROW(CallRPC("getrpcinfo nosuchmethod"), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(rpc_batch_order)
+{
+    BOOST_CHECK(tableRPC.isParallelSafe("getblockcount"));
+    BOOST_CHECK(!tableRPC.isParallelSafe("setban"));
+    BOOST_CHECK(!tableRPC.isParallelSafe("nosuchmethod"));
+
+    // Runs of parallel calls and the calls between them answer in request order
+    const char* methods[] = {"getblockcount", "uptime", "getbestblockhash", "setban", "getblockcount", "getrpcinfo", "nosuchmethod", "uptime"};
+    UniValue batch(UniValue::VARR);
+    for (unsigned int i = 0; i < sizeof(methods) / sizeof(methods[0]); i++) {
+        UniValue req(UniValue::VOBJ);
+        req.pushKV("method", methods[i]);
+        req.pushKV("params", UniValue(UniValue::VARR));
+        req.pushKV("id", (int)i);
+        batch.push_back(req);
+    }
+    batch.push_back(UniValue("not a request"));
+    UniValue reply;
+    BOOST_CHECK(reply.read(JSONRPCExecBatch(batch)));
+    BOOST_CHECK_EQUAL(reply.size(), batch.size());
+    for (unsigned int i = 0; i + 1 < reply.size(); i++) {
+        BOOST_CHECK_EQUAL(find_value(reply[i], "id").get_int(), (int)i);
+    }
+    BOOST_CHECK(find_value(reply[reply.size() - 1], "id").isNull());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
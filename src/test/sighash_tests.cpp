@@ -171,6 +171,30 @@ BOOST_AUTO_TEST_CASE(sighash_test)
     #endif
 }
 
+BOOST_AUTO_TEST_CASE(sighash_legacy_cache)
+{
+    SeedInsecureRand(false);
+
+    for (int i=0; i<1000; i++) {
+        CMutableTransaction txTo;
+        RandomTransaction(txTo, false);
+        const CTransaction tx(txTo);
+        PrecomputedTransactionData txdata(tx);
+        // Hash types and inputs in random order, with repeats served from the cache
+        for (int j=0; j<20; j++) {
+            int nHashType = InsecureRand32() & ~SIGHASH_FORKID;
+            unsigned int nIn = InsecureRandRange(tx.vin.size());
+            CScript scriptCode;
+            RandomScript(scriptCode);
+            uint256 sho = SignatureHashOld(scriptCode, tx, nIn, nHashType);
+            BOOST_CHECK(SignatureHash(scriptCode, tx, nIn, nHashType, 0, SIGVERSION_BASE, &txdata) == sho);
+            BOOST_CHECK(SignatureHash(scriptCode, tx, nIn, nHashType, 0, SIGVERSION_BASE, &txdata) == sho);
+        }
+        txdata.legacyCache.Clear();
+        BOOST_CHECK(SignatureHash(CScript(), tx, 0, SIGHASH_ALL, 0, SIGVERSION_BASE, &txdata) == SignatureHashOld(CScript(), tx, 0, SIGHASH_ALL));
+    }
+}
+
 // Goal: check that SignatureHash generates correct hash
 BOOST_AUTO_TEST_CASE(sighash_from_data)
 {
@@ -27,6 +27,7 @@
 #include <boost/filesystem.hpp>
 #include <libethashseal/Ethash.h>
 #include "contract/config.h"
+#include "contract/contractregistry.h"
 #include "contract/contractutil.h"
 #include "contract/ethstate.h"
 #include "contract/staterootview.h"
@@ -98,6 +99,8 @@ TestingSetup::TestingSetup(const std::string& chainName) : BasicTestingSetup(cha
         fs::create_directories(contractPath);
         StateRootView::Init(contractPath, false);
         StateRootView::Instance()->InitGenesis(chainparams);
+        ContractRegistry::Init(contractPath, false);
+        ContractRegistry::Instance()->SetComplete();
         const dev::h256 hashDB(dev::sha3(dev::rlp("")));
         EthState::Init(dev::u256(0), EthState::openDB(contractPath.string(), hashDB, dev::WithExisting::Trust), contractPath.string(), dev::eth::BaseState::Empty);
 
@@ -146,6 +149,7 @@ TestingSetup::~TestingSetup()
 
         EthState::Release();
         StateRootView::Release();
+        ContractRegistry::Release();
         TxExecRecord::Release();
 
         fs::remove_all(pathTemp);
@@ -2,6 +2,7 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include "chainparams.h"
 #include "consensus/validation.h"
 #include "key.h"
 #include "validation.h"
@@ -19,7 +20,7 @@
 
 #include <boost/test/unit_test.hpp>
 
-bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsViewCache &inputs, bool fScriptChecks, unsigned int flags, bool cacheSigStore, bool cacheFullScriptStore, PrecomputedTransactionData& txdata, std::vector<CScriptCheck> *pvChecks);
+bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsViewCache &inputs, bool fScriptChecks, unsigned int flags, bool cacheSigStore, bool cacheFullScriptStore, const PrecomputedTransactionData& txdata, std::vector<CScriptCheck> *pvChecks);
 
 BOOST_AUTO_TEST_SUITE(tx_validationcache_tests)
 
@@ -90,6 +91,40 @@ BOOST_FIXTURE_TEST_CASE(tx_mempool_block_doublespend, TestChain100Setup)
     BOOST_CHECK_EQUAL(mempool.size(), 0);
 }
 
+BOOST_FIXTURE_TEST_CASE(tx_mempool_validation_data, TestChain100Setup)
+{
+    // Mempool entries keep the data validation computed for them, and a
+    // block reusing it connects
+    CScript scriptPubKey = CScript() <<  ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+    CMutableTransaction spend;
+    spend.nVersion = 1;
+    spend.vin.resize(1);
+    spend.vin[0].prevout = COutPoint(coinbaseTxns[0].GetHash(), 0);
+    spend.vout.resize(1);
+    spend.vout[0].nValue = 11*CENT*BTC_2_BCX_RATE;
+    spend.vout[0].scriptPubKey = scriptPubKey;
+    std::vector<unsigned char> vchSig;
+    uint256 hash = SignatureHash(scriptPubKey, spend, 0, SIGHASH_BCX_ALL, coinbaseTxns[0].vout[0].nValue, SIGVERSION_BASE);
+    BOOST_CHECK(coinbaseKey.Sign(hash, vchSig));
+    vchSig.push_back((unsigned char)SIGHASH_BCX_ALL);
+    spend.vin[0].scriptSig << vchSig;
+
+    BOOST_CHECK(ToMemPool(spend));
+    {
+        LOCK2(cs_main, mempool.cs);
+        CTxMemPool::txiter it = mempool.mapTx.find(spend.GetHash());
+        BOOST_CHECK(it != mempool.mapTx.end());
+        BOOST_CHECK(it->GetTxData());
+        const unsigned int flags = GetBlockScriptFlags(chainActive.Tip(), Params().GetConsensus());
+        BOOST_CHECK(it->ScriptsCheckedWith(flags));
+        BOOST_CHECK(!it->ScriptsCheckedWith(flags ^ SCRIPT_VERIFY_NULLDUMMY));
+    }
+
+    CBlock block = CreateAndProcessBlock(std::vector<CMutableTransaction>(1, spend), scriptPubKey);
+    BOOST_CHECK(chainActive.Tip()->GetBlockHash() == block.GetHash());
+    BOOST_CHECK_EQUAL(mempool.size(), 0);
+}
+
 // Run CheckInputs (using pcoinsTip) on the given transaction, for all script
 // flags.  Test that CheckInputs passes for all flags that don't overlap with
 // the failing_flags argument, but otherwise fails.
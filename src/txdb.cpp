@@ -27,6 +27,9 @@ static const char DB_TXINDEX = 't';
 static const char DB_BLOCK_INDEX = 'b';
 
 static const char DB_HEIGHTINDEX = 'h';
+static const char DB_ADDRESSINDEX = 'a';
+static const char DB_ADDRESSUNSPENTINDEX = 'u';
+static const char DB_ADDRESSBALANCE = 's';
 static const char DB_BEST_BLOCK = 'B';
 static const char DB_HEAD_BLOCKS = 'H';
 static const char DB_FLAG = 'F';
@@ -65,6 +68,16 @@ bool CCoinsViewDB::GetCoin(const COutPoint &outpoint, Coin &coin) const {
     return db.Read(CoinEntry(&outpoint), coin);
 }
 
+size_t CCoinsViewDB::GetCoins(const std::vector<COutPoint> &vOutPoints, std::vector<Coin> &vCoins) const {
+    std::vector<CoinEntry> vEntries;
+    vEntries.reserve(vOutPoints.size());
+    for (const COutPoint& outpoint : vOutPoints) {
+        vEntries.emplace_back(&outpoint);
+    }
+    std::vector<bool> vFound;
+    return db.ReadMany(vEntries, vCoins, vFound);
+}
+
 bool CCoinsViewDB::HaveCoin(const COutPoint &outpoint) const {
     return db.Exists(CoinEntry(&outpoint));
 }
@@ -84,7 +97,7 @@ std::vector<uint256> CCoinsViewDB::GetHeadBlocks() const {
     return vhashHeadBlocks;
 }
 
-bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
+bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock, bool fErase) {
     CDBBatch batch(db);
     size_t count = 0;
     size_t changed = 0;
@@ -119,8 +132,12 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
             changed++;
         }
         count++;
-        CCoinsMap::iterator itOld = it++;
-        mapCoins.erase(itOld);
+        if (fErase) {
+            CCoinsMap::iterator itOld = it++;
+            mapCoins.erase(itOld);
+        } else {
+            ++it;
+        }
         if (batch.SizeEstimate() > batch_size) {
             LogPrint(BCLog::COINDB, "Writing partial batch of %.2f MiB\n", batch.SizeEstimate() * (1.0 / 1048576.0));
             db.WriteBatch(batch);
@@ -345,6 +362,131 @@ bool CBlockTreeDB::WipeHeightIndex() {
     return WriteBatch(batch);
 }
 
+static void WriteAddressUnspent(CDBBatch& batch, const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue>>& vUnspent)
+{
+    for (const std::pair<CAddressUnspentKey, CAddressUnspentValue>& entry : vUnspent) {
+        if (entry.second.IsNull()) {
+            batch.Erase(std::make_pair(DB_ADDRESSUNSPENTINDEX, entry.first));
+        } else {
+            batch.Write(std::make_pair(DB_ADDRESSUNSPENTINDEX, entry.first), entry.second);
+        }
+    }
+}
+
+/**
+ * Apply a block's entries to the running totals of the scripts it touches.
+ * A script whose totals already include the block (or, when disconnecting,
+ * no longer do) is left alone, so a block replayed after an unclean shutdown
+ * is not counted twice.
+ */
+static void WriteAddressBalances(CBlockTreeDB& db, CDBBatch& batch, bool fConnect,
+                                 const std::vector<std::pair<CAddressIndexKey, CAmount>>& vHistory,
+                                 const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue>>& vUnspent)
+{
+    if (vHistory.empty())
+        return;
+    const uint32_t nHeight = vHistory[0].first.nHeight;
+    const int nSign = fConnect ? 1 : -1;
+
+    std::map<uint256, CAddressBalance> mapDelta;
+    for (const std::pair<CAddressIndexKey, CAmount>& entry : vHistory) {
+        CAddressBalance& delta = mapDelta[entry.first.scriptHash];
+        delta.nBalance += nSign * entry.second;
+        if (!entry.first.fSpending)
+            delta.nReceived += nSign * entry.second;
+    }
+    for (const std::pair<CAddressUnspentKey, CAddressUnspentValue>& entry : vUnspent) {
+        mapDelta[entry.first.scriptHash].nUtxos += entry.second.IsNull() ? -1 : 1;
+    }
+
+    for (const std::pair<const uint256, CAddressBalance>& item : mapDelta) {
+        CAddressBalance balance;
+        db.ReadAddressBalance(item.first, balance);
+        if (fConnect ? balance.nHeight >= nHeight : balance.nHeight < nHeight)
+            continue;
+        balance.nBalance += item.second.nBalance;
+        balance.nReceived += item.second.nReceived;
+        balance.nUtxos += item.second.nUtxos;
+        balance.nHeight = fConnect ? nHeight : nHeight - 1;
+        batch.Write(std::make_pair(DB_ADDRESSBALANCE, item.first), balance);
+    }
+}
+
+bool CBlockTreeDB::WriteAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount>>& vHistory,
+                                     const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue>>& vUnspent,
+                                     const std::vector<std::pair<uint256, CDiskTxPos>>& vTxPos) {
+    CDBBatch batch(*this);
+    for (const std::pair<CAddressIndexKey, CAmount>& entry : vHistory)
+        batch.Write(std::make_pair(DB_ADDRESSINDEX, entry.first), entry.second);
+    WriteAddressUnspent(batch, vUnspent);
+    WriteAddressBalances(*this, batch, true, vHistory, vUnspent);
+    for (const std::pair<uint256, CDiskTxPos>& entry : vTxPos)
+        batch.Write(std::make_pair(DB_TXINDEX, entry.first), entry.second);
+    return WriteBatch(batch);
+}
+
+bool CBlockTreeDB::EraseAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount>>& vHistory,
+                                     const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue>>& vUnspent) {
+    CDBBatch batch(*this);
+    for (const std::pair<CAddressIndexKey, CAmount>& entry : vHistory)
+        batch.Erase(std::make_pair(DB_ADDRESSINDEX, entry.first));
+    WriteAddressUnspent(batch, vUnspent);
+    WriteAddressBalances(*this, batch, false, vHistory, vUnspent);
+    return WriteBatch(batch);
+}
+
+bool CBlockTreeDB::ReadAddressIndex(const uint256& scriptHash, int nStart, int nEnd, size_t nSkip, size_t nCount,
+                                    std::vector<std::pair<CAddressIndexKey, CAmount>>& vHistory) {
+    std::unique_ptr<CDBIterator> pcursor(NewIterator());
+
+    pcursor->Seek(std::make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorKey(scriptHash, std::max(nStart, 0))));
+    for (; pcursor->Valid() && vHistory.size() < nCount; pcursor->Next()) {
+        std::pair<char, CAddressIndexKey> key;
+        if (!pcursor->GetKey(key) || key.first != DB_ADDRESSINDEX || key.second.scriptHash != scriptHash)
+            break;
+        if (nEnd >= 0 && key.second.nHeight > (uint32_t)nEnd)
+            break;
+        if (nSkip > 0) {
+            nSkip--;
+            continue;
+        }
+        CAmount nValue;
+        if (!pcursor->GetValue(nValue))
+            return error("%s: failed to read address index value", __func__);
+        vHistory.emplace_back(key.second, nValue);
+    }
+    return true;
+}
+
+bool CBlockTreeDB::ReadAddressUnspentIndex(const uint256& scriptHash, size_t nSkip, size_t nCount,
+                                           std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue>>& vUnspent) {
+    std::unique_ptr<CDBIterator> pcursor(NewIterator());
+
+    pcursor->Seek(std::make_pair(DB_ADDRESSUNSPENTINDEX, scriptHash));
+    for (; pcursor->Valid() && vUnspent.size() < nCount; pcursor->Next()) {
+        std::pair<char, CAddressUnspentKey> key;
+        if (!pcursor->GetKey(key) || key.first != DB_ADDRESSUNSPENTINDEX || key.second.scriptHash != scriptHash)
+            break;
+        if (nSkip > 0) {
+            nSkip--;
+            continue;
+        }
+        CAddressUnspentValue value;
+        if (!pcursor->GetValue(value))
+            return error("%s: failed to read address unspent index value", __func__);
+        vUnspent.emplace_back(key.second, value);
+    }
+    return true;
+}
+
+bool CBlockTreeDB::ReadAddressBalance(const uint256& scriptHash, CAddressBalance& balance) {
+    if (!Exists(std::make_pair(DB_ADDRESSBALANCE, scriptHash))) {
+        balance = CAddressBalance();
+        return true;
+    }
+    return Read(std::make_pair(DB_ADDRESSBALANCE, scriptHash), balance);
+}
+
 bool CBlockTreeDB::LoadBlockIndexGuts(const Consensus::Params& consensusParams, std::function<CBlockIndex*(const uint256&)> insertBlockIndex)
 {
     std::unique_ptr<CDBIterator> pcursor(NewIterator());
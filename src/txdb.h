@@ -6,6 +6,7 @@
 #ifndef BITCOIN_TXDB_H
 #define BITCOIN_TXDB_H
 
+#include "addressindex.h"
 #include "coins.h"
 #include "dbwrapper.h"
 #include "chain.h"
@@ -73,10 +74,11 @@ public:
     CCoinsViewDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
 
     bool GetCoin(const COutPoint &outpoint, Coin &coin) const override;
+    size_t GetCoins(const std::vector<COutPoint> &vOutPoints, std::vector<Coin> &vCoins) const override;
     bool HaveCoin(const COutPoint &outpoint) const override;
     uint256 GetBestBlock() const override;
     std::vector<uint256> GetHeadBlocks() const override;
-    bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) override;
+    bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock, bool fErase) override;
     CCoinsViewCursor *Cursor() const override;
 
     //! Attempt to update from an older database format. Returns whether an error occurred.
@@ -131,6 +133,28 @@ public:
             std::vector<std::vector<uint256>> &blocksOfHashes,
             std::set<dev::h160> const &addresses);
     bool WipeHeightIndex();
+
+    /**
+     * Add a block's -addressindex history; null unspent values erase outputs.
+     * The block's -txindex entries, if any, are written in the same batch.
+     */
+    bool WriteAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount>>& vHistory,
+                           const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue>>& vUnspent,
+                           const std::vector<std::pair<uint256, CDiskTxPos>>& vTxPos = std::vector<std::pair<uint256, CDiskTxPos>>());
+    /** Remove a disconnected block's history, and restore the outputs it spent */
+    bool EraseAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount>>& vHistory,
+                           const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue>>& vUnspent);
+    /**
+     * Read the history of a script between heights nStart and nEnd (-1 for
+     * the tip), skipping the first nSkip entries and returning at most nCount
+     */
+    bool ReadAddressIndex(const uint256& scriptHash, int nStart, int nEnd, size_t nSkip, size_t nCount,
+                          std::vector<std::pair<CAddressIndexKey, CAmount>>& vHistory);
+    /** Read the unspent outputs of a script, paged like ReadAddressIndex */
+    bool ReadAddressUnspentIndex(const uint256& scriptHash, size_t nSkip, size_t nCount,
+                                 std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue>>& vUnspent);
+    /** Read the running totals of a script, which are zero if it was never seen */
+    bool ReadAddressBalance(const uint256& scriptHash, CAddressBalance& balance);
 };
 
 #endif // BITCOIN_TXDB_H
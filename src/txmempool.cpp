@@ -12,6 +12,7 @@
 #include "policy/policy.h"
 #include "policy/fees.h"
 #include "reverse_iterator.h"
+#include "script/interpreter.h"
 #include "streams.h"
 #include "timedata.h"
 #include "util.h"
@@ -24,7 +25,7 @@ CTxMemPoolEntry::CTxMemPoolEntry(const CTransactionRef& _tx, const CAmount& _nFe
                                  CAmount _nMinGasPrice):
     tx(_tx), nFee(_nFee), nTime(_nTime), entryHeight(_entryHeight),
     spendsCoinbase(_spendsCoinbase), sigOpCost(_sigOpsCost), lockPoints(lp),
-    nMinGasPrice(_nMinGasPrice)
+    nMinGasPrice(_nMinGasPrice), fScriptsChecked(false), nScriptFlags(0)
 {
     nTxWeight = GetTransactionWeight(*tx);
     nUsageSize = RecursiveDynamicUsage(tx);
@@ -46,6 +47,15 @@ CTxMemPoolEntry::CTxMemPoolEntry(const CTxMemPoolEntry& other)
     *this = other;
 }
 
+void CTxMemPoolEntry::SetValidationData(const std::shared_ptr<const PrecomputedTransactionData>& txdataIn, bool fScriptsCheckedIn, unsigned int nScriptFlagsIn)
+{
+    nUsageSize -= memusage::DynamicUsage(txdata);
+    txdata = txdataIn;
+    nUsageSize += memusage::DynamicUsage(txdata);
+    fScriptsChecked = fScriptsCheckedIn;
+    nScriptFlags = nScriptFlagsIn;
+}
+
 void CTxMemPoolEntry::UpdateFeeDelta(int64_t newFeeDelta)
 {
     nModFeesWithDescendants += newFeeDelta - feeDelta;
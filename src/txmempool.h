@@ -29,6 +29,7 @@
 #include <boost/signals2/signal.hpp>
 
 class CBlockIndex;
+struct PrecomputedTransactionData;
 
 /** Fake height value used in Coin to signify they are only in the memory pool (since 0.8) */
 static const uint32_t MEMPOOL_HEIGHT = 0x7FFFFFFF;
@@ -76,6 +77,9 @@ private:
     int64_t feeDelta;          //!< Used for determining the priority of the transaction for mining in a block
     LockPoints lockPoints;     //!< Track the height and time at which tx was final
     CAmount nMinGasPrice;      //!< The minimum gas price among the contract outputs of the tx
+    std::shared_ptr<const PrecomputedTransactionData> txdata; //!< Signature hash data computed on acceptance
+    bool fScriptsChecked;      //!< Whether all input scripts passed with nScriptFlags
+    unsigned int nScriptFlags;
 
     // Information about descendants of this transaction that are in the
     // mempool; if we remove this transaction we must remove all of these
@@ -111,6 +115,12 @@ public:
     size_t DynamicMemoryUsage() const { return nUsageSize; }
     const LockPoints& GetLockPoints() const { return lockPoints; }
     const CAmount& GetMinGasPrice() const { return nMinGasPrice; }
+    const std::shared_ptr<const PrecomputedTransactionData>& GetTxData() const { return txdata; }
+    bool ScriptsCheckedWith(unsigned int flags) const { return fScriptsChecked && nScriptFlags == flags; }
+
+    // Keeps what validation computed on acceptance, for reuse when the
+    // transaction shows up in a block. Call before adding to the mempool.
+    void SetValidationData(const std::shared_ptr<const PrecomputedTransactionData>& txdataIn, bool fScriptsCheckedIn, unsigned int nScriptFlagsIn);
 
     // Adjusts the descendant state.
     void UpdateDescendantState(int64_t modifySize, CAmount modifyFee, int64_t modifyCount);
@@ -5,11 +5,13 @@
 
 #include "validation.h"
 
+#include "addressindex.h"
 #include "arith_uint256.h"
 #include "chain.h"
 #include "chainparams.h"
 #include "checkpoints.h"
 #include "checkqueue.h"
+#include "coinsprefetch.h"
 #include "consensus/consensus.h"
 #include "consensus/merkle.h"
 #include "consensus/tx_verify.h"
@@ -56,6 +58,7 @@
 #include "contract/ethstate.h"
 #include "contract/ethtxconverter.h"
 #include "contract/contractexecutor.h"
+#include "contract/contractregistry.h"
 #include "contract/staterootview.h"
 #include "contract/txexecrecord.h"
 #include "contract/vmlog.h"
@@ -83,6 +86,7 @@ int nScriptCheckThreads = 0;
 std::atomic_bool fImporting(false);
 bool fReindex = false;
 bool fTxIndex = false;
+bool fAddressIndex = false;
 bool fHavePruned = false;
 bool fPruneMode = false;
 bool fIsBareMultisigStd = DEFAULT_PERMIT_BAREMULTISIG;
@@ -214,6 +218,7 @@ CBlockIndex* FindForkInGlobalIndex(const CChain& chain, const CBlockLocator& loc
 }
 
 CCoinsViewDB *pcoinsdbview = nullptr;
+CCoinsViewPrefetch *pcoinsprefetch = nullptr;
 CCoinsViewCache *pcoinsTip = nullptr;
 CBlockTreeDB *pblocktree = nullptr;
 
@@ -228,7 +233,7 @@ enum FlushStateMode {
 static bool FlushStateToDisk(const CChainParams& chainParams, CValidationState &state, FlushStateMode mode, int nManualPruneHeight=0);
 static void FindFilesToPruneManual(std::set<int>& setFilesToPrune, int nManualPruneHeight);
 static void FindFilesToPrune(std::set<int>& setFilesToPrune, uint64_t nPruneAfterHeight);
-bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsViewCache &inputs, bool fScriptChecks, unsigned int flags, bool cacheSigStore, bool cacheFullScriptStore, PrecomputedTransactionData& txdata, std::vector<CScriptCheck> *pvChecks = nullptr);
+bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsViewCache &inputs, bool fScriptChecks, unsigned int flags, bool cacheSigStore, bool cacheFullScriptStore, const PrecomputedTransactionData& txdata, std::vector<CScriptCheck> *pvChecks = nullptr);
 static FILE* OpenUndoFile(const CDiskBlockPos &pos, bool fReadOnly = false);
 
 bool CheckFinalTx(const CTransaction &tx, int flags)
@@ -351,9 +356,6 @@ bool CheckSequenceLocks(const CTransaction &tx, int flags, LockPoints* lp, bool
     return EvaluateSequenceLocks(index, lockPair);
 }
 
-// Returns the script flags which should be checked for a given block
-static unsigned int GetBlockScriptFlags(const CBlockIndex* pindex, const Consensus::Params& chainparams);
-
 static void LimitMempoolSize(CTxMemPool& pool, size_t limit, unsigned long age) {
     int expired = pool.Expire(GetTime() - age);
     if (expired != 0) {
@@ -454,7 +456,7 @@ void UpdateMempoolForReorg(DisconnectedBlockTransactions &disconnectpool, bool f
 // Used to avoid mempool polluting consensus critical paths if CCoinsViewMempool
 // were somehow broken and returning the wrong scriptPubKeys
 static bool CheckInputsFromMempoolAndCache(const CTransaction& tx, CValidationState &state, const CCoinsViewCache &view, CTxMemPool& pool,
-                 unsigned int flags, bool cacheSigStore, PrecomputedTransactionData& txdata) {
+                 unsigned int flags, bool cacheSigStore, const PrecomputedTransactionData& txdata) {
     AssertLockHeld(cs_main);
 
     // pool.cs should be locked already, but go ahead and re-take the lock here
@@ -942,7 +944,8 @@ static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool
 
         // Check against previous transactions
         // This is done last to help prevent CPU exhaustion denial-of-service attacks.
-        PrecomputedTransactionData txdata(tx);
+        std::shared_ptr<PrecomputedTransactionData> ptxdata = std::make_shared<PrecomputedTransactionData>(tx);
+        const PrecomputedTransactionData& txdata = *ptxdata;
         if (!CheckInputs(tx, state, view, true, scriptVerifyFlags, true, false, txdata)) {
             // SCRIPT_VERIFY_CLEANSTACK requires SCRIPT_VERIFY_WITNESS, so we
             // need to turn both off, and compare against just turning off CLEANSTACK
@@ -988,7 +991,15 @@ static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool
                     LogPrintf("Warning: -promiscuousmempool flags set to not include currently enforced soft forks, this may break mining or otherwise cause instability!\n");
                 }
             }
+            entry.SetValidationData(ptxdata, false, 0);
+        } else {
+            // ConnectBlock can skip the scripts of this transaction while
+            // the tip's flags stay the same
+            entry.SetValidationData(ptxdata, true, currentBlockScriptVerifyFlags);
         }
+        // The legacy signature hashes only served the checks above and
+        // would sit unaccounted in the mempool
+        ptxdata->legacyCache.Clear();
 
         // Remove conflicting transactions from the mempool
         for (const CTxMemPool::txiter it : allConflicting)
@@ -1171,6 +1182,35 @@ bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus
     return true;
 }
 
+bool ReadRawBlockFromDisk(std::string& data, const CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart)
+{
+    // The block is preceded by the message start and its size
+    CDiskBlockPos posHeader = pos;
+    if (posHeader.nPos < 8)
+        return error("%s: invalid position %s", __func__, pos.ToString());
+    posHeader.nPos -= 8;
+
+    CAutoFile filein(OpenBlockFile(posHeader, true), SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull())
+        return error("%s: OpenBlockFile failed for %s", __func__, pos.ToString());
+
+    try {
+        CMessageHeader::MessageStartChars blockStart;
+        unsigned int nSize;
+        filein >> FLATDATA(blockStart) >> nSize;
+        if (memcmp(blockStart, messageStart, CMessageHeader::MESSAGE_START_SIZE) != 0)
+            return error("%s: block start mismatch at %s", __func__, pos.ToString());
+        if (nSize > MAX_BLOCK_SERIALIZED_SIZE)
+            return error("%s: block size %u too large at %s", __func__, nSize, pos.ToString());
+        data.resize(nSize);
+        filein.read(&data[0], nSize);
+    }
+    catch (const std::exception& e) {
+        return error("%s: I/O error - %s at %s", __func__, e.what(), pos.ToString());
+    }
+    return true;
+}
+
 CAmount GetBlockSubsidy(int nHeight, const Consensus::Params& consensusParams)
 {
     static const CAmount BTC_INIT_SUBSIDY = 50 * COIN * BTC_2_BCX_RATE;
@@ -1404,9 +1444,13 @@ int GetSpendHeight(const CCoinsViewCache& inputs)
 }
 
 
-static CuckooCache::cache<uint256, SignatureCacheHasher> scriptExecutionCache;
+static CShardedSignatureCache scriptExecutionCache;
 static uint256 scriptExecutionCacheNonce(GetRandHash());
 
+SignatureCacheStats GetScriptExecutionCacheStats() {
+    return scriptExecutionCache.GetStats();
+}
+
 void InitScriptExecutionCache() {
     // nMaxCacheSize is unsigned. If -maxsigcachesize is set to zero,
     // setup_bytes creates the minimum possible cache (2 elements).
@@ -1430,7 +1474,7 @@ void InitScriptExecutionCache() {
  *
  * Non-static (and re-declared) in src/test/txvalidationcache_tests.cpp
  */
-bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsViewCache &inputs, bool fScriptChecks, unsigned int flags, bool cacheSigStore, bool cacheFullScriptStore, PrecomputedTransactionData& txdata, std::vector<CScriptCheck> *pvChecks)
+bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsViewCache &inputs, bool fScriptChecks, unsigned int flags, bool cacheSigStore, bool cacheFullScriptStore, const PrecomputedTransactionData& txdata, std::vector<CScriptCheck> *pvChecks)
 {
     if (!tx.IsCoinBase())
     {
@@ -1460,7 +1504,6 @@ bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsVi
             // round - giving us 19 + 32 + 4 = 55 bytes (+ 8 + 1 = 64)
             static_assert(55 - sizeof(flags) - 32 >= 128/8, "Want at least 128 bits of nonce for script execution cache");
             CSHA256().Write(scriptExecutionCacheNonce.begin(), 55 - sizeof(flags) - 32).Write(tx.GetWitnessHash().begin(), 32).Write((unsigned char*)&flags, sizeof(flags)).Finalize(hashCacheEntry.begin());
-            AssertLockHeld(cs_main); //TODO: Remove this requirement by making CuckooCache not require external locks
             if (scriptExecutionCache.contains(hashCacheEntry, !cacheFullScriptStore)) {
                 return true;
             }
@@ -1634,6 +1677,72 @@ int ApplyTxInUndo(Coin&& undo, CCoinsViewCache& view, const COutPoint& out)
     return fClean ? DISCONNECT_OK : DISCONNECT_UNCLEAN;
 }
 
+/**
+ * Collect the -addressindex entries of a transaction, which spends vSpent.
+ * Connecting adds its outputs to the unspent index and removes the ones it
+ * spends; disconnecting does the opposite.
+ */
+static void GetAddressIndexEntries(const CTransaction& tx, const std::vector<Coin>& vSpent, int nHeight, uint32_t nTxIndex, bool fConnect,
+                                   std::vector<std::pair<CAddressIndexKey, CAmount>>& vHistory,
+                                   std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue>>& vUnspent)
+{
+    const uint256& txid = tx.GetHash();
+    for (size_t j = 0; j < vSpent.size(); j++) {
+        const Coin& coin = vSpent[j];
+        const uint256 scriptHash = GetScriptHash(coin.out.scriptPubKey);
+        vHistory.emplace_back(CAddressIndexKey(scriptHash, nHeight, nTxIndex, txid, j, true), -coin.out.nValue);
+        vUnspent.emplace_back(CAddressUnspentKey(scriptHash, tx.vin[j].prevout),
+                              fConnect ? CAddressUnspentValue() : CAddressUnspentValue(coin.out.nValue, coin.out.scriptPubKey, coin.nHeight, coin.fCoinBase));
+    }
+
+    // The sender of a contract call is the P2PKH address (dev::Address) of the
+    // key spent by its first input; list the call under it when that input is
+    // not already a P2PKH output of the sender
+    if (!vSpent.empty() && tx.HasCreateOrSendOp() && !tx.HasSpendOp()) {
+        CTxDestination sender;
+        if (ExtractDestination(vSpent[0].out.scriptPubKey, sender) && boost::get<CKeyID>(&sender)) {
+            CScript senderScript = GetScriptForDestination(sender);
+            if (senderScript != vSpent[0].out.scriptPubKey) {
+                const uint256 scriptHash = GetScriptHash(senderScript);
+                for (size_t k = 0; k < tx.vout.size(); k++) {
+                    const CScript& script = tx.vout[k].scriptPubKey;
+                    if (script.HasCreateContractOp() || script.HasSendToContractOp())
+                        vHistory.emplace_back(CAddressIndexKey(scriptHash, nHeight, nTxIndex, txid, k, false), 0);
+                }
+            }
+        }
+    }
+
+    for (size_t k = 0; k < tx.vout.size(); k++) {
+        const CTxOut& out = tx.vout[k];
+        if (out.IsEmpty() || out.scriptPubKey.IsUnspendable())
+            continue;
+        const uint256 scriptHash = GetScriptHash(out.scriptPubKey);
+        vHistory.emplace_back(CAddressIndexKey(scriptHash, nHeight, nTxIndex, txid, k, false), out.nValue);
+        vUnspent.emplace_back(CAddressUnspentKey(scriptHash, COutPoint(txid, k)),
+                              fConnect ? CAddressUnspentValue(out.nValue, out.scriptPubKey, nHeight, tx.IsCoinBase()) : CAddressUnspentValue());
+    }
+}
+
+/** Undo the -addressindex entries of a block; done apart from DisconnectBlock like the contract registry */
+static bool DisconnectAddressIndex(const CBlock& block, const CBlockIndex* pindex)
+{
+    CBlockUndo blockUndo;
+    if (!UndoReadFromDisk(blockUndo, pindex->GetUndoPos(), pindex->pprev->GetBlockHash()))
+        return error("%s: failure reading undo data", __func__);
+    if (blockUndo.vtxundo.size() + 1 != block.vtx.size())
+        return error("%s: block and undo data inconsistent", __func__);
+
+    std::vector<std::pair<CAddressIndexKey, CAmount>> vHistory;
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue>> vUnspent;
+    // In reverse, so outputs spent within the block end up erased
+    for (size_t i = block.vtx.size(); i-- > 0;) {
+        const std::vector<Coin> vNoSpent;
+        GetAddressIndexEntries(*block.vtx[i], i > 0 ? blockUndo.vtxundo[i - 1].vprevout : vNoSpent, pindex->nHeight, i, false, vHistory, vUnspent);
+    }
+    return pblocktree->EraseAddressIndex(vHistory, vUnspent);
+}
+
 /** Undo the effects of this block (with given index) on the UTXO set represented by coins.
  *  When FAILED is returned, view is left in an indeterminate state. */
 static DisconnectResult DisconnectBlock(const CBlock& block, const CBlockIndex* pindex, CCoinsViewCache& view)
@@ -1750,6 +1859,11 @@ void ThreadScriptCheck() {
     scriptcheckqueue.Thread();
 }
 
+void ThreadCoinsPrefetch() {
+    RenameThread("bitcoin-prefetch");
+    pcoinsprefetch->Thread();
+}
+
 // Protected by cs_main
 VersionBitsCache versionbitscache;
 
@@ -1799,7 +1913,7 @@ public:
 // Protected by cs_main
 static ThresholdConditionCache warningcache[VERSIONBITS_NUM_BITS];
 
-static unsigned int GetBlockScriptFlags(const CBlockIndex* pindex, const Consensus::Params& consensusparams) {
+unsigned int GetBlockScriptFlags(const CBlockIndex* pindex, const Consensus::Params& consensusparams) {
     AssertLockHeld(cs_main);
 
     // BIP16 didn't become active until Apr 1 2012
@@ -1851,9 +1965,12 @@ static int64_t nTimeTotal = 0;
 
 /** Apply the effects of this block (with given index) on the UTXO set represented by coins.
  *  Validity checks that depend on the UTXO set are also done; ConnectBlock()
- *  can fail if those validity checks fail (among other reasons). */
+ *  can fail if those validity checks fail (among other reasons).
+ *  If pvReceipts is given, the execution results of the block's contract
+ *  transactions are appended to it. */
 static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pindex,
-                  CCoinsViewCache& view, const CChainParams& chainparams, bool fJustCheck = false)
+                  CCoinsViewCache& view, const CChainParams& chainparams, bool fJustCheck = false,
+                  std::vector<TxExecRecordInfo>* pvReceipts = nullptr)
 {
     AssertLockHeld(cs_main);
     assert(pindex);
@@ -1971,6 +2088,10 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
     int64_t nTime2 = GetTimeMicros(); nTimeForks += nTime2 - nTime1;
     LogPrint(BCLog::BENCH, "    - Fork checks: %.2fms [%.2fs]\n", 0.001 * (nTime2 - nTime1), nTimeForks * 0.000001);
 
+    // Read the block's inputs that are not cached yet in one go, rather than
+    // one database lookup at a time from HaveInputs below.
+    view.FetchInputs(block.vtx);
+
     CBlockUndo blockundo;
 
     CCheckQueueControl<CScriptCheck> control(fScriptChecks && nScriptCheckThreads ? &scriptcheckqueue : nullptr);
@@ -1984,8 +2105,24 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
     vPos.reserve(block.vtx.size());
     blockundo.vtxundo.reserve(block.vtx.size() - 1);
     std::map<dev::Address, std::pair<CHeightTxIndexKey, std::vector<uint256>>> heightIndexes;
-    std::vector<PrecomputedTransactionData> txdata;
-    txdata.reserve(block.vtx.size()); // Required so that pointers to individual PrecomputedTransactionData don't get invalidated
+    std::vector<ContractInfo> vContracts;
+    std::vector<uint160> vDestroyedContracts;
+    std::vector<std::pair<CAddressIndexKey, CAmount>> vAddressHistory;
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue>> vAddressUnspent;
+    // Transactions from our mempool bring the signature hash data computed on
+    // acceptance, and need no script checks if verified with this block's flags
+    std::vector<std::shared_ptr<const PrecomputedTransactionData>> txdata(block.vtx.size());
+    std::vector<bool> vScriptsChecked(block.vtx.size());
+    {
+        LOCK(mempool.cs);
+        for (unsigned int i = 1; i < block.vtx.size(); i++) {
+            CTxMemPool::txiter it = mempool.mapTx.find(block.vtx[i]->GetHash());
+            if (it != mempool.mapTx.end() && it->GetTxData() && it->GetTx().GetWitnessHash() == block.vtx[i]->GetWitnessHash()) {
+                txdata[i] = it->GetTxData();
+                vScriptsChecked[i] = it->ScriptsCheckedWith(flags);
+            }
+        }
+    }
 
     uint64_t blockGasUsed = 0;
     CAmount gasRefunds = 0;
@@ -2024,7 +2161,8 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
             return state.DoS(100, error("ConnectBlock(): too many sigops"),
                              REJECT_INVALID, "bad-blk-sigops");
 
-        txdata.emplace_back(tx);
+        if (!txdata[i])
+            txdata[i] = std::make_shared<PrecomputedTransactionData>(tx);
 
         const bool hasCreateOrSendOp = tx.HasCreateOrSendOp();
         const bool hasSpendOp = tx.HasSpendOp();
@@ -2034,7 +2172,7 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
 
             std::vector<CScriptCheck> vChecks;
             bool fCacheResults = fJustCheck; /* Don't cache results if we're actually connecting blocks (still consult the cache, though) */
-            if (!CheckInputs(tx, state, view, fScriptChecks, flags, fCacheResults, fCacheResults, txdata[i], (hasCreateOrSendOp || hasSpendOp) ? NULL : (nScriptCheckThreads ? &vChecks : NULL)))
+            if (!CheckInputs(tx, state, view, fScriptChecks && !vScriptsChecked[i], flags, fCacheResults, fCacheResults, *txdata[i], (hasCreateOrSendOp || hasSpendOp) ? NULL : (nScriptCheckThreads ? &vChecks : NULL)))
                 return error("ConnectBlock(): CheckInputs on %s failed with %s",
                     tx.GetHash().ToString(), FormatStateMessage(state));
             control.Add(vChecks);
@@ -2130,17 +2268,17 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
                 }
 
                 countCumulativeGasUsed += exeResult.totalGasUsed;
-                std::vector<TxExecRecordInfo> recordInfo;
-                if (fLogEvents) 
-				{
+                if (fLogEvents || pvReceipts) {
+                    std::vector<TxExecRecordInfo> recordInfo;
                     for (size_t k = 0; k < ethTxs.size(); k++) {
-					dev::Address key = ethExeResult[k].execRes.newAddress;
-                    	if(!heightIndexes.count(key))
-						{
-                        	heightIndexes[key].first = CHeightTxIndexKey(pindex->nHeight, ethExeResult[k].execRes.newAddress);
-                    	}
- 						heightIndexes[key].second.push_back(tx.GetHash());
-						
+                        if (fLogEvents) {
+                            dev::Address key = ethExeResult[k].execRes.newAddress;
+                            if (!heightIndexes.count(key)) {
+                                heightIndexes[key].first = CHeightTxIndexKey(pindex->nHeight, ethExeResult[k].execRes.newAddress);
+                            }
+                            heightIndexes[key].second.push_back(tx.GetHash());
+                        }
+
                         recordInfo.push_back(TxExecRecordInfo{
                             block.GetHash(),
                             uint32_t(pindex->nHeight),
@@ -2156,7 +2294,12 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
                         });
                     }
 
-                    TxExecRecord::Instance()->Add(uintToh256(tx.GetHash()), recordInfo);
+                    if (pvReceipts) {
+                        pvReceipts->insert(pvReceipts->end(), recordInfo.begin(), recordInfo.end());
+                    }
+                    if (fLogEvents) {
+                        TxExecRecord::Instance()->Add(uintToh256(tx.GetHash()), recordInfo);
+                    }
                 }
 
                 blockGasUsed += exeResult.totalGasUsed;
@@ -2174,14 +2317,47 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
                     VMLog::Write(ethExeResult, tx, block);
                 }
 
-                for (const EthExecutionResult& r : ethExeResult) {
+                for (size_t k = 0; k < ethExeResult.size(); k++) {
+                    const EthExecutionResult& r = ethExeResult[k];
                     if (r.execRes.newAddress != dev::Address() && !fJustCheck) {
                         LogPrintf("ConnectBlock(): txindex=%d, contract=%s\n", i, r.execRes.newAddress.hex());
+                        if (r.execRes.excepted == dev::eth::TransactionException::None) {
+                            ContractInfo info;
+                            info.txid = tx.GetHash();
+                            info.nHeight = pindex->nHeight;
+                            if (ethTxs[k].isCreation()) {
+                                info.address = uint160(r.execRes.newAddress.asBytes());
+                                info.creator = uint160(ethTxs[k].from().asBytes());
+                                info.codeHash = h256Touint(EthState::Instance()->codeHash(r.execRes.newAddress));
+                                vContracts.push_back(info);
+                            }
+                            // Contracts created by the contract the transaction created or called
+                            for (const dev::Address& address : r.createdContracts) {
+                                info.address = uint160(address.asBytes());
+                                info.creator = uint160(r.execRes.newAddress.asBytes());
+                                info.codeHash = h256Touint(EthState::Instance()->codeHash(address));
+                                vContracts.push_back(info);
+                            }
+                            for (const dev::Address& address : r.destroyedContracts) {
+                                vDestroyedContracts.push_back(uint160(address.asBytes()));
+                            }
+                        }
                     }
                 }
             }
         }
 
+        if (fAddressIndex && !fJustCheck) {
+            std::vector<Coin> vSpent;
+            if (!tx.IsCoinBase()) {
+                vSpent.reserve(tx.vin.size());
+                for (const CTxIn& txin : tx.vin) {
+                    vSpent.push_back(view.AccessCoin(txin.prevout));
+                }
+            }
+            GetAddressIndexEntries(tx, vSpent, pindex->nHeight, i, true, vAddressHistory, vAddressUnspent);
+        }
+
         CTxUndo undoDummy;
         if (i > 0) {
             blockundo.vtxundo.push_back(CTxUndo());
@@ -2291,9 +2467,14 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
         }
     }
 	
-    if (fTxIndex)
+    if (fAddressIndex) {
+        // The transaction index goes in the same batch
+        if (!pblocktree->WriteAddressIndex(vAddressHistory, vAddressUnspent, fTxIndex ? vPos : std::vector<std::pair<uint256, CDiskTxPos>>()))
+            return AbortNode(state, "Failed to write address index");
+    } else if (fTxIndex) {
         if (!pblocktree->WriteTxIndex(vPos))
             return AbortNode(state, "Failed to write transaction index");
+    }
 
     // add this block to the view's block chain
     view.SetBestBlock(pindex->GetBlockHash());
@@ -2303,6 +2484,9 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
         StateRootView::Instance()->SetRoot(pindex->GetBlockHash(), EthState::Instance()->rootHash(), EthState::Instance()->rootHashUTXO());
     }
 
+    if (!ContractRegistry::Instance()->Add(pindex->nHeight, vContracts, vDestroyedContracts))
+        return AbortNode(state, "Failed to write contract registry");
+
     int64_t nTime5 = GetTimeMicros(); nTimeIndex += nTime5 - nTime4;
     LogPrint(BCLog::BENCH, "    - Index writing: %.2fms [%.2fs]\n", 0.001 * (nTime5 - nTime4), nTimeIndex * 0.000001);
 
@@ -2414,8 +2598,15 @@ bool static FlushStateToDisk(const CChainParams& chainparams, CValidationState &
             if (!CheckDiskSpace(48 * 2 * 2 * pcoinsTip->GetCacheSize()))
                 return state.Error("out of disk space");
             // Flush the chainstate (which may refer to block index entries).
-            if (!pcoinsTip->Flush())
+            // The cache keeps its unspent entries, so that validation does
+            // not restart from a cold cache; only when it is running out of
+            // space are some of them evicted.
+            if (!pcoinsTip->Sync())
                 return AbortNode(state, "Failed to write to coin database");
+            if (fCacheLarge || fCacheCritical) {
+                size_t nEvicted = pcoinsTip->Trim(nTotalSpace / 100 * COINS_CACHE_TRIM_PERCENT);
+                LogPrint(BCLog::COINDB, "Evicted %u coins from the cache, %.1f MiB left\n", (unsigned int)nEvicted, pcoinsTip->DynamicMemoryUsage() * (1.0 / 1048576.0));
+            }
             nLastFlush = nNow;
         }
     }
@@ -2541,6 +2732,12 @@ bool static DisconnectTip(CValidationState& state, const CChainParams& chainpara
         bool flushed = view.Flush();
         assert(flushed);
     }
+    // Done here rather than in DisconnectBlock, which VerifyDB also uses to
+    // disconnect blocks in memory only.
+    if (!ContractRegistry::Instance()->Remove(pindexDelete->nHeight))
+        return AbortNode(state, "Failed to write contract registry");
+    if (fAddressIndex && !DisconnectAddressIndex(block, pindexDelete))
+        return AbortNode(state, "Failed to write address index");
     LogPrint(BCLog::BENCH, "- Disconnect block: %.2fms\n", (GetTimeMicros() - nStart) * 0.001);
     // Write the chain state to disk, if necessary.
     if (!FlushStateToDisk(chainparams, state, FLUSH_STATE_IF_NEEDED))
@@ -2577,6 +2774,7 @@ struct PerBlockConnectTrace {
     CBlockIndex* pindex = nullptr;
     std::shared_ptr<const CBlock> pblock;
     std::shared_ptr<std::vector<CTransactionRef>> conflictedTxs;
+    std::shared_ptr<std::vector<TxExecRecordInfo>> receipts;
     PerBlockConnectTrace() : conflictedTxs(std::make_shared<std::vector<CTransactionRef>>()) {}
 };
 /**
@@ -2609,12 +2807,14 @@ public:
         pool.NotifyEntryRemoved.disconnect(boost::bind(&ConnectTrace::NotifyEntryRemoved, this, _1, _2));
     }
 
-    void BlockConnected(CBlockIndex* pindex, std::shared_ptr<const CBlock> pblock) {
+    void BlockConnected(CBlockIndex* pindex, std::shared_ptr<const CBlock> pblock, std::shared_ptr<std::vector<TxExecRecordInfo>> receipts) {
         assert(!blocksConnected.back().pindex);
         assert(pindex);
         assert(pblock);
+        assert(receipts);
         blocksConnected.back().pindex = pindex;
         blocksConnected.back().pblock = std::move(pblock);
+        blocksConnected.back().receipts = std::move(receipts);
         blocksConnected.emplace_back();
     }
 
@@ -2663,13 +2863,14 @@ bool static ConnectTip(CValidationState& state, const CChainParams& chainparams,
     int64_t nTime2 = GetTimeMicros(); nTimeReadFromDisk += nTime2 - nTime1;
     int64_t nTime3;
     LogPrint(BCLog::BENCH, "  - Load block from disk: %.2fms [%.2fs]\n", (nTime2 - nTime1) * 0.001, nTimeReadFromDisk * 0.000001);
+    std::shared_ptr<std::vector<TxExecRecordInfo>> receipts = std::make_shared<std::vector<TxExecRecordInfo>>();
     {
         CCoinsViewCache view(pcoinsTip);
 
         const dev::h256 oldHashStateRoot(EthState::Instance()->rootHash());
         const dev::h256 oldHashUTXORoot(EthState::Instance()->rootHashUTXO());
 
-        bool rv = ConnectBlock(blockConnecting, state, pindexNew, view, chainparams);
+        bool rv = ConnectBlock(blockConnecting, state, pindexNew, view, chainparams, false, receipts.get());
         GetMainSignals().BlockChecked(blockConnecting, state);
         if (!rv) {
             if (state.IsInvalid())
@@ -2703,7 +2904,7 @@ bool static ConnectTip(CValidationState& state, const CChainParams& chainparams,
     LogPrint(BCLog::BENCH, "  - Connect postprocess: %.2fms [%.2fs]\n", (nTime6 - nTime5) * 0.001, nTimePostConnect * 0.000001);
     LogPrint(BCLog::BENCH, "- Connect block: %.2fms [%.2fs]\n", (nTime6 - nTime1) * 0.001, nTimeTotal * 0.000001);
 
-    connectTrace.BlockConnected(pindexNew, std::move(pthisBlock));
+    connectTrace.BlockConnected(pindexNew, std::move(pthisBlock), std::move(receipts));
     return true;
 }
 
@@ -2933,6 +3134,7 @@ bool ActivateBestChain(CValidationState &state, const CChainParams& chainparams,
             for (const PerBlockConnectTrace& trace : connectTrace.GetBlocksConnected()) {
                 assert(trace.pblock && trace.pindex);
                 GetMainSignals().BlockConnected(trace.pblock, trace.pindex, *trace.conflictedTxs);
+                GetMainSignals().ContractReceiptsConnected(trace.pindex, *trace.receipts);
             }
         }
         // When we reach this point, we switched to a new tip (stored in pindexNewTip).
@@ -3791,6 +3993,11 @@ bool ProcessNewBlock(const CChainParams& chainparams, const std::shared_ptr<cons
         // belt-and-suspenders.
         bool ret = CheckBlock(*pblock, state, chainparams.GetConsensus());
 
+        // Warm the coins cache with the block's inputs while earlier blocks
+        // are being connected.
+        if (ret && pcoinsprefetch)
+            pcoinsprefetch->Prefetch(pblock);
+
         LOCK(cs_main);
 
         if (ret) {
@@ -3844,6 +4051,58 @@ bool TestBlockValidity(CValidationState& state, const CChainParams& chainparams,
     return true;
 }
 
+bool PredictContractTransactions(const CBlockHeader& header, const std::vector<CTransactionRef>& vtx, std::vector<CTransactionRef>& vtxPredicted)
+{
+    AssertLockHeld(cs_main);
+    if (vtx.empty() || !vtx[0] || header.hashPrevBlock != chainActive.Tip()->GetBlockHash())
+        return false;
+
+    // The executor looks at the block for its environment and for outputs
+    // spent within it, so give it the transactions known so far
+    CBlock block(header);
+    for (const CTransactionRef& ptx : vtx) {
+        if (ptx)
+            block.vtx.push_back(ptx);
+    }
+
+    const int nHeight = chainActive.Height() + 1;
+    const uint64_t blockGasLimit = DEFAULT_BLOCK_GAS_LIMIT;
+    uint64_t blockGasUsed = 0;
+    CCoinsViewCache view(pcoinsTip);
+    const dev::h256 oldHashStateRoot(EthState::Instance()->rootHash());
+    const dev::h256 oldHashUTXORoot(EthState::Instance()->rootHashUTXO());
+    try {
+        for (const CTransactionRef& ptx : vtx) {
+            // Transactions after a missing one may spend its outputs or depend
+            // on its contract state; those predictions just won't match
+            if (!ptx || (!ptx->IsCoinBase() && !view.HaveInputs(*ptx)))
+                continue;
+            const CTransaction& tx = *ptx;
+            if (tx.HasCreateOrSendOp() && !tx.HasSpendOp() && CheckSenderScript(view, tx)) {
+                EthTxConverter converter(tx, &view, &block.vtx);
+                std::vector<EthTransaction> ethTxs;
+                if (converter.Convert(ethTxs)) {
+                    ContractExecutor executor(block, ethTxs, blockGasLimit);
+                    ExecutionResult exeResult;
+                    if (!executor.Execut() || !executor.GetResult(exeResult))
+                        break;
+                    blockGasUsed += exeResult.totalGasUsed;
+                    if (blockGasUsed > blockGasLimit)
+                        break;
+                    for (const CTransaction& t : exeResult.transferTxs)
+                        vtxPredicted.push_back(MakeTransactionRef(t));
+                }
+            }
+            UpdateCoins(tx, view, nHeight);
+        }
+    } catch (const std::exception& e) {
+        LogPrint(BCLog::CMPCTBLOCK, "%s: contract execution for block %s failed: %s\n", __func__, header.GetHash().ToString(), e.what());
+    }
+    EthState::Instance()->setRoot(oldHashStateRoot);
+    EthState::Instance()->setUTXORoot(oldHashUTXORoot);
+    return true;
+}
+
 /**
  * BLOCK PRUNING CODE
  */
@@ -4159,6 +4418,10 @@ bool static LoadBlockIndexDB(const CChainParams& chainparams)
     pblocktree->ReadFlag("txindex", fTxIndex);
     LogPrintf("%s: transaction index %s\n", __func__, fTxIndex ? "enabled" : "disabled");
 
+    // Check whether we have an address index
+    pblocktree->ReadFlag("addressindex", fAddressIndex);
+    LogPrintf("%s: address index %s\n", __func__, fAddressIndex ? "enabled" : "disabled");
+
     // Check whether we have a transaction index
     pblocktree->ReadFlag("logevents", fLogEvents);
     LogPrintf("%s: log events index %s\n", __func__, fLogEvents ? "enabled" : "disabled");
@@ -4547,6 +4810,10 @@ bool LoadBlockIndex(const CChainParams& chainparams)
         fTxIndex = gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX);
         pblocktree->WriteFlag("txindex", fTxIndex);
 
+        // Use the provided setting for -addressindex in the new database
+        fAddressIndex = gArgs.GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX);
+        pblocktree->WriteFlag("addressindex", fAddressIndex);
+
         // Use the provided setting for -logevents in the new database
         fLogEvents = gArgs.GetBoolArg("-logevents", DEFAULT_LOGEVENTS);
         pblocktree->WriteFlag("logevents", fLogEvents);
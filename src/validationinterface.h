@@ -20,6 +20,7 @@ class CValidationInterface;
 class CValidationState;
 class uint256;
 class CScheduler;
+struct TxExecRecordInfo;
 
 // These functions dispatch to one or all registered wallets
 
@@ -41,6 +42,12 @@ protected:
      * Provides a vector of transactions evicted from the mempool as a result.
      */
     virtual void BlockConnected(const std::shared_ptr<const CBlock> &block, const CBlockIndex *pindex, const std::vector<CTransactionRef> &txnConflicted) {}
+    /**
+     * Notifies listeners of the contract execution results of a block being
+     * connected, right after its BlockConnected. Called for every block, with
+     * an empty vector for blocks without contract transactions.
+     */
+    virtual void ContractReceiptsConnected(const CBlockIndex *pindex, const std::vector<TxExecRecordInfo> &receipts) {}
     /** Notifies listeners of a block being disconnected */
     virtual void BlockDisconnected(const std::shared_ptr<const CBlock> &block) {}
     /** Notifies listeners of the new active block chain on-disk. */
@@ -85,6 +92,7 @@ public:
     void UpdatedBlockTip(const CBlockIndex *, const CBlockIndex *, bool fInitialDownload);
     void TransactionAddedToMempool(const CTransactionRef &);
     void BlockConnected(const std::shared_ptr<const CBlock> &, const CBlockIndex *pindex, const std::vector<CTransactionRef> &);
+    void ContractReceiptsConnected(const CBlockIndex *, const std::vector<TxExecRecordInfo> &);
     void BlockDisconnected(const std::shared_ptr<const CBlock> &);
     void SetBestChain(const CBlockLocator &);
     void Inventory(const uint256 &);
@@ -393,7 +393,7 @@ void CDBEnv::CheckpointLSN(const std::string& strFile)
 }
 
 
-CDB::CDB(CWalletDBWrapper& dbw, const char* pszMode, bool fFlushOnCloseIn) : pdb(nullptr), activeTxn(nullptr)
+CDB::CDB(CWalletDBWrapper& dbw, const char* pszMode, bool fFlushOnCloseIn) : pdb(nullptr), activeTxn(nullptr), plog(nullptr), fLogTxn(false)
 {
     fReadOnly = (!strchr(pszMode, '+') && !strchr(pszMode, 'w'));
     fFlushOnClose = fFlushOnCloseIn;
@@ -404,6 +404,17 @@ CDB::CDB(CWalletDBWrapper& dbw, const char* pszMode, bool fFlushOnCloseIn) : pdb
     const std::string &strFilename = dbw.strFile;
 
     bool fCreate = strchr(pszMode, 'c') != nullptr;
+    if (dbw.logstore) {
+        plog = dbw.logstore.get();
+        strFile = strFilename;
+        if (fCreate && !Exists(std::string("version"))) {
+            bool fTmp = fReadOnly;
+            fReadOnly = false;
+            WriteVersion(CLIENT_VERSION);
+            fReadOnly = fTmp;
+        }
+        return;
+    }
     unsigned int nFlags = DB_THREAD;
     if (fCreate)
         nFlags |= DB_CREATE;
@@ -474,6 +485,15 @@ void CWalletDBWrapper::IncrementUpdateCounter()
 
 void CDB::Close()
 {
+    if (plog) {
+        vLogTxn.clear();
+        fLogTxn = false;
+        // Batches are already in the file; make them survive a crash too
+        if (fFlushOnClose && !fReadOnly)
+            plog->Flush(true);
+        plog = nullptr;
+        return;
+    }
     if (!pdb)
         return;
     if (activeTxn)
@@ -506,6 +526,9 @@ void CDBEnv::CloseDb(const std::string& strFile)
 
 bool CDB::Rewrite(CWalletDBWrapper& dbw, const char* pszSkip)
 {
+    if (dbw.logstore) {
+        return dbw.logstore->Compact(pszSkip);
+    }
     if (dbw.IsDummy()) {
         return true;
     }
@@ -538,7 +561,7 @@ bool CDB::Rewrite(CWalletDBWrapper& dbw, const char* pszSkip)
                         fSuccess = false;
                     }
 
-                    Dbc* pcursor = db.GetCursor();
+                    CDBCursor* pcursor = db.GetCursor();
                     if (pcursor)
                         while (fSuccess) {
                             CDataStream ssKey(SER_DISK, CLIENT_VERSION);
@@ -637,6 +660,16 @@ void CDBEnv::Flush(bool fShutdown)
 
 bool CDB::PeriodicFlush(CWalletDBWrapper& dbw)
 {
+    if (dbw.logstore) {
+        // Sync everything appended since the last flush in one go
+        int64_t nStart = GetTimeMillis();
+        if (!dbw.logstore->Flush(true))
+            return false;
+        if (dbw.logstore->NeedsCompaction() && !dbw.logstore->Compact())
+            LogPrintf("Compacting %s failed\n", dbw.strFile);
+        LogPrint(BCLog::DB, "Flushed %s %dms\n", dbw.strFile, GetTimeMillis() - nStart);
+        return true;
+    }
     if (dbw.IsDummy()) {
         return true;
     }
@@ -685,6 +718,12 @@ bool CWalletDBWrapper::Rewrite(const char* pszSkip)
 
 bool CWalletDBWrapper::Backup(const std::string& strDest)
 {
+    if (logstore) {
+        fs::path pathDest(strDest);
+        if (fs::is_directory(pathDest))
+            pathDest /= strFile;
+        return logstore->Backup(pathDest);
+    }
     if (IsDummy()) {
         return false;
     }
@@ -727,7 +766,137 @@ bool CWalletDBWrapper::Backup(const std::string& strDest)
 
 void CWalletDBWrapper::Flush(bool shutdown)
 {
-    if (!IsDummy()) {
+    if (logstore) {
+        logstore->Flush(true);
+    } else if (!IsDummy()) {
         env->Flush(shutdown);
     }
 }
+
+std::unique_ptr<CWalletDBWrapper> CWalletDBWrapper::Open(const std::string& walletFile, std::string& strError)
+{
+    if (!IsWalletLogFile(walletFile)) {
+        return std::unique_ptr<CWalletDBWrapper>(new CWalletDBWrapper(&bitdb, walletFile));
+    }
+
+    fs::path path = GetDataDir() / walletFile;
+    std::string strSource = walletFile.substr(0, walletFile.size() - strlen(WALLET_LOG_SUFFIX)) + ".dat";
+    if (!fs::exists(path) && fs::exists(GetDataDir() / strSource)) {
+        // Fill a temporary log and move it in place once complete, so that an
+        // interrupted migration is simply started over
+        LogPrintf("Migrating wallet %s to %s\n", strSource, walletFile);
+        fs::path pathTmp = GetDataDir() / (walletFile + ".migrate");
+        fs::remove(pathTmp);
+        {
+            CWalletLogStore store(pathTmp);
+            if (!store.Open(strError))
+                return nullptr;
+            CWalletDBWrapper source(&bitdb, strSource);
+            if (!CDB::CopyToLogStore(source, store) || !store.Flush(true)) {
+                strError = strprintf(_("Error migrating wallet %s to %s"), strSource, walletFile);
+                return nullptr;
+            }
+            LogPrintf("Copied %u records from %s\n", store.Count(), strSource);
+        }
+        if (!RenameOver(pathTmp, path)) {
+            strError = strprintf(_("Error migrating wallet %s to %s"), strSource, walletFile);
+            return nullptr;
+        }
+    }
+
+    std::unique_ptr<CWalletLogStore> store(new CWalletLogStore(path));
+    if (!store->Open(strError))
+        return nullptr;
+    return std::unique_ptr<CWalletDBWrapper>(new CWalletDBWrapper(std::move(store), walletFile));
+}
+
+bool CDB::CopyToLogStore(CWalletDBWrapper& dbw, CWalletLogStore& store)
+{
+    std::vector<CWalletLogStore::Record> batch;
+    {
+        CDB db(dbw, "r");
+        CDBCursor* pcursor = db.GetCursor();
+        if (!pcursor)
+            return false;
+        while (true) {
+            CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+            CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+            int ret = db.ReadAtCursor(pcursor, ssKey, ssValue);
+            if (ret == DB_NOTFOUND)
+                break;
+            if (ret != 0) {
+                pcursor->close();
+                return false;
+            }
+            batch.emplace_back(CWalletLogStore::Data(ssKey.begin(), ssKey.end()), CWalletLogStore::Data(ssValue.begin(), ssValue.end()));
+        }
+        pcursor->close();
+    }
+    return store.Apply(batch);
+}
+
+bool CDB::LogRead(const CDataStream& ssKey, CDataStream& ssValue)
+{
+    CWalletLogStore::Data key(ssKey.begin(), ssKey.end());
+    // Writes of the open transaction come first, the last one wins
+    for (std::vector<CWalletLogStore::Record>::const_reverse_iterator it = vLogTxn.rbegin(); it != vLogTxn.rend(); ++it) {
+        if (it->key == key) {
+            if (it->fErase)
+                return false;
+            ssValue.write(it->value.data(), it->value.size());
+            return true;
+        }
+    }
+    CWalletLogStore::Data value;
+    if (!plog->Read(key, value))
+        return false;
+    ssValue.write(value.data(), value.size());
+    return true;
+}
+
+bool CDB::LogExists(const CDataStream& ssKey)
+{
+    CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+    return LogRead(ssKey, ssValue);
+}
+
+bool CDB::LogWrite(const CDataStream& ssKey, const CDataStream& ssValue, bool fOverwrite)
+{
+    if (!fOverwrite && LogExists(ssKey))
+        return false;
+    CWalletLogStore::Record record(CWalletLogStore::Data(ssKey.begin(), ssKey.end()), CWalletLogStore::Data(ssValue.begin(), ssValue.end()));
+    if (fLogTxn) {
+        vLogTxn.push_back(std::move(record));
+        return true;
+    }
+    return plog->Apply(std::vector<CWalletLogStore::Record>(1, record));
+}
+
+bool CDB::LogErase(const CDataStream& ssKey)
+{
+    CWalletLogStore::Record record((CWalletLogStore::Data(ssKey.begin(), ssKey.end())));
+    if (fLogTxn) {
+        vLogTxn.push_back(std::move(record));
+        return true;
+    }
+    return plog->Apply(std::vector<CWalletLogStore::Record>(1, record));
+}
+
+int CDB::LogReadAtCursor(CDBCursor* pcursor, CDataStream& ssKey, CDataStream& ssValue, bool setRange)
+{
+    bool fInclusive = setRange || !pcursor->fStarted;
+    if (setRange)
+        pcursor->key.assign(ssKey.begin(), ssKey.end());
+    CWalletLogStore::Data value;
+    if (!plog->Next(pcursor->key, value, fInclusive))
+        return DB_NOTFOUND;
+    pcursor->fStarted = true;
+
+    ssKey.SetType(SER_DISK);
+    ssKey.clear();
+    ssKey.write(pcursor->key.data(), pcursor->key.size());
+    ssValue.SetType(SER_DISK);
+    ssValue.clear();
+    ssValue.write(value.data(), value.size());
+    return 0;
+}
@@ -12,9 +12,11 @@
 #include "streams.h"
 #include "sync.h"
 #include "version.h"
+#include "wallet/logdb.h"
 
 #include <atomic>
 #include <map>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -88,7 +90,8 @@ public:
 extern CDBEnv bitdb;
 
 /** An instance of this class represents one database.
- * For BerkeleyDB this is just a (env, strFile) tuple.
+ * For BerkeleyDB this is just a (env, strFile) tuple, otherwise it owns
+ * the CWalletLogStore the wallet is kept in.
  **/
 class CWalletDBWrapper
 {
@@ -105,6 +108,18 @@ public:
     {
     }
 
+    /** Create DB handle to an opened wallet log store */
+    CWalletDBWrapper(std::unique_ptr<CWalletLogStore> logstore_in, const std::string &strFile_in) :
+        nUpdateCounter(0), nLastSeen(0), nLastFlushed(0), nLastWalletUpdate(0), env(nullptr), strFile(strFile_in), logstore(std::move(logstore_in))
+    {
+    }
+
+    /** Open the database for a -wallet file name. Names ending in
+     * WALLET_LOG_SUFFIX get a log store, which is filled from the
+     * BerkeleyDB wallet of the same name with a .dat suffix on first use.
+     */
+    static std::unique_ptr<CWalletDBWrapper> Open(const std::string& walletFile, std::string& strError);
+
     /** Rewrite the entire database on disk, with the exception of key pszSkip if non-zero
      */
     bool Rewrite(const char* pszSkip=nullptr);
@@ -133,11 +148,33 @@ private:
     CDBEnv *env;
     std::string strFile;
 
+    std::unique_ptr<CWalletLogStore> logstore;
+
     /** Return whether this database handle is a dummy for testing.
      * Only to be used at a low level, application should ideally not care
      * about this.
      */
-    bool IsDummy() { return env == nullptr; }
+    bool IsDummy() { return env == nullptr && !logstore; }
+};
+
+/** Database cursor, over either a Berkeley database or a log store */
+class CDBCursor
+{
+public:
+    Dbc* pcursor;
+    //! last key read from a log store
+    CWalletLogStore::Data key;
+    bool fStarted;
+
+    explicit CDBCursor(Dbc* pcursorIn) : pcursor(pcursorIn), fStarted(false) {}
+
+    /** Close and free the cursor, like Dbc::close */
+    void close()
+    {
+        if (pcursor)
+            pcursor->close();
+        delete this;
+    }
 };
 
 
@@ -152,6 +189,17 @@ protected:
     bool fFlushOnClose;
     CDBEnv *env;
 
+    /** Log store specific; writes of an open transaction are held in vLogTxn */
+    CWalletLogStore* plog;
+    bool fLogTxn;
+    std::vector<CWalletLogStore::Record> vLogTxn;
+
+    bool LogRead(const CDataStream& ssKey, CDataStream& ssValue);
+    bool LogWrite(const CDataStream& ssKey, const CDataStream& ssValue, bool fOverwrite);
+    bool LogErase(const CDataStream& ssKey);
+    bool LogExists(const CDataStream& ssKey);
+    int LogReadAtCursor(CDBCursor* pcursor, CDataStream& ssKey, CDataStream& ssValue, bool setRange);
+
 public:
     explicit CDB(CWalletDBWrapper& dbw, const char* pszMode = "r+", bool fFlushOnCloseIn=true);
     ~CDB() { Close(); }
@@ -167,6 +215,8 @@ public:
     static bool VerifyEnvironment(const std::string& walletFile, const fs::path& dataDir, std::string& errorStr);
     /* verifies the database file */
     static bool VerifyDatabaseFile(const std::string& walletFile, const fs::path& dataDir, std::string& warningStr, std::string& errorStr, CDBEnv::recoverFunc_type recoverFunc);
+    /* copies all records of a Berkeley database into a log store */
+    static bool CopyToLogStore(CWalletDBWrapper& dbw, CWalletLogStore& store);
 
 private:
     CDB(const CDB&);
@@ -176,13 +226,28 @@ public:
     template <typename K, typename T>
     bool Read(const K& key, T& value)
     {
-        if (!pdb)
+        if (!pdb && !plog)
             return false;
 
         // Key
         CDataStream ssKey(SER_DISK, CLIENT_VERSION);
         ssKey.reserve(1000);
         ssKey << key;
+
+        if (plog) {
+            CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+            bool success = LogRead(ssKey, ssValue);
+            memory_cleanse(ssKey.data(), ssKey.size());
+            if (success) {
+                try {
+                    ssValue >> value;
+                } catch (const std::exception&) {
+                    success = false;
+                }
+            }
+            return success;
+        }
+
         Dbt datKey(ssKey.data(), ssKey.size());
 
         // Read
@@ -211,7 +276,7 @@ public:
     template <typename K, typename T>
     bool Write(const K& key, const T& value, bool fOverwrite = true)
     {
-        if (!pdb)
+        if (!pdb && !plog)
             return true;
         if (fReadOnly)
             assert(!"Write called on database in read-only mode");
@@ -226,6 +291,14 @@ public:
         CDataStream ssValue(SER_DISK, CLIENT_VERSION);
         ssValue.reserve(10000);
         ssValue << value;
+
+        if (plog) {
+            bool success = LogWrite(ssKey, ssValue, fOverwrite);
+            memory_cleanse(ssKey.data(), ssKey.size());
+            memory_cleanse(ssValue.data(), ssValue.size());
+            return success;
+        }
+
         Dbt datValue(ssValue.data(), ssValue.size());
 
         // Write
@@ -240,7 +313,7 @@ public:
     template <typename K>
     bool Erase(const K& key)
     {
-        if (!pdb)
+        if (!pdb && !plog)
             return false;
         if (fReadOnly)
             assert(!"Erase called on database in read-only mode");
@@ -249,6 +322,12 @@ public:
         CDataStream ssKey(SER_DISK, CLIENT_VERSION);
         ssKey.reserve(1000);
         ssKey << key;
+
+        if (plog) {
+            bool success = LogErase(ssKey);
+            memory_cleanse(ssKey.data(), ssKey.size());
+            return success;
+        }
         Dbt datKey(ssKey.data(), ssKey.size());
 
         // Erase
@@ -262,13 +341,19 @@ public:
     template <typename K>
     bool Exists(const K& key)
     {
-        if (!pdb)
+        if (!pdb && !plog)
             return false;
 
         // Key
         CDataStream ssKey(SER_DISK, CLIENT_VERSION);
         ssKey.reserve(1000);
         ssKey << key;
+
+        if (plog) {
+            bool success = LogExists(ssKey);
+            memory_cleanse(ssKey.data(), ssKey.size());
+            return success;
+        }
         Dbt datKey(ssKey.data(), ssKey.size());
 
         // Exists
@@ -279,19 +364,24 @@ public:
         return (ret == 0);
     }
 
-    Dbc* GetCursor()
+    CDBCursor* GetCursor()
     {
+        if (plog)
+            return new CDBCursor(nullptr);
         if (!pdb)
             return nullptr;
         Dbc* pcursor = nullptr;
         int ret = pdb->cursor(nullptr, &pcursor, 0);
         if (ret != 0)
             return nullptr;
-        return pcursor;
+        return new CDBCursor(pcursor);
     }
 
-    int ReadAtCursor(Dbc* pcursor, CDataStream& ssKey, CDataStream& ssValue, bool setRange = false)
+    int ReadAtCursor(CDBCursor* pcursor, CDataStream& ssKey, CDataStream& ssValue, bool setRange = false)
     {
+        if (plog)
+            return LogReadAtCursor(pcursor, ssKey, ssValue, setRange);
+
         // Read at cursor
         Dbt datKey;
         unsigned int fFlags = DB_NEXT;
@@ -303,7 +393,7 @@ public:
         Dbt datValue;
         datKey.set_flags(DB_DBT_MALLOC);
         datValue.set_flags(DB_DBT_MALLOC);
-        int ret = pcursor->get(&datKey, &datValue, fFlags);
+        int ret = pcursor->pcursor->get(&datKey, &datValue, fFlags);
         if (ret != 0)
             return ret;
         else if (datKey.get_data() == nullptr || datValue.get_data() == nullptr)
@@ -328,6 +418,12 @@ public:
 public:
     bool TxnBegin()
     {
+        if (plog) {
+            if (fLogTxn)
+                return false;
+            fLogTxn = true;
+            return true;
+        }
         if (!pdb || activeTxn)
             return false;
         DbTxn* ptxn = bitdb.TxnBegin();
@@ -339,6 +435,14 @@ public:
 
     bool TxnCommit()
     {
+        if (plog) {
+            if (!fLogTxn)
+                return false;
+            bool ret = plog->Apply(vLogTxn);
+            vLogTxn.clear();
+            fLogTxn = false;
+            return ret;
+        }
         if (!pdb || !activeTxn)
             return false;
         int ret = activeTxn->commit(0);
@@ -348,6 +452,13 @@ public:
 
     bool TxnAbort()
     {
+        if (plog) {
+            if (!fLogTxn)
+                return false;
+            vLogTxn.clear();
+            fLogTxn = false;
+            return true;
+        }
         if (!pdb || !activeTxn)
             return false;
         int ret = activeTxn->abort();
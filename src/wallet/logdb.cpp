@@ -0,0 +1,397 @@
+#include "wallet/logdb.h"
+
+#include "clientversion.h"
+#include "hash.h"
+#include "streams.h"
+#include "util.h"
+
+#include <string.h>
+
+static const char LOG_MAGIC[4] = {'w', 'l', 'o', 'g'};
+static const uint32_t LOG_VERSION = 1;
+
+static const unsigned char LOG_PUT = 'p';
+static const unsigned char LOG_ERASE = 'e';
+static const unsigned char LOG_COMMIT = 'c';
+
+bool IsWalletLogFile(const std::string& walletFile)
+{
+    const size_t nSuffix = strlen(WALLET_LOG_SUFFIX);
+    return walletFile.size() > nSuffix && walletFile.compare(walletFile.size() - nSuffix, nSuffix, WALLET_LOG_SUFFIX) == 0;
+}
+
+static void WriteData(CDataStream& ss, const CWalletLogStore::Data& data)
+{
+    WriteCompactSize(ss, data.size());
+    ss.write(data.data(), data.size());
+}
+
+static void ReadData(CDataStream& ss, CWalletLogStore::Data& data)
+{
+    data.resize(ReadCompactSize(ss));
+    ss.read(data.data(), data.size());
+}
+
+static void WriteHeader(CDataStream& ss)
+{
+    ss.write(LOG_MAGIC, sizeof(LOG_MAGIC));
+    ss << LOG_VERSION;
+}
+
+/** Serialize a batch followed by its commit record */
+static void WriteBatch(CDataStream& ss, const std::vector<CWalletLogStore::Record>& batch)
+{
+    const size_t nStart = ss.size();
+    for (const CWalletLogStore::Record& record : batch) {
+        if (record.fErase) {
+            ss << LOG_ERASE;
+            WriteData(ss, record.key);
+        } else {
+            ss << LOG_PUT;
+            WriteData(ss, record.key);
+            WriteData(ss, record.value);
+        }
+    }
+    uint256 hash = Hash(ss.begin() + nStart, ss.end());
+    ss << LOG_COMMIT << (uint32_t)batch.size() << hash;
+}
+
+bool CWalletLogStore::DataCompare::operator()(const Data& a, const Data& b) const
+{
+    int cmp = memcmp(a.data(), b.data(), std::min(a.size(), b.size()));
+    return cmp < 0 || (cmp == 0 && a.size() < b.size());
+}
+
+CWalletLogStore::CWalletLogStore(const fs::path& pathIn) : path(pathIn), file(nullptr), nLogSize(0), nSyncedSize(0), nLiveSize(0), fBroken(false)
+{
+}
+
+bool CWalletLogStore::OpenFile(const char* pszMode)
+{
+    file = fsbridge::fopen(path, pszMode);
+    if (!file)
+        return false;
+    // Batches are written in one call anyway; without a buffer a failed
+    // write leaves nothing behind that a later flush could still append
+    setvbuf(file, nullptr, _IONBF, 0);
+    return true;
+}
+
+CWalletLogStore::~CWalletLogStore()
+{
+    Close();
+}
+
+bool CWalletLogStore::Open(std::string& strError)
+{
+    LOCK(cs);
+    assert(!file);
+    mapRecords.clear();
+    nLiveSize = 0;
+    fBroken = false;
+
+    if (OpenFile("r+b")) {
+        if (!Replay(strError)) {
+            Close();
+            return false;
+        }
+    } else {
+        if (!OpenFile("w+b")) {
+            strError = strprintf("Unable to create wallet log %s", path.string());
+            return false;
+        }
+        CDataStream ss(SER_DISK, CLIENT_VERSION);
+        WriteHeader(ss);
+        if (fwrite(ss.data(), 1, ss.size(), file) != ss.size() || fflush(file) != 0) {
+            strError = strprintf("Unable to write wallet log %s", path.string());
+            Close();
+            return false;
+        }
+        FileCommit(file);
+        nLogSize = ss.size();
+    }
+    // Whatever an earlier run left behind is taken as synced
+    nSyncedSize = nLogSize;
+    return true;
+}
+
+bool CWalletLogStore::Replay(std::string& strError)
+{
+    if (fseek(file, 0, SEEK_END) != 0) {
+        strError = strprintf("Unable to read wallet log %s", path.string());
+        return false;
+    }
+    long nFileSize = ftell(file);
+    CSerializeData buf(std::max(0L, nFileSize));
+    rewind(file);
+    if (nFileSize < 0 || fread(buf.data(), 1, buf.size(), file) != buf.size()) {
+        strError = strprintf("Unable to read wallet log %s", path.string());
+        return false;
+    }
+
+    CDataStream ss(buf.begin(), buf.end(), SER_DISK, CLIENT_VERSION);
+    try {
+        char magic[sizeof(LOG_MAGIC)];
+        uint32_t nVersion;
+        ss.read(magic, sizeof(magic));
+        ss >> nVersion;
+        if (memcmp(magic, LOG_MAGIC, sizeof(magic)) != 0 || nVersion > LOG_VERSION) {
+            strError = strprintf("%s is not a wallet log this version can read", path.string());
+            return false;
+        }
+    } catch (const std::exception&) {
+        strError = strprintf("%s is not a wallet log", path.string());
+        return false;
+    }
+
+    // Committed batches are applied; whatever follows the last one is an
+    // interrupted write and gets cut off
+    size_t nCommitted = buf.size() - ss.size();
+    std::vector<Record> batch;
+    try {
+        const char* pBatch = ss.data();
+        while (!ss.empty()) {
+            const char* pRecord = ss.data();
+            unsigned char nType;
+            ss >> nType;
+            if (nType == LOG_PUT) {
+                batch.emplace_back(Data(), Data());
+                ReadData(ss, batch.back().key);
+                ReadData(ss, batch.back().value);
+            } else if (nType == LOG_ERASE) {
+                batch.emplace_back(Data());
+                ReadData(ss, batch.back().key);
+            } else if (nType == LOG_COMMIT) {
+                uint256 hashBatch = Hash(pBatch, pRecord);
+                uint32_t nRecords;
+                uint256 hash;
+                ss >> nRecords >> hash;
+                if (nRecords != batch.size() || hash != hashBatch)
+                    break;
+                for (const Record& record : batch)
+                    ApplyRecord(record);
+                batch.clear();
+                nCommitted = buf.size() - ss.size();
+                pBatch = ss.data();
+            } else {
+                break;
+            }
+        }
+    } catch (const std::exception&) {
+        // Truncated record
+    }
+
+    if (nCommitted < buf.size()) {
+        LogPrintf("%s: dropping %u bytes of uncommitted records from %s\n", __func__, buf.size() - nCommitted, path.string());
+        if (!TruncateFile(file, nCommitted)) {
+            strError = strprintf("Unable to truncate wallet log %s", path.string());
+            return false;
+        }
+    }
+    if (fseek(file, 0, SEEK_END) != 0) {
+        strError = strprintf("Unable to open wallet log %s for writing", path.string());
+        return false;
+    }
+    nLogSize = nCommitted;
+    return true;
+}
+
+void CWalletLogStore::Close()
+{
+    LOCK(cs);
+    if (file) {
+        fflush(file);
+        FileCommit(file);
+        nSyncedSize = nLogSize;
+        fclose(file);
+        file = nullptr;
+    }
+}
+
+void CWalletLogStore::ApplyRecord(const Record& record)
+{
+    std::map<Data, Data, DataCompare>::iterator it = mapRecords.find(record.key);
+    if (it != mapRecords.end()) {
+        nLiveSize -= it->first.size() + it->second.size();
+        if (record.fErase) {
+            mapRecords.erase(it);
+            return;
+        }
+        it->second = record.value;
+    } else {
+        if (record.fErase)
+            return;
+        mapRecords.emplace(record.key, record.value);
+    }
+    nLiveSize += record.key.size() + record.value.size();
+}
+
+bool CWalletLogStore::Read(const Data& key, Data& value) const
+{
+    LOCK(cs);
+    std::map<Data, Data, DataCompare>::const_iterator it = mapRecords.find(key);
+    if (it == mapRecords.end())
+        return false;
+    value = it->second;
+    return true;
+}
+
+bool CWalletLogStore::Exists(const Data& key) const
+{
+    LOCK(cs);
+    return mapRecords.count(key) > 0;
+}
+
+bool CWalletLogStore::Next(Data& key, Data& value, bool fInclusive) const
+{
+    LOCK(cs);
+    std::map<Data, Data, DataCompare>::const_iterator it = fInclusive ? mapRecords.lower_bound(key) : mapRecords.upper_bound(key);
+    if (it == mapRecords.end())
+        return false;
+    key = it->first;
+    value = it->second;
+    return true;
+}
+
+size_t CWalletLogStore::Count() const
+{
+    LOCK(cs);
+    return mapRecords.size();
+}
+
+bool CWalletLogStore::IsSynced() const
+{
+    LOCK(cs);
+    return nSyncedSize == nLogSize;
+}
+
+bool CWalletLogStore::Apply(const std::vector<Record>& batch)
+{
+    if (batch.empty())
+        return true;
+
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    WriteBatch(ss, batch);
+
+    LOCK(cs);
+    if (!file || fBroken)
+        return false;
+    if (fwrite(ss.data(), 1, ss.size(), file) != ss.size() || fflush(file) != 0) {
+        LogPrintf("%s: error writing to %s\n", __func__, path.string());
+        // Cut off whatever part of the batch made it, or the next open would
+        // stop there and drop every batch appended after it
+        clearerr(file);
+        if (!TruncateFile(file, nLogSize) || fseek(file, nLogSize, SEEK_SET) != 0) {
+            LogPrintf("%s: unable to cut off the partial write, refusing further writes to %s\n", __func__, path.string());
+            fBroken = true;
+        }
+        return false;
+    }
+    nLogSize += ss.size();
+    for (const Record& record : batch)
+        ApplyRecord(record);
+    return true;
+}
+
+bool CWalletLogStore::Flush(bool fSync)
+{
+    LOCK(cs);
+    if (!file)
+        return false;
+    if (fflush(file) != 0)
+        return false;
+    if (fSync) {
+        FileCommit(file);
+        nSyncedSize = nLogSize;
+    }
+    return true;
+}
+
+bool CWalletLogStore::NeedsCompaction() const
+{
+    LOCK(cs);
+    return nLogSize > WALLET_LOG_COMPACT_MIN && nLogSize > 2 * nLiveSize;
+}
+
+bool CWalletLogStore::Compact(const char* pszSkip)
+{
+    LOCK(cs);
+    if (!file)
+        return false;
+
+    std::vector<Record> batch;
+    batch.reserve(mapRecords.size());
+    const size_t nSkip = pszSkip ? strlen(pszSkip) : 0;
+    for (const std::pair<const Data, Data>& item : mapRecords) {
+        if (pszSkip && memcmp(item.first.data(), pszSkip, std::min(item.first.size(), nSkip)) == 0)
+            continue;
+        batch.emplace_back(item.first, item.second);
+    }
+
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    WriteHeader(ss);
+    WriteBatch(ss, batch);
+
+    fs::path pathTmp = path;
+    pathTmp += ".tmp";
+    FILE* fileTmp = fsbridge::fopen(pathTmp, "wb");
+    if (!fileTmp) {
+        LogPrintf("%s: unable to create %s\n", __func__, pathTmp.string());
+        return false;
+    }
+    bool fOk = fwrite(ss.data(), 1, ss.size(), fileTmp) == ss.size() && fflush(fileTmp) == 0;
+    if (fOk)
+        FileCommit(fileTmp);
+    fclose(fileTmp);
+    if (!fOk) {
+        LogPrintf("%s: error writing %s\n", __func__, pathTmp.string());
+        fs::remove(pathTmp);
+        return false;
+    }
+
+    fclose(file);
+    file = nullptr;
+    bool fRenamed = RenameOver(pathTmp, path);
+    if (!fRenamed) {
+        LogPrintf("%s: unable to replace %s\n", __func__, path.string());
+        fs::remove(pathTmp);
+    }
+    if (!OpenFile("r+b") || fseek(file, 0, SEEK_END) != 0) {
+        LogPrintf("%s: unable to reopen %s\n", __func__, path.string());
+        return false;
+    }
+    if (!fRenamed)
+        return false;
+
+    // The index only changes when pszSkip dropped records
+    if (batch.size() != mapRecords.size()) {
+        mapRecords.clear();
+        nLiveSize = 0;
+        for (const Record& record : batch)
+            ApplyRecord(record);
+    }
+    nLogSize = ftell(file);
+    nSyncedSize = nLogSize;
+    // The rewritten log holds nothing of a failed write
+    fBroken = false;
+    return true;
+}
+
+bool CWalletLogStore::Backup(const fs::path& pathDest)
+{
+    LOCK(cs);
+    if (!Flush(true))
+        return false;
+    try {
+        if (fs::exists(pathDest) && fs::equivalent(path, pathDest)) {
+            LogPrintf("cannot backup to wallet source file %s\n", pathDest.string());
+            return false;
+        }
+        fs::copy_file(path, pathDest, fs::copy_option::overwrite_if_exists);
+        LogPrintf("copied %s to %s\n", path.string(), pathDest.string());
+        return true;
+    } catch (const fs::filesystem_error& e) {
+        LogPrintf("error copying %s to %s - %s\n", path.string(), pathDest.string(), e.what());
+        return false;
+    }
+}
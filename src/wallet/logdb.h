@@ -0,0 +1,97 @@
+#ifndef BITCOIN_WALLET_LOGDB_H
+#define BITCOIN_WALLET_LOGDB_H
+
+#include "fs.h"
+#include "support/allocators/zeroafterfree.h"
+#include "sync.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+//! -wallet file names ending in this are kept in a CWalletLogStore
+static const char* const WALLET_LOG_SUFFIX = ".wlog";
+//! don't compact logs smaller than this (1 MiB)
+static const uint64_t WALLET_LOG_COMPACT_MIN = 1 << 20;
+
+bool IsWalletLogFile(const std::string& walletFile);
+
+/**
+ * Append-only store for wallet records. Each change is appended to the log
+ * file in a batch closed by a commit record carrying the batch hash, and the
+ * live records are kept in a sorted in-memory index. A batch goes to the file
+ * in a single write but is only synced by Flush, so many wallet writes share
+ * one sync. On open, committed batches are replayed and a torn tail is cut
+ * off. Compact rewrites the log with just the live records.
+ */
+class CWalletLogStore
+{
+public:
+    typedef CSerializeData Data;
+
+    struct Record
+    {
+        Data key;
+        Data value;
+        bool fErase;
+
+        Record(const Data& keyIn, const Data& valueIn) : key(keyIn), value(valueIn), fErase(false) {}
+        explicit Record(const Data& keyIn) : key(keyIn), fErase(true) {}
+    };
+
+    explicit CWalletLogStore(const fs::path& pathIn);
+    ~CWalletLogStore();
+
+    /** Open or create the log and load the records it holds */
+    bool Open(std::string& strError);
+    void Close();
+
+    bool Read(const Data& key, Data& value) const;
+    bool Exists(const Data& key) const;
+    /**
+     * Move key to the next record in key order (byte-wise, like BerkeleyDB),
+     * starting at key itself if fInclusive
+     */
+    bool Next(Data& key, Data& value, bool fInclusive) const;
+
+    /** Append a batch to the log and apply it */
+    bool Apply(const std::vector<Record>& batch);
+    /** Flush the log file, and sync it to disk if fSync */
+    bool Flush(bool fSync);
+    /** Whether enough of the log is overwritten records for Compact to pay off */
+    bool NeedsCompaction() const;
+    /** Rewrite the log with only the live records, dropping keys starting with pszSkip */
+    bool Compact(const char* pszSkip = nullptr);
+    /** Copy the synced log to pathDest */
+    bool Backup(const fs::path& pathDest);
+
+    size_t Count() const;
+    /** Whether every applied batch has been synced to disk */
+    bool IsSynced() const;
+    const fs::path& GetPath() const { return path; }
+
+private:
+    struct DataCompare
+    {
+        bool operator()(const Data& a, const Data& b) const;
+    };
+
+    mutable CCriticalSection cs;
+    fs::path path;
+    FILE* file;
+    std::map<Data, Data, DataCompare> mapRecords;
+    //! bytes in the log file
+    uint64_t nLogSize;
+    //! bytes of the log known to be synced to disk
+    uint64_t nSyncedSize;
+    //! bytes taken by the live keys and values
+    uint64_t nLiveSize;
+    //! a failed write could not be cut off, so nothing may be appended
+    bool fBroken;
+
+    bool Replay(std::string& strError);
+    bool OpenFile(const char* pszMode);
+    void ApplyRecord(const Record& record);
+};
+
+#endif // BITCOIN_WALLET_LOGDB_H
@@ -0,0 +1,258 @@
+#include "wallet/logdb.h"
+#include "wallet/db.h"
+
+#include "wallet/test/wallet_test_fixture.h"
+#include "util.h"
+
+#include <boost/test/unit_test.hpp>
+
+#ifndef WIN32
+#include <signal.h>
+#include <sys/resource.h>
+#endif
+
+static CWalletLogStore::Data D(const std::string& str)
+{
+    return CWalletLogStore::Data(str.begin(), str.end());
+}
+
+static std::string S(const CWalletLogStore::Data& data)
+{
+    return std::string(data.begin(), data.end());
+}
+
+BOOST_FIXTURE_TEST_SUITE(logdb_tests, WalletTestingSetup)
+
+BOOST_AUTO_TEST_CASE(logdb_reopen)
+{
+    fs::path path = GetDataDir() / "reopen_test.wlog";
+    std::string strError;
+    {
+        CWalletLogStore store(path);
+        BOOST_CHECK(store.Open(strError));
+        std::vector<CWalletLogStore::Record> batch;
+        batch.emplace_back(D("b"), D("2"));
+        batch.emplace_back(D("a"), D("1"));
+        batch.emplace_back(D("ab"), D("3"));
+        BOOST_CHECK(store.Apply(batch));
+        batch.clear();
+        batch.emplace_back(D("b"), D("4"));
+        batch.emplace_back(D("ab"));
+        BOOST_CHECK(store.Apply(batch));
+    }
+
+    CWalletLogStore store(path);
+    BOOST_CHECK(store.Open(strError));
+    BOOST_CHECK_EQUAL(store.Count(), 2U);
+    CWalletLogStore::Data value;
+    BOOST_CHECK(!store.Read(D("ab"), value));
+    BOOST_CHECK(store.Read(D("b"), value));
+    BOOST_CHECK_EQUAL(S(value), "4");
+
+    // Keys come back in byte order
+    CWalletLogStore::Data key;
+    BOOST_CHECK(store.Next(key, value, true));
+    BOOST_CHECK_EQUAL(S(key), "a");
+    BOOST_CHECK(store.Next(key, value, false));
+    BOOST_CHECK_EQUAL(S(key), "b");
+    BOOST_CHECK(!store.Next(key, value, false));
+}
+
+BOOST_AUTO_TEST_CASE(logdb_torn_tail)
+{
+    fs::path path = GetDataDir() / "torn_test.wlog";
+    std::string strError;
+    {
+        CWalletLogStore store(path);
+        BOOST_CHECK(store.Open(strError));
+        BOOST_CHECK(store.Apply(std::vector<CWalletLogStore::Record>(1, CWalletLogStore::Record(D("key"), D("value")))));
+    }
+    const uintmax_t nGood = fs::file_size(path);
+
+    // A batch whose commit record never made it to disk
+    FILE* file = fsbridge::fopen(path, "ab");
+    const char tail[] = {'p', 3, 'n', 'e', 'w', 5, 'v'};
+    BOOST_CHECK_EQUAL(fwrite(tail, 1, sizeof(tail), file), sizeof(tail));
+    fclose(file);
+
+    CWalletLogStore store(path);
+    BOOST_CHECK(store.Open(strError));
+    BOOST_CHECK_EQUAL(store.Count(), 1U);
+    BOOST_CHECK(!store.Exists(D("new")));
+    BOOST_CHECK_EQUAL(fs::file_size(path), nGood);
+
+    // Appending continues where the good part ended
+    BOOST_CHECK(store.Apply(std::vector<CWalletLogStore::Record>(1, CWalletLogStore::Record(D("new"), D("value")))));
+    store.Close();
+    BOOST_CHECK(store.Open(strError));
+    BOOST_CHECK_EQUAL(store.Count(), 2U);
+}
+
+#ifndef WIN32
+BOOST_AUTO_TEST_CASE(logdb_failed_write)
+{
+    fs::path path = GetDataDir() / "failed_test.wlog";
+    std::string strError;
+    CWalletLogStore store(path);
+    BOOST_CHECK(store.Open(strError));
+    BOOST_CHECK(store.Apply(std::vector<CWalletLogStore::Record>(1, CWalletLogStore::Record(D("before"), D("1")))));
+    const uintmax_t nGood = fs::file_size(path);
+
+    // Let a large batch only partly reach the file, as on a full disk
+    struct rlimit limitOld;
+    BOOST_REQUIRE(getrlimit(RLIMIT_FSIZE, &limitOld) == 0);
+    void (*handlerOld)(int) = signal(SIGXFSZ, SIG_IGN);
+    struct rlimit limit = limitOld;
+    limit.rlim_cur = nGood + 16;
+    BOOST_REQUIRE(setrlimit(RLIMIT_FSIZE, &limit) == 0);
+    bool fApplied = store.Apply(std::vector<CWalletLogStore::Record>(1, CWalletLogStore::Record(D("torn"), D(std::string(1000, 'x')))));
+    BOOST_REQUIRE(setrlimit(RLIMIT_FSIZE, &limitOld) == 0);
+    signal(SIGXFSZ, handlerOld);
+    BOOST_CHECK(!fApplied);
+    BOOST_CHECK(!store.Exists(D("torn")));
+    BOOST_CHECK_EQUAL(fs::file_size(path), nGood);
+
+    // Batches after the failure survive a reopen
+    BOOST_CHECK(store.Apply(std::vector<CWalletLogStore::Record>(1, CWalletLogStore::Record(D("after"), D("2")))));
+    BOOST_CHECK(store.Apply(std::vector<CWalletLogStore::Record>(1, CWalletLogStore::Record(D("key"), D("3")))));
+    store.Close();
+    BOOST_CHECK(store.Open(strError));
+    BOOST_CHECK_EQUAL(store.Count(), 3U);
+    BOOST_CHECK(!store.Exists(D("torn")));
+    CWalletLogStore::Data value;
+    BOOST_CHECK(store.Read(D("key"), value));
+    BOOST_CHECK_EQUAL(S(value), "3");
+}
+#endif
+
+BOOST_AUTO_TEST_CASE(logdb_transactions)
+{
+    std::unique_ptr<CWalletLogStore> store(new CWalletLogStore(GetDataDir() / "txn_test.wlog"));
+    std::string strError;
+    BOOST_CHECK(store->Open(strError));
+    CWalletDBWrapper dbw(std::move(store), "txn_test.wlog");
+    CDB db(dbw, "cr+");
+
+    int nValue = 0;
+    BOOST_CHECK(db.Read(std::string("version"), nValue));
+
+    BOOST_CHECK(db.TxnBegin());
+    BOOST_CHECK(db.Write(std::string("aborted"), 1));
+    BOOST_CHECK(db.Read(std::string("aborted"), nValue));
+    BOOST_CHECK(db.TxnAbort());
+    BOOST_CHECK(!db.Exists(std::string("aborted")));
+
+    BOOST_CHECK(db.TxnBegin());
+    BOOST_CHECK(db.Write(std::string("committed"), 1));
+    BOOST_CHECK(db.Write(std::string("committed"), 2));
+    BOOST_CHECK(!db.Write(std::string("committed"), 3, false));
+    BOOST_CHECK(db.Erase(std::string("version")));
+    BOOST_CHECK(!db.Exists(std::string("version")));
+    BOOST_CHECK(db.TxnCommit());
+    BOOST_CHECK(db.Read(std::string("committed"), nValue));
+    BOOST_CHECK_EQUAL(nValue, 2);
+    BOOST_CHECK(!db.Exists(std::string("version")));
+
+    // Cursors walk the committed records
+    BOOST_CHECK(db.Write(std::string("another"), 4));
+    CDBCursor* pcursor = db.GetCursor();
+    std::vector<std::string> keys;
+    while (true) {
+        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+        CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+        if (db.ReadAtCursor(pcursor, ssKey, ssValue) != 0)
+            break;
+        std::string strKey;
+        ssKey >> strKey;
+        keys.push_back(strKey);
+    }
+    pcursor->close();
+    BOOST_CHECK(keys == std::vector<std::string>({"another", "committed"}));
+}
+
+BOOST_AUTO_TEST_CASE(logdb_flush_on_close)
+{
+    fs::path path = GetDataDir() / "flush_test.wlog";
+    std::unique_ptr<CWalletLogStore> store(new CWalletLogStore(path));
+    std::string strError;
+    BOOST_CHECK(store->Open(strError));
+    const CWalletLogStore* plog = store.get();
+    CWalletDBWrapper dbw(std::move(store), "flush_test.wlog");
+
+    // Handles opened without fFlushOnClose leave the sync to a later one
+    {
+        CDB db(dbw, "cr+", false);
+        BOOST_CHECK(db.Write(std::string("unsynced"), 1));
+    }
+    BOOST_CHECK(!plog->IsSynced());
+
+    {
+        CDB db(dbw, "r+");
+        BOOST_CHECK(db.TxnBegin());
+        BOOST_CHECK(db.Write(std::string("key"), 2));
+        BOOST_CHECK(db.TxnCommit());
+        BOOST_CHECK(!plog->IsSynced());
+    }
+    BOOST_CHECK(plog->IsSynced());
+
+    // Another reader of the file sees every record of the closed handles
+    CWalletLogStore reader(path);
+    BOOST_CHECK(reader.Open(strError));
+    // The version record plus the two writes
+    BOOST_CHECK_EQUAL(reader.Count(), 3U);
+}
+
+BOOST_AUTO_TEST_CASE(logdb_compact)
+{
+    fs::path path = GetDataDir() / "compact_test.wlog";
+    std::string strError;
+    CWalletLogStore store(path);
+    BOOST_CHECK(store.Open(strError));
+    BOOST_CHECK(store.Apply(std::vector<CWalletLogStore::Record>(1, CWalletLogStore::Record(D("skipme"), D("x")))));
+    for (int i = 0; i < 1000; i++) {
+        BOOST_CHECK(store.Apply(std::vector<CWalletLogStore::Record>(1, CWalletLogStore::Record(D("key"), D(std::to_string(i))))));
+    }
+    const uintmax_t nBefore = fs::file_size(path);
+
+    BOOST_CHECK(store.Compact("skip"));
+    BOOST_CHECK(fs::file_size(path) < nBefore / 100);
+    BOOST_CHECK_EQUAL(store.Count(), 1U);
+    BOOST_CHECK(store.Apply(std::vector<CWalletLogStore::Record>(1, CWalletLogStore::Record(D("other"), D("y")))));
+
+    store.Close();
+    BOOST_CHECK(store.Open(strError));
+    CWalletLogStore::Data value;
+    BOOST_CHECK(store.Read(D("key"), value));
+    BOOST_CHECK_EQUAL(S(value), "999");
+    BOOST_CHECK(store.Exists(D("other")));
+    BOOST_CHECK(!store.Exists(D("skipme")));
+}
+
+BOOST_AUTO_TEST_CASE(logdb_copy_from_bdb)
+{
+    CWalletDBWrapper source(&bitdb, "migrate_test.dat");
+    {
+        CDB db(source, "cr+");
+        for (int i = 0; i < 10; i++) {
+            BOOST_CHECK(db.Write(std::make_pair(std::string("n"), i), i * i));
+        }
+    }
+
+    CWalletLogStore store(GetDataDir() / "migrate_test.wlog");
+    std::string strError;
+    BOOST_CHECK(store.Open(strError));
+    BOOST_CHECK(CDB::CopyToLogStore(source, store));
+    // Ten records plus the version
+    BOOST_CHECK_EQUAL(store.Count(), 11U);
+
+    std::unique_ptr<CWalletLogStore> pstore(new CWalletLogStore(GetDataDir() / "migrate_test.wlog"));
+    store.Close();
+    BOOST_CHECK(pstore->Open(strError));
+    CWalletDBWrapper dbw(std::move(pstore), "migrate_test.wlog");
+    CDB db(dbw, "r");
+    int nValue = 0;
+    BOOST_CHECK(db.Read(std::make_pair(std::string("n"), 7), nValue));
+    BOOST_CHECK_EQUAL(nValue, 49);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -9,7 +9,9 @@
 #include <utility>
 #include <vector>
 
+#include "base58.h"
 #include "consensus/validation.h"
+#include "contract/txexecrecord.h"
 #include "rpc/server.h"
 #include "test/test_bitcoin.h"
 #include "validation.h"
@@ -343,6 +345,47 @@ BOOST_AUTO_TEST_CASE(coin_selection_tests)
     empty_wallet();
 }
 
+BOOST_AUTO_TEST_CASE(coin_selection_bnb)
+{
+    CoinSet setCoinsRet;
+    CAmount nValueRet;
+
+    LOCK(testWallet.cs_wallet);
+
+    empty_wallet();
+    add_coin(3 * CENT * BTC_2_BCX_RATE);
+    add_coin(5 * CENT * BTC_2_BCX_RATE);
+    add_coin(7 * CENT * BTC_2_BCX_RATE);
+    add_coin(1 * COIN * BTC_2_BCX_RATE);
+
+    // 9.5 cents can't be made exactly, but 7+3 overshoots by less than the window
+    BOOST_CHECK(testWallet.SelectCoinsMinConf(95 * CENT * BTC_2_BCX_RATE / 10, 1, 6, 0, vCoins, setCoinsRet, nValueRet, 1 * CENT * BTC_2_BCX_RATE));
+    BOOST_CHECK_EQUAL(nValueRet, 10 * CENT * BTC_2_BCX_RATE);
+    BOOST_CHECK_EQUAL(setCoinsRet.size(), 2U);
+
+    // an exact match needs no window
+    BOOST_CHECK(testWallet.SelectCoinsMinConf(15 * CENT * BTC_2_BCX_RATE, 1, 6, 0, vCoins, setCoinsRet, nValueRet));
+    BOOST_CHECK_EQUAL(nValueRet, 15 * CENT * BTC_2_BCX_RATE);
+    BOOST_CHECK_EQUAL(setCoinsRet.size(), 3U);
+
+    // of all subsets in the window the one with the least excess wins: the
+    // search meets 7+5 and 7+4 before the exact 6+4
+    empty_wallet();
+    add_coin(4 * CENT * BTC_2_BCX_RATE);
+    add_coin(5 * CENT * BTC_2_BCX_RATE);
+    add_coin(6 * CENT * BTC_2_BCX_RATE);
+    add_coin(7 * CENT * BTC_2_BCX_RATE);
+    BOOST_CHECK(testWallet.SelectCoinsMinConf(10 * CENT * BTC_2_BCX_RATE, 1, 6, 0, vCoins, setCoinsRet, nValueRet, 2 * CENT * BTC_2_BCX_RATE));
+    BOOST_CHECK_EQUAL(nValueRet, 10 * CENT * BTC_2_BCX_RATE);
+    BOOST_CHECK_EQUAL(setCoinsRet.size(), 2U);
+    std::set<CAmount> setValues;
+    for (const CInputCoin& coin : setCoinsRet)
+        setValues.insert(coin.txout.nValue);
+    BOOST_CHECK(setValues == std::set<CAmount>({4 * CENT * BTC_2_BCX_RATE, 6 * CENT * BTC_2_BCX_RATE}));
+
+    empty_wallet();
+}
+
 BOOST_AUTO_TEST_CASE(ApproximateBestSubset)
 {
     CoinSet setCoinsRet;
@@ -443,6 +486,30 @@ BOOST_FIXTURE_TEST_CASE(rescan, TestChain100Setup)
     }
 }
 
+// Check that the rescan prefilter lets through outputs to watch-only scripts
+// as well as to keys.
+BOOST_FIXTURE_TEST_CASE(rescan_watchonly, TestChain100Setup)
+{
+    LOCK(cs_main);
+
+    CBlockIndex* const nullBlock = nullptr;
+    {
+        CWallet wallet;
+        {
+            LOCK(wallet.cs_wallet);
+            wallet.AddWatchOnly(GetScriptForRawPubKey(coinbaseKey.GetPubKey()), 0);
+        }
+        BOOST_CHECK_EQUAL(nullBlock, wallet.ScanForWalletTransactions(chainActive.Genesis()));
+        BOOST_CHECK_EQUAL(wallet.mapWallet.size(), coinbaseTxns.size());
+    }
+    {
+        CWallet wallet;
+        AddKey(wallet, coinbaseKey);
+        BOOST_CHECK_EQUAL(nullBlock, wallet.ScanForWalletTransactions(chainActive.Genesis()));
+        BOOST_CHECK_EQUAL(wallet.mapWallet.size(), coinbaseTxns.size());
+    }
+}
+
 // Verify importwallet RPC starts rescan at earliest block with timestamp
 // greater or equal than key birthday. Previously there was a bug where
 // importwallet RPC would start the scan at the latest block with timestamp less
@@ -593,6 +660,121 @@ BOOST_AUTO_TEST_CASE(LoadReceiveRequests)
     BOOST_CHECK_EQUAL(values[1], "val_rr1");
 }
 
+// Keys topped up in batches on multiple threads must be the ones derived one
+// at a time, including skipping keys the wallet already has.
+BOOST_AUTO_TEST_CASE(keypool_batch_derivation)
+{
+    CWallet serial(std::unique_ptr<CWalletDBWrapper>(new CWalletDBWrapper(&bitdb, "keypool_serial.dat")));
+    CWallet batched(std::unique_ptr<CWalletDBWrapper>(new CWalletDBWrapper(&bitdb, "keypool_batched.dat")));
+    LOCK2(serial.cs_wallet, batched.cs_wallet);
+    serial.SetMinVersion(FEATURE_HD_SPLIT);
+    batched.SetMinVersion(FEATURE_HD_SPLIT);
+
+    CPubKey masterPubKey = serial.GenerateNewHDMasterKey();
+    CKey masterKey;
+    BOOST_CHECK(serial.GetKey(masterPubKey.GetID(), masterKey));
+    BOOST_CHECK(batched.AddKeyPubKey(masterKey, masterPubKey));
+    BOOST_CHECK(serial.SetHDMasterKey(masterPubKey));
+    BOOST_CHECK(batched.SetHDMasterKey(masterPubKey));
+
+    // Both wallets already hold m/0'/0'/5'
+    const uint32_t nHardened = 0x80000000;
+    CExtKey extKey, accountKey, chainKey, childKey;
+    extKey.SetMaster(masterKey.begin(), masterKey.size());
+    extKey.Derive(accountKey, nHardened);
+    accountKey.Derive(chainKey, nHardened);
+    chainKey.Derive(childKey, 5 | nHardened);
+    BOOST_CHECK(serial.AddKeyPubKey(childKey.key, childKey.key.GetPubKey()));
+    BOOST_CHECK(batched.AddKeyPubKey(childKey.key, childKey.key.GetPubKey()));
+
+    const unsigned int nKeys = KEYPOOL_BATCH_SIZE + 200;
+    BOOST_CHECK(batched.TopUpKeyPool(nKeys));
+    BOOST_CHECK_EQUAL(batched.GetKeyPoolSize(), 2 * nKeys);
+
+    CWalletDB walletdb(serial.GetDBHandle());
+    for (bool internal : {false, true}) {
+        for (unsigned int i = 0; i < nKeys; i++) {
+            CPubKey pubkey = serial.GenerateNewKey(walletdb, internal);
+            BOOST_CHECK(batched.HaveKey(pubkey.GetID()));
+            BOOST_CHECK_EQUAL(batched.mapKeyMetadata[pubkey.GetID()].hdKeypath, serial.mapKeyMetadata[pubkey.GetID()].hdKeypath);
+        }
+    }
+    BOOST_CHECK_EQUAL(batched.GetHDChain().nExternalChainCounter, nKeys + 1);
+    BOOST_CHECK_EQUAL(batched.GetHDChain().nInternalChainCounter, nKeys);
+    BOOST_CHECK_EQUAL(serial.GetHDChain().nExternalChainCounter, nKeys + 1);
+}
+
+static dev::h256 AddressTopic(const CKeyID& keyid)
+{
+    dev::h256 topic;
+    std::copy(keyid.begin(), keyid.end(), topic.begin() + 12);
+    return topic;
+}
+
+static dev::eth::LogEntry TransferLog(const std::string& strContract, const CKeyID& from, const CKeyID& to, uint64_t nValue)
+{
+    dev::bytes data(32, 0);
+    for (int i = 0; i < 8; i++) {
+        data[31 - i] = (nValue >> (8 * i)) & 0xff;
+    }
+    dev::h256s topics{dev::h256("ddf252ad1be2c89b69c2b068fc378daa952ba7f163c4a11628f55a4df523b3ef"), AddressTopic(from), AddressTopic(to)};
+    return dev::eth::LogEntry(dev::Address(strContract), topics, std::move(data));
+}
+
+// Check that Transfer logs of watched tokens are picked up from the receipts
+// of connected blocks, and rolled back when the block is disconnected.
+BOOST_FIXTURE_TEST_CASE(token_transfer_receipts, TestChain100Setup)
+{
+    ::bitdb.MakeMock();
+    {
+        CWallet wallet(std::unique_ptr<CWalletDBWrapper>(new CWalletDBWrapper(&bitdb, "wallet_test.dat")));
+        LOCK2(cs_main, wallet.cs_wallet);
+
+        CBlockIndex* tip = chainActive.Tip();
+        CKeyID mine = coinbaseKey.GetPubKey().GetID();
+        CKeyID other = CKeyID(uint160(std::vector<unsigned char>(20, 0x42)));
+        const std::string strContract = "eb23c0b3e6042821da281a2e2364feb22dd543e3";
+
+        // One token in sync with the parent of the tip, one still behind
+        CTokenInfo synced;
+        synced.strContractAddress = "EB23C0B3E6042821DA281A2E2364FEB22DD543E3";
+        synced.strSenderAddress = CBitcoinAddress(mine).ToString();
+        synced.blockHash = tip->pprev->GetBlockHash();
+        synced.blockNumber = tip->pprev->nHeight;
+        wallet.LoadToken(synced);
+        CTokenInfo behind = synced;
+        behind.strSenderAddress = CBitcoinAddress(other).ToString();
+        behind.blockHash.SetNull();
+        behind.blockNumber = -1;
+        wallet.LoadToken(behind);
+
+        TxExecRecordInfo receipt;
+        receipt.transactionHash = GetRandHash();
+        receipt.logs.push_back(TransferLog(strContract, other, mine, 1000));
+        receipt.logs.push_back(TransferLog("0000000000000000000000000000000000000001", other, mine, 5));
+        wallet.ContractReceiptsConnected(tip, std::vector<TxExecRecordInfo>(1, receipt));
+
+        BOOST_CHECK_EQUAL(wallet.mapTokenTx.size(), 1U);
+        const CTokenTx& tokenTx = wallet.mapTokenTx.begin()->second;
+        BOOST_CHECK_EQUAL(tokenTx.strReceiverAddress, CBitcoinAddress(mine).ToString());
+        // Recorded under the normalized address, like the log search does
+        BOOST_CHECK_EQUAL(tokenTx.strContractAddress, strContract);
+        BOOST_CHECK(tokenTx.nValue == u256Touint(1000));
+        BOOST_CHECK(tokenTx.transactionHash == receipt.transactionHash);
+        BOOST_CHECK_EQUAL(tokenTx.blockNumber, tip->nHeight);
+        BOOST_CHECK(wallet.mapToken[synced.GetHash()].blockHash == tip->GetBlockHash());
+        BOOST_CHECK(wallet.mapToken[behind.GetHash()].blockHash.IsNull());
+
+        std::shared_ptr<CBlock> block = std::make_shared<CBlock>();
+        BOOST_CHECK(ReadBlockFromDisk(*block, tip, Params().GetConsensus()));
+        wallet.BlockDisconnected(block);
+        BOOST_CHECK_EQUAL(wallet.mapTokenTx.begin()->second.blockNumber, -1);
+        BOOST_CHECK(wallet.mapToken[synced.GetHash()].blockHash == tip->pprev->GetBlockHash());
+    }
+    ::bitdb.Flush(true);
+    ::bitdb.Reset();
+}
+
 class ListCoinsTestingSetup : public TestChain100Setup
 {
 public:
@@ -680,4 +862,69 @@ BOOST_FIXTURE_TEST_CASE(ListCoins, ListCoinsTestingSetup)
     BOOST_CHECK_EQUAL(list.begin()->second.size(), 2);
 }
 
+static void CheckBalancesEqual(const CWalletBalance& a, const CWalletBalance& b)
+{
+    BOOST_CHECK_EQUAL(a.nTrusted, b.nTrusted);
+    BOOST_CHECK_EQUAL(a.nUntrusted, b.nUntrusted);
+    BOOST_CHECK_EQUAL(a.nImmature, b.nImmature);
+    BOOST_CHECK_EQUAL(a.nWatchTrusted, b.nWatchTrusted);
+    BOOST_CHECK_EQUAL(a.nWatchUntrusted, b.nWatchUntrusted);
+    BOOST_CHECK_EQUAL(a.nWatchImmature, b.nWatchImmature);
+}
+
+// Check that the running balance totals follow spends and new blocks the same
+// way summing every transaction again does.
+BOOST_FIXTURE_TEST_CASE(balance_cache, ListCoinsTestingSetup)
+{
+    LOCK2(cs_main, wallet->cs_wallet);
+
+    CWalletBalance before = wallet->GetBalances();
+    BOOST_CHECK_EQUAL(before.nTrusted, 50 * COIN * BTC_2_BCX_RATE);
+
+    AddTx(CRecipient{GetScriptForRawPubKey({}), 1 * COIN * BTC_2_BCX_RATE, false /* subtract fee */});
+    CWalletBalance after = wallet->GetBalances();
+    BOOST_CHECK(after.nTrusted != before.nTrusted);
+
+    std::vector<COutput> available;
+    wallet->AvailableCoins(available);
+    CAmount nAvailable = 0;
+    for (const COutput& out : available) {
+        nAvailable += out.tx->tx->vout[out.i].nValue;
+    }
+    BOOST_CHECK_EQUAL(after.nTrusted, nAvailable);
+
+    wallet->MarkDirty();
+    CheckBalancesEqual(after, wallet->GetBalances());
+}
+
+// Check that an output of a wallet transaction paying a key the wallet only
+// learns about later, as with keypool keys derived past the gap, becomes
+// available and counts towards the balance.
+BOOST_FIXTURE_TEST_CASE(unspent_index_new_key, ListCoinsTestingSetup)
+{
+    LOCK2(cs_main, wallet->cs_wallet);
+
+    CKey key;
+    key.MakeNewKey(true);
+    const CWalletTx& wtx = AddTx(CRecipient{GetScriptForDestination(key.GetPubKey().GetID()), 1 * COIN * BTC_2_BCX_RATE, false /* subtract fee */});
+    std::vector<COutput> available;
+    wallet->AvailableCoins(available);
+    BOOST_CHECK_EQUAL(available.size(), 1U);
+    CWalletBalance before = wallet->GetBalances();
+
+    {
+        CWalletDB walletdb(wallet->GetDBHandle());
+        BOOST_CHECK(wallet->AddKeyPubKeyWithDB(walletdb, key, key.GetPubKey()));
+    }
+    wallet->AvailableCoins(available);
+    BOOST_CHECK_EQUAL(available.size(), 2U);
+    bool fFound = false;
+    for (const COutput& out : available) {
+        fFound |= out.tx->GetHash() == wtx.GetHash() && out.tx->tx->vout[out.i].scriptPubKey == GetScriptForDestination(key.GetPubKey().GetID());
+    }
+    BOOST_CHECK(fFound);
+    BOOST_CHECK_EQUAL(wallet->GetBalances().nTrusted, before.nTrusted + 1 * COIN * BTC_2_BCX_RATE);
+    BOOST_CHECK_EQUAL(wallet->GetAvailableBalance(), before.nTrusted + 1 * COIN * BTC_2_BCX_RATE);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
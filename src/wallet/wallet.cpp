@@ -11,8 +11,12 @@
 #include "wallet/coincontrol.h"
 #include "consensus/consensus.h"
 #include "consensus/validation.h"
+#include "crypto/common.h"
+#include "crypto/ripemd160.h"
 #include "contract/config.h"
+#include "contract/txexecrecord.h"
 #include "fs.h"
+#include "hash.h"
 #include "init.h"
 #include "key.h"
 #include "keystore.h"
@@ -25,6 +29,7 @@
 #include "primitives/transaction.h"
 #include "script/script.h"
 #include "script/sign.h"
+#include "script/standard.h"
 #include "scheduler.h"
 #include "timedata.h"
 #include "txmempool.h"
@@ -32,8 +37,15 @@
 #include "ui_interface.h"
 #include "utilmoneystr.h"
 
+#include <algorithm>
 #include <assert.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <thread>
+#include <unordered_set>
 
+#include <boost/algorithm/string/case_conv.hpp>
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/thread.hpp>
 #include <miner.h>
@@ -170,14 +182,12 @@ CPubKey CWallet::GenerateNewKey(CWalletDB &walletdb, bool internal)
     return pubkey;
 }
 
-void CWallet::DeriveNewChildKey(CWalletDB &walletdb, CKeyMetadata& metadata, CKey& secret, bool internal)
+void CWallet::DeriveChainKey(CExtKey& chainChildKey, bool internal)
 {
     // for now we use a fixed keypath scheme of m/0'/0'/k
     CKey key;                      //master key seed (256bit)
     CExtKey masterKey;             //hd master key
     CExtKey accountKey;            //key at m/0'
-    CExtKey chainChildKey;         //key at m/0'/0' (external) or m/0'/1' (internal)
-    CExtKey childKey;              //key at m/0'/0'/<n>'
 
     // try to get the master key
     if (!GetKey(hdChain.masterKeyID, key))
@@ -192,6 +202,14 @@ void CWallet::DeriveNewChildKey(CWalletDB &walletdb, CKeyMetadata& metadata, CKe
     // derive m/0'/0' (external chain) OR m/0'/1' (internal chain)
     assert(internal ? CanSupportFeature(FEATURE_HD_SPLIT) : true);
     accountKey.Derive(chainChildKey, BIP32_HARDENED_KEY_LIMIT+(internal ? 1 : 0));
+}
+
+void CWallet::DeriveNewChildKey(CWalletDB &walletdb, CKeyMetadata& metadata, CKey& secret, bool internal)
+{
+    CExtKey chainChildKey;         //key at m/0'/0' (external) or m/0'/1' (internal)
+    CExtKey childKey;              //key at m/0'/0'/<n>'
+
+    DeriveChainKey(chainChildKey, internal);
 
     // derive child key at next index, skip keys already known to the wallet
     do {
@@ -216,6 +234,96 @@ void CWallet::DeriveNewChildKey(CWalletDB &walletdb, CKeyMetadata& metadata, CKe
         throw std::runtime_error(std::string(__func__) + ": Writing HD chain model failed");
 }
 
+namespace {
+
+//! Fewest keys worth handing to another derivation thread
+static const unsigned int MIN_KEYS_PER_DERIVE_THREAD = 64;
+
+/** A derived HD key and its public key */
+struct CDerivedKey
+{
+    CKey key;
+    CPubKey pubkey;
+};
+
+/**
+ * Derive the hardened children nFirst.. of chainKey into keys, on as many
+ * threads as there are cores. Computing and checking the public keys
+ * dominates, and each key is independent of the others.
+ */
+void DeriveChildKeys(const CExtKey& chainKey, uint32_t nFirst, std::vector<CDerivedKey>& keys)
+{
+    std::atomic<size_t> nNext(0);
+    auto derive = [&]() {
+        for (size_t i = nNext++; i < keys.size(); i = nNext++) {
+            CExtKey childKey;
+            chainKey.Derive(childKey, (nFirst + i) | BIP32_HARDENED_KEY_LIMIT);
+            keys[i].key = childKey.key;
+            keys[i].pubkey = childKey.key.GetPubKey();
+            assert(keys[i].key.VerifyPubKey(keys[i].pubkey));
+        }
+    };
+
+    const int nThreads = std::max(1, std::min<int>(GetNumCores(), keys.size() / MIN_KEYS_PER_DERIVE_THREAD));
+    std::vector<std::thread> threads;
+    for (int i = 1; i < nThreads; i++) {
+        threads.emplace_back(derive);
+    }
+    derive();
+    for (std::thread& t : threads) {
+        t.join();
+    }
+}
+
+} // namespace
+
+std::vector<CPubKey> CWallet::GenerateNewKeys(CWalletDB& walletdb, unsigned int nCount, bool internal)
+{
+    AssertLockHeld(cs_wallet); // mapKeyMetadata
+    std::vector<CPubKey> vPubKeys;
+    vPubKeys.reserve(nCount);
+    if (!IsHDEnabled()) {
+        while (vPubKeys.size() < nCount) {
+            vPubKeys.push_back(GenerateNewKey(walletdb, internal));
+        }
+        return vPubKeys;
+    }
+
+    internal = CanSupportFeature(FEATURE_HD_SPLIT) ? internal : false;
+    CExtKey chainChildKey;
+    DeriveChainKey(chainChildKey, internal);
+    uint32_t& nCounter = internal ? hdChain.nInternalChainCounter : hdChain.nExternalChainCounter;
+    const std::string strKeypathPrefix = internal ? "m/0'/1'/" : "m/0'/0'/";
+    const int64_t nCreationTime = GetTime();
+
+    // Keys already known to the wallet are skipped, as in DeriveNewChildKey
+    while (vPubKeys.size() < nCount) {
+        std::vector<CDerivedKey> keys(nCount - vPubKeys.size());
+        DeriveChildKeys(chainChildKey, nCounter, keys);
+        for (const CDerivedKey& derived : keys) {
+            CKeyMetadata metadata(nCreationTime);
+            metadata.hdKeypath = strKeypathPrefix + std::to_string(nCounter) + "'";
+            metadata.hdMasterKeyID = hdChain.masterKeyID;
+            nCounter++;
+            if (HaveKey(derived.pubkey.GetID()))
+                continue;
+
+            mapKeyMetadata[derived.pubkey.GetID()] = metadata;
+            if (!AddKeyPubKeyWithDB(walletdb, derived.key, derived.pubkey)) {
+                throw std::runtime_error(std::string(__func__) + ": AddKey failed");
+            }
+            vPubKeys.push_back(derived.pubkey);
+        }
+    }
+
+    // HD keys are always compressed
+    SetMinVersion(FEATURE_COMPRPUBKEY);
+    UpdateTimeFirstKey(nCreationTime);
+    if (!walletdb.WriteHDChain(hdChain))
+        throw std::runtime_error(std::string(__func__) + ": Writing HD chain model failed");
+    return vPubKeys;
+}
+
 bool CWallet::AddKeyPubKeyWithDB(CWalletDB &walletdb, const CKey& secret, const CPubKey &pubkey)
 {
     AssertLockHeld(cs_wallet); // mapKeyMetadata
@@ -232,16 +340,20 @@ bool CWallet::AddKeyPubKeyWithDB(CWalletDB &walletdb, const CKey& secret, const
         return false;
     }
     if (needsDB) pwalletdbEncryption = nullptr;
+    // Existing outputs may pay the new key, be it imported or derived
+    fUnspentIndexStale = true;
+    if (fScanningWallet)
+        vScanFilterIds.push_back(pubkey.GetID());
 
     // check if we need to remove from watch-only
     CScript script;
     script = GetScriptForDestination(pubkey.GetID());
     if (HaveWatchOnly(script)) {
-        RemoveWatchOnly(script);
+        RemoveWatchOnlyWithDB(walletdb, script);
     }
     script = GetScriptForRawPubKey(pubkey);
     if (HaveWatchOnly(script)) {
-        RemoveWatchOnly(script);
+        RemoveWatchOnlyWithDB(walletdb, script);
     }
 
     if (!IsCrypted()) {
@@ -309,6 +421,11 @@ bool CWallet::AddCScript(const CScript& redeemScript)
 {
     if (!CCryptoKeyStore::AddCScript(redeemScript))
         return false;
+    fUnspentIndexStale = true;
+    if (fScanningWallet) {
+        LOCK(cs_wallet);
+        vScanFilterIds.push_back(CScriptID(redeemScript));
+    }
     return CWalletDB(*dbw).WriteCScript(Hash160(redeemScript), redeemScript);
 }
 
@@ -337,6 +454,11 @@ bool CWallet::AddWatchOnly(const CScript& dest)
 {
     if (!CCryptoKeyStore::AddWatchOnly(dest))
         return false;
+    fUnspentIndexStale = true;
+    if (fScanningWallet) {
+        LOCK(cs_wallet);
+        vScanFilterWatchOnly.push_back(Hash160(dest.begin(), dest.end()));
+    }
     const CKeyMetadata& meta = mapKeyMetadata[CScriptID(dest)];
     UpdateTimeFirstKey(meta.nCreateTime);
     NotifyWatchonlyChanged(true);
@@ -349,19 +471,26 @@ bool CWallet::AddWatchOnly(const CScript& dest, int64_t nCreateTime)
     return AddWatchOnly(dest);
 }
 
-bool CWallet::RemoveWatchOnly(const CScript &dest)
+bool CWallet::RemoveWatchOnlyWithDB(CWalletDB &walletdb, const CScript &dest)
 {
     AssertLockHeld(cs_wallet);
     if (!CCryptoKeyStore::RemoveWatchOnly(dest))
         return false;
+    fUnspentIndexStale = true;
     if (!HaveWatchOnly())
         NotifyWatchonlyChanged(false);
-    if (!CWalletDB(*dbw).EraseWatchOnly(dest))
+    if (!walletdb.EraseWatchOnly(dest))
         return false;
 
     return true;
 }
 
+bool CWallet::RemoveWatchOnly(const CScript &dest)
+{
+    CWalletDB walletdb(*dbw);
+    return RemoveWatchOnlyWithDB(walletdb, dest);
+}
+
 bool CWallet::LoadWatchOnly(const CScript &dest)
 {
     return CCryptoKeyStore::AddWatchOnly(dest);
@@ -435,8 +564,15 @@ bool CWallet::ChangeWalletPassphrase(const SecureString& strOldWalletPassphrase,
 
 void CWallet::SetBestChain(const CBlockLocator& loc)
 {
+    LOCK(cs_wallet);
     CWalletDB walletdb(*dbw);
     walletdb.WriteBestBlock(loc);
+
+    // Token sync heights advanced by ContractReceiptsConnected are kept in
+    // memory until here, rather than written for every block.
+    for (const auto& item : mapToken) {
+        walletdb.WriteToken(item.second);
+    }
 }
 
 bool CWallet::SetMinVersion(enum WalletFeature nVersion, CWalletDB* pwalletdbIn, bool fExplicit)
@@ -546,6 +682,11 @@ bool CWallet::Verify()
             return InitError(strError);
         }
 
+        // Log stores are checked when replayed on load; salvage is BerkeleyDB only
+        if (IsWalletLogFile(walletFile)) {
+            continue;
+        }
+
         if (gArgs.GetBoolArg("-salvagewallet", false)) {
             // Recover readable keypairs:
             CWallet dummyWallet;
@@ -943,9 +1084,15 @@ void CWallet::MarkDirty()
         LOCK(cs_wallet);
         for (std::pair<const uint256, CWalletTx>& item : mapWallet)
             item.second.MarkDirty();
+        fBalanceStale = true;
     }
 }
 
+void CWallet::MarkBalanceDirty(const uint256& hash) const
+{
+    setBalanceDirty.insert(hash);
+}
+
 bool CWallet::MarkReplaced(const uint256& originalHash, const uint256& newHash)
 {
     LOCK(cs_wallet);
@@ -995,6 +1142,13 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFlushOnClose)
         wtxOrdered.insert(std::make_pair(wtx.nOrderPos, TxPair(&wtx, (CAccountingEntry*)0)));
         wtx.nTimeSmart = ComputeTimeSmart(wtx);
         AddToSpends(hash);
+        AddToUnspentIndex(wtx);
+        if (fScanningWallet) {
+            vScanFilterTxids.push_back(hash);
+            for (const CTxIn& txin : wtx.tx->vin) {
+                vScanFilterTxids.push_back(txin.prevout.hash);
+            }
+        }
     }
 
     bool fUpdated = false;
@@ -1207,8 +1361,10 @@ bool CWallet::AbandonTransaction(const uint256& hashTx)
             // available of the outputs it spends. So force those to be recomputed
             for (const CTxIn& txin : wtx.tx->vin)
             {
-                if (mapWallet.count(txin.prevout.hash))
+                if (mapWallet.count(txin.prevout.hash)) {
                     mapWallet[txin.prevout.hash].MarkDirty();
+                    AddToUnspentIndex(mapWallet[txin.prevout.hash]);
+                }
             }
         }
     }
@@ -1268,8 +1424,10 @@ void CWallet::MarkConflicted(const uint256& hashBlock, const uint256& hashTx)
             // available of the outputs it spends. So force those to be recomputed
             for (const CTxIn& txin : wtx.tx->vin)
             {
-                if (mapWallet.count(txin.prevout.hash))
+                if (mapWallet.count(txin.prevout.hash)) {
                     mapWallet[txin.prevout.hash].MarkDirty();
+                    AddToUnspentIndex(mapWallet[txin.prevout.hash]);
+                }
             }
         }
     }
@@ -1320,6 +1478,138 @@ void CWallet::BlockDisconnected(const std::shared_ptr<const CBlock>& pblock) {
     for (const CTransactionRef& ptx : pblock->vtx) {
         SyncTransaction(ptx);
     }
+
+    // Token transfers of the block are unconfirmed again, and tokens synced up
+    // to it step back to its parent.
+    const uint256 hashBlock = pblock->GetHash();
+    std::vector<uint256> vUpdated;
+    CWalletDB walletdb(*dbw);
+    for (auto& item : mapTokenTx) {
+        CTokenTx& tokenTx = item.second;
+        if (tokenTx.blockHash == hashBlock) {
+            tokenTx.blockHash.SetNull();
+            tokenTx.blockNumber = -1;
+            walletdb.WriteTokenTx(tokenTx);
+            vUpdated.push_back(item.first);
+        }
+    }
+    BlockMap::const_iterator mi = mapBlockIndex.find(pblock->hashPrevBlock);
+    for (auto& item : mapToken) {
+        CTokenInfo& token = item.second;
+        if (token.blockHash == hashBlock) {
+            token.blockHash = pblock->hashPrevBlock;
+            token.blockNumber = mi != mapBlockIndex.end() ? mi->second->nHeight : -1;
+        }
+    }
+    for (const uint256& hash : vUpdated) {
+        NotifyTokenTransactionChanged(this, hash, CT_UPDATED);
+    }
+}
+
+/** Topic of the ERC20 Transfer(address,address,uint256) event */
+static const char* TOKEN_TRANSFER_TOPIC = "ddf252ad1be2c89b69c2b068fc378daa952ba7f163c4a11628f55a4df523b3ef";
+
+static std::string TopicToAddress(const dev::h256& topic)
+{
+    // Addresses are the low 20 bytes of the topic
+    return CBitcoinAddress(CKeyID(uint160(std::vector<unsigned char>(topic.begin() + 12, topic.end())))).ToString();
+}
+
+void CWallet::ContractReceiptsConnected(const CBlockIndex *pindex, const std::vector<TxExecRecordInfo>& receipts)
+{
+    LOCK2(cs_main, cs_wallet);
+
+    if (mapToken.empty() || !pindex->pprev)
+        return;
+
+    // Only tokens synced up to the parent block are carried forward here. The
+    // others are still behind and get their history from a log search first.
+    std::map<std::string, std::vector<uint256>> mapTracked;
+    const uint256 hashPrev = pindex->pprev->GetBlockHash();
+    for (const auto& item : mapToken) {
+        if (item.second.blockHash == hashPrev) {
+            mapTracked[boost::algorithm::to_lower_copy(item.second.strContractAddress)].push_back(item.first);
+        }
+    }
+    if (mapTracked.empty())
+        return;
+
+    static const dev::h256 transferTopic(TOKEN_TRANSFER_TOPIC);
+    std::map<uint256, CTokenTx> mapNewTx;
+    std::set<uint256> setTokenChanged;
+    for (const TxExecRecordInfo& receipt : receipts) {
+        for (const dev::eth::LogEntry& log : receipt.logs) {
+            if (log.topics.size() < 3 || log.topics[0] != transferTopic || log.data.size() < 32)
+                continue;
+            auto it = mapTracked.find(log.address.hex());
+            if (it == mapTracked.end())
+                continue;
+
+            std::string strSender = TopicToAddress(log.topics[1]);
+            std::string strReceiver = TopicToAddress(log.topics[2]);
+            for (const uint256& tokenHash : it->second) {
+                const CTokenInfo& token = mapToken[tokenHash];
+                if (token.strSenderAddress != strSender && token.strSenderAddress != strReceiver)
+                    continue;
+
+                CTokenTx tokenTx;
+                tokenTx.strContractAddress = log.address.hex();
+                tokenTx.strSenderAddress = strSender;
+                tokenTx.strReceiverAddress = strReceiver;
+                tokenTx.nValue = uint256(std::vector<unsigned char>(log.data.begin(), log.data.begin() + 32));
+                tokenTx.transactionHash = receipt.transactionHash;
+                tokenTx.blockHash = pindex->GetBlockHash();
+                tokenTx.blockNumber = pindex->nHeight;
+                tokenTx.nCreateTime = pindex->GetBlockTime();
+                uint256 hash = tokenTx.GetHash();
+                std::map<uint256, CTokenTx>::const_iterator mi = mapTokenTx.find(hash);
+                if (mi != mapTokenTx.end()) {
+                    tokenTx.strLabel = mi->second.strLabel;
+                }
+                mapNewTx[hash] = tokenTx;
+                setTokenChanged.insert(tokenHash);
+            }
+        }
+    }
+
+    // Write the whole block's worth of token history at once
+    if (!mapNewTx.empty()) {
+        CWalletDB walletdb(*dbw);
+        if (!walletdb.TxnBegin()) {
+            LogPrintf("%s: failed to begin wallet transaction\n", __func__);
+            return;
+        }
+        bool fOk = true;
+        for (const auto& item : mapNewTx) {
+            fOk = fOk && walletdb.WriteTokenTx(item.second);
+        }
+        for (const uint256& tokenHash : setTokenChanged) {
+            CTokenInfo token = mapToken[tokenHash];
+            token.blockHash = pindex->GetBlockHash();
+            token.blockNumber = pindex->nHeight;
+            fOk = fOk && walletdb.WriteToken(token);
+        }
+        if (!fOk) {
+            walletdb.TxnAbort();
+        }
+        if (!fOk || !walletdb.TxnCommit()) {
+            LogPrintf("%s: failed to write token transactions of block %s\n", __func__, pindex->GetBlockHash().ToString());
+            return;
+        }
+    }
+
+    for (const auto& item : mapTracked) {
+        for (const uint256& tokenHash : item.second) {
+            CTokenInfo& token = mapToken[tokenHash];
+            token.blockHash = pindex->GetBlockHash();
+            token.blockNumber = pindex->nHeight;
+        }
+    }
+    for (const auto& item : mapNewTx) {
+        bool fInsertedNew = !mapTokenTx.count(item.first);
+        mapTokenTx[item.first] = item.second;
+        NotifyTokenTransactionChanged(this, item.first, fInsertedNew ? CT_NEW : CT_UPDATED);
+    }
 }
 
 
@@ -1656,11 +1946,234 @@ int64_t CWallet::RescanFromTime(int64_t startTime, bool update)
     return startTime;
 }
 
+//! Most threads reading blocks ahead of a rescan
+static const int MAX_RESCAN_READ_THREADS = 4;
+//! Blocks read ahead of the one being scanned
+static const size_t RESCAN_READ_AHEAD = 32;
+
+namespace {
+
+/** The keys of the scan filter are hashes already */
+struct CheapUint160Hasher
+{
+    size_t operator()(const uint160& h) const { return ReadLE64(h.begin()); }
+};
+
+/** Reads the blocks of a rescan on a few threads, ahead of the scan */
+class CBlockReadAhead
+{
+public:
+    explicit CBlockReadAhead(int nThreads) : nNext(0), fStop(false)
+    {
+        for (int i = 0; i < nThreads; i++) {
+            threads.emplace_back(&CBlockReadAhead::ThreadRead, this);
+        }
+    }
+
+    ~CBlockReadAhead()
+    {
+        {
+            std::lock_guard<std::mutex> lock(cs);
+            fStop = true;
+        }
+        condWork.notify_all();
+        for (std::thread& t : threads) {
+            t.join();
+        }
+    }
+
+    size_t Size()
+    {
+        std::lock_guard<std::mutex> lock(cs);
+        return queue.size();
+    }
+
+    //! Queue a block to be read, blocks come out of Pop in the order they were pushed
+    void Push(CBlockIndex* pindex)
+    {
+        {
+            std::lock_guard<std::mutex> lock(cs);
+            queue.emplace_back(pindex);
+        }
+        condWork.notify_one();
+    }
+
+    //! Wait for the oldest queued block, returns false if it could not be read
+    bool Pop(CBlockIndex*& pindex, CBlock& block)
+    {
+        std::unique_lock<std::mutex> lock(cs);
+        assert(!queue.empty());
+        condDone.wait(lock, [this] { return queue.front().fDone; });
+        Item& item = queue.front();
+        pindex = item.pindex;
+        block = std::move(item.block);
+        bool fOk = item.fOk;
+        queue.pop_front();
+        nNext--;
+        return fOk;
+    }
+
+private:
+    struct Item {
+        CBlockIndex* pindex;
+        CBlock block;
+        bool fDone;
+        bool fOk;
+        explicit Item(CBlockIndex* pindexIn) : pindex(pindexIn), fDone(false), fOk(false) {}
+    };
+
+    void ThreadRead()
+    {
+        std::unique_lock<std::mutex> lock(cs);
+        while (true) {
+            condWork.wait(lock, [this] { return fStop || nNext < queue.size(); });
+            if (fStop)
+                return;
+            // Items are only popped once done, so this stays valid unlocked
+            Item& item = queue[nNext++];
+            lock.unlock();
+            bool fOk = ReadBlockFromDisk(item.block, item.pindex, Params().GetConsensus());
+            lock.lock();
+            item.fOk = fOk;
+            item.fDone = true;
+            condDone.notify_one();
+        }
+    }
+
+    std::mutex cs;
+    std::condition_variable condWork;
+    std::condition_variable condDone;
+    std::deque<Item> queue;
+    //! Position in queue of the next block to read
+    size_t nNext;
+    bool fStop;
+    std::vector<std::thread> threads;
+};
+
+} // namespace
+
+/**
+ * Prefilter for rescans. A transaction that does not match it cannot involve
+ * the wallet, so it is skipped without taking the wallet lock; matches are
+ * checked in full by AddToWalletIfInvolvingMe. It errs on the side of
+ * matching, e.g. multisig outputs match on any one of the wallet's keys.
+ */
+class CWalletScanFilter
+{
+public:
+    //! Key and script IDs of the wallet, as they appear in output scripts
+    std::unordered_set<uint160, CheapUint160Hasher> setIds;
+    //! Hash160 of the watch-only scripts
+    std::unordered_set<uint160, CheapUint160Hasher> setWatchOnly;
+    //! Wallet transactions, and the transactions they spend from
+    std::unordered_set<uint256, SaltedTxidHasher> setTxids;
+
+    bool MatchOutput(const CScript& script) const
+    {
+        if (!setWatchOnly.empty() && setWatchOnly.count(Hash160(script.begin(), script.end())))
+            return true;
+
+        std::vector<std::vector<unsigned char>> vSolutions;
+        txnouttype whichType;
+        if (!Solver(script, whichType, vSolutions))
+            return false;
+
+        switch (whichType) {
+        case TX_PUBKEY:
+            return setIds.count(Hash160(vSolutions[0]));
+        case TX_PUBKEYHASH:
+        case TX_SCRIPTHASH:
+        case TX_WITNESS_V0_KEYHASH:
+            return setIds.count(uint160(vSolutions[0]));
+        case TX_WITNESS_V0_SCRIPTHASH: {
+            uint160 hash;
+            CRIPEMD160().Write(vSolutions[0].data(), vSolutions[0].size()).Finalize(hash.begin());
+            return setIds.count(hash);
+        }
+        case TX_MULTISIG:
+            for (size_t i = 1; i + 1 < vSolutions.size(); i++) {
+                if (setIds.count(Hash160(vSolutions[i])))
+                    return true;
+            }
+            return false;
+        default:
+            return false;
+        }
+    }
+
+    bool Match(const CTransaction& tx) const
+    {
+        if (setTxids.count(tx.GetHash()))
+            return true;
+        for (const CTxIn& txin : tx.vin) {
+            if (setTxids.count(txin.prevout.hash))
+                return true;
+        }
+        for (const CTxOut& txout : tx.vout) {
+            if (MatchOutput(txout.scriptPubKey))
+                return true;
+        }
+        return false;
+    }
+
+    void AddTx(const CTransaction& tx)
+    {
+        setTxids.insert(tx.GetHash());
+        for (const CTxIn& txin : tx.vin) {
+            setTxids.insert(txin.prevout.hash);
+        }
+    }
+};
+
+void CWallet::InitScanFilter(CWalletScanFilter& filter)
+{
+    AssertLockHeld(cs_wallet);
+    LOCK(cs_KeyStore);
+
+    vScanFilterIds.clear();
+    vScanFilterWatchOnly.clear();
+    vScanFilterTxids.clear();
+
+    std::set<CKeyID> setKeys;
+    GetKeys(setKeys);
+    filter.setIds.reserve(setKeys.size() + mapScripts.size());
+    filter.setIds.insert(setKeys.begin(), setKeys.end());
+    for (const auto& item : mapScripts) {
+        filter.setIds.insert(item.first);
+    }
+    for (const CScript& script : setWatchOnly) {
+        filter.setWatchOnly.insert(Hash160(script.begin(), script.end()));
+    }
+    filter.setTxids.reserve(mapWallet.size() + mapTxSpends.size());
+    for (const auto& item : mapWallet) {
+        filter.setTxids.insert(item.first);
+    }
+    for (const auto& item : mapTxSpends) {
+        filter.setTxids.insert(item.first.hash);
+    }
+}
+
+void CWallet::UpdateScanFilter(CWalletScanFilter& filter)
+{
+    AssertLockHeld(cs_wallet);
+
+    filter.setIds.insert(vScanFilterIds.begin(), vScanFilterIds.end());
+    filter.setWatchOnly.insert(vScanFilterWatchOnly.begin(), vScanFilterWatchOnly.end());
+    filter.setTxids.insert(vScanFilterTxids.begin(), vScanFilterTxids.end());
+    vScanFilterIds.clear();
+    vScanFilterWatchOnly.clear();
+    vScanFilterTxids.clear();
+}
+
 /**
  * Scan the block chain (starting in pindexStart) for transactions
  * from or to us. If fUpdate is true, found transactions that already
  * exist in the wallet will be updated.
  *
+ * Blocks are read ahead on a few threads and matched against a
+ * CWalletScanFilter, so that the wallet is only locked for blocks with
+ * candidate transactions.
+ *
  * Returns null if scan was successful. Otherwise, if a complete rescan was not
  * possible (due to pruning or corruption), returns pointer to the most recent
  * block that could not be scanned.
@@ -1673,15 +2186,39 @@ CBlockIndex* CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, bool f
     CBlockIndex* pindex = pindexStart;
     CBlockIndex* ret = nullptr;
     {
-        LOCK2(cs_main, cs_wallet);
         fAbortRescan = false;
         fScanningWallet = true;
 
         ShowProgress(_("Rescanning..."), 0); // show rescan progress in GUI as dialog or on splashscreen, if -rescan on startup
-        double dProgressStart = GuessVerificationProgress(chainParams.TxData(), pindex);
-        double dProgressTip = GuessVerificationProgress(chainParams.TxData(), chainActive.Tip());
-        while (pindex && !fAbortRescan)
+        double dProgressStart;
+        double dProgressTip;
+        CWalletScanFilter filter;
+        {
+            LOCK2(cs_main, cs_wallet);
+            dProgressStart = GuessVerificationProgress(chainParams.TxData(), pindex);
+            dProgressTip = GuessVerificationProgress(chainParams.TxData(), chainActive.Tip());
+            InitScanFilter(filter);
+        }
+
+        CBlockReadAhead reader(std::max(1, std::min(GetNumCores(), MAX_RESCAN_READ_THREADS)));
+        CBlockIndex* pindexNext = pindex;
+        while (!fAbortRescan)
         {
+            {
+                LOCK(cs_main);
+                while (pindexNext && reader.Size() < RESCAN_READ_AHEAD) {
+                    reader.Push(pindexNext);
+                    pindexNext = chainActive.Next(pindexNext);
+                }
+            }
+            if (reader.Size() == 0) {
+                pindex = nullptr;
+                break;
+            }
+
+            CBlock block;
+            bool fRead = reader.Pop(pindex, block);
+
             if (pindex->nHeight % 100 == 0 && dProgressTip - dProgressStart > 0.0)
                 ShowProgress(_("Rescanning..."), std::max(1, std::min(99, (int)((GuessVerificationProgress(chainParams.TxData(), pindex) - dProgressStart) / (dProgressTip - dProgressStart) * 100))));
             if (GetTime() >= nNow + 60) {
@@ -1689,15 +2226,33 @@ CBlockIndex* CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, bool f
                 LogPrintf("Still rescanning. At block %d. Progress=%f\n", pindex->nHeight, GuessVerificationProgress(chainParams.TxData(), pindex));
             }
 
-            CBlock block;
-            if (ReadBlockFromDisk(block, pindex, Params().GetConsensus())) {
-                for (size_t posInBlock = 0; posInBlock < block.vtx.size(); ++posInBlock) {
-                    AddToWalletIfInvolvingMe(block.vtx[posInBlock], pindex, posInBlock, fUpdate);
-                }
-            } else {
+            if (!fRead) {
+                ret = pindex;
+                continue;
+            }
+
+            std::vector<size_t> vMatches;
+            for (size_t posInBlock = 0; posInBlock < block.vtx.size(); ++posInBlock) {
+                if (filter.Match(*block.vtx[posInBlock]))
+                    vMatches.push_back(posInBlock);
+            }
+            if (vMatches.empty())
+                continue;
+
+            LOCK2(cs_main, cs_wallet);
+            if (!chainActive.Contains(pindex)) {
+                // Abort scan if current block is no longer active, to prevent
+                // marking transactions as coming from the wrong block.
                 ret = pindex;
+                pindex = nullptr;
+                break;
             }
-            pindex = chainActive.Next(pindex);
+            for (size_t posInBlock : vMatches) {
+                AddToWalletIfInvolvingMe(block.vtx[posInBlock], pindex, posInBlock, fUpdate);
+                filter.AddTx(*block.vtx[posInBlock]);
+            }
+            // Keys may have been added by topping up the keypool
+            UpdateScanFilter(filter);
         }
         if (pindex && fAbortRescan) {
             LogPrintf("Rescan aborted at block %d. Progress=%f\n", pindex->nHeight, GuessVerificationProgress(chainParams.TxData(), pindex));
@@ -1936,6 +2491,21 @@ CAmount CWalletTx::GetChange() const
     return nChangeCached;
 }
 
+void CWalletTx::MarkDirty() const
+{
+    fCreditCached = false;
+    fAvailableCreditCached = false;
+    fImmatureCreditCached = false;
+    fWatchDebitCached = false;
+    fWatchCreditCached = false;
+    fAvailableWatchCreditCached = false;
+    fImmatureWatchCreditCached = false;
+    fDebitCached = false;
+    fChangeCached = false;
+    if (pwallet)
+        pwallet->MarkBalanceDirty(GetHash());
+}
+
 bool CWalletTx::InMempool() const
 {
     LOCK(mempool.cs);
@@ -2041,94 +2611,116 @@ void CWallet::ResendWalletTransactions(int64_t nBestBlockTime, CConnman* connman
  */
 
 
-CAmount CWallet::GetBalance() const
+CWalletBalance CWallet::GetTxBalance(const CWalletTx& wtx) const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (std::map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            if (pcoin->IsTrusted())
-                nTotal += pcoin->GetAvailableCredit();
+    CWalletBalance balance;
+    if (wtx.IsTrusted()) {
+        balance.nTrusted = wtx.GetAvailableCredit();
+        balance.nWatchTrusted = wtx.GetAvailableWatchOnlyCredit();
+    } else if (wtx.GetDepthInMainChain() == 0 && wtx.InMempool()) {
+        balance.nUntrusted = wtx.GetAvailableCredit();
+        balance.nWatchUntrusted = wtx.GetAvailableWatchOnlyCredit();
+    }
+    balance.nImmature = wtx.GetImmatureCredit();
+    balance.nWatchImmature = wtx.GetImmatureWatchOnlyCredit();
+    return balance;
+}
+
+CWalletBalance CWallet::GetBalances() const
+{
+    LOCK2(cs_main, cs_wallet);
+
+    // Picks up credits of outputs that new keys or scripts made ours
+    if (fUnspentIndexStale)
+        RebuildUnspentIndex();
+
+    // A reorg can change the depth of any transaction without marking it dirty
+    if (pindexBalanceTip && !chainActive.Contains(pindexBalanceTip))
+        fBalanceStale = true;
+
+    if (fBalanceStale) {
+        balanceSettled = CWalletBalance();
+        mapBalanceSettled.clear();
+        setBalancePending.clear();
+        setBalanceDirty.clear();
+        for (const std::pair<const uint256, CWalletTx>& item : mapWallet)
+            setBalancePending.insert(item.first);
+        pindexBalanceTip = nullptr;
+        fBalanceStale = false;
+    }
+
+    // Take dirty transactions out of the totals, they get summed again below
+    bool fPendingChanged = !setBalanceDirty.empty() || pindexBalanceTip != chainActive.Tip() ||
+                           nBalanceMempoolUpdated != mempool.GetTransactionsUpdated();
+    for (const uint256& hash : setBalanceDirty) {
+        std::map<uint256, CWalletBalance>::iterator it = mapBalanceSettled.find(hash);
+        if (it != mapBalanceSettled.end()) {
+            balanceSettled -= it->second;
+            mapBalanceSettled.erase(it);
+        }
+        if (mapWallet.count(hash))
+            setBalancePending.insert(hash);
+    }
+    setBalanceDirty.clear();
+
+    if (fPendingChanged) {
+        balancePending = CWalletBalance();
+        std::set<uint256>::iterator it = setBalancePending.begin();
+        while (it != setBalancePending.end()) {
+            std::map<uint256, CWalletTx>::const_iterator mi = mapWallet.find(*it);
+            if (mi == mapWallet.end()) {
+                it = setBalancePending.erase(it);
+                continue;
+            }
+            const CWalletTx& wtx = mi->second;
+            CWalletBalance balance = GetTxBalance(wtx);
+            int nDepth = wtx.GetDepthInMainChain();
+            if (nDepth < 0 || (nDepth > 0 && wtx.GetBlocksToMaturity() == 0)) {
+                balanceSettled += balance;
+                mapBalanceSettled[*it] = balance;
+                it = setBalancePending.erase(it);
+            } else {
+                balancePending += balance;
+                ++it;
+            }
         }
+        pindexBalanceTip = chainActive.Tip();
+        nBalanceMempoolUpdated = mempool.GetTransactionsUpdated();
     }
 
-    return nTotal;
+    CWalletBalance balance = balanceSettled;
+    balance += balancePending;
+    return balance;
+}
+
+CAmount CWallet::GetBalance() const
+{
+    return GetBalances().nTrusted;
 }
 
 CAmount CWallet::GetUnconfirmedBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (std::map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            if (!pcoin->IsTrusted() && pcoin->GetDepthInMainChain() == 0 && pcoin->InMempool())
-                nTotal += pcoin->GetAvailableCredit();
-        }
-    }
-    return nTotal;
+    return GetBalances().nUntrusted;
 }
 
 CAmount CWallet::GetImmatureBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (std::map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            nTotal += pcoin->GetImmatureCredit();
-        }
-    }
-    return nTotal;
+    return GetBalances().nImmature;
 }
 
 CAmount CWallet::GetWatchOnlyBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (std::map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            if (pcoin->IsTrusted())
-                nTotal += pcoin->GetAvailableWatchOnlyCredit();
-        }
-    }
-
-    return nTotal;
+    return GetBalances().nWatchTrusted;
 }
 
 CAmount CWallet::GetUnconfirmedWatchOnlyBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (std::map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            if (!pcoin->IsTrusted() && pcoin->GetDepthInMainChain() == 0 && pcoin->InMempool())
-                nTotal += pcoin->GetAvailableWatchOnlyCredit();
-        }
-    }
-    return nTotal;
+    return GetBalances().nWatchUntrusted;
 }
 
 CAmount CWallet::GetImmatureWatchOnlyBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (std::map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            nTotal += pcoin->GetImmatureWatchOnlyCredit();
-        }
-    }
-    return nTotal;
+    return GetBalances().nWatchImmature;
 }
 
 // Calculate total balance in a different way from GetBalance. The biggest
@@ -2189,6 +2781,44 @@ CAmount CWallet::GetAvailableBalance(const CCoinControl* coinControl) const
     return balance;
 }
 
+void CWallet::AddToUnspentIndex(const CWalletTx& wtx) const
+{
+    AssertLockHeld(cs_wallet);
+    if (fUnspentIndexStale)
+        return;
+    const uint256& hash = wtx.GetHash();
+    for (unsigned int i = 0; i < wtx.tx->vout.size(); i++) {
+        isminetype mine = IsMine(wtx.tx->vout[i]);
+        if (mine != ISMINE_NO)
+            mapWalletUnspent[COutPoint(hash, i)] = mine;
+    }
+}
+
+void CWallet::RebuildUnspentIndex() const
+{
+    AssertLockHeld(cs_wallet);
+    std::map<COutPoint, isminetype> mapOld;
+    mapOld.swap(mapWalletUnspent);
+    fUnspentIndexStale = false;
+    for (const std::pair<const uint256, CWalletTx>& item : mapWallet)
+        AddToUnspentIndex(item.second);
+
+    // Outputs that became ours or stopped being ours change the credit of
+    // their transaction. Spent outputs dropped since the last rebuild show up
+    // here too, which only costs summing those transactions again.
+    std::vector<std::pair<COutPoint, isminetype>> vChanged;
+    std::set_symmetric_difference(mapOld.begin(), mapOld.end(), mapWalletUnspent.begin(), mapWalletUnspent.end(), std::back_inserter(vChanged));
+    uint256 hashLast;
+    for (const std::pair<COutPoint, isminetype>& item : vChanged) {
+        if (item.first.hash == hashLast)
+            continue;
+        hashLast = item.first.hash;
+        std::map<uint256, CWalletTx>::const_iterator mi = mapWallet.find(hashLast);
+        if (mi != mapWallet.end())
+            mi->second.MarkDirty();
+    }
+}
+
 void CWallet::AvailableCoins(std::vector<COutput> &vCoins, bool fOnlySafe, const CCoinControl *coinControl, const CAmount &nMinimumAmount, const CAmount &nMaximumAmount, const CAmount &nMinimumSumAmount, const uint64_t &nMaximumCount, const int &nMinDepth, const int &nMaxDepth) const
 {
     vCoins.clear();
@@ -2198,10 +2828,23 @@ void CWallet::AvailableCoins(std::vector<COutput> &vCoins, bool fOnlySafe, const
 
         CAmount nTotal = 0;
 
-        for (std::map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
+        if (fUnspentIndexStale)
+            RebuildUnspentIndex();
+
+        std::map<COutPoint, isminetype>::iterator it = mapWalletUnspent.begin();
+        while (it != mapWalletUnspent.end())
         {
-            const uint256& wtxid = it->first;
-            const CWalletTx* pcoin = &(*it).second;
+            const uint256 wtxid = it->first.hash;
+            std::map<COutPoint, isminetype>::iterator itOut = it;
+            std::map<COutPoint, isminetype>::iterator itEnd = mapWalletUnspent.lower_bound(COutPoint(wtxid, std::numeric_limits<uint32_t>::max()));
+            it = itEnd;
+
+            std::map<uint256, CWalletTx>::const_iterator mi = mapWallet.find(wtxid);
+            if (mi == mapWallet.end()) {
+                mapWalletUnspent.erase(itOut, itEnd);
+                continue;
+            }
+            const CWalletTx* pcoin = &mi->second;
 
             if (!CheckFinalTx(*pcoin))
                 continue;
@@ -2258,24 +2901,26 @@ void CWallet::AvailableCoins(std::vector<COutput> &vCoins, bool fOnlySafe, const
             if (nDepth < nMinDepth || nDepth > nMaxDepth)
                 continue;
 
-            for (unsigned int i = 0; i < pcoin->tx->vout.size(); i++) {
-                if (pcoin->tx->vout[i].nValue < nMinimumAmount || pcoin->tx->vout[i].nValue > nMaximumAmount)
-                    continue;
+            while (itOut != itEnd) {
+                const unsigned int i = itOut->first.n;
+                const isminetype mine = itOut->second;
 
-                if (coinControl && coinControl->HasSelected() && !coinControl->fAllowOtherInputs && !coinControl->IsSelected(COutPoint((*it).first, i)))
+                // Outputs stay spent unless the spend gets conflicted or
+                // abandoned, which puts them back, so drop them here
+                if (IsSpent(wtxid, i)) {
+                    itOut = mapWalletUnspent.erase(itOut);
                     continue;
+                }
+                ++itOut;
 
-                if (IsLockedCoin((*it).first, i))
+                if (pcoin->tx->vout[i].nValue < nMinimumAmount || pcoin->tx->vout[i].nValue > nMaximumAmount)
                     continue;
 
-                if (IsSpent(wtxid, i))
+                if (coinControl && coinControl->HasSelected() && !coinControl->fAllowOtherInputs && !coinControl->IsSelected(COutPoint(wtxid, i)))
                     continue;
 
-                isminetype mine = IsMine(pcoin->tx->vout[i]);
-
-                if (mine == ISMINE_NO) {
+                if (IsLockedCoin(wtxid, i))
                     continue;
-                }
 
                 bool fSpendableIn = ((mine & ISMINE_SPENDABLE) != ISMINE_NO) || (coinControl && coinControl->fAllowWatchOnly && (mine & ISMINE_WATCH_SOLVABLE) != ISMINE_NO);
                 bool fSolvableIn = (mine & (ISMINE_SPENDABLE | ISMINE_WATCH_SOLVABLE)) != ISMINE_NO;
@@ -2362,6 +3007,63 @@ const CTxOut& CWallet::FindNonChangeParentOutput(const CTransaction& tx, int out
     return ptx->vout[n];
 }
 
+/**
+ * Depth first search for the subset of vValue (sorted by descending value)
+ * whose total lands in [nTargetValue, nTargetValue + nChangeWindow] with the
+ * least excess, so that no change output is needed. Gives up after
+ * BNB_TOTAL_TRIES steps and keeps the best subset found so far.
+ */
+static bool SelectCoinsBnB(const std::vector<CInputCoin>& vValue, const CAmount& nTargetValue, const CAmount& nChangeWindow,
+                           std::vector<char>& vfBest, CAmount& nBest)
+{
+    std::vector<char> vfIncluded(vValue.size(), false);
+    CAmount nTotal = 0;
+    CAmount nRemaining = 0;
+    for (const CInputCoin& coin : vValue)
+        nRemaining += coin.txout.nValue;
+
+    bool fFound = false;
+    // Coins [0, i) have been decided on, nRemaining is the value of the rest
+    size_t i = 0;
+    for (int nTries = 0; nTries < BNB_TOTAL_TRIES; nTries++)
+    {
+        bool fBacktrack = false;
+        if (nTotal + nRemaining < nTargetValue || nTotal > nTargetValue + nChangeWindow || (fFound && nTotal >= nBest)) {
+            fBacktrack = true;
+        } else if (nTotal >= nTargetValue) {
+            vfBest = vfIncluded;
+            nBest = nTotal;
+            fFound = true;
+            if (nBest == nTargetValue)
+                break;
+            fBacktrack = true;
+        }
+
+        if (fBacktrack) {
+            // Walk back to the last included coin and leave it out instead
+            while (i > 0 && !vfIncluded[i - 1]) {
+                i--;
+                nRemaining += vValue[i].txout.nValue;
+            }
+            if (i == 0)
+                break;
+            vfIncluded[i - 1] = false;
+            nTotal -= vValue[i - 1].txout.nValue;
+        } else {
+            // Including a coin worth the same as one just left out only
+            // repeats a branch that was already searched
+            const CAmount nValue = vValue[i].txout.nValue;
+            nRemaining -= nValue;
+            if (i == 0 || vfIncluded[i - 1] || nValue != vValue[i - 1].txout.nValue) {
+                vfIncluded[i] = true;
+                nTotal += nValue;
+            }
+            i++;
+        }
+    }
+    return fFound;
+}
+
 static void ApproximateBestSubset(const std::vector<CInputCoin>& vValue, const CAmount& nTotalLower, const CAmount& nTargetValue,
                                   std::vector<char>& vfBest, CAmount& nBest, int iterations = 1000)
 {
@@ -2409,7 +3111,7 @@ static void ApproximateBestSubset(const std::vector<CInputCoin>& vValue, const C
 }
 
 bool CWallet::SelectCoinsMinConf(const CAmount& nTargetValue, const int nConfMine, const int nConfTheirs, const uint64_t nMaxAncestors, std::vector<COutput> vCoins,
-                                 std::set<CInputCoin>& setCoinsRet, CAmount& nValueRet) const
+                                 std::set<CInputCoin>& setCoinsRet, CAmount& nValueRet, const CAmount& nChangeWindow) const
 {
     setCoinsRet.clear();
     nValueRet = 0;
@@ -2474,12 +3176,24 @@ bool CWallet::SelectCoinsMinConf(const CAmount& nTargetValue, const int nConfMin
         return true;
     }
 
-    // Solve subset sum by stochastic approximation
     std::sort(vValue.begin(), vValue.end(), CompareValueOnly());
     std::reverse(vValue.begin(), vValue.end());
     std::vector<char> vfBest;
     CAmount nBest;
 
+    // Look for a subset that needs no change first
+    if (SelectCoinsBnB(vValue, nTargetValue, nChangeWindow, vfBest, nBest)) {
+        for (unsigned int i = 0; i < vValue.size(); i++) {
+            if (vfBest[i]) {
+                setCoinsRet.insert(vValue[i]);
+                nValueRet += vValue[i].txout.nValue;
+            }
+        }
+        LogPrint(BCLog::SELECTCOINS, "SelectCoins() changeless subset of %u coins, total %s\n", setCoinsRet.size(), FormatMoney(nBest));
+        return true;
+    }
+
+    // Solve subset sum by stochastic approximation
     ApproximateBestSubset(vValue, nTotalLower, nTargetValue, vfBest, nBest);
     if (nBest != nTargetValue && nTotalLower >= nTargetValue + MIN_CHANGE)
         ApproximateBestSubset(vValue, nTotalLower, nTargetValue + MIN_CHANGE, vfBest, nBest);
@@ -2514,7 +3228,7 @@ bool CWallet::SelectCoinsMinConf(const CAmount& nTargetValue, const int nConfMin
     return true;
 }
 
-bool CWallet::SelectCoins(const std::vector<COutput>& vAvailableCoins, const CAmount& nTargetValue, std::set<CInputCoin>& setCoinsRet, CAmount& nValueRet, const CCoinControl* coinControl) const
+bool CWallet::SelectCoins(const std::vector<COutput>& vAvailableCoins, const CAmount& nTargetValue, std::set<CInputCoin>& setCoinsRet, CAmount& nValueRet, const CCoinControl* coinControl, const CAmount& nChangeWindow) const
 {
     std::vector<COutput> vCoins(vAvailableCoins);
 
@@ -2566,13 +3280,13 @@ bool CWallet::SelectCoins(const std::vector<COutput>& vAvailableCoins, const CAm
     bool fRejectLongChains = gArgs.GetBoolArg("-walletrejectlongchains", DEFAULT_WALLET_REJECT_LONG_CHAINS);
 
     bool res = nTargetValue <= nValueFromPresetInputs ||
-        SelectCoinsMinConf(nTargetValue - nValueFromPresetInputs, 1, 6, 0, vCoins, setCoinsRet, nValueRet) ||
-        SelectCoinsMinConf(nTargetValue - nValueFromPresetInputs, 1, 1, 0, vCoins, setCoinsRet, nValueRet) ||
-        (bSpendZeroConfChange && SelectCoinsMinConf(nTargetValue - nValueFromPresetInputs, 0, 1, 2, vCoins, setCoinsRet, nValueRet)) ||
-        (bSpendZeroConfChange && SelectCoinsMinConf(nTargetValue - nValueFromPresetInputs, 0, 1, std::min((size_t)4, nMaxChainLength/3), vCoins, setCoinsRet, nValueRet)) ||
-        (bSpendZeroConfChange && SelectCoinsMinConf(nTargetValue - nValueFromPresetInputs, 0, 1, nMaxChainLength/2, vCoins, setCoinsRet, nValueRet)) ||
-        (bSpendZeroConfChange && SelectCoinsMinConf(nTargetValue - nValueFromPresetInputs, 0, 1, nMaxChainLength, vCoins, setCoinsRet, nValueRet)) ||
-        (bSpendZeroConfChange && !fRejectLongChains && SelectCoinsMinConf(nTargetValue - nValueFromPresetInputs, 0, 1, std::numeric_limits<uint64_t>::max(), vCoins, setCoinsRet, nValueRet));
+        SelectCoinsMinConf(nTargetValue - nValueFromPresetInputs, 1, 6, 0, vCoins, setCoinsRet, nValueRet, nChangeWindow) ||
+        SelectCoinsMinConf(nTargetValue - nValueFromPresetInputs, 1, 1, 0, vCoins, setCoinsRet, nValueRet, nChangeWindow) ||
+        (bSpendZeroConfChange && SelectCoinsMinConf(nTargetValue - nValueFromPresetInputs, 0, 1, 2, vCoins, setCoinsRet, nValueRet, nChangeWindow)) ||
+        (bSpendZeroConfChange && SelectCoinsMinConf(nTargetValue - nValueFromPresetInputs, 0, 1, std::min((size_t)4, nMaxChainLength/3), vCoins, setCoinsRet, nValueRet, nChangeWindow)) ||
+        (bSpendZeroConfChange && SelectCoinsMinConf(nTargetValue - nValueFromPresetInputs, 0, 1, nMaxChainLength/2, vCoins, setCoinsRet, nValueRet, nChangeWindow)) ||
+        (bSpendZeroConfChange && SelectCoinsMinConf(nTargetValue - nValueFromPresetInputs, 0, 1, nMaxChainLength, vCoins, setCoinsRet, nValueRet, nChangeWindow)) ||
+        (bSpendZeroConfChange && !fRejectLongChains && SelectCoinsMinConf(nTargetValue - nValueFromPresetInputs, 0, 1, std::numeric_limits<uint64_t>::max(), vCoins, setCoinsRet, nValueRet, nChangeWindow));
 
     // because SelectCoinsMinConf clears the setCoinsRet, we now add the possible inputs to the coinset
     setCoinsRet.insert(setPresetCoins.begin(), setPresetCoins.end());
@@ -2781,6 +3495,9 @@ bool CWallet::CreateTransaction(const std::vector<CRecipient>& vecSend, CWalletT
             size_t change_prototype_size = GetSerializeSize(change_prototype_txout, SER_DISK, 0);
 
             CFeeRate discard_rate = GetDiscardRate(::feeEstimator);
+            // Change below the dust threshold is added to the fee, so inputs
+            // that overshoot the target by less still need no change output
+            CAmount nChangeWindow = std::max<CAmount>(0, GetDustThreshold(change_prototype_txout, discard_rate) - 1);
             nFeeRet = 0;
             bool pick_new_inputs = true;
             CAmount nValueIn = 0;
@@ -2832,7 +3549,7 @@ bool CWallet::CreateTransaction(const std::vector<CRecipient>& vecSend, CWalletT
                 if (pick_new_inputs) {
                     nValueIn = 0;
                     setCoins.clear();
-                    if (!SelectCoins(vAvailableCoins, nValueToSelect, setCoins, nValueIn, &coin_control))
+                    if (!SelectCoins(vAvailableCoins, nValueToSelect, setCoins, nValueIn, &coin_control, nChangeWindow))
                     {
                         strFailReason = _("Insufficient funds");
                         return false;
@@ -3418,28 +4135,68 @@ bool CWallet::TopUpKeyPool(unsigned int kpSize)
             // don't create extra internal keys
             missingInternal = 0;
         }
-        bool internal = false;
+        // Keys are generated and written in batches, each in one database
+        // transaction; external keys come first
+        const int64_t nTotal = missingInternal + missingExternal;
+        const bool fShowProgress = nTotal >= KEYPOOL_PROGRESS_MIN;
+        int64_t nDone = 0;
+        if (fShowProgress) {
+            ShowProgress(_("Generating keys..."), 0);
+        }
         CWalletDB walletdb(*dbw);
-        for (int64_t i = missingInternal + missingExternal; i--;)
-        {
-            if (i < missingInternal) {
-                internal = true;
-            }
-
-            assert(m_max_keypool_index < std::numeric_limits<int64_t>::max()); // How in the hell did you use so many keys?
-            int64_t index = ++m_max_keypool_index;
-
-            CPubKey pubkey(GenerateNewKey(walletdb, internal));
-            if (!walletdb.WritePool(index, CKeyPool(pubkey, internal))) {
-                throw std::runtime_error(std::string(__func__) + ": writing generated key failed");
-            }
+        for (bool internal : {false, true}) {
+            int64_t nMissing = internal ? missingInternal : missingExternal;
+            while (nMissing > 0) {
+                const unsigned int nBatch = std::min<int64_t>(nMissing, KEYPOOL_BATCH_SIZE);
+                if (!walletdb.TxnBegin()) {
+                    throw std::runtime_error(std::string(__func__) + ": starting database transaction failed");
+                }
+                // Undone if the batch does not make it to disk, so that the
+                // key pool never refers to entries that were not written
+                const CHDChain hdChainBefore = hdChain;
+                const int64_t nMaxIndexBefore = m_max_keypool_index;
+                std::vector<CKeyID> vAdded;
+                try {
+                    for (const CPubKey& pubkey : GenerateNewKeys(walletdb, nBatch, internal)) {
+                        assert(m_max_keypool_index < std::numeric_limits<int64_t>::max()); // How in the hell did you use so many keys?
+                        int64_t index = ++m_max_keypool_index;
+
+                        if (!walletdb.WritePool(index, CKeyPool(pubkey, internal))) {
+                            throw std::runtime_error(std::string(__func__) + ": writing generated key failed");
+                        }
 
-            if (internal) {
-                setInternalKeyPool.insert(index);
-            } else {
-                setExternalKeyPool.insert(index);
+                        if (internal) {
+                            setInternalKeyPool.insert(index);
+                        } else {
+                            setExternalKeyPool.insert(index);
+                        }
+                        m_pool_key_to_index[pubkey.GetID()] = index;
+                        vAdded.push_back(pubkey.GetID());
+                    }
+                    if (!walletdb.TxnCommit()) {
+                        throw std::runtime_error(std::string(__func__) + ": writing generated keys failed");
+                    }
+                } catch (...) {
+                    walletdb.TxnAbort();
+                    hdChain = hdChainBefore;
+                    for (int64_t index = nMaxIndexBefore + 1; index <= m_max_keypool_index; index++) {
+                        (internal ? setInternalKeyPool : setExternalKeyPool).erase(index);
+                    }
+                    for (const CKeyID& keyid : vAdded) {
+                        m_pool_key_to_index.erase(keyid);
+                    }
+                    m_max_keypool_index = nMaxIndexBefore;
+                    throw;
+                }
+                nMissing -= nBatch;
+                nDone += nBatch;
+                if (fShowProgress) {
+                    ShowProgress(_("Generating keys..."), std::max(1, std::min(99, (int)(nDone * 100 / nTotal))));
+                }
             }
-            m_pool_key_to_index[pubkey.GetID()] = index;
+        }
+        if (fShowProgress) {
+            ShowProgress(_("Generating keys..."), 100);
         }
         if (missingInternal + missingExternal > 0) {
             LogPrintf("keypool added %d keys (%d internal), size=%u (%u internal)\n", missingInternal + missingExternal, missingInternal, setInternalKeyPool.size() + setExternalKeyPool.size(), setInternalKeyPool.size());
@@ -4031,7 +4788,12 @@ CWallet* CWallet::CreateWalletFromFile(const std::string walletFile)
     if (gArgs.GetBoolArg("-zapwallettxes", false)) {
         uiInterface.InitMessage(_("Zapping all transactions from wallet..."));
 
-        std::unique_ptr<CWalletDBWrapper> dbw(new CWalletDBWrapper(&bitdb, walletFile));
+        std::string strError;
+        std::unique_ptr<CWalletDBWrapper> dbw = CWalletDBWrapper::Open(walletFile, strError);
+        if (!dbw) {
+            InitError(strError);
+            return nullptr;
+        }
         CWallet *tempWallet = new CWallet(std::move(dbw));
         DBErrors nZapWalletRet = tempWallet->ZapWalletTx(vWtx);
         if (nZapWalletRet != DB_LOAD_OK) {
@@ -4047,7 +4809,12 @@ CWallet* CWallet::CreateWalletFromFile(const std::string walletFile)
 
     int64_t nStart = GetTimeMillis();
     bool fFirstRun = true;
-    std::unique_ptr<CWalletDBWrapper> dbw(new CWalletDBWrapper(&bitdb, walletFile));
+    std::string strError;
+    std::unique_ptr<CWalletDBWrapper> dbw = CWalletDBWrapper::Open(walletFile, strError);
+    if (!dbw) {
+        InitError(strError);
+        return nullptr;
+    }
     CWallet *walletInstance = new CWallet(std::move(dbw));
     DBErrors nLoadWalletRet = walletInstance->LoadWallet(fFirstRun);
     if (nLoadWalletRet != DB_LOAD_OK)
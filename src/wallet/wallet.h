@@ -48,6 +48,10 @@ extern bool fCheckForUpdates;
 extern bool fBatchProcessingMode;
 
 static const unsigned int DEFAULT_KEYPOOL_SIZE = 1000;
+//! Keys TopUpKeyPool generates and writes per database transaction
+static const unsigned int KEYPOOL_BATCH_SIZE = 1000;
+//! Keypool refills of at least this many keys report their progress
+static const int64_t KEYPOOL_PROGRESS_MIN = 10000;
 //! -paytxfee default
 static const CAmount DEFAULT_TRANSACTION_FEE = 0;
 //! -fallbackfee default
@@ -62,6 +66,8 @@ static const CAmount WALLET_INCREMENTAL_RELAY_FEE = 5000;
 static const CAmount MIN_CHANGE = CENT * BTC_2_BCX_RATE;
 //! final minimum change amount after paying for fees
 static const CAmount MIN_FINAL_CHANGE = MIN_CHANGE/2;
+//! search steps the branch and bound coin selection may take
+static const int BNB_TOTAL_TRIES = 100000;
 //! Default for -spendzeroconfchange
 static const bool DEFAULT_SPEND_ZEROCONF_CHANGE = true;
 //! Default for -zerobalanceaddresstoken
@@ -96,6 +102,8 @@ class CBlockPolicyEstimator;
 class CWalletTx;
 class CTokenTx;
 class CContractBookData;
+class CWalletScanFilter;
+struct TxExecRecordInfo;
 struct FeeCalculation;
 enum class FeeEstimateMode;
 
@@ -443,18 +451,7 @@ public:
     }
 
     //! make sure balances are recalculated
-    void MarkDirty()
-    {
-        fCreditCached = false;
-        fAvailableCreditCached = false;
-        fImmatureCreditCached = false;
-        fWatchDebitCached = false;
-        fWatchCreditCached = false;
-        fAvailableWatchCreditCached = false;
-        fImmatureWatchCreditCached = false;
-        fDebitCached = false;
-        fChangeCached = false;
-    }
+    void MarkDirty() const;
 
     void BindWallet(CWallet *pwalletIn)
     {
@@ -664,6 +661,41 @@ private:
     std::vector<char> _ssExtra;
 };
 
+/** Wallet balances, split the same way as CWallet::GetBalance and friends */
+struct CWalletBalance
+{
+    CAmount nTrusted;
+    CAmount nUntrusted;
+    CAmount nImmature;
+    CAmount nWatchTrusted;
+    CAmount nWatchUntrusted;
+    CAmount nWatchImmature;
+
+    CWalletBalance() : nTrusted(0), nUntrusted(0), nImmature(0), nWatchTrusted(0), nWatchUntrusted(0), nWatchImmature(0) {}
+
+    CWalletBalance& operator+=(const CWalletBalance& b)
+    {
+        nTrusted += b.nTrusted;
+        nUntrusted += b.nUntrusted;
+        nImmature += b.nImmature;
+        nWatchTrusted += b.nWatchTrusted;
+        nWatchUntrusted += b.nWatchUntrusted;
+        nWatchImmature += b.nWatchImmature;
+        return *this;
+    }
+
+    CWalletBalance& operator-=(const CWalletBalance& b)
+    {
+        nTrusted -= b.nTrusted;
+        nUntrusted -= b.nUntrusted;
+        nImmature -= b.nImmature;
+        nWatchTrusted -= b.nWatchTrusted;
+        nWatchUntrusted -= b.nWatchUntrusted;
+        nWatchImmature -= b.nWatchImmature;
+        return *this;
+    }
+};
+
 
 /** 
  * A CWallet is an extension of a keystore, which also maintains a set of transactions and balances,
@@ -681,7 +713,7 @@ private:
      * all coins from coinControl are selected; Never select unconfirmed coins
      * if they are not ours
      */
-    bool SelectCoins(const std::vector<COutput>& vAvailableCoins, const CAmount& nTargetValue, std::set<CInputCoin>& setCoinsRet, CAmount& nValueRet, const CCoinControl *coinControl = nullptr) const;
+    bool SelectCoins(const std::vector<COutput>& vAvailableCoins, const CAmount& nTargetValue, std::set<CInputCoin>& setCoinsRet, CAmount& nValueRet, const CCoinControl *coinControl = nullptr, const CAmount& nChangeWindow = 0) const;
 
     CWalletDB *pwalletdbEncryption;
 
@@ -712,6 +744,50 @@ private:
 
     void SyncMetaData(std::pair<TxSpends::iterator, TxSpends::iterator>);
 
+    /* Build the rescan prefilter from the whole wallet */
+    void InitScanFilter(CWalletScanFilter& filter);
+    /* Add what the wallet gained since the rescan prefilter was built or last updated */
+    void UpdateScanFilter(CWalletScanFilter& filter);
+
+    /**
+     * Key and script IDs, hashes of watch-only scripts and transaction ids
+     * added to the wallet while a rescan runs, so that UpdateScanFilter can
+     * extend its prefilter without walking the whole keystore again.
+     */
+    std::vector<uint160> vScanFilterIds;
+    std::vector<uint160> vScanFilterWatchOnly;
+    std::vector<uint256> vScanFilterTxids;
+
+    /**
+     * Outputs of wallet transactions that are ours and may still be unspent,
+     * with their IsMine, so AvailableCoins does not have to walk the whole
+     * wallet history. AvailableCoins drops entries it finds spent; a spend
+     * that gets conflicted or abandoned puts the outputs it spent back.
+     */
+    mutable std::map<COutPoint, isminetype> mapWalletUnspent;
+    //! Set when IsMine of existing outputs may have changed, e.g. by an import
+    mutable bool fUnspentIndexStale;
+    void AddToUnspentIndex(const CWalletTx& wtx) const;
+    void RebuildUnspentIndex() const;
+
+    /**
+     * Running balance totals. Transactions that are confirmed and mature (or
+     * conflicted) only change balance when they are marked dirty, so their
+     * amounts are kept summed in balanceSettled. The rest, unconfirmed and
+     * immature transactions, are summed again when the tip or the mempool
+     * changed, and move to the settled set once they are confirmed and mature.
+     */
+    mutable CWalletBalance balanceSettled;
+    mutable std::map<uint256, CWalletBalance> mapBalanceSettled;
+    mutable CWalletBalance balancePending;
+    mutable std::set<uint256> setBalancePending;
+    mutable std::set<uint256> setBalanceDirty;
+    mutable const CBlockIndex* pindexBalanceTip;
+    mutable unsigned int nBalanceMempoolUpdated;
+    //! Sum all transactions again, e.g. after an import or a reorg
+    mutable bool fBalanceStale;
+    CWalletBalance GetTxBalance(const CWalletTx& wtx) const;
+
     /* Used by TransactionAddedToMemorypool/BlockConnected/Disconnected.
      * Should be called with pindexBlock and posInBlock if this is for a transaction that is included in a block. */
     void SyncTransaction(const CTransactionRef& tx, const CBlockIndex *pindex = nullptr, int posInBlock = 0);
@@ -721,6 +797,8 @@ private:
 
     /* HD derive new child key (on internal or external chain) */
     void DeriveNewChildKey(CWalletDB &walletdb, CKeyMetadata& metadata, CKey& secret, bool internal = false);
+    /* Derive the HD chain key m/0'/0' (external) or m/0'/1' (internal) */
+    void DeriveChainKey(CExtKey& chainChildKey, bool internal);
 
     std::set<int64_t> setInternalKeyPool;
     std::set<int64_t> setExternalKeyPool;
@@ -812,6 +890,10 @@ public:
         nRelockTime = 0;
         fAbortRescan = false;
         fScanningWallet = false;
+        fUnspentIndexStale = true;
+        pindexBalanceTip = nullptr;
+        nBalanceMempoolUpdated = 0;
+        fBalanceStale = true;
     }
 
     std::map<uint256, CWalletTx> mapWallet;
@@ -861,11 +943,13 @@ public:
 
     /**
      * Shuffle and select coins until nTargetValue is reached while avoiding
-     * small change; This method is stochastic for some inputs and upon
+     * small change; A subset overshooting nTargetValue by at most
+     * nChangeWindow is searched for first, as it needs no change at all.
+     * Otherwise this method is stochastic for some inputs and upon
      * completion the coin set and corresponding actual target value is
      * assembled
      */
-    bool SelectCoinsMinConf(const CAmount& nTargetValue, int nConfMine, int nConfTheirs, uint64_t nMaxAncestors, std::vector<COutput> vCoins, std::set<CInputCoin>& setCoinsRet, CAmount& nValueRet) const;
+    bool SelectCoinsMinConf(const CAmount& nTargetValue, int nConfMine, int nConfTheirs, uint64_t nMaxAncestors, std::vector<COutput> vCoins, std::set<CInputCoin>& setCoinsRet, CAmount& nValueRet, const CAmount& nChangeWindow = 0) const;
 
     bool IsSpent(const uint256& hash, unsigned int n) const;
 
@@ -887,6 +971,11 @@ public:
      * Generate a new key
      */
     CPubKey GenerateNewKey(CWalletDB& walletdb, bool internal = false);
+    /**
+     * Generate nCount new keys, like GenerateNewKey. HD keys are derived
+     * on multiple threads and the chain counter is written once.
+     */
+    std::vector<CPubKey> GenerateNewKeys(CWalletDB& walletdb, unsigned int nCount, bool internal = false);
     //! Adds a key to the store, and saves it to disk.
     bool AddKeyPubKey(const CKey& key, const CPubKey &pubkey) override;
     bool AddKeyPubKeyWithDB(CWalletDB &walletdb,const CKey& key, const CPubKey &pubkey);
@@ -919,6 +1008,8 @@ public:
     //! Adds a watch-only address to the store, and saves it to disk.
     bool AddWatchOnly(const CScript& dest, int64_t nCreateTime);
     bool RemoveWatchOnly(const CScript &dest) override;
+    //! Removes a watch-only address, erasing it through walletdb, e.g. within its transaction
+    bool RemoveWatchOnlyWithDB(CWalletDB &walletdb, const CScript &dest);
     //! Adds a watch-only address to the store, without saving it to disk (used by LoadWallet)
     bool LoadWatchOnly(const CScript &dest);
 
@@ -949,11 +1040,14 @@ public:
     bool GetAccountPubkey(CPubKey &pubKey, std::string strAccount, bool bForceNew = false);
 
     void MarkDirty();
+    //! Have GetBalances recompute what a transaction adds to the balances
+    void MarkBalanceDirty(const uint256& hash) const;
     bool AddToWallet(const CWalletTx& wtxIn, bool fFlushOnClose=true);
     bool LoadToWallet(const CWalletTx& wtxIn);
     void TransactionAddedToMempool(const CTransactionRef& tx) override;
     void BlockConnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex *pindex, const std::vector<CTransactionRef>& vtxConflicted) override;
     void BlockDisconnected(const std::shared_ptr<const CBlock>& pblock) override;
+    void ContractReceiptsConnected(const CBlockIndex *pindex, const std::vector<TxExecRecordInfo>& receipts) override;
     bool AddToWalletIfInvolvingMe(const CTransactionRef& tx, const CBlockIndex* pIndex, int posInBlock, bool fUpdate);
     int64_t RescanFromTime(int64_t startTime, bool update);
     CBlockIndex* ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate = false);
@@ -961,6 +1055,7 @@ public:
     void ResendWalletTransactions(int64_t nBestBlockTime, CConnman* connman) override;
     // ResendWalletTransactionsBefore may only be called if fBroadcastTransactions!
     std::vector<uint256> ResendWalletTransactionsBefore(int64_t nTime, CConnman* connman);
+    CWalletBalance GetBalances() const;
     CAmount GetBalance() const;
     CAmount GetUnconfirmedBalance() const;
     CAmount GetImmatureBalance() const;
@@ -7,8 +7,13 @@
 
 #include "zmqconfig.h"
 
+#include <memory>
+#include <vector>
+
+class CBlock;
 class CBlockIndex;
 class CZMQAbstractNotifier;
+struct TxExecRecordInfo;
 
 typedef CZMQAbstractNotifier* (*CZMQNotifierFactory)();
 
@@ -32,8 +37,10 @@ public:
     virtual bool Initialize(void *pcontext) = 0;
     virtual void Shutdown() = 0;
 
-    virtual bool NotifyBlock(const CBlockIndex *pindex);
+    //! pblock is the block of pindex if it is at hand, or null
+    virtual bool NotifyBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock> &pblock);
     virtual bool NotifyTransaction(const CTransaction &transaction);
+    virtual bool NotifyContractReceipts(const CBlockIndex *pindex, const std::vector<TxExecRecordInfo> &receipts);
 
 protected:
     void *psocket;
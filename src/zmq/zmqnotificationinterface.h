@@ -9,6 +9,8 @@
 #include <string>
 #include <map>
 #include <list>
+#include <memory>
+#include <mutex>
 
 class CBlockIndex;
 class CZMQAbstractNotifier;
@@ -29,12 +31,17 @@ protected:
     void BlockConnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindexConnected, const std::vector<CTransactionRef>& vtxConflicted) override;
     void BlockDisconnected(const std::shared_ptr<const CBlock>& pblock) override;
     void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload) override;
+    void ContractReceiptsConnected(const CBlockIndex *pindex, const std::vector<TxExecRecordInfo> &receipts) override;
 
 private:
     CZMQNotificationInterface();
 
     void *pcontext;
     std::list<CZMQAbstractNotifier*> notifiers;
+
+    //! The last block connected, handed to the notifiers if it becomes the tip
+    std::mutex csLastConnected;
+    std::shared_ptr<const CBlock> pblockLastConnected;
 };
 
 #endif // BITCOIN_ZMQ_ZMQNOTIFICATIONINTERFACE_H
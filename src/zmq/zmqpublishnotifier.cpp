@@ -4,18 +4,171 @@
 
 #include "chain.h"
 #include "chainparams.h"
+#include "contract/txexecrecord.h"
+#include "lockfreequeue.h"
 #include "streams.h"
 #include "zmqpublishnotifier.h"
 #include "validation.h"
 #include "util.h"
 #include "rpc/server.h"
 
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
 static std::multimap<std::string, CZMQAbstractPublishNotifier*> mapPublishNotifiers;
 
 static const char *MSG_HASHBLOCK = "hashblock";
 static const char *MSG_HASHTX    = "hashtx";
 static const char *MSG_RAWBLOCK  = "rawblock";
 static const char *MSG_RAWTX     = "rawtx";
+static const char *MSG_CONTRACTRECEIPT = "contractreceipt";
+static const char *MSG_CONTRACTLOG     = "contractlog";
+
+/** A message waiting for the publisher thread */
+struct CZMQQueuedMessage
+{
+    CZMQAbstractPublishNotifier *notifier;
+    const char *command;
+    uint32_t nSequence;
+    std::vector<unsigned char> data;
+    //! Block messages are serialized by the publisher thread
+    const CBlockIndex *pindex;
+    std::shared_ptr<const CBlock> pblock;
+};
+
+class CZMQPublisher
+{
+private:
+    CLockFreeQueue<std::unique_ptr<CZMQQueuedMessage>> queue;
+    std::mutex cs;
+    std::condition_variable cond;
+    bool fRunning;
+    std::thread thread;
+    //! Last block serialized, for rawblock notifiers on several addresses
+    uint256 hashLastBlock;
+    CDataStream ssLastBlock;
+
+    bool SerializeBlock(const CZMQQueuedMessage &msg)
+    {
+        const uint256 hash = msg.pindex->GetBlockHash();
+        if (hash == hashLastBlock && !ssLastBlock.empty())
+            return true;
+        hashLastBlock.SetNull();
+        ssLastBlock.clear();
+        if (msg.pblock) {
+            ssLastBlock << *msg.pblock;
+        } else {
+            LOCK(cs_main);
+            CBlock block;
+            if (!ReadBlockFromDisk(block, msg.pindex, Params().GetConsensus()))
+            {
+                zmqError("Can't read block from disk");
+                return false;
+            }
+            ssLastBlock << block;
+        }
+        hashLastBlock = hash;
+        return true;
+    }
+
+    void Send(const CZMQQueuedMessage &msg)
+    {
+        if (msg.pindex) {
+            if (!SerializeBlock(msg)) {
+                msg.notifier->nFailed++;
+                return;
+            }
+            msg.notifier->Publish(msg.command, ssLastBlock.data(), ssLastBlock.size(), msg.nSequence);
+        } else {
+            msg.notifier->Publish(msg.command, msg.data.data(), msg.data.size(), msg.nSequence);
+        }
+    }
+
+    void ThreadPublish()
+    {
+        RenameThread("bitcoin-zmqpub");
+        std::unique_ptr<CZMQQueuedMessage> msg;
+        while (true) {
+            if (queue.TryPop(msg)) {
+                Send(*msg);
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(cs);
+            if (queue.Size() > 0)
+                continue;
+            // Whatever was queued before stopping has been sent
+            if (!fRunning)
+                break;
+            cond.wait(lock);
+        }
+    }
+
+public:
+    explicit CZMQPublisher(size_t nCapacity) : queue(nCapacity), fRunning(true), ssLastBlock(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags())
+    {
+        thread = std::thread(&CZMQPublisher::ThreadPublish, this);
+    }
+
+    ~CZMQPublisher()
+    {
+        {
+            std::lock_guard<std::mutex> lock(cs);
+            fRunning = false;
+        }
+        cond.notify_one();
+        thread.join();
+    }
+
+    bool Push(std::unique_ptr<CZMQQueuedMessage> msg)
+    {
+        if (!queue.TryPush(std::move(msg)))
+            return false;
+        // Taking the lock orders the push before the publisher's emptiness check
+        {
+            std::lock_guard<std::mutex> lock(cs);
+        }
+        cond.notify_one();
+        return true;
+    }
+
+    void GetInfo(CZMQPublishQueueInfo &info) const
+    {
+        info.nDepth = queue.Size();
+        info.nCapacity = queue.Capacity();
+    }
+};
+
+static std::unique_ptr<CZMQPublisher> g_zmq_publisher;
+
+void StartZMQPublisher()
+{
+    assert(!g_zmq_publisher);
+    g_zmq_publisher.reset(new CZMQPublisher(ZMQ_PUBLISH_QUEUE_SIZE));
+}
+
+void StopZMQPublisher()
+{
+    g_zmq_publisher.reset();
+}
+
+bool GetZMQPublishQueueInfo(CZMQPublishQueueInfo &info)
+{
+    if (!g_zmq_publisher)
+        return false;
+    g_zmq_publisher->GetInfo(info);
+    return true;
+}
+
+std::vector<CZMQPublishNotifierInfo> GetZMQPublishNotifierInfo()
+{
+    std::vector<CZMQPublishNotifierInfo> vInfo;
+    for (const std::pair<const std::string, CZMQAbstractPublishNotifier*>& item : mapPublishNotifiers) {
+        const CZMQAbstractPublishNotifier *notifier = item.second;
+        vInfo.push_back(CZMQPublishNotifierInfo{notifier->GetType(), notifier->GetAddress(), notifier->nPublished, notifier->nDropped, notifier->nFailed});
+    }
+    return vInfo;
+}
 
 // Internal function to send multipart message
 static int zmq_send_multipart(void *sock, const void* data, size_t size, ...)
@@ -133,20 +286,52 @@ bool CZMQAbstractPublishNotifier::SendMessage(const char *command, const void* d
 {
     assert(psocket);
 
+    std::unique_ptr<CZMQQueuedMessage> msg(new CZMQQueuedMessage());
+    msg->notifier = this;
+    msg->command = command;
+    msg->nSequence = nSequence++;
+    msg->data.assign((const unsigned char*)data, (const unsigned char*)data + size);
+    msg->pindex = nullptr;
+    // A dropped message leaves a gap in the sequence numbers, but the
+    // notifier stays up
+    if (!g_zmq_publisher || !g_zmq_publisher->Push(std::move(msg)))
+        nDropped++;
+    return true;
+}
+
+bool CZMQAbstractPublishNotifier::SendBlock(const char *command, const CBlockIndex *pindex, const std::shared_ptr<const CBlock> &pblock)
+{
+    assert(psocket);
+
+    std::unique_ptr<CZMQQueuedMessage> msg(new CZMQQueuedMessage());
+    msg->notifier = this;
+    msg->command = command;
+    msg->nSequence = nSequence++;
+    msg->pindex = pindex;
+    msg->pblock = pblock;
+    if (!g_zmq_publisher || !g_zmq_publisher->Push(std::move(msg)))
+        nDropped++;
+    return true;
+}
+
+bool CZMQAbstractPublishNotifier::Publish(const char *command, const void* data, size_t size, uint32_t nSequenceIn)
+{
+    assert(psocket);
+
     /* send three parts, command & data & a LE 4byte sequence number */
     unsigned char msgseq[sizeof(uint32_t)];
-    WriteLE32(&msgseq[0], nSequence);
+    WriteLE32(&msgseq[0], nSequenceIn);
     int rc = zmq_send_multipart(psocket, command, strlen(command), data, size, msgseq, (size_t)sizeof(uint32_t), (void*)0);
-    if (rc == -1)
+    if (rc == -1) {
+        nFailed++;
         return false;
+    }
 
-    /* increment memory only sequence number after sending */
-    nSequence++;
-
+    nPublished++;
     return true;
 }
 
-bool CZMQPublishHashBlockNotifier::NotifyBlock(const CBlockIndex *pindex)
+bool CZMQPublishHashBlockNotifier::NotifyBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock> &/*pblock*/)
 {
     uint256 hash = pindex->GetBlockHash();
     LogPrint(BCLog::ZMQ, "zmq: Publish hashblock %s\n", hash.GetHex());
@@ -166,25 +351,10 @@ bool CZMQPublishHashTransactionNotifier::NotifyTransaction(const CTransaction &t
     return SendMessage(MSG_HASHTX, data, 32);
 }
 
-bool CZMQPublishRawBlockNotifier::NotifyBlock(const CBlockIndex *pindex)
+bool CZMQPublishRawBlockNotifier::NotifyBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock> &pblock)
 {
     LogPrint(BCLog::ZMQ, "zmq: Publish rawblock %s\n", pindex->GetBlockHash().GetHex());
-
-    const Consensus::Params& consensusParams = Params().GetConsensus();
-    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
-    {
-        LOCK(cs_main);
-        CBlock block;
-        if(!ReadBlockFromDisk(block, pindex, consensusParams))
-        {
-            zmqError("Can't read block from disk");
-            return false;
-        }
-
-        ss << block;
-    }
-
-    return SendMessage(MSG_RAWBLOCK, &(*ss.begin()), ss.size());
+    return SendBlock(MSG_RAWBLOCK, pindex, pblock);
 }
 
 bool CZMQPublishRawTransactionNotifier::NotifyTransaction(const CTransaction &transaction)
@@ -195,3 +365,53 @@ bool CZMQPublishRawTransactionNotifier::NotifyTransaction(const CTransaction &tr
     ss << transaction;
     return SendMessage(MSG_RAWTX, &(*ss.begin()), ss.size());
 }
+
+static void WriteBytes(CDataStream& ss, const dev::bytes& vch)
+{
+    ss.write((const char*)vch.data(), vch.size());
+}
+
+/** Where a receipt or log comes from: block hash, height, txid and position in the block */
+static void WriteReceiptOrigin(CDataStream& ss, const TxExecRecordInfo& receipt)
+{
+    ss << receipt.blockHash << receipt.blockNumber << receipt.transactionHash << receipt.transactionIndex;
+}
+
+bool CZMQPublishContractReceiptNotifier::NotifyContractReceipts(const CBlockIndex *pindex, const std::vector<TxExecRecordInfo> &receipts)
+{
+    LogPrint(BCLog::ZMQ, "zmq: Publish %u contractreceipt for block %s\n", receipts.size(), pindex->GetBlockHash().GetHex());
+    for (const TxExecRecordInfo& receipt : receipts) {
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+        WriteReceiptOrigin(ss, receipt);
+        WriteBytes(ss, receipt.from.asBytes());
+        WriteBytes(ss, receipt.to.asBytes());
+        ss << receipt.cumulativeGasUsed << receipt.gasUsed;
+        WriteBytes(ss, receipt.contractAddress.asBytes());
+        ss << (uint32_t)receipt.excepted << (uint32_t)receipt.logs.size();
+        if (!SendMessage(MSG_CONTRACTRECEIPT, &(*ss.begin()), ss.size()))
+            return false;
+    }
+    return true;
+}
+
+bool CZMQPublishContractLogNotifier::NotifyContractReceipts(const CBlockIndex *pindex, const std::vector<TxExecRecordInfo> &receipts)
+{
+    LogPrint(BCLog::ZMQ, "zmq: Publish contractlog for block %s\n", pindex->GetBlockHash().GetHex());
+    for (const TxExecRecordInfo& receipt : receipts) {
+        for (size_t i = 0; i < receipt.logs.size(); i++) {
+            const dev::eth::LogEntry& log = receipt.logs[i];
+            CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+            WriteReceiptOrigin(ss, receipt);
+            ss << (uint32_t)i;
+            WriteBytes(ss, log.address.asBytes());
+            WriteCompactSize(ss, log.topics.size());
+            for (const dev::h256& topic : log.topics)
+                WriteBytes(ss, topic.asBytes());
+            WriteCompactSize(ss, log.data.size());
+            WriteBytes(ss, log.data);
+            if (!SendMessage(MSG_CONTRACTLOG, &(*ss.begin()), ss.size()))
+                return false;
+        }
+    }
+    return true;
+}
@@ -7,16 +7,31 @@
 
 #include "zmqabstractnotifier.h"
 
+#include <atomic>
+
 class CBlockIndex;
 
+//! Messages the publisher thread can hold before new ones are dropped
+static const size_t ZMQ_PUBLISH_QUEUE_SIZE = 4096;
+
+/**
+ * Publish notifiers hand their messages to a single publisher thread, so a
+ * slow socket or a block read never holds up validation. When its queue is
+ * full, messages are dropped; subscribers see the gap in sequence numbers.
+ */
 class CZMQAbstractPublishNotifier : public CZMQAbstractNotifier
 {
 private:
     uint32_t nSequence; //!< upcounting per message sequence number
 
 public:
+    std::atomic<uint64_t> nPublished; //!< messages sent on the socket
+    std::atomic<uint64_t> nDropped;   //!< messages dropped because the queue was full
+    std::atomic<uint64_t> nFailed;    //!< messages the socket did not take
+
+    CZMQAbstractPublishNotifier() : nSequence(0U), nPublished(0), nDropped(0), nFailed(0) {}
 
-    /* send zmq multipart message
+    /* queue zmq multipart message
        parts:
           * command
           * data
@@ -24,14 +39,46 @@ public:
     */
     bool SendMessage(const char *command, const void* data, size_t size);
 
+    /* queue a block, read and serialized by the publisher thread unless
+       pblock has it already */
+    bool SendBlock(const char *command, const CBlockIndex *pindex, const std::shared_ptr<const CBlock> &pblock);
+
+    /* send a message on the socket; called by the publisher thread */
+    bool Publish(const char *command, const void* data, size_t size, uint32_t nSequenceIn);
+
     bool Initialize(void *pcontext) override;
     void Shutdown() override;
 };
 
+struct CZMQPublishQueueInfo
+{
+    size_t nDepth;
+    size_t nCapacity;
+};
+
+/** Start and stop the publisher thread, around the notifier sockets' lifetime */
+void StartZMQPublisher();
+void StopZMQPublisher();
+
+/** State of the publisher queue. Returns false if the publisher is not running. */
+bool GetZMQPublishQueueInfo(CZMQPublishQueueInfo& info);
+
+struct CZMQPublishNotifierInfo
+{
+    std::string type;
+    std::string address;
+    uint64_t nPublished;
+    uint64_t nDropped;
+    uint64_t nFailed;
+};
+
+/** Counters of the publish notifiers that are up */
+std::vector<CZMQPublishNotifierInfo> GetZMQPublishNotifierInfo();
+
 class CZMQPublishHashBlockNotifier : public CZMQAbstractPublishNotifier
 {
 public:
-    bool NotifyBlock(const CBlockIndex *pindex) override;
+    bool NotifyBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock> &pblock) override;
 };
 
 class CZMQPublishHashTransactionNotifier : public CZMQAbstractPublishNotifier
@@ -43,7 +90,7 @@ public:
 class CZMQPublishRawBlockNotifier : public CZMQAbstractPublishNotifier
 {
 public:
-    bool NotifyBlock(const CBlockIndex *pindex) override;
+    bool NotifyBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock> &pblock) override;
 };
 
 class CZMQPublishRawTransactionNotifier : public CZMQAbstractPublishNotifier
@@ -52,4 +99,18 @@ public:
     bool NotifyTransaction(const CTransaction &transaction) override;
 };
 
+/** Publishes one message per contract execution receipt of a connected block */
+class CZMQPublishContractReceiptNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyContractReceipts(const CBlockIndex *pindex, const std::vector<TxExecRecordInfo> &receipts) override;
+};
+
+/** Publishes one message per log entry emitted by the contracts of a connected block */
+class CZMQPublishContractLogNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyContractReceipts(const CBlockIndex *pindex, const std::vector<TxExecRecordInfo> &receipts) override;
+};
+
 #endif // BITCOIN_ZMQ_ZMQPUBLISHNOTIFIER_H
@@ -0,0 +1,73 @@
+// Copyright (c) 2015-2016 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "zmq/zmqrpc.h"
+
+#include "rpc/server.h"
+#include "utilstrencodings.h"
+#include "zmq/zmqpublishnotifier.h"
+
+#include <univalue.h>
+
+UniValue getzmqnotifications(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 0)
+        throw std::runtime_error(
+                "getzmqnotifications\n"
+                        "\nReturns the active ZMQ notifications and the state of the publisher queue.\n"
+                        "\nResult:\n"
+                        "{\n"
+                        "  \"queue\": {\n"
+                        "    \"depth\": n,           (numeric) Messages waiting to be published\n"
+                        "    \"capacity\": n         (numeric) Messages the queue holds before dropping new ones\n"
+                        "  },\n"
+                        "  \"notifications\": [\n"
+                        "    {\n"
+                        "      \"type\": \"pubhashtx\",  (string) Type of notification\n"
+                        "      \"address\": \"...\",     (string) Address of the publisher\n"
+                        "      \"published\": n,       (numeric) Messages sent\n"
+                        "      \"dropped\": n,         (numeric) Messages dropped because the queue was full\n"
+                        "      \"failed\": n           (numeric) Messages that could not be built or sent\n"
+                        "    },\n"
+                        "    ...\n"
+                        "  ]\n"
+                        "}\n"
+                        "\nExamples:\n"
+                + HelpExampleCli("getzmqnotifications", "")
+                + HelpExampleRpc("getzmqnotifications", "")
+        );
+
+    UniValue result(UniValue::VOBJ);
+    CZMQPublishQueueInfo queueInfo;
+    if (GetZMQPublishQueueInfo(queueInfo)) {
+        UniValue queue(UniValue::VOBJ);
+        queue.push_back(Pair("depth", (uint64_t)queueInfo.nDepth));
+        queue.push_back(Pair("capacity", (uint64_t)queueInfo.nCapacity));
+        result.push_back(Pair("queue", queue));
+    }
+    UniValue notifications(UniValue::VARR);
+    for (const CZMQPublishNotifierInfo& info : GetZMQPublishNotifierInfo()) {
+        UniValue obj(UniValue::VOBJ);
+        obj.push_back(Pair("type", info.type));
+        obj.push_back(Pair("address", info.address));
+        obj.push_back(Pair("published", info.nPublished));
+        obj.push_back(Pair("dropped", info.nDropped));
+        obj.push_back(Pair("failed", info.nFailed));
+        notifications.push_back(obj);
+    }
+    result.push_back(Pair("notifications", notifications));
+    return result;
+}
+
+static const CRPCCommand commands[] =
+{ //  category              name                      actor (function)         okSafeMode
+  //  --------------------- ------------------------  -----------------------  ----------
+    { "zmq",                "getzmqnotifications",    &getzmqnotifications,    true,  {} },
+};
+
+void RegisterZMQRPCCommands(CRPCTable &t)
+{
+    for (unsigned int vcidx = 0; vcidx < ARRAYLEN(commands); vcidx++)
+        t.appendCommand(commands[vcidx].name, &commands[vcidx]);
+}
@@ -4,15 +4,53 @@
 # file COPYING or http://www.opensource.org/licenses/mit-license.php.
 """Test the ZMQ API."""
 import configparser
+from io import BytesIO
 import os
 import struct
 
+from test_framework.mininode import deser_compact_size
 from test_framework.test_framework import BitcoinTestFramework, SkipTest
 from test_framework.util import (assert_equal,
                                  bytes_to_hex_str,
+                                 connect_nodes_bi,
                                  hash256,
+                                 wait_until,
                                 )
 
+# Contract whose code copies the call data into a LOG1 under a fixed topic
+LOG_TOPIC = "ab" * 32
+LOG_CONTRACT = "602c80600b6000396000f3" + "3660006000377f" + LOG_TOPIC + "366000a100"
+
+def parse_receipt_origin(f):
+    """Block hash, height, txid and position in the block that start every contract message."""
+    return {
+        "blockHash": bytes_to_hex_str(f.read(32)[::-1]),
+        "blockNumber": struct.unpack("<I", f.read(4))[0],
+        "transactionHash": bytes_to_hex_str(f.read(32)[::-1]),
+        "transactionIndex": struct.unpack("<I", f.read(4))[0],
+    }
+
+def parse_contract_receipt(body):
+    f = BytesIO(body)
+    receipt = parse_receipt_origin(f)
+    receipt["from"] = bytes_to_hex_str(f.read(20))
+    receipt["to"] = bytes_to_hex_str(f.read(20))
+    receipt["cumulativeGasUsed"], receipt["gasUsed"] = struct.unpack("<QQ", f.read(16))
+    receipt["contractAddress"] = bytes_to_hex_str(f.read(20))
+    receipt["excepted"], receipt["nLogs"] = struct.unpack("<II", f.read(8))
+    assert_equal(f.read(), b"")
+    return receipt
+
+def parse_contract_log(body):
+    f = BytesIO(body)
+    log = parse_receipt_origin(f)
+    log["index"] = struct.unpack("<I", f.read(4))[0]
+    log["address"] = bytes_to_hex_str(f.read(20))
+    log["topics"] = [bytes_to_hex_str(f.read(32)) for _ in range(deser_compact_size(f))]
+    log["data"] = bytes_to_hex_str(f.read(deser_compact_size(f)))
+    assert_equal(f.read(), b"")
+    return log
+
 class ZMQTest (BitcoinTestFramework):
     def set_test_params(self):
         self.num_nodes = 2
@@ -42,14 +80,21 @@ class ZMQTest (BitcoinTestFramework):
         self.zmqSubSocket.setsockopt(zmq.SUBSCRIBE, b"rawtx")
         ip_address = "tcp://127.0.0.1:28332"
         self.zmqSubSocket.connect(ip_address)
+        self.zmqContractSocket = self.zmqContext.socket(zmq.SUB)
+        self.zmqContractSocket.set(zmq.RCVTIMEO, 60000)
+        self.zmqContractSocket.setsockopt(zmq.SUBSCRIBE, b"contractreceipt")
+        self.zmqContractSocket.setsockopt(zmq.SUBSCRIBE, b"contractlog")
+        self.zmqContractSocket.connect(ip_address)
         self.extra_args = [['-zmqpubhashblock=%s' % ip_address, '-zmqpubhashtx=%s' % ip_address,
-                       '-zmqpubrawblock=%s' % ip_address, '-zmqpubrawtx=%s' % ip_address], []]
+                       '-zmqpubrawblock=%s' % ip_address, '-zmqpubrawtx=%s' % ip_address,
+                       '-zmqpubcontractreceipt=%s' % ip_address, '-zmqpubcontractlog=%s' % ip_address], []]
         self.add_nodes(self.num_nodes, self.extra_args)
         self.start_nodes()
 
     def run_test(self):
         try:
             self._zmq_test()
+            self._zmq_contract_test()
         finally:
             # Destroy the zmq context
             self.log.debug("Destroying zmq context")
@@ -149,5 +194,88 @@ class ZMQTest (BitcoinTestFramework):
         assert_equal(hashRPC, hashZMQ)  # txid from sendtoaddress must be equal to the hash received over zmq
         assert_equal(hashRPC, hashedZMQ)
 
+        self.log.info("Check the publisher counters")
+        # The counters move on the publishing thread, after the messages went out
+        def counters_caught_up():
+            info = self.nodes[0].getzmqnotifications()
+            published = {n["type"]: n["published"] for n in info["notifications"]}
+            return info["queue"]["depth"] == 0 and published["pubhashblock"] == published["pubrawblock"] == blockcount + 1
+        wait_until(counters_caught_up)
+        info = self.nodes[0].getzmqnotifications()
+        notifications = {n["type"]: n for n in info["notifications"]}
+        assert_equal(sorted(notifications), ["pubcontractlog", "pubcontractreceipt", "pubhashblock", "pubhashtx", "pubrawblock", "pubrawtx"])
+        for n in notifications.values():
+            assert_equal(n["dropped"], 0)
+            assert_equal(n["failed"], 0)
+        assert_equal(self.nodes[1].getzmqnotifications(), {"notifications": []})
+
+    def _zmq_contract_test(self):
+        node = self.nodes[0]
+
+        # Receipts are only recorded with -logevents, which takes a rebuilt chainstate to turn on
+        self.log.info("Restart node0 with -logevents")
+        height = node.getblockcount()
+        self.stop_node(0)
+        self.start_node(0, self.extra_args[0] + ['-logevents', '-reindex-chainstate'])
+        wait_until(lambda: node.getblockcount() == height)
+        connect_nodes_bi(self.nodes, 0, 1)
+
+        self.log.info("Activate contracts")
+        while node.getblockchaininfo()["bip9_softforks"]["contract"]["status"] != "active":
+            node.generate(144)
+        self.sync_all()
+
+        self.log.info("Deploy and call a contract")
+        created = node.createcontract(LOG_CONTRACT)
+        node.generate(1)
+        called = node.sendtocontract(created["address"], "deadbeef")
+        node.generate(1)
+        self.sync_all()
+
+        receipts = []
+        logs = []
+        while len(receipts) < 2 or len(logs) < 1:
+            msg = self.zmqContractSocket.recv_multipart()
+            topic = msg[0]
+            msgSequence = struct.unpack('<I', msg[-1])[-1]
+            if topic == b"contractreceipt":
+                assert_equal(msgSequence, len(receipts))
+                receipts.append(parse_contract_receipt(msg[1]))
+            else:
+                assert_equal(topic, b"contractlog")
+                assert_equal(msgSequence, len(logs))
+                logs.append(parse_contract_log(msg[1]))
+        assert_equal(len(receipts), 2)
+        assert_equal(len(logs), 1)
+
+        self.log.info("Check the receipts against getexecrecord")
+        records = []
+        for receipt, txid in zip(receipts, [created["txid"], called["txid"]]):
+            record = node.getexecrecord(txid)
+            assert_equal(len(record), 1)
+            record = record[0]
+            assert_equal(receipt["transactionHash"], txid)
+            for key in ["blockHash", "blockNumber", "transactionHash", "transactionIndex", "from", "to",
+                        "cumulativeGasUsed", "gasUsed", "contractAddress"]:
+                assert_equal(receipt[key], record[key])
+            assert_equal(record["excepted"], "None")
+            assert_equal(receipt["excepted"], 0)
+            assert_equal(receipt["nLogs"], len(record["log"]))
+            records.append(record)
+        assert_equal(receipts[0]["contractAddress"], created["address"])
+        assert_equal(receipts[1]["nLogs"], 1)
+
+        self.log.info("Check the log against getexecrecord")
+        log = logs[0]
+        record = records[1]
+        for key in ["blockHash", "blockNumber", "transactionHash", "transactionIndex"]:
+            assert_equal(log[key], record[key])
+        assert_equal(log["index"], 0)
+        for key in ["address", "topics", "data"]:
+            assert_equal(log[key], record["log"][0][key])
+        assert_equal(log["address"], created["address"])
+        assert_equal(log["topics"], [LOG_TOPIC])
+        assert_equal(log["data"], "deadbeef")
+
 if __name__ == '__main__':
     ZMQTest().main()